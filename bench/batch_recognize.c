@@ -0,0 +1,142 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+#include <time.h>
+
+#define BENCH_STRINGS 1000000
+#define BENCH_ROUNDS 5
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int gen_expr(char *out, int max, int depth);
+
+static int gen_factor(char *out, int max, int depth) {
+  if (max < 3 || depth <= 0 || rand() % 4 != 0) {
+    out[0] = "abcd"[rand() % 4];
+    return 1;
+  }
+
+  out[0] = '(';
+  int l = gen_expr(out + 1, max - 2, depth - 1);
+  out[l + 1] = ')';
+  return l + 2;
+}
+
+static int gen_term(char *out, int max, int depth) {
+  int l = gen_factor(out, max, depth);
+
+  while (l + 2 <= max && rand() % 3 == 0) {
+    out[l++] = '*';
+    l += gen_factor(out + l, max - l, depth);
+  }
+
+  return l;
+}
+
+static int gen_expr(char *out, int max, int depth) {
+  int l = gen_term(out, max, depth);
+
+  while (l + 2 <= max && rand() % 3 == 0) {
+    out[l++] = '+';
+    l += gen_term(out + l, max - l, depth);
+  }
+
+  return l;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : BENCH_STRINGS;
+
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'A', "CD");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'C', "I");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+
+  srand(42);
+
+  const char **strs = (const char **)malloc(sizeof(char *) * count);
+  int *lens = (int *)malloc(sizeof(int) * count);
+  char *data = (char *)malloc(sizeof(char) * count * 32);
+  unsigned char *batch = (unsigned char *)malloc((count + 7) / 8);
+  unsigned char *scalar = (unsigned char *)malloc((count + 7) / 8);
+  long bytes = 0;
+
+  for (int i = 0; i < count; i++) {
+    char *s = data + i * 32;
+    lens[i] = gen_expr(s, 31, 3);
+
+    // every fourth string gets one byte flipped to exercise the reject path
+    if (i % 4 == 0)
+      s[rand() % lens[i]] = "+*()abcdx"[rand() % 9];
+
+    strs[i] = s;
+    bytes += lens[i];
+  }
+
+  double scalar_best = 0, batch_best = 0;
+  int scalar_accepted = 0, batch_accepted = 0;
+
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    double start = now_seconds();
+
+    memset(scalar, 0, (count + 7) / 8);
+    scalar_accepted = 0;
+
+    for (int i = 0; i < count; i++) {
+      if (ll1_recognize(t, g->start_var, strs[i], lens[i]) == STRING_RECOGNIZE_SUCCESS) {
+        scalar[i / 8] |= 1 << (i % 8);
+        scalar_accepted++;
+      }
+    }
+
+    double elapsed = now_seconds() - start;
+    if (r == 0 || elapsed < scalar_best)
+      scalar_best = elapsed;
+
+    start = now_seconds();
+    batch_accepted = ll1_recognize_batch(t, g->start_var, strs, lens, count, batch);
+    elapsed = now_seconds() - start;
+    if (r == 0 || elapsed < batch_best)
+      batch_best = elapsed;
+  }
+
+  int same = memcmp(scalar, batch, (count + 7) / 8) == 0;
+
+  printf("strings: %d, bytes: %ld, accepted: %d\n", count, bytes,
+         scalar_accepted);
+  printf("scalar loop: %.3f ms, %.1f MB/s, %.1f M strings/s\n",
+         scalar_best * 1e3, bytes / scalar_best / 1e6,
+         count / scalar_best / 1e6);
+  printf("batch:       %.3f ms, %.1f MB/s, %.1f M strings/s\n",
+         batch_best * 1e3, bytes / batch_best / 1e6, count / batch_best / 1e6);
+  printf("results %s (batch accepted %d)\n", same ? "match" : "DIFFER",
+         batch_accepted);
+
+  free(strs);
+  free(lens);
+  free(data);
+  free(batch);
+  free(scalar);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  return same ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+#include <time.h>
+
+// grammars go from BENCH_MIN_PRODS up by BENCH_PRODS_STEP to the first
+// argument (default BENCH_MAX_PRODS). small grammars are analyzed repeatedly
+// until BENCH_PRODS_PER_RUN productions went through each phase. times are
+// the best run, peak MB is the process high-water mark during the phase, so it
+// includes the grammar itself.
+#define BENCH_MIN_PRODS 100
+#define BENCH_PRODS_STEP 10
+#define BENCH_MAX_PRODS 100000
+#define BENCH_PRODS_PER_RUN 200000
+#define BENCH_TERMINALS 16
+#define BENCH_FAN_OUT 64
+#define BENCH_NAME_LEN 32
+
+#define BENCH_PHASES 4
+
+typedef struct bench_shape {
+  const char *name;
+  grammar *(*gen)(int prods);
+} bench_shape;
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// writing 5 to clear_refs resets the peak, VmHWM then reports the peak since
+static void reset_peak_rss() {
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+
+  if (f != NULL) {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+static long peak_rss_kb() {
+  char line[256];
+  long kb = -1;
+  FILE *f = fopen("/proc/self/status", "r");
+
+  if (f == NULL)
+    return -1;
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0)
+      kb = atol(line + 6);
+  }
+
+  fclose(f);
+  return kb;
+}
+
+static symbol_id var_n(grammar *g, const char *prefix, int i) {
+  char name[BENCH_NAME_LEN];
+  int len = snprintf(name, sizeof(name), "%s%d", prefix, i);
+
+  return grammar_add_var(g, name, len);
+}
+
+static symbol_id terminal_n(grammar *g, int i) {
+  char name[BENCH_NAME_LEN];
+  int len = snprintf(name, sizeof(name), "t%d", i);
+
+  return grammar_add_terminal(g, name, len);
+}
+
+static void add_rhs(grammar *g, symbol_id var, symbol_id a, symbol_id b,
+                    symbol_id c) {
+  symbol_id syms[3] = {a, b, c};
+  int len = 0;
+
+  while (len < 3 && syms[len] != SYMBOL_NONE)
+    len++;
+
+  add_production_symbols(g, var, syms, len);
+}
+
+// C0 -> C1 t0, C1 -> C2 t1, ..., the last -> t: FIRST flows up a chain as
+// long as the grammar and every FOLLOW set is a single terminal
+static grammar *gen_chain(int prods) {
+  grammar *g = new_empty_grammar();
+
+  for (int i = 0; i < prods - 1; i++)
+    add_rhs(g, var_n(g, "C", i), var_n(g, "C", i + 1),
+            terminal_n(g, i % BENCH_TERMINALS), SYMBOL_NONE);
+
+  add_rhs(g, var_n(g, "C", prods - 1), terminal_n(g, 0), SYMBOL_NONE,
+          SYMBOL_NONE);
+  grammar_set_start_var(g, var_n(g, "C", 0));
+
+  return g;
+}
+
+// W0 -> t0 W1 | t1 W1 | ... BENCH_FAN_OUT alternatives per variable, so the
+// table rows are full and every FIRST set has BENCH_FAN_OUT terminals
+static grammar *gen_wide(int prods) {
+  grammar *g = new_empty_grammar();
+  int vars = prods / BENCH_FAN_OUT + 1;
+
+  for (int i = 0; i < vars; i++) {
+    symbol_id var = var_n(g, "W", i);
+
+    if (i == vars - 1) {
+      add_rhs(g, var, SYMBOL_NONE, SYMBOL_NONE, SYMBOL_NONE);
+      continue;
+    }
+
+    for (int k = 0; k < BENCH_FAN_OUT; k++)
+      add_rhs(g, var, terminal_n(g, k), var_n(g, "W", i + 1), SYMBOL_NONE);
+  }
+
+  grammar_set_start_var(g, var_n(g, "W", 0));
+
+  return g;
+}
+
+// E0 -> N0 E1, N0 -> eps, ...: every FIRST set is found behind a run of
+// nullable variables as long as the grammar
+static grammar *gen_epsilon(int prods) {
+  grammar *g = new_empty_grammar();
+  int vars = prods / 2 > 0 ? prods / 2 : 1;
+
+  for (int i = 0; i < vars - 1; i++) {
+    add_rhs(g, var_n(g, "E", i), var_n(g, "N", i), var_n(g, "E", i + 1),
+            SYMBOL_NONE);
+    add_rhs(g, var_n(g, "N", i), SYMBOL_NONE, SYMBOL_NONE, SYMBOL_NONE);
+  }
+
+  add_rhs(g, var_n(g, "E", vars - 1), terminal_n(g, 0), SYMBOL_NONE,
+          SYMBOL_NONE);
+  grammar_set_start_var(g, var_n(g, "E", 0));
+
+  return g;
+}
+
+// Dn -> t Dn-1 Xn | eps, Xn -> eps: FOLLOW of every D depends on the D
+// above it, and the variables are numbered against that direction
+static grammar *gen_follow(int prods) {
+  grammar *g = new_empty_grammar();
+  int vars = prods / 3 > 1 ? prods / 3 : 2;
+
+  for (int i = 0; i < vars; i++)
+    var_n(g, "D", i);
+
+  for (int i = vars - 1; i > 0; i--) {
+    symbol_id var = var_n(g, "D", i);
+
+    add_rhs(g, var, terminal_n(g, i % BENCH_TERMINALS), var_n(g, "D", i - 1),
+            var_n(g, "X", i));
+    add_rhs(g, var, SYMBOL_NONE, SYMBOL_NONE, SYMBOL_NONE);
+    add_rhs(g, var_n(g, "X", i), SYMBOL_NONE, SYMBOL_NONE, SYMBOL_NONE);
+  }
+
+  add_rhs(g, var_n(g, "D", 0), terminal_n(g, 0), SYMBOL_NONE, SYMBOL_NONE);
+  grammar_set_start_var(g, var_n(g, "D", vars - 1));
+
+  return g;
+}
+
+static bench_shape shapes[] = {
+    {"chain", gen_chain},
+    {"wide", gen_wide},
+    {"epsilon", gen_epsilon},
+    {"follow", gen_follow},
+};
+
+static void bench_grammar(bench_shape *shape, grammar *g) {
+  static const char *phases[BENCH_PHASES] = {"new_ff_table", "firsts",
+                                             "follows", "new_ll1_table"};
+  int prods = g->productions_table->len;
+  int runs = prods >= BENCH_PRODS_PER_RUN ? 1 : BENCH_PRODS_PER_RUN / prods;
+  double best[BENCH_PHASES];
+  long peak[BENCH_PHASES] = {0};
+  int ll1 = 1;
+
+  for (int r = 0; r < runs; r++) {
+    double elapsed[BENCH_PHASES];
+    double start;
+
+    reset_peak_rss();
+    start = now_seconds();
+    ff_table *fft = new_ff_table(g);
+    elapsed[0] = now_seconds() - start;
+    peak[0] = peak_rss_kb();
+
+    reset_peak_rss();
+    start = now_seconds();
+    calculate_firsts(g, fft);
+    elapsed[1] = now_seconds() - start;
+    peak[1] = peak_rss_kb();
+
+    reset_peak_rss();
+    start = now_seconds();
+    calculate_follows(g, fft);
+    elapsed[2] = now_seconds() - start;
+    peak[2] = peak_rss_kb();
+
+    reset_peak_rss();
+    start = now_seconds();
+    ll1_table *t = new_ll1_table(g, fft);
+    elapsed[3] = now_seconds() - start;
+    peak[3] = peak_rss_kb();
+
+    ll1 = t != NULL;
+
+    for (int k = 0; k < BENCH_PHASES; k++) {
+      if (r == 0 || elapsed[k] < best[k])
+        best[k] = elapsed[k];
+    }
+
+    if (t != NULL)
+      free_ll1_table(t);
+    free_ff_table(fft);
+  }
+
+  for (int k = 0; k < BENCH_PHASES; k++)
+    printf("%-8s %8d %8d %8d  %-14s %12.3f %10.1f%s\n", shape->name, prods,
+           g->vars_len, g->terminals_len, phases[k], best[k] * 1e3,
+           peak[k] / 1024.0,
+           k == BENCH_PHASES - 1 && !ll1 ? "  NOT LL(1)" : "");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  int max_prods = argc > 1 ? atoi(argv[1]) : BENCH_MAX_PRODS;
+
+  if (max_prods < BENCH_MIN_PRODS) {
+    fprintf(stderr, "usage: %s [max productions]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-8s %8s %8s %8s  %-14s %12s %10s\n", "shape", "prods", "vars",
+         "terms", "phase", "ms", "peak MB");
+
+  for (int i = 0; i < (int)(sizeof(shapes) / sizeof(shapes[0])); i++) {
+    for (long prods = BENCH_MIN_PRODS; prods <= max_prods;
+         prods *= BENCH_PRODS_STEP) {
+      grammar *g = shapes[i].gen(prods);
+
+      if (g == NULL) {
+        fprintf(stderr, "%s: cannot build %ld productions\n", shapes[i].name,
+                prods);
+        continue;
+      }
+
+      bench_grammar(&shapes[i], g);
+      free_grammar(g);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,464 @@
+#include "../include/grammar.h"
+#include "../include/grammar_file.h"
+#include "../include/ll1.h"
+#include <time.h>
+
+// sizes go from BENCH_MIN_BYTES up by BENCH_SIZE_STEP to the first argument
+// (default BENCH_MAX_BYTES, 1 GiB is 1073741824). engines building trees stop
+// at the second argument, trees take several times the input in memory.
+#define BENCH_MIN_BYTES 1024L
+#define BENCH_SIZE_STEP 32
+#define BENCH_MAX_BYTES (32L << 20)
+#define BENCH_TREE_MAX_BYTES (1L << 20)
+#define BENCH_BYTES_PER_RUN (8L << 20)
+#define BENCH_ROUNDS 3
+#define BENCH_NESTING 4096
+#define BENCH_PUSH_CHUNK 65536
+
+// every allocation of the process goes through these, so allocations per
+// parse can be counted without touching the library
+static long bench_allocs = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+  bench_allocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+  bench_allocs++;
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+  bench_allocs++;
+  return __libc_realloc(p, size);
+}
+}
+
+typedef struct bench_grammar {
+  const char *name;
+  const char *text;
+  long (*gen)(char *out, long size);
+} bench_grammar;
+
+typedef struct bench_ctx {
+  ll1_table *table;
+  symbol_id start_var;
+  ll1_parse_tree *tree;
+  ll1_flat_tree *flat;
+  ll1_parser_ctx *parser;
+} bench_ctx;
+
+typedef struct bench_engine {
+  const char *name;
+  int builds_tree;
+  int (*parse)(bench_ctx *c, const char *str, int len);
+} bench_engine;
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// writing 5 to clear_refs resets the peak, VmHWM then reports the peak since
+static void reset_peak_rss() {
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+
+  if (f != NULL) {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+static long peak_rss_kb() {
+  char line[256];
+  long kb = -1;
+  FILE *f = fopen("/proc/self/status", "r");
+
+  if (f == NULL)
+    return -1;
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0)
+      kb = atol(line + 6);
+  }
+
+  fclose(f);
+  return kb;
+}
+
+static long gen_factor(char *out, long max, int depth);
+
+static long gen_expr(char *out, long max, int depth) {
+  long l = 0;
+
+  do {
+    if (l > 0)
+      out[l++] = '+';
+
+    l += gen_factor(out + l, max - l, depth);
+
+    while (l + 2 <= max && rand() % 3 == 0) {
+      out[l++] = '*';
+      l += gen_factor(out + l, max - l, depth);
+    }
+  } while (l + 2 <= max && rand() % 3 == 0);
+
+  return l;
+}
+
+static long gen_factor(char *out, long max, int depth) {
+  if (max < 8 || depth <= 0 || rand() % 4 != 0) {
+    out[0] = "abcd"[rand() % 4];
+    return 1;
+  }
+
+  out[0] = '(';
+  long l = gen_expr(out + 1, max < 34 ? max - 2 : 32, depth - 1);
+  out[l + 1] = ')';
+  return l + 2;
+}
+
+static long gen_arith(char *out, long size) {
+  long l = 0;
+
+  while (l + 2 <= size) {
+    if (l > 0)
+      out[l++] = '+';
+    l += gen_expr(out + l, size - l < 34 ? size - l : 32, 3);
+  }
+
+  return l;
+}
+
+// a+a+a... keeps the stack flat but predicts through B on every second byte
+static long gen_right(char *out, long size) {
+  long l = 0;
+
+  out[l++] = 'a';
+  while (l + 2 <= size) {
+    out[l++] = '+';
+    out[l++] = 'a';
+  }
+
+  return l;
+}
+
+static const char *wide_bytes =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static long gen_wide(char *out, long size) {
+  int n = strlen(wide_bytes);
+
+  for (long i = 0; i < size; i++)
+    out[i] = wide_bytes[rand() % n];
+
+  return size;
+}
+
+// balanced parentheses, random walks up to BENCH_NESTING deep
+static long gen_nested(char *out, long size) {
+  long l = 0;
+  int depth = 0;
+
+  while (l + depth < size) {
+    if (depth > 0 && (depth == BENCH_NESTING || rand() % 2 == 0)) {
+      out[l++] = ')';
+      depth--;
+    } else {
+      out[l++] = '(';
+      depth++;
+    }
+  }
+
+  while (depth-- > 0)
+    out[l++] = ')';
+
+  return l;
+}
+
+static int engine_create_tree(bench_ctx *c, const char *str, int len) {
+  ll1_parse_tree *tree = NULL;
+
+  if (create_parse_tree_with_string(c->table, &tree, c->start_var, str, len,
+                                    NULL) != STRING_PARSE_SUCCESS)
+    return 0;
+
+  free_ll1_parse_tree(tree);
+  return 1;
+}
+
+static int engine_fill_tree(bench_ctx *c, const char *str, int len) {
+  return fill_parse_tree_with_string(c->table, c->tree, c->start_var, str,
+                                     len, NULL) == STRING_PARSE_SUCCESS;
+}
+
+static int engine_parser_ctx(bench_ctx *c, const char *str, int len) {
+  return ll1_parser_ctx_parse_string(c->parser, c->tree, c->start_var, str,
+                                     len, NULL) == STRING_PARSE_SUCCESS;
+}
+
+static int engine_flat_tree(bench_ctx *c, const char *str, int len) {
+  return fill_flat_tree_with_string(c->table, c->flat, c->start_var, str,
+                                    len) == STRING_PARSE_SUCCESS;
+}
+
+// the cheapest useful consumer, it only counts what it is told
+static int count_event(void *data, symbol_id var) {
+  (void)var;
+  (*(long *)data)++;
+  return 0;
+}
+
+static int count_enter(void *data, symbol_id var, production_rhs *rhs) {
+  (void)rhs;
+  return count_event(data, var);
+}
+
+static int count_terminal(void *data, symbol_id terminal, int offset) {
+  (void)offset;
+  return count_event(data, terminal);
+}
+
+static int engine_events(bench_ctx *c, const char *str, int len) {
+  long events = 0;
+  ll1_parse_callbacks cb = {&events, count_enter, count_terminal, count_event,
+                            count_event};
+
+  return ll1_parse_events(c->table, c->start_var, str, len, &cb) ==
+         STRING_PARSE_SUCCESS;
+}
+
+static int engine_recognize(bench_ctx *c, const char *str, int len) {
+  return ll1_recognize(c->table, c->start_var, str, len) ==
+         STRING_RECOGNIZE_SUCCESS;
+}
+
+static int engine_push(bench_ctx *c, const char *str, int len) {
+  ll1_push_parser *p = new_ll1_push_parser(c->table, c->start_var, NULL);
+  if (p == NULL)
+    return 0;
+
+  for (int i = 0; i < len; i += BENCH_PUSH_CHUNK)
+    ll1_feed(p, str + i,
+             len - i < BENCH_PUSH_CHUNK ? len - i : BENCH_PUSH_CHUNK);
+
+  int accepted = ll1_finish(p) == LL1_PUSH_ACCEPTED;
+  free_ll1_push_parser(p);
+
+  return accepted;
+}
+
+// new engines are added here
+static bench_engine engines[] = {
+    {"create_parse_tree", 1, engine_create_tree},
+    {"fill_parse_tree", 1, engine_fill_tree},
+    {"flat_tree", 1, engine_flat_tree},
+    {"parser_ctx", 1, engine_parser_ctx},
+    {"ll1_recognize", 0, engine_recognize},
+    {"parse_events", 0, engine_events},
+    {"push_parser", 0, engine_push},
+};
+
+static bench_grammar grammars[] = {
+    {"expr",
+     "<S> ::= <A> <B> ;\n"
+     "<A> ::= <C> <D> ;\n"
+     "<B> ::= \"+\" <A> <B> | eps ;\n"
+     "<C> ::= <I> | \"(\" <S> \")\" ;\n"
+     "<D> ::= \"*\" <C> <D> | eps ;\n"
+     "<I> ::= \"a\" | \"b\" | \"c\" | \"d\" ;\n",
+     gen_arith},
+    {"right",
+     "<S> ::= \"a\" <B> ;\n"
+     "<B> ::= \"+\" \"a\" <B> | eps ;\n",
+     gen_right},
+    {"wide", NULL, gen_wide},
+    {"nested", "<P> ::= \"(\" <P> \")\" <P> | eps ;\n", gen_nested},
+};
+
+// one alternative per byte of wide_bytes
+static char *wide_grammar_text() {
+  int n = strlen(wide_bytes);
+  char *text = (char *)malloc(64 + n * 6);
+  int l = sprintf(text, "<S> ::= <X> <S> | eps ;\n<X> ::=");
+
+  for (int i = 0; i < n; i++)
+    l += sprintf(text + l, "%s \"%c\"", i > 0 ? " |" : "", wide_bytes[i]);
+
+  sprintf(text + l, " ;\n");
+  return text;
+}
+
+// the steps (stack pops) and nodes a table driven parse of str goes through,
+// counted with the loop of ll1_recognize
+static int count_work(ll1_table *t, symbol_id start_var, const char *str,
+                      long len, long *steps, long *nodes) {
+  int cols = t->cols;
+  int max = LL1_RECOGNIZE_STACK_LEN;
+  int *stack = (int *)malloc(sizeof(int) * max);
+  int top = 0;
+  long i = 0;
+
+  *steps = 0;
+  *nodes = 1;
+  stack[0] = cols + symbol_index(start_var);
+
+  while (top >= 0) {
+    int sym = stack[top--];
+    int col = i < len ? t->terminal_cols[(unsigned char)str[i]] : LL1_END_COL;
+
+    (*steps)++;
+
+    if (sym < cols) {
+      if (sym != col || i == len)
+        break;
+      i++;
+      continue;
+    }
+
+    int p = col == LL1_NO_INDEX ? LL1_NO_PRODUCTION
+                                : t->cells[(sym - cols) * cols + col];
+    if (p == LL1_NO_PRODUCTION)
+      break;
+
+    int from = t->prod_offsets[p];
+    int n = t->prod_offsets[p + 1] - from;
+
+    *nodes += n > 0 ? n : 1;
+
+    if (top + n >= max) {
+      while (top + n >= max)
+        max *= 2;
+      stack = (int *)realloc(stack, sizeof(int) * max);
+    }
+
+    memcpy(&stack[top + 1], &t->prod_syms[from], sizeof(int) * n);
+    top += n;
+  }
+
+  free(stack);
+  return top < 0 && i == len;
+}
+
+static void bench_size(bench_grammar *bg, ll1_table *t, symbol_id start_var,
+                       const char *str, long len, long tree_max) {
+  long steps, nodes;
+
+  if (!count_work(t, start_var, str, len, &steps, &nodes)) {
+    printf("%-8s %12ld  generated input is rejected\n", bg->name, len);
+    return;
+  }
+
+  bench_ctx c;
+  c.table = t;
+  c.start_var = start_var;
+  c.tree = new_ll1_parse_tree(start_var);
+  c.flat = new_ll1_flat_tree(0);
+  c.parser = new_ll1_parser_ctx(t);
+
+  int runs = len >= BENCH_BYTES_PER_RUN ? 1 : BENCH_BYTES_PER_RUN / len;
+
+  for (int e = 0; e < (int)(sizeof(engines) / sizeof(engines[0])); e++) {
+    bench_engine *engine = &engines[e];
+
+    if (engine->builds_tree && len > tree_max)
+      continue;
+
+    double best = 0;
+    long allocs = 0;
+    int accepted = 1;
+
+    reset_peak_rss();
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+      long allocs_before = bench_allocs;
+      double start = now_seconds();
+
+      for (int k = 0; k < runs; k++)
+        accepted &= engine->parse(&c, str, len);
+
+      double elapsed = (now_seconds() - start) / runs;
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+      allocs = bench_allocs - allocs_before;
+    }
+
+    long rss = peak_rss_kb();
+
+    printf("%-8s %12ld  %-18s %9.1f %10.1f ", bg->name, len, engine->name,
+           len / best / 1e6, steps / best / 1e6);
+
+    if (engine->builds_tree)
+      printf("%10.1f ", nodes / best / 1e6);
+    else
+      printf("%10s ", "-");
+
+    printf("%10.1f %10.1f%s\n", rss / 1024.0, (double)allocs / runs,
+           accepted ? "" : "  REJECTED");
+    fflush(stdout);
+  }
+
+  free_ll1_parse_tree(c.tree);
+  free_ll1_flat_tree(c.flat);
+  free_ll1_parser_ctx(c.parser);
+}
+
+int main(int argc, char **argv) {
+  long max_bytes = argc > 1 ? atol(argv[1]) : BENCH_MAX_BYTES;
+  long tree_max = argc > 2 ? atol(argv[2]) : BENCH_TREE_MAX_BYTES;
+
+  if (max_bytes < BENCH_MIN_BYTES || max_bytes > 0x7fffffffL) {
+    fprintf(stderr, "usage: %s [max bytes] [max tree bytes]\n", argv[0]);
+    return 1;
+  }
+
+  char *str = (char *)malloc(max_bytes);
+  char *wide_text = wide_grammar_text();
+
+  grammars[2].text = wide_text;
+
+  printf("%-8s %12s  %-18s %9s %10s %10s %10s %10s\n", "grammar", "bytes",
+         "engine", "MB/s", "Msteps/s", "Mnodes/s", "peak MB", "allocs");
+
+  for (int i = 0; i < (int)(sizeof(grammars) / sizeof(grammars[0])); i++) {
+    bench_grammar *bg = &grammars[i];
+    grammar_file_error err;
+    grammar *g = new_grammar_from_text(bg->text, strlen(bg->text), &err);
+
+    if (g == NULL) {
+      fprintf(stderr, "%s: %d:%d: %s\n", bg->name, err.line, err.col,
+              err.msg);
+      continue;
+    }
+
+    ff_table *fft = new_ff_table(g);
+    calculate_firsts(g, fft);
+    calculate_follows(g, fft);
+    ll1_table *t = new_ll1_table(g, fft);
+
+    srand(42);
+
+    for (long size = BENCH_MIN_BYTES; t != NULL && size <= max_bytes;
+         size *= BENCH_SIZE_STEP) {
+      long len = bg->gen(str, size);
+      bench_size(bg, t, g->start_var, str, len, tree_max);
+    }
+
+    if (t != NULL)
+      free_ll1_table(t);
+    free_ff_table(fft);
+    free_grammar(g);
+  }
+
+  free(wide_text);
+  free(str);
+
+  return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _H_ARENA
+#define _H_ARENA
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block {
+  size_t size;
+  size_t used;
+  struct arena_block *next;
+} arena_block;
+
+// bump allocator, memory is handed out from the newest block and everything
+// is released at once. blocks are chained newest first.
+typedef struct arena {
+  size_t capacity;
+  arena_block *head;
+} arena;
+
+void free_arena(arena *a);
+
+arena *new_arena(size_t block_size);
+void *arena_alloc(arena *a, size_t size);
+void arena_reset(arena *a);
+
+#endif
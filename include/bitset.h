@@ -0,0 +1,22 @@
+#ifndef _H_BITSET
+#define _H_BITSET
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define BITSET_WORD_BITS 64
+
+typedef unsigned long long bitset_word;
+
+int bitset_words(int bits);
+bitset_word *new_bitset(int words);
+void bitset_clear(bitset_word *b, int words);
+void bitset_set(bitset_word *b, int i);
+int bitset_test(const bitset_word *b, int i);
+int bitset_union(bitset_word *dst, const bitset_word *src, int words);
+int bitset_intersects(const bitset_word *a, const bitset_word *b, int words);
+int bitset_count(const bitset_word *b, int words);
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef _H_GRAMMAR
 #define _H_GRAMMAR
 
+#include "./arena.h"
+#include "./symbol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,11 +10,14 @@
 // consts
 #define EPSILON_DEFINITION_1 "epsilon"
 #define EPSILON_DEFINITION_2 "eps"
-#define EPSILON -100
-#define MAX_PRODS 26
-#define PRODS_INDEX_SHIFT 65
 #define MIN_PROD_CHAR 'A'
 #define MAX_PROD_CHAR 'Z'
+#define GRAMMAR_BYTES_LEN 256
+#define GRAMMAR_NO_TERMINAL -1
+#define GRAMMAR_INITIAL_VARS 16
+#define GRAMMAR_INITIAL_TOKENS 8
+#define TOKEN_LITERAL 0
+#define TOKEN_PATTERN 1
 
 // return codes
 #define SUCCESS_ADD_PROD 0
@@ -20,76 +25,94 @@
 #define NULL_RULE_RECEIVED -2
 #define NULL_GRAMMAR_RECEIVED -3
 #define UNDEFINED_PRODUCTION -4
+#define ERROR_ADD_PROD -5
+#define SUCCESS_ADD_TOKEN 0
+#define ERROR_ADD_TOKEN -6
 #define PRODUCTION_FOUND 1
 #define EPS_PROD_FOUND 1
 #define EPS_PROD_NOT_FOUND 0
 
+// an epsilon right hand side has len 0
 typedef struct production_rhs {
-  char *rhs;
-  char for_var;
+  int id;
+  int len;
+  symbol_id *syms;
+  symbol_id for_var;
   struct production_rhs *next;
 } production_rhs;
 
 typedef struct production {
-  char var;
+  symbol_id var;
   int len;
   production_rhs *first_rhs;
 } production;
 
+// productions has one entry per variable, indexed by its symbol index, len
+// counts the right hand sides of the whole grammar
 typedef struct production_table {
   production *productions;
+  int max;
   int len;
 } production_table;
 
-typedef struct production_rhs_stack {
-  int top;
-  int max;
-  production_rhs **data;
-} production_rhs_stack;
+// how a terminal is spelled in the input, terminal is SYMBOL_NONE for skips
+typedef struct token_def {
+  symbol_id terminal;
+  int kind;
+  int len;
+  const char *text;
+} token_def;
 
+// right hand sides and token texts live in rhs_arena, byte_terminals maps a
+// byte to the terminal named by it
 typedef struct grammar {
+  symbol_table *symbols;
   int vars_len;
-  char *vars;
   int terminals_len;
-  char *terminals;
-  char start_var;
+  symbol_id start_var;
   production_table *productions_table;
+  arena *rhs_arena;
+  int byte_terminals[GRAMMAR_BYTES_LEN];
+  int tokens_len;
+  int tokens_max;
+  token_def *tokens;
 } grammar;
 
-typedef struct char_stack {
+typedef struct symbol_stack {
   int top;
   int max;
-  char **data;
-} char_stack;
+  symbol_id *data;
+} symbol_stack;
 
 void free_grammar(grammar *g);
-void free_production_rhs_stack(production_rhs_stack *s);
-void free_char_stack(char_stack *s);
-void free_production_rhs(production_rhs *rhs);
+void free_symbol_stack(symbol_stack *s);
 void free_production_table(production_table *t);
 
-production_rhs_stack *new_production_rhs_stack(int max);
-int production_rhs_stack_is_full(production_rhs_stack *s);
-int production_rhs_stack_is_empty(production_rhs_stack *s);
-int production_rhs_stack_increase(production_rhs_stack *s);
-production_rhs *production_rhs_stack_top(production_rhs_stack *s);
-int production_rhs_stack_push(production_rhs_stack *s, production_rhs *rhs);
-int production_rhs_stack_pop(production_rhs_stack *s, production_rhs **rhs);
-
-char_stack *new_char_stack(int max);
-int char_stack_is_full(char_stack *s);
-int char_stack_is_empty(char_stack *s);
-int char_stack_increase(char_stack *s);
-char *char_stack_top(char_stack *s);
-int char_stack_push(char_stack *s, char *c);
-int char_stack_pop(char_stack *s, char **c);
+symbol_stack *new_symbol_stack(int max);
+int symbol_stack_is_full(symbol_stack *s);
+int symbol_stack_is_empty(symbol_stack *s);
+int symbol_stack_increase(symbol_stack *s);
+symbol_id symbol_stack_top(symbol_stack *s);
+int symbol_stack_push(symbol_stack *s, symbol_id c);
+int symbol_stack_pop(symbol_stack *s, symbol_id *c);
 
+grammar *new_empty_grammar();
 grammar *new_grammar(const char *vars, const char *terminals, char start_var);
+symbol_id grammar_add_var(grammar *g, const char *name, int len);
+symbol_id grammar_add_terminal(grammar *g, const char *name, int len);
+int grammar_set_start_var(grammar *g, symbol_id var);
 int add_production(grammar *g, char var, const char *rhs);
-int get_production(grammar *g, char var, production *prod);
-int var_has_epsilon_rhs(grammar *g, char var);
+int add_production_symbols(grammar *g, symbol_id var, const symbol_id *rhs,
+                           int len);
+int grammar_add_token(grammar *g, symbol_id terminal, int kind,
+                      const char *text, int len);
+int grammar_add_skip(grammar *g, const char *pattern);
+int get_production(grammar *g, symbol_id var, production *prod);
+int var_has_epsilon_rhs(grammar *g, symbol_id var);
 
-void print_production(production p, int space_indent);
+int format_production_rhs(symbol_table *t, production_rhs *rhs, char *buff,
+                          int size);
+void print_production(grammar *g, production p, int space_indent);
 void print_grammar(grammar *g);
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef _H_GRAMMAR_FILE
+#define _H_GRAMMAR_FILE
+
+#include "./grammar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define GRAMMAR_FILE_ERROR_LEN 256
+#define GRAMMAR_FILE_INITIAL_SYMS 64
+
+// where loading stopped and why, line and col start at 1 and are 0 when the
+// error is not tied to a position
+typedef struct grammar_file_error {
+  int line;
+  int col;
+  char msg[GRAMMAR_FILE_ERROR_LEN];
+} grammar_file_error;
+
+// grammar files are BNF with yacc style rules and %start, %token and %skip
+// directives, the format is described in grammar_file.c
+grammar *new_grammar_from_text(const char *text, int len,
+                               grammar_file_error *err);
+grammar *new_grammar_from_file(const char *path, grammar_file_error *err);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _H_GRAMMAR_GEN
+#define _H_GRAMMAR_GEN
+
+#include "./bitset.h"
+#include "./grammar.h"
+#include "./ll1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define GRAMMAR_GEN_BUFF_LEN 65536
+#define GRAMMAR_GEN_STACK_LEN 256
+#define GRAMMAR_GEN_SEP_LEN 8
+#define GRAMMAR_GEN_DEFAULT_WEIGHT 1
+#define GRAMMAR_GEN_UNBOUNDED (1L << 48)
+
+// return codes
+#define GRAMMAR_GEN_SUCCESS 0
+#define GRAMMAR_GEN_ERROR -1
+#define GRAMMAR_GEN_NO_SENTENCE -2
+#define GRAMMAR_GEN_NO_NEAR_MISS -3
+
+// random sentences of a grammar of about a target size, for corpora and load
+// tests. the fields are described in grammar_gen.c
+typedef struct grammar_gen {
+  grammar *g;
+  ff_table *fft;
+  unsigned long long state;
+  int vars_len;
+  int terminals_len;
+  int prods_len;
+  int *var_offsets;
+  int *var_prods;
+  int *prod_offsets;
+  int *prod_syms;
+  int *prod_vars;
+  int *prod_leads;
+  int *prod_var_pos;
+  int *prod_text_offsets;
+  char *prod_texts;
+  int *weights;
+  long *min_lens;
+  long *rhs_min_lens;
+  int *grow_ends;
+  int *finite_ends;
+  char *uniform;
+  long *cum_weights;
+  int *spell_offsets;
+  int *spell_lens;
+  char *spellings;
+  int sep_len;
+  char sep[GRAMMAR_GEN_SEP_LEN];
+  long mutation_offset;
+  int top;
+  int max;
+  int *stack;
+  long *budgets;
+  bitset_word *valid;
+  char *buff;
+} grammar_gen;
+
+void free_grammar_gen(grammar_gen *gen);
+
+grammar_gen *new_grammar_gen(grammar *g, unsigned long long seed);
+int grammar_gen_set_weight(grammar_gen *gen, int prod_id, int weight);
+int grammar_gen_set_separator(grammar_gen *gen, const char *sep, int len);
+
+// both return the bytes written to out, a near miss is rejected at
+// mutation_offset
+long grammar_gen_sentence(grammar_gen *gen, long target, FILE *out);
+long grammar_gen_near_miss(grammar_gen *gen, long target, FILE *out);
+
+#endif
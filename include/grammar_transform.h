@@ -0,0 +1,53 @@
+#ifndef _H_GRAMMAR_TRANSFORM
+#define _H_GRAMMAR_TRANSFORM
+
+#include "./arena.h"
+#include "./grammar.h"
+#include "./ll1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define GRAMMAR_TRANSFORM_PRIME '\''
+#define GRAMMAR_TRANSFORM_RESTORE_STACK_LEN 64
+#define GRAMMAR_ORIGIN_SAME 0
+#define GRAMMAR_ORIGIN_TAIL 1
+#define GRAMMAR_ORIGIN_FACTOR 2
+
+// return codes
+#define GRAMMAR_TRANSFORM_SUCCESS 0
+#define GRAMMAR_TRANSFORM_ERROR -1
+#define GRAMMAR_TRANSFORM_HIDDEN_RECURSION -2
+
+// after at symbols, the last len of them become a node for source prod
+typedef struct grammar_origin_level {
+  int prod;
+  int at;
+} grammar_origin_level;
+
+// g is source without left recursion and common prefixes, see
+// grammar_transform.c for how it maps back
+typedef struct grammar_transform {
+  grammar *source;
+  grammar *g;
+  int vars_len;
+  symbol_id *var_origins;
+  char *var_kinds;
+  int prods_len;
+  int *level_offsets;
+  grammar_origin_level *levels;
+  production_rhs **source_prods;
+} grammar_transform;
+
+// g is released with the transform, source is not and must outlive it
+void free_grammar_transform(grammar_transform *t);
+
+grammar_transform *new_grammar_transform(grammar *source, int *res);
+symbol_id grammar_transform_origin(grammar_transform *t, symbol_id sym);
+
+// returns a new tree over the symbols of source
+ll1_parse_tree *grammar_transform_restore_tree(grammar_transform *t,
+                                               ll1_parse_tree *tree);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _H_LEXER
+#define _H_LEXER
+
+#include "./bitset.h"
+#include "./grammar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define LEXER_DEAD_STATE -1
+#define LEXER_NO_ACCEPT -1
+#define LEXER_SKIP -2
+#define LEXER_RUN_RANGES 4
+#define LEXER_BYTE_WORDS 4
+#define LEXER_TOKENS_INITIAL_LEN 64
+
+// return codes
+#define LEXER_SUCCESS -1
+#define LEXER_ERROR -2
+
+// bytes that keep a state in itself, as ranges lo..lo + span
+typedef struct lexer_run {
+  int len;
+  unsigned char lo[LEXER_RUN_RANGES];
+  unsigned char span[LEXER_RUN_RANGES];
+} lexer_run;
+
+// minimized DFA over the token definitions of a grammar, state 0 is the start
+typedef struct lexer {
+  int states_len;
+  int classes_len;
+  unsigned char byte_classes[GRAMMAR_BYTES_LEN];
+  int *trans;
+  int *accepts;
+  lexer_run *runs;
+} lexer;
+
+// tokens as terminal columns, each with the byte range it was read from
+typedef struct lexer_tokens {
+  int len;
+  int max;
+  int *cols;
+  int *offsets;
+  int *lens;
+} lexer_tokens;
+
+void free_lexer(lexer *l);
+void free_lexer_tokens(lexer_tokens *t);
+
+lexer *new_lexer(grammar *g);
+lexer_tokens *new_lexer_tokens(int max);
+int lexer_tokens_push(lexer_tokens *t, int col, int offset, int len);
+int lex_string(lexer *l, const char *str, int str_len, lexer_tokens *out);
+
+void print_lexer_tokens(lexer_tokens *t, symbol_table *s);
+
+#endif
@@ -1,15 +1,40 @@
 #ifndef _H_LL1
 #define _H_LL1
 
+#include "./arena.h"
+#include "./bitset.h"
 #include "./grammar.h"
+#include "./output.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // consts
-#define TERMINATE_SYMBOL '$'
-#define FOLLOW_LEN_NOT_CALCULATED -2
-#define FOLLOW_LEN_CALCULATING -1
+#define LL1_END_COL 0
+#define LL1_NO_PRODUCTION -1
+#define LL1_NO_INDEX -1
+#define LL1_RECOGNIZE_STACK_LEN 256
+#define LL1_PUSH_STACK_LEN 64
+#define LL1_BATCH_LANES 8
+#define LL1_BATCH_STACK_LEN 256
+#define LL1_BATCH_WINDOW_LEN 65536
+#define LL1_CONFLICTS_INITIAL_LEN 16
+#define LL1_CONFLICT_FIRST_FIRST 1
+#define LL1_CONFLICT_FIRST_FOLLOW 2
+#define LL1_PARSE_ERRORS_INITIAL_LEN 16
+#define LL1_FLAT_TREE_INITIAL_LEN 256
+#define LL1_FLAT_STACK_LEN 256
+#define LL1_WALK_STACK_LEN 256
+#define LL1_PRINT_STACK_LEN 256
+#define LL1_PARSER_CTX_STACK_LEN 64
+#define LL1_REPARSE_DEAD_RATIO 1
+
+// counting in the tree building parsers is compiled in with -DLL1_STATS
+#ifdef LL1_STATS
+#define LL1_STATS_ENABLED 1
+#else
+#define LL1_STATS_ENABLED 0
+#endif
 
 // return codes
 #define GRAMMAR_IS_NOT_LL1 -3
@@ -17,50 +42,43 @@
 #define ERROR_ON_FOLLOW_CALC -1
 #define SUCCESS_ON_FIRST_CALC 1
 #define SUCCESS_ON_FOLLOW_CALC 1
-#define FOLLOW_ALREADY_CALCULATED -2
 #define HASHMAP_INSERT_FAILED -1
 #define HASHMAP_INSERT_SUCCESS 1
 #define HASHMAP_KEY_FOUND_ERROR -2
 #define HASHMAP_KEY_NOT_FOUND -1
 #define HASHMAP_KEY_FOUND_SUCCESS 1
 #define HASHMAP_INSERT_DUPLICATE -2
-#define DUPLICATED_FIRST_FOUND 1
-#define DUPLICATED_FIRST_NOT_FOUND 0
-#define DUPLICATED_FOLLOW_FOUND 1
-#define DUPLICATED_FOLLOW_NOT_FOUND 0
 #define PARSE_TREE_ADD_NODE_SUCCESS 1
 #define PARSE_TREE_ADD_NODE_ERROR -1
 #define STRING_PARSE_SUCCESS 1
 #define STRING_PARSE_ERROR -1
+#define STRING_PARSE_RECOVERED 2
+#define STRING_PARSE_STOPPED 3
+// recognizers return the offset the input failed at or one of these two
+#define STRING_RECOGNIZE_SUCCESS -3
+#define STRING_RECOGNIZE_ERROR -2
+#define LL1_PUSH_RUNNING 0
+#define LL1_PUSH_ACCEPTED 1
+#define LL1_PUSH_FAILED -1
 
-typedef struct first {
-  char c;
-  production_rhs *rhs;
-} first;
-
-typedef struct follow {
-  char c;
-} follow;
-
-typedef struct var_firsts {
-  char var;
-  int firsts_len;
-  first *firsts;
-} var_firsts;
-
-typedef struct var_follows {
-  char var;
-  int follows_len;
-  follow *follows;
-} var_follows;
-
+// bitsets over terminal indices, the end of input marker is terminal 0
 typedef struct ff_table {
-  var_firsts *firsts;
-  var_follows *follows;
+  symbol_table *symbols;
+  int vars_len;
+  int terminals_len;
+  int words;
+  char *nullable;
+  bitset_word *first_sets;
+  bitset_word *follow_sets;
+  int prods_len;
+  production_rhs **prods;
+  int *suffix_offsets;
+  char *suffix_nullable;
+  bitset_word *suffix_firsts;
 } ff_table;
 
 typedef struct rhs_hashmap_node {
-  char key;
+  int key;
   production_rhs *data;
   struct rhs_hashmap_node *next;
 } rhs_hashmap_node;
@@ -71,7 +89,7 @@ typedef struct rhs_hashmap {
 } rhs_hashmap;
 
 typedef struct ll1_hashmap_node {
-  char key;
+  int key;
   rhs_hashmap *data;
   struct ll1_hashmap_node *next;
 } ll1_hashmap_node;
@@ -81,18 +99,65 @@ typedef struct ll1_hashmap {
   ll1_hashmap_node **nodes;
 } ll1_hashmap;
 
+// cells[row * cols + col] is an index into prods or LL1_NO_PRODUCTION, table
+// is only built with -DLL1_USE_HASHMAP
 typedef struct ll1_table {
+  symbol_table *symbols;
   int vars_len;
-  char *vars;
   int terminals_len;
-  char *terminals;
   ll1_hashmap *table;
+  int cols;
+  int *cells;
+  int prods_len;
+  production_rhs **prods;
+  int *prod_offsets;
+  int *prod_syms;
+  int terminal_cols[GRAMMAR_BYTES_LEN];
 } ll1_table;
 
+// a table cell claimed by the right hand sides ids[ids_offset] onwards
+typedef struct ll1_conflict {
+  symbol_id var;
+  symbol_id terminal;
+  int kind;
+  int ids_offset;
+  int ids_len;
+} ll1_conflict;
+
+typedef struct ll1_conflicts {
+  symbol_table *symbols;
+  production_rhs **prods;
+  int len;
+  int max;
+  ll1_conflict *data;
+  int ids_len;
+  int ids_max;
+  int *ids;
+} ll1_conflicts;
+
+// a place where the input did not fit the table
+typedef struct ll1_parse_error {
+  int offset;
+  int found;
+  symbol_id sym;
+  int skipped;
+} ll1_parse_error;
+
+typedef struct ll1_parse_errors {
+  int len;
+  int max;
+  int words;
+  ll1_parse_error *data;
+  bitset_word *expected;
+} ll1_parse_errors;
+
+// len is the bytes or tokens the subtree covers, only kept by the reparsing
+// functions
 typedef struct ll1_parse_node {
-  char c;
+  symbol_id sym;
   int max_children;
   int children_len;
+  int len;
   struct ll1_parse_node *parent;
   struct ll1_parse_node **children;
 } ll1_parse_node;
@@ -110,14 +175,86 @@ typedef struct ll1_parse_node_stack {
   ll1_parse_node **data;
 } ll1_parse_node_stack;
 
+// nodes are carved from the tree's arena, spans is set while every len is.
+// dead counts the nodes reparsing left in the arena outside the tree
 typedef struct ll1_parse_tree {
   int nodes;
+  int spans;
+  int dead;
   ll1_parse_node *root;
+  arena *node_arena;
 } ll1_parse_tree;
 
+// parse tree as parallel arrays in preorder, the subtree of n ends at ends[n]
+typedef struct ll1_flat_tree {
+  int len;
+  int max;
+  int input_len;
+  symbol_id *syms;
+  int *ends;
+  int *offsets;
+} ll1_flat_tree;
+
+// any callback may be NULL, one returning non zero stops the parse
+typedef struct ll1_parse_callbacks {
+  void *data;
+  int (*enter_var)(void *data, symbol_id var, production_rhs *rhs);
+  int (*terminal)(void *data, symbol_id terminal, int offset);
+  int (*epsilon)(void *data, symbol_id var);
+  int (*exit_var)(void *data, symbol_id var);
+} ll1_parse_callbacks;
+
+// hot path counters of the tree building parsers, only kept with LL1_STATS
+typedef struct ll1_parse_stats {
+  long parses;
+  long table_lookups;
+  long terminal_matches;
+  long epsilon_expansions;
+  long max_stack_depth;
+  long nodes_allocated;
+  long stack_reallocs;
+  long bytes_allocated;
+} ll1_parse_stats;
+
+// resumable parser fed with arbitrarily split chunks of input
+typedef struct ll1_push_parser {
+  ll1_table *table;
+  ll1_parse_tree *tree;
+  int status;
+  long offset;
+  int top;
+  int max;
+  int *syms;
+  ll1_parse_node **nodes;
+} ll1_push_parser;
+
+// input [offset, offset + deleted) was replaced by inserted bytes or tokens
+typedef struct ll1_edit {
+  int offset;
+  int deleted;
+  int inserted;
+} ll1_edit;
+
+// a symbol still to derive and the node it hangs from in the tree
+typedef struct ll1_parser_entry {
+  symbol_id sym;
+  ll1_parse_node *node;
+} ll1_parser_entry;
+
+// what fill_parse_tree needs besides the table and the tree, reusable
+typedef struct ll1_parser_ctx {
+  ll1_table *table;
+  int max;
+  ll1_parser_entry *stack;
+} ll1_parser_ctx;
+
+void free_ll1_parser_ctx(ll1_parser_ctx *ctx);
+void free_ll1_push_parser(ll1_push_parser *p);
+void free_ll1_conflicts(ll1_conflicts *c);
+void free_ll1_parse_errors(ll1_parse_errors *e);
+void free_ll1_flat_tree(ll1_flat_tree *t);
 void free_ll1_parse_node_stack(ll1_parse_node_stack *s);
 void free_ll1_parse_node_queue(ll1_parse_node_queue *q);
-void free_ll1_parse_node(ll1_parse_node *n);
 void free_ll1_parse_tree(ll1_parse_tree *t);
 void free_rhs_hashmap_node(rhs_hashmap_node *n);
 void free_rhs_hashmap(rhs_hashmap *hm);
@@ -126,21 +263,21 @@ void free_ll1_hashmap(ll1_hashmap *hm);
 void free_ff_table(ff_table *t);
 void free_ll1_table(ll1_table *t);
 
-rhs_hashmap_node *new_rhs_hashmap_node(char k, production_rhs *v);
+rhs_hashmap_node *new_rhs_hashmap_node(int k, production_rhs *v);
 rhs_hashmap *new_rhs_hashmap(int max);
-int rhs_hashmap_hash_func(rhs_hashmap *hm, char k);
-int insert_into_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs *v);
-int search_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs **output);
-void print_rhs_hashmap_node(rhs_hashmap_node *n);
-void print_rhs_hashmap(rhs_hashmap *hm);
+int rhs_hashmap_hash_func(rhs_hashmap *hm, int k);
+int insert_into_rhs_hashmap(rhs_hashmap *hm, int k, production_rhs *v);
+int search_rhs_hashmap(rhs_hashmap *hm, int k, production_rhs **output);
+void print_rhs_hashmap_node(rhs_hashmap_node *n, symbol_table *s);
+void print_rhs_hashmap(rhs_hashmap *hm, symbol_table *s);
 
-ll1_hashmap_node *new_ll1_hashmap_node(char k, rhs_hashmap *v);
+ll1_hashmap_node *new_ll1_hashmap_node(int k, rhs_hashmap *v);
 ll1_hashmap *new_ll1_hashmap(int max);
-int ll1_hashmap_hash_func(ll1_hashmap *hm, char k);
-int insert_into_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap *v);
-int search_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap **output);
-void print_ll1_hashmap_node(ll1_hashmap_node *n);
-void print_ll1_hashmap(ll1_hashmap *hm);
+int ll1_hashmap_hash_func(ll1_hashmap *hm, int k);
+int insert_into_ll1_hashmap(ll1_hashmap *hm, int k, rhs_hashmap *v);
+int search_ll1_hashmap(ll1_hashmap *hm, int k, rhs_hashmap **output);
+void print_ll1_hashmap_node(ll1_hashmap_node *n, symbol_table *s);
+void print_ll1_hashmap(ll1_hashmap *hm, symbol_table *s);
 
 ll1_parse_node_queue *new_ll1_parse_node_queue(int max);
 int ll1_parse_node_queue_is_full(ll1_parse_node_queue *q);
@@ -160,31 +297,110 @@ ll1_parse_node *ll1_parse_node_stack_top(ll1_parse_node_stack *s);
 int ll1_parse_node_stack_push(ll1_parse_node_stack *s, ll1_parse_node *c);
 int ll1_parse_node_stack_pop(ll1_parse_node_stack *s, ll1_parse_node **c);
 
-ll1_parse_node *new_ll1_parse_node(ll1_parse_node *parent, char val,
-                                   int max_children);
-int ll1_parse_tree_add_child(ll1_parse_tree *t, ll1_parse_node *node, char val,
-                             int max_children);
+ll1_parse_node *new_ll1_parse_node(arena *a, ll1_parse_node *parent,
+                                   symbol_id val, int max_children);
+int ll1_parse_node_reserve_children(ll1_parse_tree *t, ll1_parse_node *node,
+                                    int max_children);
+int ll1_parse_tree_add_child(ll1_parse_tree *t, ll1_parse_node *node,
+                             symbol_id val, int max_children);
 
-ll1_parse_tree *new_ll1_parse_tree(char start_var, int max_children);
+ll1_parse_tree *new_ll1_parse_tree(symbol_id start_var);
+int ll1_parse_tree_reset(ll1_parse_tree *t, symbol_id start_var);
 
-int check_first_duplicate(first *f, int f_len, char c);
-int check_follow_duplicate(follow *f, int f_len, char c);
+ll1_flat_tree *new_ll1_flat_tree(int max);
+int ll1_flat_tree_first_child(ll1_flat_tree *t, int node);
+int ll1_flat_tree_next_sibling(ll1_flat_tree *t, int parent, int node);
+int ll1_flat_tree_children_len(ll1_flat_tree *t, int node);
+int ll1_flat_tree_parent(ll1_flat_tree *t, int node);
+int ll1_flat_tree_span_end(ll1_flat_tree *t, int node);
+ll1_parse_tree *new_ll1_parse_tree_from_flat(ll1_flat_tree *f);
+int ll1_flat_tree_from_tree(ll1_flat_tree *f, ll1_parse_tree *tree);
 
 ff_table *new_ff_table(grammar *g);
-int find_first(production_table *t, ff_table *fft, char var);
+bitset_word *ff_first_set(ff_table *t, symbol_id var);
+bitset_word *ff_follow_set(ff_table *t, symbol_id var);
+bitset_word *ff_rhs_first_set(ff_table *t, production_rhs *rhs, int from);
+int ff_rhs_nullable(ff_table *t, production_rhs *rhs, int from);
 int calculate_firsts(grammar *g, ff_table *fft);
-int find_follow(production_table *t, ff_table **fft, char var, char start_var);
 int calculate_follows(grammar *g, ff_table *fft);
 
 ll1_table *new_ll1_table(grammar *g, ff_table *fft);
+ll1_conflicts *new_ll1_conflicts(grammar *g, ff_table *fft);
+production_rhs *ll1_table_predict(ll1_table *t, symbol_id var,
+                                  symbol_id terminal);
 
 int create_parse_tree_with_string(ll1_table *table,
-                                  ll1_parse_tree **output_tree, char start_var,
-                                  const char *str, int str_len);
+                                  ll1_parse_tree **output_tree,
+                                  symbol_id start_var, const char *str,
+                                  int str_len, ll1_parse_stats *stats);
+int fill_parse_tree_with_string(ll1_table *table, ll1_parse_tree *tree,
+                                symbol_id start_var, const char *str,
+                                int str_len, ll1_parse_stats *stats);
+int fill_parse_tree_with_tokens(ll1_table *table, ll1_parse_tree *tree,
+                                symbol_id start_var, const int *tokens,
+                                int tokens_len, ll1_parse_stats *stats);
+ll1_parser_ctx *new_ll1_parser_ctx(ll1_table *table);
+int ll1_parser_ctx_parse_string(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                                symbol_id start_var, const char *str,
+                                int str_len, ll1_parse_stats *stats);
+int ll1_parser_ctx_parse_tokens(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                                symbol_id start_var, const int *tokens,
+                                int tokens_len, ll1_parse_stats *stats);
+int ll1_reparse_with_string(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                            symbol_id start_var, const char *str, int str_len,
+                            ll1_edit *edit, ll1_parse_stats *stats);
+int ll1_reparse_with_tokens(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                            symbol_id start_var, const int *tokens,
+                            int tokens_len, ll1_edit *edit,
+                            ll1_parse_stats *stats);
+int fill_flat_tree_with_string(ll1_table *table, ll1_flat_tree *tree,
+                               symbol_id start_var, const char *str,
+                               int str_len);
+int fill_flat_tree_with_tokens(ll1_table *table, ll1_flat_tree *tree,
+                               symbol_id start_var, const int *tokens,
+                               int tokens_len);
+int ll1_parse_events(ll1_table *table, symbol_id start_var, const char *str,
+                     int str_len, ll1_parse_callbacks *cb);
+int ll1_parse_events_tokens(ll1_table *table, symbol_id start_var,
+                            const int *tokens, int tokens_len,
+                            ll1_parse_callbacks *cb);
+ll1_parse_errors *new_ll1_parse_errors(ll1_table *table);
+int recover_parse_tree_with_string(ll1_table *table, ff_table *fft,
+                                   ll1_parse_tree *tree, symbol_id start_var,
+                                   const char *str, int str_len,
+                                   ll1_parse_errors *errors);
+int recover_parse_tree_with_tokens(ll1_table *table, ff_table *fft,
+                                   ll1_parse_tree *tree, symbol_id start_var,
+                                   const int *tokens, int tokens_len,
+                                   ll1_parse_errors *errors);
+int ll1_recognize(ll1_table *table, symbol_id start_var, const char *str,
+                  int str_len);
+int ll1_recognize_tokens(ll1_table *table, symbol_id start_var,
+                         const int *tokens, int tokens_len);
+ll1_push_parser *new_ll1_push_parser(ll1_table *table, symbol_id start_var,
+                                     ll1_parse_tree *tree);
+int ll1_feed(ll1_push_parser *p, const char *chunk, int len);
+int ll1_finish(ll1_push_parser *p);
+
+int ll1_recognize_batch(ll1_table *table, symbol_id start_var,
+                        const char **strs, const int *str_lens, int count,
+                        unsigned char *accepted);
 
-void print_ll1_parse_node(ll1_parse_node *n, int level);
-void print_ll1_parse_tree(ll1_parse_tree *t);
+// the print functions write to stdout through an output buffer, the write
+// ones to a buffer the caller flushes
+void print_ll1_parse_node(ll1_parse_node *n, symbol_table *s, int level);
+void print_ll1_parse_tree(ll1_parse_tree *t, symbol_table *s);
+int write_ll1_parse_node(output_buffer *o, ll1_parse_node *n, symbol_table *s,
+                         int level);
+int write_ll1_parse_tree(output_buffer *o, ll1_parse_tree *t,
+                         symbol_table *s);
+void print_ll1_parse_stats(ll1_parse_stats *s);
+void print_ll1_flat_tree(ll1_flat_tree *t, symbol_table *s);
 void print_ff_table(ff_table *t);
 void print_ll1_table(ll1_table *t);
+int write_ff_table(output_buffer *o, ff_table *t);
+int write_ll1_table(output_buffer *o, ll1_table *t);
+void print_ll1_conflicts(ll1_conflicts *c);
+void print_ll1_parse_errors(ll1_parse_errors *e, symbol_table *s);
 
 #endif
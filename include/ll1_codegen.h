@@ -0,0 +1,22 @@
+#ifndef _H_LL1_CODEGEN
+#define _H_LL1_CODEGEN
+
+#include "./ll1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define LL1_CODEGEN_MAX_DEPTH 10000
+#define LL1_CODEGEN_PREFIX_LEN 64
+
+// return codes
+#define LL1_CODEGEN_SUCCESS 0
+#define LL1_CODEGEN_ERROR -1
+
+// writes a recursive descent parser for the grammar of t to out, defining
+// <prefix>_parse_string, <prefix>_parse_tokens and <prefix>_recognize
+int ll1_generate_parser(FILE *out, ll1_table *t, symbol_id start_var,
+                        const char *prefix);
+
+#endif
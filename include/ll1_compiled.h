@@ -0,0 +1,93 @@
+#ifndef _H_LL1_COMPILED
+#define _H_LL1_COMPILED
+
+#include "./ll1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define LL1_COMPILED_MAGIC "LL1GRAM"
+#define LL1_COMPILED_VERSION 1
+#define LL1_COMPILED_BYTE_ORDER 0x01020304u
+#define LL1_COMPILED_ALIGNMENT 8
+#define LL1_COMPILED_ANY_FINGERPRINT 0ull
+#define LL1_COMPILED_PATH_LEN 4096
+
+// return codes
+#define LL1_COMPILED_SUCCESS 0
+#define LL1_COMPILED_ERROR -1
+
+// a right hand side in the file, syms_offset indexes the rhs_syms section
+typedef struct ll1_compiled_rhs {
+  int id;
+  int len;
+  symbol_id for_var;
+  int syms_offset;
+} ll1_compiled_rhs;
+
+// sections are stored at the byte offsets of the header fields ending in
+// _at, all aligned to LL1_COMPILED_ALIGNMENT. nothing in the file is a
+// pointer, so it can be mapped at any address and shared between processes.
+typedef struct ll1_compiled_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int byte_order;
+  unsigned long long fingerprint;
+  unsigned long long size;
+  symbol_id start_var;
+  int vars_len;
+  int terminals_len;
+  int cols;
+  int prods_len;
+  int syms_len;
+  int words;
+  int suffixes_len;
+  int var_buckets_len;
+  int terminal_buckets_len;
+  int names_len;
+  int terminal_cols[GRAMMAR_BYTES_LEN];
+  unsigned long long cells_at;
+  unsigned long long prod_offsets_at;
+  unsigned long long prod_syms_at;
+  unsigned long long rhs_at;
+  unsigned long long rhs_syms_at;
+  unsigned long long nullable_at;
+  unsigned long long first_sets_at;
+  unsigned long long follow_sets_at;
+  unsigned long long suffix_offsets_at;
+  unsigned long long suffix_nullable_at;
+  unsigned long long suffix_firsts_at;
+  unsigned long long var_names_at;
+  unsigned long long var_name_lens_at;
+  unsigned long long var_buckets_at;
+  unsigned long long terminal_names_at;
+  unsigned long long terminal_name_lens_at;
+  unsigned long long terminal_buckets_at;
+  unsigned long long names_at;
+} ll1_compiled_header;
+
+// a mapped compiled grammar, table, ff and symbols are views into the mapping
+// and must not be freed on their own
+typedef struct ll1_compiled {
+  void *map;
+  size_t size;
+  const ll1_compiled_header *header;
+  symbol_id start_var;
+  symbol_table symbols;
+  production_rhs *rhs;
+  production_rhs **prods;
+  ff_table ff;
+  ll1_table table;
+} ll1_compiled;
+
+void free_ll1_compiled(ll1_compiled *c);
+
+unsigned long long grammar_fingerprint(grammar *g);
+int ll1_save_compiled(const char *path, grammar *g, ff_table *fft,
+                      ll1_table *t);
+ll1_compiled *ll1_load_compiled(const char *path,
+                                unsigned long long fingerprint);
+ll1_compiled *ll1_compiled_cache_load(const char *dir, grammar *g);
+
+#endif
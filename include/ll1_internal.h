@@ -0,0 +1,119 @@
+#ifndef _H_LL1_INTERNAL
+#define _H_LL1_INTERNAL
+
+#include "./ll1.h"
+
+// helpers shared by the table driven engines in src/, not part of the api
+
+// a token is a terminal column, the end of input column is not one
+static inline int ll1_table_token_col(ll1_table *t, int token) {
+  if (token <= LL1_END_COL || token >= t->cols)
+    return LL1_NO_INDEX;
+
+  return token;
+}
+
+// grows a stack that starts in stack_buf, free *stack once it moved off it
+int ll1_stack_reserve(int **stack, int *max, int *stack_buf, int top,
+                      int len);
+
+// what a walk does at each step of the parse. the hooks return 0 to go on
+// or the result to stop with, enter also sets the mark its exit gets
+typedef struct ll1_walk_hooks {
+  int (*enter)(void *data, int row, int p, int offset, int *mark);
+  int (*terminal)(void *data, int col, int offset);
+  int (*epsilon)(void *data, int mark, int offset);
+  int (*exit)(void *data, int mark);
+} ll1_walk_hooks;
+
+// the stack of ll1_recognize_input plus markers: an expanded variable leaves
+// -(mark + 1) under its right hand side, popping it is the exit. inline so
+// every engine gets a copy with its hooks called directly.
+static inline int ll1_walk_input(ll1_table *table, symbol_id start_var,
+                                 const char *str, const int *tokens,
+                                 int str_len, const ll1_walk_hooks *h,
+                                 void *data) {
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= table->vars_len)
+    return STRING_PARSE_ERROR;
+
+  int stack_buf[LL1_WALK_STACK_LEN];
+  int *stack = stack_buf;
+  int max = LL1_WALK_STACK_LEN;
+  int top = 0;
+  int cols = table->cols;
+  int i = 0;
+  int res = 0;
+
+  stack[top] = cols + symbol_index(start_var);
+
+  while (top >= 0 && res == 0) {
+    int sym = stack[top--];
+
+    if (sym < 0) {
+      res = h->exit(data, -sym - 1);
+      continue;
+    }
+
+    int col = LL1_END_COL;
+
+    if (i < str_len) {
+      col = str != NULL ? table->terminal_cols[(unsigned char)str[i]]
+                        : ll1_table_token_col(table, tokens[i]);
+
+      if (col == LL1_NO_INDEX) {
+        res = STRING_PARSE_ERROR;
+        continue;
+      }
+    }
+
+    if (sym < cols) {
+      if (sym != col || i == str_len)
+        res = STRING_PARSE_ERROR;
+      else
+        res = h->terminal(data, sym, i++);
+      continue;
+    }
+
+    int p = table->cells[(sym - cols) * cols + col];
+    int mark = 0;
+
+    if (p == LL1_NO_PRODUCTION) {
+      res = STRING_PARSE_ERROR;
+      continue;
+    }
+
+    res = h->enter(data, sym - cols, p, i, &mark);
+    if (res != 0)
+      continue;
+
+    int from = table->prod_offsets[p];
+    int len = table->prod_offsets[p + 1] - from;
+
+    if (len == 0) {
+      res = h->epsilon(data, mark, i);
+      if (res == 0)
+        res = h->exit(data, mark);
+      continue;
+    }
+
+    // the right hand side and the marker under it
+    if (ll1_stack_reserve(&stack, &max, stack_buf, top, len + 1) != 0) {
+      res = STRING_PARSE_ERROR;
+      continue;
+    }
+
+    stack[++top] = -mark - 1;
+    memcpy(&stack[top + 1], &table->prod_syms[from], sizeof(int) * len);
+    top += len;
+  }
+
+  if (stack != stack_buf)
+    free(stack);
+
+  if (res != 0)
+    return res;
+
+  return i < str_len ? STRING_PARSE_ERROR : STRING_PARSE_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,519 @@
+#ifndef _H_LL1_STATIC
+#define _H_LL1_STATIC
+
+#include "./ll1.h"
+
+#if __cplusplus < 201402L
+#error "ll1_static.hpp needs C++14 or later"
+#endif
+
+// grammars fixed at build time, compiled into constant tables that match
+// new_ll1_table. a grammar that is not LL(1) fails to compile:
+//
+//   static constexpr ll1_static::production calc_prods[] = {
+//       {'S', "AB"}, {'B', "+AB"}, {'B', "epsilon"}, ...};
+//   static constexpr ll1_static::grammar_def calc = {
+//       "SABCDI", "+*()abcd", 'S', calc_prods,
+//       sizeof(calc_prods) / sizeof(calc_prods[0])};
+//
+//   ll1_static::recognize<calc>(str, str_len);
+//   ll1_static::fill_parse_tree<calc>(tree, str, str_len);
+namespace ll1_static {
+
+struct production {
+  char var;
+  const char *rhs;
+};
+
+struct grammar_def {
+  const char *vars;
+  const char *terminals;
+  char start_var;
+  const production *prods;
+  int prods_len;
+};
+
+// never constexpr, reaching one while compiling a table is the build error
+inline void grammar_is_not_ll1() {}
+inline void grammar_symbol_not_declared() {}
+inline void grammar_symbol_declared_twice() {}
+
+constexpr int cstr_len(const char *s) {
+  int len = 0;
+
+  while (s[len] != '\0')
+    len++;
+
+  return len;
+}
+
+constexpr bool cstr_equal(const char *a, const char *b) {
+  int i = 0;
+
+  while (a[i] != '\0' && a[i] == b[i])
+    i++;
+
+  return a[i] == b[i];
+}
+
+constexpr bool is_epsilon(const char *rhs) {
+  return cstr_equal(rhs, EPSILON_DEFINITION_1) ||
+         cstr_equal(rhs, EPSILON_DEFINITION_2);
+}
+
+constexpr int rhs_len(const char *rhs) {
+  return is_epsilon(rhs) ? 0 : cstr_len(rhs);
+}
+
+constexpr int syms_len(const grammar_def &g) {
+  int len = 0;
+
+  for (int i = 0; i < g.prods_len; i++)
+    len += rhs_len(g.prods[i].rhs);
+
+  return len;
+}
+
+// the layout of ll1_table and ff_table with sizes known at compile time.
+// columns and rows are numbered like the runtime tables, prod_syms holds the
+// right hand sides reversed in push order and rhs_syms in tree order.
+template <int Vars, int Cols, int Prods, int Syms> struct table_data {
+  static constexpr int words = (Cols + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+
+  symbol_id start_var = SYMBOL_NONE;
+  int var_rows[GRAMMAR_BYTES_LEN] = {};
+  int terminal_cols[GRAMMAR_BYTES_LEN] = {};
+  bool nullable[Vars] = {};
+  bitset_word first_sets[Vars][words] = {};
+  bitset_word follow_sets[Vars][words] = {};
+  int cells[Vars * Cols] = {};
+  int prod_vars[Prods] = {};
+  int prod_offsets[Prods + 1] = {};
+  int prod_syms[Syms + 1] = {};
+  symbol_id rhs_syms[Syms + 1] = {};
+};
+
+template <int Words>
+constexpr bool set_union(bitset_word (&dst)[Words],
+                         const bitset_word (&src)[Words]) {
+  bool changed = false;
+
+  for (int i = 0; i < Words; i++) {
+    changed |= (dst[i] | src[i]) != dst[i];
+    dst[i] |= src[i];
+  }
+
+  return changed;
+}
+
+template <int Words> constexpr bool set_add(bitset_word (&dst)[Words], int i) {
+  bitset_word bit = 1ull << (i % BITSET_WORD_BITS);
+  bool changed = (dst[i / BITSET_WORD_BITS] & bit) == 0;
+
+  dst[i / BITSET_WORD_BITS] |= bit;
+  return changed;
+}
+
+template <int Words>
+constexpr bool set_test(const bitset_word (&set)[Words], int i) {
+  return (set[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1;
+}
+
+// FIRST of the suffix of production p starting at from, returns whether the
+// suffix is nullable
+template <class Data>
+constexpr bool suffix_first(const Data &d, int p, int from,
+                            bitset_word (&out)[Data::words]) {
+  for (int i = d.prod_offsets[p] + from; i < d.prod_offsets[p + 1]; i++) {
+    symbol_id s = d.rhs_syms[i];
+
+    if ((s & SYMBOL_VAR_FLAG) == 0) {
+      set_add(out, (int)s);
+      return false;
+    }
+
+    int row = s & SYMBOL_INDEX_MASK;
+    set_union(out, d.first_sets[row]);
+
+    if (!d.nullable[row])
+      return false;
+  }
+
+  return true;
+}
+
+template <class Data>
+constexpr void build_symbols(const grammar_def &g, Data &d) {
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++) {
+    d.var_rows[i] = LL1_NO_INDEX;
+    d.terminal_cols[i] = LL1_NO_INDEX;
+  }
+
+  for (int i = 0; g.vars[i] != '\0'; i++) {
+    unsigned char c = g.vars[i];
+
+    if (c < MIN_PROD_CHAR || c > MAX_PROD_CHAR)
+      grammar_symbol_not_declared();
+    if (d.var_rows[c] != LL1_NO_INDEX)
+      grammar_symbol_declared_twice();
+
+    d.var_rows[c] = i;
+  }
+
+  // terminal 0 is the end of input marker
+  for (int i = 0; g.terminals[i] != '\0'; i++) {
+    unsigned char c = g.terminals[i];
+
+    if (c >= MIN_PROD_CHAR && c <= MAX_PROD_CHAR)
+      grammar_symbol_not_declared();
+    if (d.terminal_cols[c] != LL1_NO_INDEX)
+      grammar_symbol_declared_twice();
+
+    d.terminal_cols[c] = i + 1;
+  }
+
+  if (d.var_rows[(unsigned char)g.start_var] == LL1_NO_INDEX)
+    grammar_symbol_not_declared();
+
+  d.start_var = SYMBOL_VAR_FLAG | d.var_rows[(unsigned char)g.start_var];
+}
+
+template <class Data, int Cols>
+constexpr void build_productions(const grammar_def &g, Data &d) {
+  int len = 0;
+
+  for (int p = 0; p < g.prods_len; p++) {
+    const char *rhs = g.prods[p].rhs;
+    int n = rhs_len(rhs);
+
+    if (d.var_rows[(unsigned char)g.prods[p].var] == LL1_NO_INDEX)
+      grammar_symbol_not_declared();
+
+    d.prod_vars[p] = d.var_rows[(unsigned char)g.prods[p].var];
+    d.prod_offsets[p] = len;
+
+    for (int i = 0; i < n; i++) {
+      unsigned char c = rhs[i];
+      int row = d.var_rows[c];
+      int col = d.terminal_cols[c];
+
+      if (row == LL1_NO_INDEX && col == LL1_NO_INDEX)
+        grammar_symbol_not_declared();
+
+      d.rhs_syms[len + i] =
+          row != LL1_NO_INDEX ? SYMBOL_VAR_FLAG | row : (symbol_id)col;
+      d.prod_syms[len + n - 1 - i] = row != LL1_NO_INDEX ? Cols + row : col;
+    }
+
+    len += n;
+  }
+
+  d.prod_offsets[g.prods_len] = len;
+}
+
+// plain fixpoints instead of the runtime worklists, grammars compiled this
+// way are small and the work is paid once per build
+template <class Data>
+constexpr void build_firsts(const grammar_def &g, Data &d) {
+  for (bool changed = true; changed;) {
+    changed = false;
+
+    for (int p = 0; p < g.prods_len; p++) {
+      int row = d.prod_vars[p];
+      bitset_word first[Data::words] = {};
+      bool nullable = suffix_first(d, p, 0, first);
+
+      changed |= set_union(d.first_sets[row], first);
+
+      if (nullable && !d.nullable[row]) {
+        d.nullable[row] = true;
+        changed = true;
+      }
+    }
+  }
+}
+
+template <class Data>
+constexpr void build_follows(const grammar_def &g, Data &d) {
+  set_add(d.follow_sets[d.start_var & SYMBOL_INDEX_MASK], LL1_END_COL);
+
+  for (bool changed = true; changed;) {
+    changed = false;
+
+    for (int p = 0; p < g.prods_len; p++) {
+      int row = d.prod_vars[p];
+      int len = d.prod_offsets[p + 1] - d.prod_offsets[p];
+
+      for (int i = 0; i < len; i++) {
+        symbol_id s = d.rhs_syms[d.prod_offsets[p] + i];
+
+        if ((s & SYMBOL_VAR_FLAG) == 0)
+          continue;
+
+        bitset_word first[Data::words] = {};
+        bool nullable = suffix_first(d, p, i + 1, first);
+        bitset_word(&follow)[Data::words] =
+            d.follow_sets[s & SYMBOL_INDEX_MASK];
+
+        changed |= set_union(follow, first);
+        if (nullable)
+          changed |= set_union(follow, d.follow_sets[row]);
+      }
+    }
+  }
+}
+
+template <class Data, int Cols>
+constexpr void build_cells(const grammar_def &g, Data &d) {
+  for (int i = 0; i < (int)(sizeof(d.cells) / sizeof(d.cells[0])); i++)
+    d.cells[i] = LL1_NO_PRODUCTION;
+
+  for (int p = 0; p < g.prods_len; p++) {
+    int row = d.prod_vars[p];
+    bitset_word first[Data::words] = {};
+    bool nullable = suffix_first(d, p, 0, first);
+
+    for (int c = 0; c < Cols; c++) {
+      if (!set_test(first, c) && !(nullable && set_test(d.follow_sets[row], c)))
+        continue;
+
+      if (d.cells[row * Cols + c] != LL1_NO_PRODUCTION)
+        grammar_is_not_ll1();
+
+      d.cells[row * Cols + c] = p;
+    }
+  }
+}
+
+template <const grammar_def &G, class Data, int Cols>
+constexpr Data build_table() {
+  Data d;
+
+  build_symbols(G, d);
+  build_productions<Data, Cols>(G, d);
+  build_firsts(G, d);
+  build_follows(G, d);
+  build_cells<Data, Cols>(G, d);
+
+  return d;
+}
+
+// symbols and production ids are numbered like the runtime tables, so trees
+// print with the symbol table of the equivalent grammar
+template <const grammar_def &G> struct compiled {
+  static constexpr int vars_len = cstr_len(G.vars);
+  static constexpr int cols = cstr_len(G.terminals) + 1;
+  static constexpr int prods_len = G.prods_len;
+  typedef table_data<vars_len, cols, prods_len, syms_len(G)> data_type;
+
+  static constexpr data_type data = build_table<G, data_type, cols>();
+};
+
+// before C++17 a static constexpr member that is bound to a reference needs
+// a definition outside the class, after it the member is implicitly inline
+#if __cplusplus < 201703L
+template <const grammar_def &G>
+constexpr typename compiled<G>::data_type compiled<G>::data;
+#endif
+
+template <const grammar_def &G> constexpr symbol_id start_var() {
+  return compiled<G>::data.start_var;
+}
+
+// ll1_recognize with the table folded into the loop
+template <const grammar_def &G>
+int recognize(const char *str, int str_len) {
+  typedef compiled<G> c;
+  constexpr int cols = c::cols;
+  const auto &d = c::data;
+
+  int stack_buf[LL1_RECOGNIZE_STACK_LEN];
+  int *stack = stack_buf;
+  int max = LL1_RECOGNIZE_STACK_LEN;
+  int top = 0;
+  int i = 0;
+  int failed = 0;
+
+  stack[top] = cols + (d.start_var & SYMBOL_INDEX_MASK);
+
+  while (top >= 0 && !failed) {
+    int sym = stack[top--];
+    int col = LL1_END_COL;
+
+    if (i < str_len) {
+      col = d.terminal_cols[(unsigned char)str[i]];
+
+      if (col == LL1_NO_INDEX) {
+        failed = 1;
+        continue;
+      }
+    }
+
+    if (sym < cols) {
+      if (sym != col || i == str_len)
+        failed = 1;
+      else
+        i++;
+      continue;
+    }
+
+    int p = d.cells[(sym - cols) * cols + col];
+    if (p == LL1_NO_PRODUCTION) {
+      failed = 1;
+      continue;
+    }
+
+    int from = d.prod_offsets[p];
+    int len = d.prod_offsets[p + 1] - from;
+
+    if (top + len >= max) {
+      while (top + len >= max)
+        max *= 2;
+
+      int *temp;
+
+      if (stack == stack_buf) {
+        temp = (int *)malloc(sizeof(int) * max);
+        if (temp != NULL)
+          memcpy(temp, stack_buf, sizeof(int) * (top + 1));
+      } else {
+        temp = (int *)realloc(stack, sizeof(int) * max);
+      }
+
+      if (temp == NULL) {
+        if (stack != stack_buf)
+          free(stack);
+        return STRING_RECOGNIZE_ERROR;
+      }
+
+      stack = temp;
+    }
+
+    for (int k = 0; k < len; k++)
+      stack[top + 1 + k] = d.prod_syms[from + k];
+    top += len;
+  }
+
+  if (stack != stack_buf)
+    free(stack);
+
+  if (failed || i < str_len)
+    return i;
+
+  return STRING_RECOGNIZE_SUCCESS;
+}
+
+// fill_parse_tree_with_string over the compiled table
+template <const grammar_def &G>
+int fill_parse_tree(ll1_parse_tree *tree, const char *str, int str_len) {
+  typedef compiled<G> c;
+  constexpr int cols = c::cols;
+  const auto &d = c::data;
+
+  if (str_len == 0 || str == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  if (ll1_parse_tree_reset(tree, d.start_var) != PARSE_TREE_ADD_NODE_SUCCESS)
+    return STRING_PARSE_ERROR;
+
+  int max = LL1_PUSH_STACK_LEN;
+  int top = 0;
+  int i = 0;
+  int res = STRING_PARSE_SUCCESS;
+  int *syms = (int *)malloc(sizeof(int) * max);
+  ll1_parse_node **nodes =
+      (ll1_parse_node **)malloc(sizeof(ll1_parse_node *) * max);
+
+  if (syms == NULL || nodes == NULL) {
+    free(syms);
+    free(nodes);
+    return STRING_PARSE_ERROR;
+  }
+
+  syms[0] = cols + (d.start_var & SYMBOL_INDEX_MASK);
+  nodes[0] = tree->root;
+
+  while (top >= 0 && res == STRING_PARSE_SUCCESS) {
+    int sym = syms[top];
+    ll1_parse_node *node = nodes[top--];
+    int col = i < str_len ? d.terminal_cols[(unsigned char)str[i]]
+                          : LL1_END_COL;
+
+    if (sym < cols) {
+      if (sym != col || i == str_len)
+        res = STRING_PARSE_ERROR;
+      else
+        i++;
+      continue;
+    }
+
+    int p = col != LL1_NO_INDEX ? d.cells[(sym - cols) * cols + col]
+                                : LL1_NO_PRODUCTION;
+    if (p == LL1_NO_PRODUCTION) {
+      res = STRING_PARSE_ERROR;
+      continue;
+    }
+
+    int from = d.prod_offsets[p];
+    int len = d.prod_offsets[p + 1] - from;
+
+    if (len == 0) {
+      if (ll1_parse_tree_add_child(tree, node, SYMBOL_EPSILON, 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
+        res = STRING_PARSE_ERROR;
+      continue;
+    }
+
+    if (ll1_parse_node_reserve_children(tree, node, len) !=
+        PARSE_TREE_ADD_NODE_SUCCESS) {
+      res = STRING_PARSE_ERROR;
+      continue;
+    }
+
+    for (int k = 0; k < len && res == STRING_PARSE_SUCCESS; k++) {
+      if (ll1_parse_tree_add_child(tree, node, d.rhs_syms[from + k], 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
+        res = STRING_PARSE_ERROR;
+    }
+
+    if (res != STRING_PARSE_SUCCESS)
+      continue;
+
+    if (top + len >= max) {
+      while (top + len >= max)
+        max *= 2;
+
+      int *temp_syms = (int *)realloc(syms, sizeof(int) * max);
+      if (temp_syms != NULL)
+        syms = temp_syms;
+
+      ll1_parse_node **temp_nodes =
+          (ll1_parse_node **)realloc(nodes, sizeof(ll1_parse_node *) * max);
+      if (temp_nodes != NULL)
+        nodes = temp_nodes;
+
+      if (temp_syms == NULL || temp_nodes == NULL) {
+        res = STRING_PARSE_ERROR;
+        continue;
+      }
+    }
+
+    for (int k = 0; k < len; k++) {
+      syms[top + 1 + k] = d.prod_syms[from + k];
+      nodes[top + 1 + k] = node->children[len - 1 - k];
+    }
+    top += len;
+  }
+
+  free(syms);
+  free(nodes);
+
+  if (res != STRING_PARSE_SUCCESS || i < str_len)
+    return STRING_PARSE_ERROR;
+
+  return STRING_PARSE_SUCCESS;
+}
+
+} // namespace ll1_static
+
+#endif
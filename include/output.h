@@ -0,0 +1,34 @@
+#ifndef _H_OUTPUT
+#define _H_OUTPUT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// consts
+#define OUTPUT_BUFFER_LEN 65536
+
+// return codes
+#define OUTPUT_SUCCESS 0
+#define OUTPUT_ERROR -1
+
+// text gathered in data and handed to f with one fwrite when it fills up
+typedef struct output_buffer {
+  FILE *f;
+  int len;
+  int max;
+  int failed;
+  char *data;
+} output_buffer;
+
+void free_output_buffer(output_buffer *o);
+
+output_buffer *new_output_buffer(FILE *f, int max);
+void output_write(output_buffer *o, const char *s, int len);
+void output_str(output_buffer *o, const char *s);
+void output_char(output_buffer *o, char c);
+void output_fill(output_buffer *o, char c, int n);
+void output_int(output_buffer *o, long v);
+int output_flush(output_buffer *o);
+
+#endif
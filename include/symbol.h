@@ -0,0 +1,71 @@
+#ifndef _H_SYMBOL
+#define _H_SYMBOL
+
+#include "./arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// symbols are dense 32-bit ids, variables and terminals are numbered
+// separately from 0 and variables carry SYMBOL_VAR_FLAG. terminal 0 is always
+// the end of input marker.
+typedef unsigned int symbol_id;
+
+// consts
+#define SYMBOL_VAR_FLAG 0x80000000u
+#define SYMBOL_INDEX_MASK 0x7fffffffu
+#define SYMBOL_EPSILON 0xfffffffeu
+#define SYMBOL_ERROR 0xfffffffdu
+#define SYMBOL_NONE 0xffffffffu
+#define SYMBOL_TERMINATE 0u
+#define SYMBOL_TERMINATE_NAME "$"
+#define SYMBOL_EPSILON_NAME "eps"
+#define SYMBOL_ERROR_NAME "error"
+#define SYMBOL_NAMES_INITIAL_LEN 16
+
+typedef struct symbol_names {
+  int len;
+  int max;
+  const char **names;
+  int *name_lens;
+  int buckets_len;
+  int *buckets;
+} symbol_names;
+
+typedef struct symbol_table {
+  symbol_names vars;
+  symbol_names terminals;
+  arena *names_arena;
+} symbol_table;
+
+void free_symbol_table(symbol_table *t);
+
+symbol_table *new_symbol_table();
+symbol_id intern_var(symbol_table *t, const char *name, int len);
+symbol_id intern_terminal(symbol_table *t, const char *name, int len);
+symbol_id find_var(symbol_table *t, const char *name, int len);
+symbol_id find_terminal(symbol_table *t, const char *name, int len);
+
+const char *symbol_name(symbol_table *t, symbol_id s);
+int symbol_name_len(symbol_table *t, symbol_id s);
+
+// the packed id is looked at on every parse step, so these stay inline
+static inline int symbol_is_var(symbol_id s) {
+  return (s & SYMBOL_VAR_FLAG) != 0 && s < SYMBOL_ERROR;
+}
+
+static inline int symbol_is_terminal(symbol_id s) {
+  return (s & SYMBOL_VAR_FLAG) == 0;
+}
+
+static inline int symbol_index(symbol_id s) {
+  return (int)(s & SYMBOL_INDEX_MASK);
+}
+
+static inline symbol_id var_symbol(int index) {
+  return SYMBOL_VAR_FLAG | (symbol_id)index;
+}
+
+static inline symbol_id terminal_symbol(int index) { return (symbol_id)index; }
+
+#endif
@@ -0,0 +1,102 @@
+#include "../include/arena.h"
+
+static size_t arena_align(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+static arena_block *new_arena_block(size_t size) {
+  arena_block *b =
+      (arena_block *)malloc(arena_align(sizeof(arena_block)) + size);
+
+  if (b == NULL)
+    return NULL;
+
+  b->size = size;
+  b->used = 0;
+  b->next = NULL;
+
+  return b;
+}
+
+arena *new_arena(size_t block_size) {
+  arena *a = (arena *)malloc(sizeof(arena));
+  if (a == NULL)
+    return NULL;
+
+  if (block_size == 0)
+    block_size = ARENA_DEFAULT_BLOCK_SIZE;
+
+  a->head = new_arena_block(arena_align(block_size));
+  if (a->head == NULL) {
+    free(a);
+    return NULL;
+  }
+
+  a->capacity = a->head->size;
+
+  return a;
+}
+
+void *arena_alloc(arena *a, size_t size) {
+  size = arena_align(size);
+
+  arena_block *b = a->head;
+
+  if (b->size - b->used < size) {
+    size_t block_size = b->size * 2;
+
+    while (block_size < size)
+      block_size *= 2;
+
+    b = new_arena_block(block_size);
+    if (b == NULL)
+      return NULL;
+
+    b->next = a->head;
+    a->head = b;
+    a->capacity += block_size;
+  }
+
+  void *p = (char *)b + arena_align(sizeof(arena_block)) + b->used;
+  b->used += size;
+
+  return p;
+}
+
+void arena_reset(arena *a) {
+  if (a->head->next == NULL) {
+    a->head->used = 0;
+    return;
+  }
+
+  // merge the chain into one block that fits everything the last round
+  // needed, so the next round of the same size does not allocate
+  arena_block *merged = new_arena_block(a->capacity);
+
+  if (merged == NULL) {
+    a->head->used = 0;
+    return;
+  }
+
+  arena_block *curr = a->head;
+
+  while (curr != NULL) {
+    arena_block *next = curr->next;
+    free(curr);
+    curr = next;
+  }
+
+  a->head = merged;
+}
+
+void free_arena(arena *a) {
+  arena_block *curr = a->head;
+
+  while (curr != NULL) {
+    arena_block *next = curr->next;
+    free(curr);
+    curr = next;
+  }
+
+  free(a);
+}
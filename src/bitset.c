@@ -0,0 +1,52 @@
+#include "../include/bitset.h"
+
+int bitset_words(int bits) {
+  return (bits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+bitset_word *new_bitset(int words) {
+  return (bitset_word *)calloc(words > 0 ? words : 1, sizeof(bitset_word));
+}
+
+void bitset_clear(bitset_word *b, int words) {
+  memset(b, 0, sizeof(bitset_word) * words);
+}
+
+void bitset_set(bitset_word *b, int i) {
+  b[i / BITSET_WORD_BITS] |= (bitset_word)1 << (i % BITSET_WORD_BITS);
+}
+
+int bitset_test(const bitset_word *b, int i) {
+  return (b[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1;
+}
+
+// returns 1 when dst gained a bit
+int bitset_union(bitset_word *dst, const bitset_word *src, int words) {
+  bitset_word changed = 0;
+
+  for (int i = 0; i < words; i++) {
+    bitset_word merged = dst[i] | src[i];
+    changed |= merged ^ dst[i];
+    dst[i] = merged;
+  }
+
+  return changed != 0;
+}
+
+int bitset_intersects(const bitset_word *a, const bitset_word *b, int words) {
+  for (int i = 0; i < words; i++) {
+    if (a[i] & b[i])
+      return 1;
+  }
+
+  return 0;
+}
+
+int bitset_count(const bitset_word *b, int words) {
+  int c = 0;
+
+  for (int i = 0; i < words; i++)
+    c += __builtin_popcountll(b[i]);
+
+  return c;
+}
@@ -1,9 +1,6 @@
 #include "../include/grammar.h"
 
-grammar *new_grammar(const char *vars, const char *terminals, char start_var) {
-  if (terminals == NULL || vars == NULL)
-    return NULL;
-
+grammar *new_empty_grammar() {
   grammar *g = (grammar *)malloc(sizeof(grammar));
   if (g == NULL)
     return NULL;
@@ -14,65 +11,127 @@ grammar *new_grammar(const char *vars, const char *terminals, char start_var) {
     return NULL;
   }
 
+  g->productions_table->len = 0;
+  g->productions_table->max = GRAMMAR_INITIAL_VARS;
   g->productions_table->productions =
-      (production *)malloc(sizeof(production) * MAX_PRODS);
+      (production *)malloc(sizeof(production) * GRAMMAR_INITIAL_VARS);
   if (g->productions_table->productions == NULL) {
     free(g->productions_table);
     free(g);
     return NULL;
   }
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    production n;
-    n.var = i + PRODS_INDEX_SHIFT;
-    n.first_rhs = NULL;
-    g->productions_table->productions[i] = n;
-  }
-
-  g->terminals_len = strlen(terminals);
-  g->vars_len = strlen(vars);
-
-  g->terminals = (char *)malloc(sizeof(char) * g->terminals_len + 1);
-  if (g->terminals == NULL) {
-    free(g->productions_table->productions);
-    free(g->productions_table);
+  g->symbols = new_symbol_table();
+  if (g->symbols == NULL) {
+    free_production_table(g->productions_table);
     free(g);
     return NULL;
   }
 
-  g->vars = (char *)malloc(sizeof(char) * g->vars_len + 1);
-  if (g->vars == NULL) {
-    free(g->productions_table->productions);
-    free(g->productions_table);
-    free(g->terminals);
+  g->rhs_arena = new_arena(ARENA_DEFAULT_BLOCK_SIZE);
+  if (g->rhs_arena == NULL) {
+    free_symbol_table(g->symbols);
+    free_production_table(g->productions_table);
     free(g);
     return NULL;
   }
 
-  if (strcpy(g->vars, vars) == NULL ||
-      strcpy(g->terminals, terminals) == NULL) {
-    free(g->productions_table->productions);
-    free(g->productions_table);
-    free(g->terminals);
-    free(g->vars);
-    free(g);
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++)
+    g->byte_terminals[i] = GRAMMAR_NO_TERMINAL;
+
+  g->tokens_len = 0;
+  g->tokens_max = 0;
+  g->tokens = NULL;
+  g->vars_len = 0;
+  g->terminals_len = g->symbols->terminals.len;
+  g->start_var = SYMBOL_NONE;
+
+  return g;
+}
+
+grammar *new_grammar(const char *vars, const char *terminals, char start_var) {
+  if (terminals == NULL || vars == NULL)
     return NULL;
-  }
 
-  if (strchr(vars, start_var) == NULL) {
-    free(g->productions_table->productions);
-    free(g->productions_table);
-    free(g->terminals);
-    free(g->vars);
-    free(g);
+  if (strchr(vars, start_var) == NULL)
     return NULL;
+
+  grammar *g = new_empty_grammar();
+  if (g == NULL)
+    return NULL;
+
+  for (int i = 0; vars[i] != '\0'; i++) {
+    if (vars[i] < MIN_PROD_CHAR || vars[i] > MAX_PROD_CHAR ||
+        grammar_add_var(g, &vars[i], 1) == SYMBOL_NONE) {
+      free_grammar(g);
+      return NULL;
+    }
   }
 
-  g->start_var = start_var;
+  for (int i = 0; terminals[i] != '\0'; i++) {
+    if (grammar_add_terminal(g, &terminals[i], 1) == SYMBOL_NONE) {
+      free_grammar(g);
+      return NULL;
+    }
+  }
+
+  g->start_var = find_var(g->symbols, &start_var, 1);
 
   return g;
 }
 
+symbol_id grammar_add_var(grammar *g, const char *name, int len) {
+  symbol_id var = intern_var(g->symbols, name, len);
+  if (var == SYMBOL_NONE)
+    return SYMBOL_NONE;
+
+  production_table *t = g->productions_table;
+  int index = symbol_index(var);
+
+  if (index < g->vars_len)
+    return var;
+
+  if (index >= t->max) {
+    int max = t->max * 2;
+    production *temp =
+        (production *)realloc(t->productions, sizeof(production) * max);
+
+    if (temp == NULL)
+      return SYMBOL_NONE;
+
+    t->productions = temp;
+    t->max = max;
+  }
+
+  t->productions[index].var = var;
+  t->productions[index].len = 0;
+  t->productions[index].first_rhs = NULL;
+  g->vars_len = index + 1;
+
+  return var;
+}
+
+symbol_id grammar_add_terminal(grammar *g, const char *name, int len) {
+  symbol_id terminal = intern_terminal(g->symbols, name, len);
+  if (terminal == SYMBOL_NONE)
+    return SYMBOL_NONE;
+
+  if (len == 1 && terminal != SYMBOL_TERMINATE)
+    g->byte_terminals[(unsigned char)name[0]] = symbol_index(terminal);
+
+  g->terminals_len = g->symbols->terminals.len;
+
+  return terminal;
+}
+
+int grammar_set_start_var(grammar *g, symbol_id var) {
+  if (!symbol_is_var(var) || symbol_index(var) >= g->vars_len)
+    return INCORRECT_VAR_SIGN;
+
+  g->start_var = var;
+  return SUCCESS_ADD_PROD;
+}
+
 int add_production(grammar *g, char var, const char *rhs) {
   if (var < MIN_PROD_CHAR || var > MAX_PROD_CHAR)
     return INCORRECT_VAR_SIGN;
@@ -81,42 +140,131 @@ int add_production(grammar *g, char var, const char *rhs) {
   if (g == NULL)
     return NULL_GRAMMAR_RECEIVED;
 
-  production_rhs *new_rhs = (production_rhs *)malloc(sizeof(production_rhs));
+  symbol_id v = grammar_add_var(g, &var, 1);
+  if (v == SYMBOL_NONE)
+    return ERROR_ADD_PROD;
 
   if (strcmp(rhs, EPSILON_DEFINITION_1) == 0 ||
-      strcmp(rhs, EPSILON_DEFINITION_2) == 0) {
-    new_rhs->rhs = (char *)malloc(sizeof(char) * 1);
-    new_rhs->rhs[0] = EPSILON;
-  } else {
-    new_rhs->rhs = (char *)malloc(sizeof(char) * strlen(rhs));
-    strcpy(new_rhs->rhs, rhs);
+      strcmp(rhs, EPSILON_DEFINITION_2) == 0)
+    return add_production_symbols(g, v, NULL, 0);
+
+  int len = strlen(rhs);
+  symbol_id *syms = (symbol_id *)malloc(sizeof(symbol_id) * (len + 1));
+  if (syms == NULL)
+    return ERROR_ADD_PROD;
+
+  for (int i = 0; i < len; i++) {
+    if (rhs[i] >= MIN_PROD_CHAR && rhs[i] <= MAX_PROD_CHAR)
+      syms[i] = grammar_add_var(g, &rhs[i], 1);
+    else
+      syms[i] = grammar_add_terminal(g, &rhs[i], 1);
+
+    if (syms[i] == SYMBOL_NONE || syms[i] == SYMBOL_TERMINATE) {
+      free(syms);
+      return ERROR_ADD_PROD;
+    }
   }
 
-  new_rhs->for_var = var;
-  new_rhs->next = NULL;
+  int res = add_production_symbols(g, v, syms, len);
+  free(syms);
 
-  int index = var - PRODS_INDEX_SHIFT;
+  return res;
+}
 
-  production_table *t = g->productions_table;
+int add_production_symbols(grammar *g, symbol_id var, const symbol_id *rhs,
+                           int len) {
+  if (g == NULL)
+    return NULL_GRAMMAR_RECEIVED;
+  if (!symbol_is_var(var) || symbol_index(var) >= g->vars_len)
+    return INCORRECT_VAR_SIGN;
+  if (rhs == NULL && len != 0)
+    return NULL_RULE_RECEIVED;
 
-  if (t->productions[index].first_rhs != NULL) {
-    new_rhs->next = t->productions[index].first_rhs;
+  production_rhs *new_rhs =
+      (production_rhs *)arena_alloc(g->rhs_arena, sizeof(production_rhs));
+  if (new_rhs == NULL)
+    return ERROR_ADD_PROD;
+
+  new_rhs->syms = NULL;
+
+  if (len > 0) {
+    new_rhs->syms =
+        (symbol_id *)arena_alloc(g->rhs_arena, sizeof(symbol_id) * len);
+    if (new_rhs->syms == NULL)
+      return ERROR_ADD_PROD;
+
+    memcpy(new_rhs->syms, rhs, sizeof(symbol_id) * len);
   }
 
-  t->productions[index].first_rhs = new_rhs;
+  production_table *t = g->productions_table;
+  production *p = &t->productions[symbol_index(var)];
+
+  new_rhs->id = t->len;
+  new_rhs->len = len;
+  new_rhs->for_var = var;
+  new_rhs->next = p->first_rhs;
+
+  p->first_rhs = new_rhs;
+  p->len++;
   t->len++;
 
   return SUCCESS_ADD_PROD;
 }
 
-int get_production(grammar *g, char var, production *prod) {
-  if (var < MIN_PROD_CHAR || var > MAX_PROD_CHAR) {
+// earlier definitions win ties between matches of the same length
+int grammar_add_token(grammar *g, symbol_id terminal, int kind,
+                      const char *text, int len) {
+  if (g == NULL)
+    return NULL_GRAMMAR_RECEIVED;
+  if (text == NULL || len <= 0 ||
+      (kind != TOKEN_LITERAL && kind != TOKEN_PATTERN))
+    return ERROR_ADD_TOKEN;
+  if (terminal != SYMBOL_NONE &&
+      (!symbol_is_terminal(terminal) || terminal == SYMBOL_TERMINATE ||
+       symbol_index(terminal) >= g->terminals_len))
+    return ERROR_ADD_TOKEN;
+
+  if (g->tokens_len == g->tokens_max) {
+    int max = g->tokens_max > 0 ? g->tokens_max * 2 : GRAMMAR_INITIAL_TOKENS;
+    token_def *temp = (token_def *)realloc(g->tokens, sizeof(token_def) * max);
+
+    if (temp == NULL)
+      return ERROR_ADD_TOKEN;
+
+    g->tokens = temp;
+    g->tokens_max = max;
+  }
+
+  char *copy = (char *)arena_alloc(g->rhs_arena, len + 1);
+  if (copy == NULL)
+    return ERROR_ADD_TOKEN;
+
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+
+  token_def *t = &g->tokens[g->tokens_len++];
+  t->terminal = terminal;
+  t->kind = kind;
+  t->len = len;
+  t->text = copy;
+
+  return SUCCESS_ADD_TOKEN;
+}
+
+int grammar_add_skip(grammar *g, const char *pattern) {
+  if (pattern == NULL)
+    return ERROR_ADD_TOKEN;
+
+  return grammar_add_token(g, SYMBOL_NONE, TOKEN_PATTERN, pattern,
+                           strlen(pattern));
+}
+
+int get_production(grammar *g, symbol_id var, production *prod) {
+  if (!symbol_is_var(var) || symbol_index(var) >= g->vars_len) {
     return INCORRECT_VAR_SIGN;
   }
 
-  production_table *t = g->productions_table;
-  int index = var - PRODS_INDEX_SHIFT;
-  production p = t->productions[index];
+  production p = g->productions_table->productions[symbol_index(var)];
 
   if (p.first_rhs == NULL) {
     return UNDEFINED_PRODUCTION;
@@ -126,23 +274,17 @@ int get_production(grammar *g, char var, production *prod) {
   return PRODUCTION_FOUND;
 }
 
-int var_has_epsilon_rhs(grammar *g, char var) {
-  if (var < MIN_PROD_CHAR || var > MAX_PROD_CHAR)
-    return INCORRECT_VAR_SIGN;
+int var_has_epsilon_rhs(grammar *g, symbol_id var) {
+  production p;
 
-  production_table *t = g->productions_table;
-
-  int index = var - PRODS_INDEX_SHIFT;
-  production p = t->productions[index];
-
-  if (p.first_rhs == NULL) {
-    return UNDEFINED_PRODUCTION;
-  }
+  int res = get_production(g, var, &p);
+  if (res != PRODUCTION_FOUND)
+    return res;
 
   production_rhs *curr = p.first_rhs;
 
   while (curr != NULL) {
-    if (curr->rhs[0] == (char)EPSILON) {
+    if (curr->len == 0) {
       return EPS_PROD_FOUND;
     }
 
@@ -152,205 +294,174 @@ int var_has_epsilon_rhs(grammar *g, char var) {
   return EPS_PROD_NOT_FOUND;
 }
 
+// writes the right hand side into buff, single character names are written
+// back to back as before and longer names are separated by spaces. returns
+// the length the full text needs, like snprintf.
+int format_production_rhs(symbol_table *t, production_rhs *rhs, char *buff,
+                          int size) {
+  int spaced = 0;
+  int l = 0;
+
+  if (rhs->len == 0)
+    return snprintf(buff, size, "%s", SYMBOL_EPSILON_NAME);
+
+  for (int i = 0; i < rhs->len; i++) {
+    if (symbol_name_len(t, rhs->syms[i]) != 1)
+      spaced = 1;
+  }
+
+  for (int i = 0; i < rhs->len; i++) {
+    const char *name = symbol_name(t, rhs->syms[i]);
+    int name_len = symbol_name_len(t, rhs->syms[i]);
+
+    if (spaced && i > 0) {
+      if (l < size - 1)
+        buff[l] = ' ';
+      l++;
+    }
+
+    for (int j = 0; j < name_len; j++, l++) {
+      if (l < size - 1)
+        buff[l] = name[j];
+    }
+  }
+
+  if (size > 0)
+    buff[l < size - 1 ? l : size - 1] = '\0';
+
+  return l;
+}
+
 void print_grammar(grammar *g) {
+  symbol_table *s = g->symbols;
+
   printf("Grammar:\n");
   printf("   Variables: ");
 
   for (int i = 0; i < g->vars_len; i++) {
     if (i == g->vars_len - 1) {
-      printf("%c", g->vars[i]);
+      printf("%s", symbol_name(s, var_symbol(i)));
     } else {
-      printf("%c,", g->vars[i]);
+      printf("%s,", symbol_name(s, var_symbol(i)));
     }
   }
 
   printf("\n");
   printf("   Terminals: ");
 
-  for (int i = 0; i < g->terminals_len; i++) {
+  for (int i = 1; i < g->terminals_len; i++) {
     if (i == g->terminals_len - 1) {
-      printf("%c", g->terminals[i]);
+      printf("%s", symbol_name(s, terminal_symbol(i)));
     } else {
-      printf("%c,", g->terminals[i]);
+      printf("%s,", symbol_name(s, terminal_symbol(i)));
     }
   }
 
   printf("\n");
-  printf("   Start Variable: %c", g->start_var);
+  // a grammar made with new_empty_grammar has no start variable yet
+  int has_start = g->start_var != SYMBOL_NONE;
+
+  printf("   Start Variable: %s",
+         has_start ? symbol_name(s, g->start_var) : "none");
   printf("\n");
 
   printf("   Productions:\n");
 
   production_table *t = g->productions_table;
 
-  production start = t->productions[g->start_var - PRODS_INDEX_SHIFT];
-  print_production(start, 6);
-  printf("\n");
+  if (has_start) {
+    production start = t->productions[symbol_index(g->start_var)];
+    print_production(g, start, 6);
+    printf("\n");
+  }
 
-  for (int i = 0; i < MAX_PRODS; i++) {
+  for (int i = 0; i < g->vars_len; i++) {
     production p = t->productions[i];
     if (p.first_rhs != NULL && p.var != g->start_var) {
 
-      print_production(p, 6);
+      print_production(g, p, 6);
       printf("\n");
     }
   }
 }
 
-void print_production(production p, int space_indent) {
+void print_production(grammar *g, production p, int space_indent) {
   for (int i = 0; i < space_indent; i++) {
     printf(" ");
   }
 
-  printf("%c -> ", p.var);
+  printf("%s -> ", symbol_name(g->symbols, p.var));
 
   production_rhs *curr = p.first_rhs;
 
   while (curr != NULL) {
-    if (curr->next == NULL) {
-      if (curr->rhs[0] == EPSILON) {
-        printf("epsilon");
-      } else {
-        printf("%s", curr->rhs);
-      }
-      break;
+    if (curr->len == 0) {
+      printf("epsilon");
     } else {
-      if (curr->rhs[0] == EPSILON) {
-        printf("epsilon | ");
+      char buff[256];
+      int l = format_production_rhs(g->symbols, curr, buff, sizeof(buff));
+
+      if (l < (int)sizeof(buff)) {
+        printf("%s", buff);
       } else {
-        printf("%s | ", curr->rhs);
+        char *big = (char *)malloc(l + 1);
+        if (big != NULL) {
+          format_production_rhs(g->symbols, curr, big, l + 1);
+          printf("%s", big);
+          free(big);
+        }
       }
-      curr = curr->next;
     }
+
+    if (curr->next != NULL)
+      printf(" | ");
+
+    curr = curr->next;
   }
 }
 
 void free_grammar(grammar *g) {
-  free(g->vars);
-  free(g->terminals);
+  free_symbol_table(g->symbols);
   free_production_table(g->productions_table);
+  free_arena(g->rhs_arena);
+  free(g->tokens);
   free(g);
 }
 
 void free_production_table(production_table *t) {
-  for (int i = 0; i < MAX_PRODS; i++) {
-    free_production_rhs(t->productions[i].first_rhs);
-  }
-
   free(t->productions);
   free(t);
 }
 
-void free_production_rhs(production_rhs *rhs) {
-  if (rhs == NULL)
-    return;
-  free_production_rhs(rhs->next);
-  free(rhs->rhs);
-  free(rhs);
-}
-
-production_rhs_stack *new_production_rhs_stack(int max) {
-  production_rhs_stack *s =
-      (production_rhs_stack *)malloc(sizeof(production_rhs_stack));
+symbol_stack *new_symbol_stack(int max) {
+  symbol_stack *s = (symbol_stack *)malloc(sizeof(symbol_stack));
 
   if (s == NULL)
     return NULL;
 
-  s->data = (production_rhs **)malloc(sizeof(production_rhs *) * max);
-  s->top = -1;
-  s->max = max;
-
-  if (s->data == NULL) {
-    if (s != NULL)
-      free(s);
-
-    return NULL;
-  }
-
-  return s;
-}
-
-void free_production_rhs_stack(production_rhs_stack *s) {
-  free(s->data);
-  free(s);
-}
-
-int production_rhs_stack_is_full(production_rhs_stack *s) {
-  return s->top == s->max - 1;
-}
-int production_rhs_stack_is_empty(production_rhs_stack *s) {
-  return s->top == -1;
-}
-
-int production_rhs_stack_increase(production_rhs_stack *s) {
-  s->max *= 2;
-  production_rhs **temp =
-      (production_rhs **)realloc(s->data, sizeof(production_rhs *) * s->max);
-
-  if (temp == NULL)
-    return -1;
-
-  s->data = temp;
-  return 0;
-}
-
-production_rhs *production_rhs_stack_top(production_rhs_stack *s) {
-  return s->data[s->top];
-}
-
-int production_rhs_stack_push(production_rhs_stack *s, production_rhs *rhs) {
-  int new_top = ++s->top;
-
-  if (new_top > s->max - 1) {
-    int res = production_rhs_stack_increase(s);
-    if (res != 0)
-      return res;
-  }
-
-  s->data[new_top] = rhs;
-
-  return 0;
-}
-
-int production_rhs_stack_pop(production_rhs_stack *s, production_rhs **rhs) {
-  if (s->top < 0)
-    return -1;
-
-  if (rhs != NULL) {
-    (*rhs) = s->data[s->top];
-  }
-
-  s->top--;
-  return 0;
-}
-
-char_stack *new_char_stack(int max) {
-  char_stack *s = (char_stack *)malloc(sizeof(char_stack));
-  s->data = (char **)malloc(sizeof(char *) * max);
+  s->data = (symbol_id *)malloc(sizeof(symbol_id) * max);
   s->top = -1;
   s->max = max;
 
   if (s->data == NULL) {
-    if (s != NULL)
-      free(s);
-
+    free(s);
     return NULL;
   }
 
   return s;
 }
 
-void free_char_stack(char_stack *s) {
+void free_symbol_stack(symbol_stack *s) {
   free(s->data);
   free(s);
 }
 
-int char_stack_is_full(char_stack *s) { return s->top == s->max - 1; }
-int char_stack_is_empty(char_stack *s) { return s->top == -1; }
+int symbol_stack_is_full(symbol_stack *s) { return s->top == s->max - 1; }
+int symbol_stack_is_empty(symbol_stack *s) { return s->top == -1; }
 
-int char_stack_increase(char_stack *s) {
+int symbol_stack_increase(symbol_stack *s) {
   s->max *= 2;
-  char **temp = (char **)realloc(s->data, sizeof(char *) * s->max);
+  symbol_id *temp = (symbol_id *)realloc(s->data, sizeof(symbol_id) * s->max);
 
   if (temp == NULL)
     return -1;
@@ -359,13 +470,13 @@ int char_stack_increase(char_stack *s) {
   return 0;
 }
 
-char *char_stack_top(char_stack *s) { return s->data[s->top]; }
+symbol_id symbol_stack_top(symbol_stack *s) { return s->data[s->top]; }
 
-int char_stack_push(char_stack *s, char *c) {
+int symbol_stack_push(symbol_stack *s, symbol_id c) {
   int new_top = ++s->top;
 
   if (new_top > s->max - 1) {
-    int res = char_stack_increase(s);
+    int res = symbol_stack_increase(s);
     if (res != 0)
       return res;
   }
@@ -375,7 +486,7 @@ int char_stack_push(char_stack *s, char *c) {
   return 0;
 }
 
-int char_stack_pop(char_stack *s, char **c) {
+int symbol_stack_pop(symbol_stack *s, symbol_id *c) {
   if (s->top < 0)
     return -1;
 
@@ -0,0 +1,577 @@
+#include "../include/grammar_file.h"
+#include <ctype.h>
+#include <stdarg.h>
+
+// grammar files are BNF with yacc style rules and lexer directives:
+//
+//   # comment
+//   %start <expr>
+//   %token NUM /[0-9]+/
+//   %token WHILE "while"
+//   %skip /[ \t\n]+/
+//   <expr> ::= <term> <tail> ;
+//   <tail> ::= "+" <term> <tail> | eps ;
+//   <term> ::= NUM | "(" <expr> ")" ;
+//
+// <name> is a variable, "text" a terminal spelled as that text (which also
+// defines a literal token for the lexer) and a bare name a terminal spelled
+// by its %token definition. an empty alternative, eps or epsilon is the
+// empty right hand side. the start variable defaults to the left hand side
+// of the first rule.
+
+// kinds of the pieces a grammar file is made of
+#define GRAMMAR_FILE_END 0
+#define GRAMMAR_FILE_VAR 1
+#define GRAMMAR_FILE_NAME 2
+#define GRAMMAR_FILE_STRING 3
+#define GRAMMAR_FILE_PATTERN 4
+#define GRAMMAR_FILE_DEFINE 5
+#define GRAMMAR_FILE_ALT 6
+#define GRAMMAR_FILE_SEMI 7
+#define GRAMMAR_FILE_DIRECTIVE 8
+#define GRAMMAR_FILE_BAD -1
+
+// text of a piece points into the file, except for strings whose unescaped
+// text is in the reader's buffer
+typedef struct grammar_file_piece {
+  int kind;
+  const char *text;
+  int len;
+  int line;
+  int col;
+} grammar_file_piece;
+
+// where a bare name was first used, it must get a %token somewhere in the
+// file since nothing else tells the lexer how it is spelled
+typedef struct grammar_file_use {
+  symbol_id terminal;
+  int line;
+  int col;
+} grammar_file_use;
+
+typedef struct grammar_reader {
+  const char *text;
+  int len;
+  int pos;
+  int line;
+  int line_start;
+  grammar *g;
+  grammar_file_error *err;
+  int failed;
+  char *buff;
+  int syms_len;
+  int syms_max;
+  symbol_id *syms;
+  int uses_len;
+  int uses_max;
+  grammar_file_use *uses;
+} grammar_reader;
+
+static void grammar_reader_error(grammar_reader *r, int line, int col,
+                                 const char *fmt, ...) {
+  if (r->failed)
+    return;
+
+  r->failed = 1;
+  r->err->line = line;
+  r->err->col = col;
+
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(r->err->msg, sizeof(r->err->msg), fmt, args);
+  va_end(args);
+}
+
+static int grammar_file_name_char(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+}
+
+static void grammar_reader_skip_space(grammar_reader *r) {
+  while (r->pos < r->len) {
+    char c = r->text[r->pos];
+
+    if (c == '#') {
+      while (r->pos < r->len && r->text[r->pos] != '\n')
+        r->pos++;
+      continue;
+    }
+
+    if (!isspace((unsigned char)c))
+      return;
+
+    r->pos++;
+    if (c == '\n') {
+      r->line++;
+      r->line_start = r->pos;
+    }
+  }
+}
+
+// reads up to the closing quote or slash, which may not be on another line.
+// strings are unescaped into buff, patterns are kept as written since the
+// lexer reads the escapes itself.
+static int grammar_reader_quoted(grammar_reader *r, grammar_file_piece *p,
+                                 char close) {
+  int is_string = close == '"';
+  int len = 0;
+
+  p->text = is_string ? r->buff : &r->text[r->pos];
+
+  while (r->pos < r->len && r->text[r->pos] != close &&
+         r->text[r->pos] != '\n') {
+    char c = r->text[r->pos++];
+
+    if (c == '\\' && r->pos < r->len && r->text[r->pos] != '\n') {
+      char e = r->text[r->pos++];
+
+      if (!is_string) {
+        len += 2;
+        continue;
+      }
+
+      if (e == 'n')
+        c = '\n';
+      else if (e == 't')
+        c = '\t';
+      else if (e == 'r')
+        c = '\r';
+      else
+        c = e;
+    } else if (!is_string) {
+      len++;
+      continue;
+    }
+
+    r->buff[len++] = c;
+  }
+
+  if (r->pos >= r->len || r->text[r->pos] != close) {
+    grammar_reader_error(r, p->line, p->col, "unterminated %s",
+                         is_string ? "string" : "pattern");
+    return GRAMMAR_FILE_BAD;
+  }
+
+  r->pos++;
+
+  if (len == 0) {
+    grammar_reader_error(r, p->line, p->col, "empty %s",
+                         is_string ? "string" : "pattern");
+    return GRAMMAR_FILE_BAD;
+  }
+
+  p->len = len;
+  return is_string ? GRAMMAR_FILE_STRING : GRAMMAR_FILE_PATTERN;
+}
+
+// patterns are only read where one is expected, elsewhere / is an error
+static int grammar_reader_next(grammar_reader *r, grammar_file_piece *p,
+                               int want_pattern) {
+  grammar_reader_skip_space(r);
+
+  p->line = r->line;
+  p->col = r->pos - r->line_start + 1;
+  p->text = &r->text[r->pos];
+  p->len = 0;
+
+  if (r->pos >= r->len)
+    return p->kind = GRAMMAR_FILE_END;
+
+  char c = r->text[r->pos++];
+
+  if (c == '|')
+    return p->kind = GRAMMAR_FILE_ALT;
+  if (c == ';')
+    return p->kind = GRAMMAR_FILE_SEMI;
+
+  if (c == ':') {
+    if (r->len - r->pos >= 2 && r->text[r->pos] == ':' &&
+        r->text[r->pos + 1] == '=') {
+      r->pos += 2;
+      return p->kind = GRAMMAR_FILE_DEFINE;
+    }
+  } else if (c == '"' || (c == '/' && want_pattern)) {
+    return p->kind = grammar_reader_quoted(r, p, c);
+  } else if (c == '<') {
+    p->text = &r->text[r->pos];
+
+    while (r->pos < r->len && r->text[r->pos] != '>' &&
+           r->text[r->pos] != '\n')
+      r->pos++;
+
+    p->len = &r->text[r->pos] - p->text;
+
+    if (r->pos < r->len && r->text[r->pos] == '>' && p->len > 0) {
+      r->pos++;
+      return p->kind = GRAMMAR_FILE_VAR;
+    }
+
+    grammar_reader_error(r, p->line, p->col, "unterminated variable name");
+    return p->kind = GRAMMAR_FILE_BAD;
+  } else if (c == '%' || grammar_file_name_char(c)) {
+    if (c == '%')
+      p->text = &r->text[r->pos];
+
+    while (r->pos < r->len && grammar_file_name_char(r->text[r->pos]))
+      r->pos++;
+
+    p->len = &r->text[r->pos] - p->text;
+
+    if (p->len > 0)
+      return p->kind = c == '%' ? GRAMMAR_FILE_DIRECTIVE : GRAMMAR_FILE_NAME;
+  }
+
+  grammar_reader_error(r, p->line, p->col, "unexpected '%c'", c);
+  return p->kind = GRAMMAR_FILE_BAD;
+}
+
+static int grammar_file_piece_is(grammar_file_piece *p, const char *word) {
+  int len = strlen(word);
+  return p->len == len && memcmp(p->text, word, len) == 0;
+}
+
+static symbol_id grammar_reader_var(grammar_reader *r, grammar_file_piece *p) {
+  symbol_id var = grammar_add_var(r->g, p->text, p->len);
+
+  if (var == SYMBOL_NONE)
+    grammar_reader_error(r, p->line, p->col, "cannot add variable <%.*s>",
+                         p->len, p->text);
+
+  return var;
+}
+
+static void grammar_reader_use(grammar_reader *r, symbol_id terminal,
+                               grammar_file_piece *p) {
+  if (r->uses_len == r->uses_max) {
+    int max = r->uses_max > 0 ? r->uses_max * 2 : GRAMMAR_FILE_INITIAL_SYMS;
+    grammar_file_use *temp =
+        (grammar_file_use *)realloc(r->uses, sizeof(grammar_file_use) * max);
+
+    if (temp == NULL) {
+      grammar_reader_error(r, p->line, p->col, "out of memory");
+      return;
+    }
+
+    r->uses = temp;
+    r->uses_max = max;
+  }
+
+  grammar_file_use *u = &r->uses[r->uses_len++];
+  u->terminal = terminal;
+  u->line = p->line;
+  u->col = p->col;
+}
+
+// a quoted terminal is spelled by its own text, so the first use also
+// defines the literal token the lexer matches it with
+static symbol_id grammar_reader_terminal(grammar_reader *r,
+                                         grammar_file_piece *p) {
+  symbol_id terminal = find_terminal(r->g->symbols, p->text, p->len);
+
+  if (terminal == SYMBOL_NONE) {
+    terminal = grammar_add_terminal(r->g, p->text, p->len);
+
+    if (p->kind == GRAMMAR_FILE_STRING && terminal != SYMBOL_NONE &&
+        terminal != SYMBOL_TERMINATE &&
+        grammar_add_token(r->g, terminal, TOKEN_LITERAL, p->text, p->len) !=
+            SUCCESS_ADD_TOKEN)
+      terminal = SYMBOL_NONE;
+
+    if (p->kind == GRAMMAR_FILE_NAME && terminal != SYMBOL_NONE &&
+        terminal != SYMBOL_TERMINATE)
+      grammar_reader_use(r, terminal, p);
+  }
+
+  if (terminal == SYMBOL_NONE || terminal == SYMBOL_TERMINATE) {
+    grammar_reader_error(r, p->line, p->col, "cannot add terminal %.*s",
+                         p->len, p->text);
+    return SYMBOL_NONE;
+  }
+
+  return terminal;
+}
+
+static void grammar_reader_push(grammar_reader *r, symbol_id sym) {
+  if (r->syms_len == r->syms_max) {
+    int max = r->syms_max * 2;
+    symbol_id *temp =
+        (symbol_id *)realloc(r->syms, sizeof(symbol_id) * max);
+
+    if (temp == NULL) {
+      grammar_reader_error(r, r->line, 0, "out of memory");
+      return;
+    }
+
+    r->syms = temp;
+    r->syms_max = max;
+  }
+
+  r->syms[r->syms_len++] = sym;
+}
+
+static void grammar_reader_directive(grammar_reader *r,
+                                     grammar_file_piece *d) {
+  grammar_file_piece p;
+
+  if (grammar_file_piece_is(d, "start")) {
+    if (grammar_reader_next(r, &p, 0) != GRAMMAR_FILE_VAR) {
+      grammar_reader_error(r, p.line, p.col, "expected <variable> after %%start");
+      return;
+    }
+
+    symbol_id var = grammar_reader_var(r, &p);
+    if (var != SYMBOL_NONE)
+      grammar_set_start_var(r->g, var);
+    return;
+  }
+
+  symbol_id terminal = SYMBOL_NONE;
+
+  if (grammar_file_piece_is(d, "token")) {
+    if (grammar_reader_next(r, &p, 0) != GRAMMAR_FILE_NAME) {
+      grammar_reader_error(r, p.line, p.col, "expected a name after %%token");
+      return;
+    }
+
+    terminal = grammar_reader_terminal(r, &p);
+    if (terminal == SYMBOL_NONE)
+      return;
+  } else if (!grammar_file_piece_is(d, "skip")) {
+    grammar_reader_error(r, d->line, d->col, "unknown directive %%%.*s",
+                         d->len, d->text);
+    return;
+  }
+
+  int kind = grammar_reader_next(r, &p, 1);
+
+  if (kind != GRAMMAR_FILE_STRING && kind != GRAMMAR_FILE_PATTERN) {
+    grammar_reader_error(r, p.line, p.col, "expected \"text\" or /pattern/");
+    return;
+  }
+
+  if (grammar_add_token(r->g, terminal,
+                        kind == GRAMMAR_FILE_STRING ? TOKEN_LITERAL
+                                                    : TOKEN_PATTERN,
+                        p.text, p.len) != SUCCESS_ADD_TOKEN)
+    grammar_reader_error(r, p.line, p.col, "cannot add token definition");
+}
+
+static void grammar_reader_rule(grammar_reader *r, grammar_file_piece *lhs) {
+  symbol_id var = grammar_reader_var(r, lhs);
+  if (var == SYMBOL_NONE)
+    return;
+
+  if (r->g->start_var == SYMBOL_NONE)
+    grammar_set_start_var(r->g, var);
+
+  grammar_file_piece p;
+
+  if (grammar_reader_next(r, &p, 0) != GRAMMAR_FILE_DEFINE) {
+    grammar_reader_error(r, p.line, p.col, "expected ::= after <%.*s>",
+                         lhs->len, lhs->text);
+    return;
+  }
+
+  int epsilon = 0;
+  r->syms_len = 0;
+
+  while (!r->failed) {
+    int kind = grammar_reader_next(r, &p, 0);
+
+    if (kind == GRAMMAR_FILE_ALT || kind == GRAMMAR_FILE_SEMI) {
+      if (epsilon && r->syms_len > 0) {
+        grammar_reader_error(r, p.line, p.col,
+                             "epsilon must be alone in its alternative");
+        return;
+      }
+
+      if (add_production_symbols(r->g, var, r->syms, r->syms_len) !=
+          SUCCESS_ADD_PROD) {
+        grammar_reader_error(r, p.line, p.col, "cannot add production");
+        return;
+      }
+
+      if (kind == GRAMMAR_FILE_SEMI)
+        return;
+
+      epsilon = 0;
+      r->syms_len = 0;
+      continue;
+    }
+
+    symbol_id sym = SYMBOL_NONE;
+
+    if (kind == GRAMMAR_FILE_VAR) {
+      sym = grammar_reader_var(r, &p);
+    } else if (kind == GRAMMAR_FILE_NAME &&
+               (grammar_file_piece_is(&p, EPSILON_DEFINITION_1) ||
+                grammar_file_piece_is(&p, EPSILON_DEFINITION_2))) {
+      epsilon = 1;
+      continue;
+    } else if (kind == GRAMMAR_FILE_NAME || kind == GRAMMAR_FILE_STRING) {
+      sym = grammar_reader_terminal(r, &p);
+    } else if (kind == GRAMMAR_FILE_END) {
+      grammar_reader_error(r, p.line, p.col, "missing ; after rule for <%.*s>",
+                           lhs->len, lhs->text);
+    } else {
+      grammar_reader_error(r, p.line, p.col, "unexpected symbol in rule");
+    }
+
+    if (sym != SYMBOL_NONE)
+      grammar_reader_push(r, sym);
+  }
+}
+
+// every variable used must have a rule, or no input would ever derive it,
+// and every bare name a %token, or no input would ever spell it
+static void grammar_reader_check(grammar_reader *r) {
+  grammar *g = r->g;
+
+  if (g->start_var == SYMBOL_NONE) {
+    grammar_reader_error(r, 0, 0, "no rules");
+    return;
+  }
+
+  for (int i = 0; i < g->vars_len; i++) {
+    if (g->productions_table->productions[i].len > 0)
+      continue;
+
+    symbol_id var = var_symbol(i);
+    grammar_reader_error(r, 0, 0, "variable <%.*s> has no rules",
+                         symbol_name_len(g->symbols, var),
+                         symbol_name(g->symbols, var));
+    return;
+  }
+
+  for (int i = 0; i < r->uses_len; i++) {
+    grammar_file_use *u = &r->uses[i];
+    int k = 0;
+
+    while (k < g->tokens_len && g->tokens[k].terminal != u->terminal)
+      k++;
+
+    if (k < g->tokens_len)
+      continue;
+
+    grammar_reader_error(r, u->line, u->col,
+                         "terminal %.*s has no %%token definition",
+                         symbol_name_len(g->symbols, u->terminal),
+                         symbol_name(g->symbols, u->terminal));
+    return;
+  }
+}
+
+// the text is read in a single pass, right hand sides are collected in one
+// reused buffer and copied straight into the grammar arena
+grammar *new_grammar_from_text(const char *text, int len,
+                               grammar_file_error *err) {
+  grammar_file_error ignored;
+
+  if (err == NULL)
+    err = &ignored;
+
+  err->line = 0;
+  err->col = 0;
+  err->msg[0] = '\0';
+
+  if (text == NULL || len < 0) {
+    snprintf(err->msg, sizeof(err->msg), "no grammar text");
+    return NULL;
+  }
+
+  grammar_reader r;
+  r.text = text;
+  r.len = len;
+  r.pos = 0;
+  r.line = 1;
+  r.line_start = 0;
+  r.err = err;
+  r.failed = 0;
+  r.syms_len = 0;
+  r.syms_max = GRAMMAR_FILE_INITIAL_SYMS;
+  r.uses_len = 0;
+  r.uses_max = 0;
+  r.uses = NULL;
+  r.g = new_empty_grammar();
+  r.buff = (char *)malloc(len + 1);
+  r.syms = (symbol_id *)malloc(sizeof(symbol_id) * r.syms_max);
+
+  if (r.g == NULL || r.buff == NULL || r.syms == NULL) {
+    snprintf(err->msg, sizeof(err->msg), "out of memory");
+
+    if (r.g != NULL)
+      free_grammar(r.g);
+    free(r.buff);
+    free(r.syms);
+    return NULL;
+  }
+
+  grammar_file_piece p;
+
+  while (!r.failed) {
+    int kind = grammar_reader_next(&r, &p, 0);
+
+    if (kind == GRAMMAR_FILE_END)
+      break;
+
+    if (kind == GRAMMAR_FILE_DIRECTIVE)
+      grammar_reader_directive(&r, &p);
+    else if (kind == GRAMMAR_FILE_VAR)
+      grammar_reader_rule(&r, &p);
+    else
+      grammar_reader_error(&r, p.line, p.col,
+                           "expected a rule or a directive");
+  }
+
+  if (!r.failed)
+    grammar_reader_check(&r);
+
+  free(r.buff);
+  free(r.syms);
+  free(r.uses);
+
+  if (r.failed) {
+    free_grammar(r.g);
+    return NULL;
+  }
+
+  return r.g;
+}
+
+grammar *new_grammar_from_file(const char *path, grammar_file_error *err) {
+  grammar_file_error ignored;
+
+  if (err == NULL)
+    err = &ignored;
+
+  err->line = 0;
+  err->col = 0;
+
+  FILE *f = path != NULL ? fopen(path, "rb") : NULL;
+  if (f == NULL) {
+    snprintf(err->msg, sizeof(err->msg), "cannot open %s",
+             path != NULL ? path : "(null)");
+    return NULL;
+  }
+
+  long len = -1;
+  if (fseek(f, 0, SEEK_END) == 0)
+    len = ftell(f);
+
+  char *text = NULL;
+  if (len >= 0 && len < 0x7fffffff && fseek(f, 0, SEEK_SET) == 0)
+    text = (char *)malloc(len + 1);
+
+  if (text == NULL || (long)fread(text, 1, len, f) != len) {
+    snprintf(err->msg, sizeof(err->msg), "cannot read %s", path);
+    free(text);
+    fclose(f);
+    return NULL;
+  }
+
+  fclose(f);
+
+  grammar *g = new_grammar_from_text(text, len, err);
+  free(text);
+
+  return g;
+}
@@ -0,0 +1,1050 @@
+#include "../include/grammar_gen.h"
+#include "../include/lexer.h"
+#include <ctype.h>
+
+// output is gathered in the generator's buffer and written in large chunks
+typedef struct gen_output {
+  FILE *out;
+  char *buff;
+  int len;
+  long written;
+  long tokens;
+  int failed;
+} gen_output;
+
+void free_grammar_gen(grammar_gen *gen) {
+  if (gen == NULL)
+    return;
+
+  if (gen->fft != NULL)
+    free_ff_table(gen->fft);
+
+  free(gen->var_offsets);
+  free(gen->var_prods);
+  free(gen->prod_offsets);
+  free(gen->prod_syms);
+  free(gen->prod_vars);
+  free(gen->prod_leads);
+  free(gen->prod_var_pos);
+  free(gen->prod_text_offsets);
+  free(gen->prod_texts);
+  free(gen->weights);
+  free(gen->min_lens);
+  free(gen->rhs_min_lens);
+  free(gen->grow_ends);
+  free(gen->finite_ends);
+  free(gen->uniform);
+  free(gen->cum_weights);
+  free(gen->spell_offsets);
+  free(gen->spell_lens);
+  free(gen->spellings);
+  free(gen->stack);
+  free(gen->budgets);
+  free(gen->valid);
+  free(gen->buff);
+  free(gen);
+}
+
+// xorshift64*
+static unsigned long long gen_random(grammar_gen *gen) {
+  unsigned long long x = gen->state;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  gen->state = x;
+
+  return x * 0x2545f4914f6cdd1dull;
+}
+
+// draws below n by multiplying with the high bits instead of dividing, the
+// low bits of xorshift64* are its weakest
+static unsigned long long gen_below(grammar_gen *gen, unsigned long long n) {
+  return (unsigned long long)(((unsigned __int128)gen_random(gen) * n) >> 64);
+}
+
+// breadth first over the lexer's DFA, so the first state accepting a
+// terminal ends the shortest string the lexer reads as that terminal. each
+// byte class is spelled by one of its bytes, letters and digits first.
+static char *gen_shortest_matches(lexer *l, const char *patterns,
+                                  const char **texts, int *lens, int n) {
+  int states = l->states_len;
+  int classes = l->classes_len;
+  int *parent = (int *)malloc(sizeof(int) * states);
+  int *via = (int *)malloc(sizeof(int) * states);
+  int *queue = (int *)malloc(sizeof(int) * states);
+  int *match = (int *)malloc(sizeof(int) * (n + 1));
+  int *depth = (int *)malloc(sizeof(int) * states);
+  char *out = NULL;
+
+  if (parent == NULL || via == NULL || queue == NULL || match == NULL ||
+      depth == NULL) {
+    free(parent);
+    free(via);
+    free(queue);
+    free(match);
+    free(depth);
+    return NULL;
+  }
+
+  unsigned char reps[GRAMMAR_BYTES_LEN];
+  int scores[GRAMMAR_BYTES_LEN];
+
+  for (int c = 0; c < classes; c++)
+    scores[c] = -1;
+
+  for (int b = 0; b < GRAMMAR_BYTES_LEN; b++) {
+    int c = l->byte_classes[b];
+    int score = isalnum(b) ? 2 : isgraph(b) ? 1 : 0;
+
+    if (score > scores[c]) {
+      scores[c] = score;
+      reps[c] = (unsigned char)b;
+    }
+  }
+
+  for (int s = 0; s < states; s++)
+    parent[s] = -2;
+
+  for (int i = 0; i < n; i++)
+    match[i] = -1;
+
+  int head = 0;
+  int tail = 0;
+
+  parent[0] = -1;
+  depth[0] = 0;
+  queue[tail++] = 0;
+
+  while (head < tail) {
+    int s = queue[head++];
+    int a = l->accepts[s];
+
+    if (a >= 0 && a < n && patterns[a] && match[a] < 0)
+      match[a] = s;
+
+    for (int c = 0; c < classes; c++) {
+      int next = l->trans[s * classes + c];
+
+      if (next == LEXER_DEAD_STATE || parent[next] != -2)
+        continue;
+
+      parent[next] = s;
+      via[next] = c;
+      depth[next] = depth[s] + 1;
+      queue[tail++] = next;
+    }
+  }
+
+  int total = 0;
+
+  for (int i = 0; i < n; i++) {
+    if (match[i] > 0)
+      total += depth[match[i]];
+  }
+
+  out = (char *)malloc(total + 1);
+
+  if (out != NULL) {
+    int offset = 0;
+
+    for (int i = 0; i < n; i++) {
+      if (match[i] <= 0)
+        continue;
+
+      int len = depth[match[i]];
+      int j = offset + len;
+
+      for (int s = match[i]; parent[s] >= 0; s = parent[s])
+        out[--j] = (char)reps[via[s]];
+
+      texts[i] = out + offset;
+      lens[i] = len;
+      offset += len;
+    }
+  }
+
+  free(parent);
+  free(via);
+  free(queue);
+  free(match);
+  free(depth);
+
+  return out;
+}
+
+// a separator is usable when the lexer skips it entirely
+static int gen_lexer_skips(lexer *l, const char *sep) {
+  lexer_tokens *tokens = new_lexer_tokens(LEXER_TOKENS_INITIAL_LEN);
+  if (tokens == NULL)
+    return 0;
+
+  int skips = lex_string(l, sep, strlen(sep), tokens) == LEXER_SUCCESS &&
+              tokens->len == 0;
+
+  free_lexer_tokens(tokens);
+  return skips;
+}
+
+static int gen_spellings(grammar_gen *gen) {
+  grammar *g = gen->g;
+  int n = gen->terminals_len;
+  const char **texts = (const char **)malloc(sizeof(char *) * (n + 1));
+  int *lens = (int *)malloc(sizeof(int) * (n + 1));
+  char *literal = (char *)calloc(n + 1, sizeof(char));
+  char *patterns = (char *)calloc(n + 1, sizeof(char));
+  char *matches = NULL;
+  int needs_lexer = 0;
+  int has_patterns = 0;
+
+  if (texts == NULL || lens == NULL || literal == NULL || patterns == NULL) {
+    free(texts);
+    free(lens);
+    free(literal);
+    free(patterns);
+    return -1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    texts[i] = symbol_name(g->symbols, terminal_symbol(i));
+    lens[i] = symbol_name_len(g->symbols, terminal_symbol(i));
+  }
+
+  for (int i = 0; i < g->tokens_len; i++) {
+    token_def *t = &g->tokens[i];
+
+    if (t->kind != TOKEN_LITERAL || t->len != 1)
+      needs_lexer = 1;
+
+    if (t->terminal == SYMBOL_NONE)
+      continue;
+
+    int idx = symbol_index(t->terminal);
+
+    if (t->kind == TOKEN_LITERAL && !literal[idx]) {
+      texts[idx] = t->text;
+      lens[idx] = t->len;
+      literal[idx] = 1;
+      patterns[idx] = 0;
+    } else if (t->kind == TOKEN_PATTERN && !literal[idx]) {
+      patterns[idx] = 1;
+      has_patterns = 1;
+    }
+  }
+
+  lexer *l = needs_lexer ? new_lexer(g) : NULL;
+
+  if (l != NULL && has_patterns)
+    matches = gen_shortest_matches(l, patterns, texts, lens, n);
+
+  if (l != NULL) {
+    if (gen_lexer_skips(l, " "))
+      grammar_gen_set_separator(gen, " ", 1);
+    else if (gen_lexer_skips(l, "\n"))
+      grammar_gen_set_separator(gen, "\n", 1);
+  }
+
+  int total = 0;
+
+  for (int i = 0; i < n; i++)
+    total += lens[i];
+
+  gen->spellings = (char *)malloc(total + 1);
+
+  if (gen->spellings != NULL) {
+    int offset = 0;
+
+    for (int i = 0; i < n; i++) {
+      memcpy(gen->spellings + offset, texts[i], lens[i]);
+      gen->spell_offsets[i] = offset;
+      gen->spell_lens[i] = lens[i];
+      offset += lens[i];
+    }
+  }
+
+  if (l != NULL)
+    free_lexer(l);
+  free(matches);
+  free(texts);
+  free(lens);
+  free(literal);
+  free(patterns);
+
+  return gen->spellings != NULL ? 0 : -1;
+}
+
+static long gen_rhs_cost(grammar_gen *gen, production_rhs *rhs) {
+  long cost = 0;
+
+  for (int j = 0; j < rhs->len && cost < GRAMMAR_GEN_UNBOUNDED; j++) {
+    symbol_id s = rhs->syms[j];
+
+    if (symbol_is_var(s))
+      cost += gen->min_lens[symbol_index(s)];
+    else
+      cost += gen->spell_lens[symbol_index(s)] + gen->sep_len;
+  }
+
+  return cost < GRAMMAR_GEN_UNBOUNDED ? cost : GRAMMAR_GEN_UNBOUNDED;
+}
+
+// orders the right hand sides of v longest first and those deriving no
+// finite string last, so the ones that fit a budget and the ones that grow
+// are ranges of var_prods
+static void gen_order_var(grammar_gen *gen, int v) {
+  int from = gen->var_offsets[v];
+  int to = gen->var_offsets[v + 1];
+
+  for (int i = from + 1; i < to; i++) {
+    int r = gen->var_prods[i];
+    long len = gen->rhs_min_lens[r];
+    int j = i;
+
+    for (; j > from; j--) {
+      long prev = gen->rhs_min_lens[gen->var_prods[j - 1]];
+
+      if (len >= GRAMMAR_GEN_UNBOUNDED ||
+          (prev < GRAMMAR_GEN_UNBOUNDED && prev >= len))
+        break;
+
+      gen->var_prods[j] = gen->var_prods[j - 1];
+    }
+
+    gen->var_prods[j] = r;
+  }
+
+  gen->grow_ends[v] = from;
+  gen->finite_ends[v] = from;
+
+  for (int i = from; i < to; i++) {
+    long len = gen->rhs_min_lens[gen->var_prods[i]];
+
+    if (len > gen->min_lens[v] && len < GRAMMAR_GEN_UNBOUNDED)
+      gen->grow_ends[v] = i + 1;
+    if (len < GRAMMAR_GEN_UNBOUNDED)
+      gen->finite_ends[v] = i + 1;
+  }
+}
+
+static void gen_cum_weights(grammar_gen *gen) {
+  gen->cum_weights[0] = 0;
+
+  for (int i = 0; i < gen->prods_len; i++)
+    gen->cum_weights[i + 1] =
+        gen->cum_weights[i] + gen->weights[gen->var_prods[i]];
+
+  for (int v = 0; v < gen->vars_len; v++) {
+    int from = gen->var_offsets[v];
+
+    gen->uniform[v] = 0;
+    if (from == gen->finite_ends[v])
+      continue;
+
+    int w = gen->weights[gen->var_prods[from]];
+
+    gen->uniform[v] = w > 0;
+
+    for (int i = from + 1; i < gen->finite_ends[v]; i++) {
+      if (gen->weights[gen->var_prods[i]] != w)
+        gen->uniform[v] = 0;
+    }
+  }
+}
+
+// shortest derivations as a fixpoint: a right hand side is costed again
+// whenever the minimum of a variable it uses drops
+static int gen_min_lens(grammar_gen *gen) {
+  production_rhs **prods = gen->fft->prods;
+  int vars_len = gen->vars_len;
+  int prods_len = gen->prods_len;
+  int *occ_offsets = (int *)calloc(vars_len + 2, sizeof(int));
+  int *occ = NULL;
+  int *queue = (int *)malloc(sizeof(int) * (prods_len + 1));
+  char *queued = (char *)malloc(prods_len + 1);
+  int occ_len = 0;
+
+  if (occ_offsets == NULL || queue == NULL || queued == NULL) {
+    free(occ_offsets);
+    free(queue);
+    free(queued);
+    return -1;
+  }
+
+  for (int r = 0; r < prods_len; r++) {
+    for (int j = 0; j < prods[r]->len; j++) {
+      symbol_id s = prods[r]->syms[j];
+
+      if (symbol_is_var(s)) {
+        occ_offsets[symbol_index(s) + 2]++;
+        occ_len++;
+      }
+    }
+  }
+
+  // offsets shifted by one so the fill below leaves them in place
+  for (int v = 0; v < vars_len; v++)
+    occ_offsets[v + 2] += occ_offsets[v + 1];
+
+  occ = (int *)malloc(sizeof(int) * (occ_len + 1));
+  if (occ == NULL) {
+    free(occ_offsets);
+    free(queue);
+    free(queued);
+    return -1;
+  }
+
+  for (int r = 0; r < prods_len; r++) {
+    for (int j = 0; j < prods[r]->len; j++) {
+      symbol_id s = prods[r]->syms[j];
+
+      if (symbol_is_var(s))
+        occ[occ_offsets[symbol_index(s) + 1]++] = r;
+    }
+  }
+
+  for (int v = 0; v < vars_len; v++)
+    gen->min_lens[v] = GRAMMAR_GEN_UNBOUNDED;
+
+  for (int r = 0; r < prods_len; r++) {
+    queue[r] = r;
+    queued[r] = 1;
+  }
+
+  int head = 0;
+  int count = prods_len;
+
+  while (count > 0) {
+    int r = queue[head];
+    head = head + 1 < prods_len ? head + 1 : 0;
+    count--;
+    queued[r] = 0;
+
+    long cost = gen_rhs_cost(gen, prods[r]);
+    int v = symbol_index(prods[r]->for_var);
+
+    gen->rhs_min_lens[r] = cost;
+    if (cost >= gen->min_lens[v])
+      continue;
+
+    gen->min_lens[v] = cost;
+
+    for (int k = occ_offsets[v]; k < occ_offsets[v + 1]; k++) {
+      int user = occ[k];
+
+      if (!queued[user]) {
+        queue[(head + count) % prods_len] = user;
+        queued[user] = 1;
+        count++;
+      }
+    }
+  }
+
+  for (int v = 0; v < vars_len; v++)
+    gen_order_var(gen, v);
+
+  gen_cum_weights(gen);
+
+  free(occ_offsets);
+  free(occ);
+  free(queue);
+  free(queued);
+
+  return 0;
+}
+
+// right hand sides are laid out reversed, in push order, terminals as their
+// index and variables as terminals_len + index
+static void gen_fill_prods(grammar_gen *gen) {
+  int tl = gen->terminals_len;
+  int n = 0;
+
+  for (int v = 0; v < gen->vars_len; v++) {
+    production_rhs *curr = gen->g->productions_table->productions[v].first_rhs;
+
+    gen->var_offsets[v] = n;
+
+    for (; curr != NULL; curr = curr->next)
+      gen->var_prods[n++] = curr->id;
+  }
+
+  gen->var_offsets[gen->vars_len] = n;
+  n = 0;
+
+  for (int r = 0; r < gen->prods_len; r++) {
+    production_rhs *rhs = gen->fft->prods[r];
+
+    gen->prod_offsets[r] = n;
+    gen->prod_vars[r] = 0;
+    gen->prod_leads[r] = 0;
+    gen->prod_var_pos[r] = 0;
+    gen->weights[r] = GRAMMAR_GEN_DEFAULT_WEIGHT;
+
+    for (int j = rhs->len - 1; j >= 0; j--) {
+      symbol_id s = rhs->syms[j];
+
+      if (symbol_is_var(s)) {
+        gen->prod_var_pos[r] = n - gen->prod_offsets[r];
+        gen->prod_syms[n++] = tl + symbol_index(s);
+        gen->prod_vars[r]++;
+        gen->prod_leads[r] = 0;
+      } else {
+        gen->prod_syms[n++] = symbol_index(s);
+        gen->prod_leads[r]++;
+      }
+    }
+  }
+
+  gen->prod_offsets[gen->prods_len] = n;
+}
+
+// the leading terminals of every right hand side spelled out with sep
+// between them, so they are written at once when no token has to be looked
+// at on its own
+static int gen_prod_texts(grammar_gen *gen) {
+  int total = 0;
+
+  for (int r = 0; r < gen->prods_len; r++) {
+    int end = gen->prod_offsets[r + 1];
+
+    for (int j = end - gen->prod_leads[r]; j < end; j++)
+      total += gen->spell_lens[gen->prod_syms[j]] + gen->sep_len;
+  }
+
+  char *texts = (char *)malloc(total + 1);
+  if (texts == NULL)
+    return -1;
+
+  int n = 0;
+
+  for (int r = 0; r < gen->prods_len; r++) {
+    int end = gen->prod_offsets[r + 1];
+
+    gen->prod_text_offsets[r] = n;
+
+    for (int j = end - 1; j >= end - gen->prod_leads[r]; j--) {
+      int t = gen->prod_syms[j];
+
+      if (j != end - 1) {
+        memcpy(texts + n, gen->sep, gen->sep_len);
+        n += gen->sep_len;
+      }
+
+      memcpy(texts + n, gen->spellings + gen->spell_offsets[t],
+             gen->spell_lens[t]);
+      n += gen->spell_lens[t];
+    }
+  }
+
+  gen->prod_text_offsets[gen->prods_len] = n;
+
+  free(gen->prod_texts);
+  gen->prod_texts = texts;
+
+  return 0;
+}
+
+// variables are expanded leftmost first on an explicit stack, each with a
+// budget of bytes that covers at least its shortest derivation, the start
+// variable with the target size. right hand sides are picked by weight among
+// those that fit the budget, leaving out the shortest ones while there is
+// room to grow. the surplus of the pick is split at random among its
+// variables, and whatever a variable leaves unused passes to the next one
+// expanded, so the sentence ends close to the target and the derivation
+// stays bushy instead of deep.
+//
+// min_lens holds the fewest bytes each variable derives (GRAMMAR_GEN_UNBOUNDED
+// when it derives no finite string), rhs_min_lens the same per right hand
+// side id. the ids of the right hand sides of variable v are
+// var_prods[var_offsets[v]] up to var_offsets[v + 1], longest first: those
+// up to grow_ends[v] are longer than the shortest and those from
+// finite_ends[v] on derive no finite string. cum_weights sums the weights in
+// that order, uniform marks the variables whose weights are all equal, which
+// are picked without it.
+//
+// like in ll1_table, prod_syms holds every right hand side reversed starting
+// at prod_offsets[id], terminals as their index and variables as
+// terminals_len + index, and the stack holds the same codes. prod_vars
+// counts the variables of each, prod_var_pos is where the last of them sits,
+// prod_leads counts the terminals it starts with and prod_texts holds those
+// spelled out, from prod_text_offsets[id].
+//
+// terminals are written as their literal token, the shortest string their
+// pattern token matches, or else their name, with sep between them. sep
+// defaults to a space when the grammar needs the lexer and skips it, and is
+// empty otherwise. a near miss has one token replaced or preceded by a
+// terminal that cannot follow the tokens before it.
+grammar_gen *new_grammar_gen(grammar *g, unsigned long long seed) {
+  if (g == NULL || !symbol_is_var(g->start_var))
+    return NULL;
+
+  grammar_gen *gen = (grammar_gen *)malloc(sizeof(grammar_gen));
+  if (gen == NULL)
+    return NULL;
+
+  gen->g = g;
+  gen->state = seed != 0 ? seed : 0x9e3779b97f4a7c15ull;
+  gen->vars_len = g->vars_len;
+  gen->terminals_len = g->terminals_len;
+  gen->prods_len = g->productions_table->len;
+  gen->var_offsets = NULL;
+  gen->var_prods = NULL;
+  gen->prod_offsets = NULL;
+  gen->prod_syms = NULL;
+  gen->prod_vars = NULL;
+  gen->prod_leads = NULL;
+  gen->prod_var_pos = NULL;
+  gen->prod_text_offsets = NULL;
+  gen->prod_texts = NULL;
+  gen->weights = NULL;
+  gen->min_lens = NULL;
+  gen->rhs_min_lens = NULL;
+  gen->grow_ends = NULL;
+  gen->finite_ends = NULL;
+  gen->uniform = NULL;
+  gen->cum_weights = NULL;
+  gen->spell_offsets = NULL;
+  gen->spell_lens = NULL;
+  gen->spellings = NULL;
+  gen->sep_len = 0;
+  gen->sep[0] = '\0';
+  gen->mutation_offset = -1;
+  gen->top = 0;
+  gen->max = GRAMMAR_GEN_STACK_LEN;
+  gen->stack = NULL;
+  gen->budgets = NULL;
+  gen->valid = NULL;
+  gen->buff = NULL;
+
+  gen->fft = new_ff_table(g);
+  int ok = gen->fft != NULL &&
+           calculate_firsts(g, gen->fft) == SUCCESS_ON_FIRST_CALC;
+  int vars_len = gen->vars_len + 1;
+  int prods_len = gen->prods_len + 1;
+  int syms_len = 1;
+
+  for (int r = 0; ok && r < gen->prods_len; r++)
+    syms_len += gen->fft->prods[r]->len;
+
+  if (ok) {
+    gen->var_offsets = (int *)malloc(sizeof(int) * vars_len);
+    gen->var_prods = (int *)malloc(sizeof(int) * prods_len);
+    gen->prod_offsets = (int *)malloc(sizeof(int) * prods_len);
+    gen->prod_syms = (int *)malloc(sizeof(int) * syms_len);
+    gen->prod_vars = (int *)malloc(sizeof(int) * prods_len);
+    gen->prod_leads = (int *)malloc(sizeof(int) * prods_len);
+    gen->prod_var_pos = (int *)malloc(sizeof(int) * prods_len);
+    gen->prod_text_offsets = (int *)malloc(sizeof(int) * prods_len);
+    gen->weights = (int *)malloc(sizeof(int) * prods_len);
+    gen->min_lens = (long *)malloc(sizeof(long) * vars_len);
+    gen->rhs_min_lens = (long *)malloc(sizeof(long) * prods_len);
+    gen->grow_ends = (int *)malloc(sizeof(int) * vars_len);
+    gen->finite_ends = (int *)malloc(sizeof(int) * vars_len);
+    gen->uniform = (char *)malloc(vars_len);
+    gen->cum_weights = (long *)malloc(sizeof(long) * prods_len);
+    gen->spell_offsets = (int *)malloc(sizeof(int) * (gen->terminals_len + 1));
+    gen->spell_lens = (int *)malloc(sizeof(int) * (gen->terminals_len + 1));
+    gen->stack = (int *)malloc(sizeof(int) * gen->max);
+    gen->budgets = (long *)malloc(sizeof(long) * gen->max);
+    gen->valid = new_bitset(gen->fft->words);
+    gen->buff = (char *)malloc(GRAMMAR_GEN_BUFF_LEN);
+    ok = gen->var_offsets != NULL && gen->var_prods != NULL &&
+         gen->prod_offsets != NULL && gen->prod_syms != NULL &&
+         gen->prod_vars != NULL && gen->prod_leads != NULL &&
+         gen->prod_var_pos != NULL && gen->prod_text_offsets != NULL &&
+         gen->weights != NULL &&
+         gen->min_lens != NULL && gen->rhs_min_lens != NULL &&
+         gen->grow_ends != NULL && gen->finite_ends != NULL &&
+         gen->uniform != NULL && gen->cum_weights != NULL &&
+         gen->spell_offsets != NULL &&
+         gen->spell_lens != NULL && gen->stack != NULL &&
+         gen->budgets != NULL && gen->valid != NULL && gen->buff != NULL;
+  }
+
+  if (ok)
+    gen_fill_prods(gen);
+
+  ok = ok && gen_spellings(gen) == 0 && gen_min_lens(gen) == 0 &&
+       gen_prod_texts(gen) == 0;
+
+  if (!ok) {
+    free_grammar_gen(gen);
+    return NULL;
+  }
+
+  return gen;
+}
+
+// a weight of 0 keeps a right hand side out unless nothing else fits
+int grammar_gen_set_weight(grammar_gen *gen, int prod_id, int weight) {
+  if (gen == NULL || prod_id < 0 || prod_id >= gen->prods_len || weight < 0)
+    return GRAMMAR_GEN_ERROR;
+
+  gen->weights[prod_id] = weight;
+  gen_cum_weights(gen);
+
+  return GRAMMAR_GEN_SUCCESS;
+}
+
+// the minimum lengths count the separator, so they are computed again
+int grammar_gen_set_separator(grammar_gen *gen, const char *sep, int len) {
+  if (gen == NULL || sep == NULL || len < 0 || len >= GRAMMAR_GEN_SEP_LEN)
+    return GRAMMAR_GEN_ERROR;
+
+  memcpy(gen->sep, sep, len);
+  gen->sep[len] = '\0';
+  gen->sep_len = len;
+
+  // spellings are not there yet while the generator is being built
+  if (gen->spellings != NULL &&
+      (gen_min_lens(gen) != 0 || gen_prod_texts(gen) != 0))
+    return GRAMMAR_GEN_ERROR;
+
+  return GRAMMAR_GEN_SUCCESS;
+}
+
+static void gen_flush(gen_output *o) {
+  if (o->len > 0 && fwrite(o->buff, 1, o->len, o->out) != (size_t)o->len)
+    o->failed = 1;
+
+  o->len = 0;
+}
+
+// without a file the output is only counted
+static void gen_write(gen_output *o, const char *s, int len) {
+  // tokens are short, a call to memcpy costs more than the copy
+  if (o->out != NULL && o->len + len <= GRAMMAR_GEN_BUFF_LEN) {
+    char *dst = o->buff + o->len;
+
+    for (int i = 0; i < len; i++)
+      dst[i] = s[i];
+
+    o->len += len;
+    o->written += len;
+    return;
+  }
+
+  if (o->out == NULL) {
+    o->written += len;
+    return;
+  }
+
+  if (o->len + len > GRAMMAR_GEN_BUFF_LEN) {
+    gen_flush(o);
+
+    if (len > GRAMMAR_GEN_BUFF_LEN) {
+      if (fwrite(s, 1, len, o->out) != (size_t)len)
+        o->failed = 1;
+
+      o->written += len;
+      return;
+    }
+  }
+
+  memcpy(o->buff + o->len, s, len);
+  o->len += len;
+  o->written += len;
+}
+
+static void gen_emit(grammar_gen *gen, gen_output *o, int terminal) {
+  if (o->tokens > 0)
+    gen_write(o, gen->sep, gen->sep_len);
+
+  gen_write(o, gen->spellings + gen->spell_offsets[terminal],
+            gen->spell_lens[terminal]);
+  o->tokens++;
+}
+
+static int gen_reserve(grammar_gen *gen, int need) {
+  int max = gen->max;
+
+  while (max < need)
+    max *= 2;
+
+  if (max == gen->max)
+    return 0;
+
+  int *stack = (int *)realloc(gen->stack, sizeof(int) * max);
+  if (stack == NULL)
+    return -1;
+
+  gen->stack = stack;
+
+  long *budgets = (long *)realloc(gen->budgets, sizeof(long) * max);
+  if (budgets == NULL)
+    return -1;
+
+  gen->budgets = budgets;
+  gen->max = max;
+  return 0;
+}
+
+// picks by weight among the right hand sides of v that fit in budget,
+// only among those longer than the shortest when grow is set. returns -1
+// when none does.
+static int gen_pick(grammar_gen *gen, int v, long budget, int grow) {
+  int lo = gen->var_offsets[v];
+  int hi = grow ? gen->grow_ends[v] : gen->finite_ends[v];
+
+  while (lo < hi && gen->rhs_min_lens[gen->var_prods[lo]] > budget)
+    lo++;
+
+  if (lo >= hi)
+    return -1;
+
+  if (gen->uniform[v])
+    return gen->var_prods[lo + gen_below(gen, hi - lo)];
+
+  long *cum = gen->cum_weights;
+  long total = cum[hi] - cum[lo];
+
+  if (total == 0)
+    return -1;
+
+  long pick = cum[lo] + (long)gen_below(gen, total);
+
+  while (cum[lo + 1] <= pick)
+    lo++;
+
+  return gen->var_prods[lo];
+}
+
+// while the budget has room the shortest right hand sides are left out
+static int gen_choose(grammar_gen *gen, int v, long budget) {
+  int from = gen->var_offsets[v];
+
+  if (gen->var_offsets[v + 1] - from == 1)
+    return gen->var_prods[from];
+
+  int r = -1;
+
+  if (budget > gen->min_lens[v])
+    r = gen_pick(gen, v, budget, 1);
+  if (r < 0)
+    r = gen_pick(gen, v, budget, 0);
+
+  // nothing fits or weighs anything, finish as quickly as possible
+  if (r < 0)
+    r = gen->var_prods[gen->finite_ends[v] - 1];
+
+  return r;
+}
+
+// the stack right after a token holds what the rest of the sentence derives,
+// so for LL(1) grammars the terminals that can come next are FIRST of the
+// stack. writes one that cannot, returning 0 when every terminal can.
+static int gen_mutate(grammar_gen *gen, gen_output *o) {
+  ff_table *fft = gen->fft;
+  int words = fft->words;
+  int tl = gen->terminals_len;
+  int i = gen->top - 1;
+
+  bitset_clear(gen->valid, words);
+
+  for (; i >= 0; i--) {
+    int s = gen->stack[i];
+
+    if (s < tl) {
+      bitset_set(gen->valid, s);
+      break;
+    }
+
+    bitset_union(gen->valid, &fft->first_sets[(s - tl) * words], words);
+    if (!fft->nullable[s - tl])
+      break;
+  }
+
+  if (i < 0)
+    bitset_set(gen->valid, SYMBOL_TERMINATE);
+
+  int invalid = tl - bitset_count(gen->valid, words);
+  if (!bitset_test(gen->valid, SYMBOL_TERMINATE))
+    invalid--;
+
+  if (invalid <= 0)
+    return 0;
+
+  int k = (int)gen_below(gen, invalid);
+
+  for (int t = 1; t < tl; t++) {
+    if (bitset_test(gen->valid, t))
+      continue;
+
+    if (k-- == 0) {
+      gen->mutation_offset = o->written + (o->tokens > 0 ? gen->sep_len : 0);
+      gen_emit(gen, o, t);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// mutates the sentence right after its first mutate_at tokens, or at the
+// first point after them where some terminal cannot come next. a negative
+// mutate_at writes a valid sentence. tokens receives the tokens written.
+static long gen_run(grammar_gen *gen, long target, FILE *out, long mutate_at,
+                    long *tokens) {
+  int tl = gen->terminals_len;
+  int start = tl + symbol_index(gen->g->start_var);
+  long start_min = gen->min_lens[start - tl];
+
+  if (start_min >= GRAMMAR_GEN_UNBOUNDED)
+    return GRAMMAR_GEN_NO_SENTENCE;
+
+  if (target < start_min)
+    target = start_min;
+  if (target > GRAMMAR_GEN_UNBOUNDED / 2)
+    target = GRAMMAR_GEN_UNBOUNDED / 2;
+
+  gen_output o;
+  o.out = out;
+  o.buff = gen->buff;
+  o.len = 0;
+  o.written = 0;
+  o.tokens = 0;
+  o.failed = 0;
+
+  int mutated = mutate_at < 0;
+  int at_token = 1;
+  int drop = 0;
+  long spare = 0;
+
+  gen->mutation_offset = -1;
+  gen->top = 1;
+  gen->stack[0] = start;
+  gen->budgets[0] = target;
+
+  while (!o.failed) {
+    // half of the near misses replace the token, the other half insert
+    if (!mutated && at_token && o.tokens >= mutate_at) {
+      mutated = gen_mutate(gen, &o);
+      drop = mutated && gen_below(gen, 2);
+    }
+
+    if (gen->top == 0)
+      break;
+
+    gen->top--;
+
+    int s = gen->stack[gen->top];
+
+    if (s < tl) {
+      at_token = 1;
+
+      if (drop)
+        drop = 0;
+      else
+        gen_emit(gen, &o, s);
+      continue;
+    }
+
+    at_token = 0;
+
+    long budget = gen->budgets[gen->top] + spare;
+    int r = gen_choose(gen, s - tl, budget);
+    int from = gen->prod_offsets[r];
+    int len = gen->prod_offsets[r + 1] - from;
+    int vars = gen->prod_vars[r];
+    long surplus = budget - gen->rhs_min_lens[r];
+
+    if (surplus < 0)
+      surplus = 0;
+
+    spare = vars == 0 ? surplus : 0;
+
+    // leading terminals go straight out unless the mutation still has to
+    // see the stack after each of them
+    if (mutated && !drop && gen->prod_leads[r] > 0) {
+      int text = gen->prod_text_offsets[r];
+
+      if (o.tokens > 0)
+        gen_write(&o, gen->sep, gen->sep_len);
+
+      gen_write(&o, gen->prod_texts + text,
+                gen->prod_text_offsets[r + 1] - text);
+      o.tokens += gen->prod_leads[r];
+      len -= gen->prod_leads[r];
+    }
+
+    if (gen->top + len > gen->max && gen_reserve(gen, gen->top + len) != 0) {
+      o.failed = 1;
+      break;
+    }
+
+    for (int j = 0; j < len; j++)
+      gen->stack[gen->top + j] = gen->prod_syms[from + j];
+
+    // the surplus is broken off in random pieces from the right, the
+    // leftmost variable gets what is left and a right hand side without
+    // variables passes all of it on
+    if (vars == 1) {
+      int k = gen->top + gen->prod_var_pos[r];
+      gen->budgets[k] = gen->min_lens[gen->stack[k] - tl] + surplus;
+    } else if (vars > 1) {
+      for (int j = 0; j < len; j++) {
+        int sym = gen->stack[gen->top + j];
+
+        if (sym < tl)
+          continue;
+
+        long b = gen->min_lens[sym - tl];
+
+        if (--vars > 0) {
+          long piece = (surplus * (long)(gen_random(gen) >> 54)) >> 10;
+          surplus -= piece;
+          b += piece;
+        } else {
+          b += surplus;
+        }
+
+        gen->budgets[gen->top + j] = b;
+      }
+    }
+
+    gen->top += len;
+  }
+
+  if (out != NULL)
+    gen_flush(&o);
+
+  if (tokens != NULL)
+    *tokens = o.tokens;
+
+  if (o.failed)
+    return GRAMMAR_GEN_ERROR;
+  if (!mutated)
+    return GRAMMAR_GEN_NO_NEAR_MISS;
+
+  return o.written;
+}
+
+long grammar_gen_sentence(grammar_gen *gen, long target, FILE *out) {
+  if (gen == NULL || out == NULL)
+    return GRAMMAR_GEN_ERROR;
+
+  return gen_run(gen, target, out, -1, NULL);
+}
+
+// the point to mutate must be picked among the tokens of the sentence, so it
+// is derived twice from the same random state: once only counting tokens,
+// then for real
+long grammar_gen_near_miss(grammar_gen *gen, long target, FILE *out) {
+  if (gen == NULL || out == NULL)
+    return GRAMMAR_GEN_ERROR;
+
+  unsigned long long state = gen->state;
+  long tokens = 0;
+  long res = gen_run(gen, target, NULL, -1, &tokens);
+
+  if (res < 0)
+    return res;
+
+  long mutate_at = (long)gen_below(gen, tokens + 1);
+  unsigned long long next = gen->state;
+
+  gen->state = state;
+  res = gen_run(gen, target, out, mutate_at, NULL);
+  gen->state = next;
+
+  return res;
+}
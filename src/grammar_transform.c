@@ -0,0 +1,1057 @@
+#include "../include/grammar_transform.h"
+
+// a right hand side while the grammar is rewritten, carved from the arena of
+// the rewrite like everything it points to
+typedef struct gt_rhs {
+  int len;
+  symbol_id *syms;
+  int levels_len;
+  grammar_origin_level *levels;
+  struct gt_rhs *next;
+} gt_rhs;
+
+// rhs holds the right hand sides of every variable of g in grammar order,
+// fresh variables are added to g as they are created
+typedef struct gt_state {
+  grammar *source;
+  grammar *g;
+  arena *a;
+  int vars_len;
+  int vars_max;
+  gt_rhs **rhs;
+  symbol_id *origins;
+  char *kinds;
+  int productive_len;
+  char *productive;
+} gt_state;
+
+static gt_rhs *gt_new_rhs(gt_state *st, int len, int levels_len) {
+  gt_rhs *r = (gt_rhs *)arena_alloc(st->a, sizeof(gt_rhs));
+  if (r == NULL)
+    return NULL;
+
+  r->len = len;
+  r->levels_len = levels_len;
+  r->next = NULL;
+  r->syms = (symbol_id *)arena_alloc(st->a, sizeof(symbol_id) * (len + 1));
+  r->levels = (grammar_origin_level *)arena_alloc(
+      st->a, sizeof(grammar_origin_level) * (levels_len + 1));
+
+  if (r->syms == NULL || r->levels == NULL)
+    return NULL;
+
+  return r;
+}
+
+static int gt_reserve_vars(gt_state *st, int len) {
+  if (len <= st->vars_max)
+    return 0;
+
+  int max = st->vars_max > 0 ? st->vars_max : GRAMMAR_INITIAL_VARS;
+
+  while (max < len)
+    max *= 2;
+
+  gt_rhs **rhs = (gt_rhs **)realloc(st->rhs, sizeof(gt_rhs *) * max);
+  if (rhs == NULL)
+    return -1;
+  st->rhs = rhs;
+
+  symbol_id *origins =
+      (symbol_id *)realloc(st->origins, sizeof(symbol_id) * max);
+  if (origins == NULL)
+    return -1;
+  st->origins = origins;
+
+  char *kinds = (char *)realloc(st->kinds, sizeof(char) * max);
+  if (kinds == NULL)
+    return -1;
+  st->kinds = kinds;
+
+  st->vars_max = max;
+  return 0;
+}
+
+// a fresh variable of g named after the source variable it belongs to, with
+// as many primes as it takes to make the name unique
+static int gt_add_var(gt_state *st, int of, int kind) {
+  symbol_id origin = st->origins[of];
+  const char *name = symbol_name(st->source->symbols, origin);
+  int name_len = symbol_name_len(st->source->symbols, origin);
+  int len = name_len + 1;
+  char *buff = (char *)malloc(sizeof(char) * (name_len + st->vars_len + 2));
+
+  if (buff == NULL || gt_reserve_vars(st, st->vars_len + 1) != 0) {
+    free(buff);
+    return -1;
+  }
+
+  memcpy(buff, name, name_len);
+  buff[name_len] = GRAMMAR_TRANSFORM_PRIME;
+
+  while (find_var(st->g->symbols, buff, len) != SYMBOL_NONE)
+    buff[len++] = GRAMMAR_TRANSFORM_PRIME;
+
+  symbol_id var = grammar_add_var(st->g, buff, len);
+  free(buff);
+
+  if (var == SYMBOL_NONE || symbol_index(var) != st->vars_len)
+    return -1;
+
+  st->rhs[st->vars_len] = NULL;
+  st->origins[st->vars_len] = origin;
+  st->kinds[st->vars_len] = kind;
+
+  return st->vars_len++;
+}
+
+// g starts as a copy of source without productions, the working right hand
+// sides are the source ones each rebuilding itself
+static int gt_load(gt_state *st) {
+  grammar *source = st->source;
+  symbol_table *s = source->symbols;
+
+  for (int i = 1; i < source->terminals_len; i++) {
+    symbol_id t = terminal_symbol(i);
+
+    if (grammar_add_terminal(st->g, symbol_name(s, t), symbol_name_len(s, t)) !=
+        t)
+      return -1;
+  }
+
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++)
+    st->g->byte_terminals[i] = source->byte_terminals[i];
+
+  for (int i = 0; i < source->tokens_len; i++) {
+    token_def *t = &source->tokens[i];
+
+    if (grammar_add_token(st->g, t->terminal, t->kind, t->text, t->len) !=
+        SUCCESS_ADD_TOKEN)
+      return -1;
+  }
+
+  if (gt_reserve_vars(st, source->vars_len) != 0)
+    return -1;
+
+  for (int i = 0; i < source->vars_len; i++) {
+    symbol_id v = var_symbol(i);
+
+    if (grammar_add_var(st->g, symbol_name(s, v), symbol_name_len(s, v)) != v)
+      return -1;
+
+    st->rhs[i] = NULL;
+    st->origins[i] = v;
+    st->kinds[i] = GRAMMAR_ORIGIN_SAME;
+
+    // the source lists are newest first, prepending restores grammar order
+    production *p = &source->productions_table->productions[i];
+
+    for (production_rhs *curr = p->first_rhs; curr != NULL;
+         curr = curr->next) {
+      gt_rhs *r = gt_new_rhs(st, curr->len, 1);
+      if (r == NULL)
+        return -1;
+
+      if (curr->len > 0)
+        memcpy(r->syms, curr->syms, sizeof(symbol_id) * curr->len);
+      r->levels[0].prod = curr->id;
+      r->levels[0].at = curr->len;
+      r->next = st->rhs[i];
+      st->rhs[i] = r;
+    }
+  }
+
+  st->vars_len = source->vars_len;
+
+  if (source->start_var != SYMBOL_NONE &&
+      grammar_set_start_var(st->g, source->start_var) != SUCCESS_ADD_PROD)
+    return -1;
+
+  return 0;
+}
+
+static int gt_starts_with_var(gt_rhs *r) {
+  return r->len > 0 && symbol_is_var(r->syms[0]);
+}
+
+static void gt_nullable(gt_state *st, char *nullable) {
+  for (int v = 0; v < st->vars_len; v++)
+    nullable[v] = 0;
+
+  for (int changed = 1; changed;) {
+    changed = 0;
+
+    for (int v = 0; v < st->vars_len; v++) {
+      for (gt_rhs *r = st->rhs[v]; r != NULL && !nullable[v]; r = r->next) {
+        int k = 0;
+
+        while (k < r->len && symbol_is_var(r->syms[k]) &&
+               nullable[symbol_index(r->syms[k])])
+          k++;
+
+        if (k == r->len) {
+          nullable[v] = 1;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+// the variable at k in r is a left corner when the variables before it
+// derive epsilon. returns its index, or -1 once k is past the left corners
+// when called with k counting up from 0.
+static int gt_left_corner(gt_rhs *r, int k, char *nullable) {
+  if (k >= r->len || !symbol_is_var(r->syms[k]))
+    return -1;
+  if (k > 0 && !nullable[symbol_index(r->syms[k - 1])])
+    return -1;
+
+  return symbol_index(r->syms[k]);
+}
+
+// strongly connected components of the source variables under "B is a left
+// corner of A", with an iterative Tarjan. only variables sharing a
+// component can be left recursive through each other.
+static int gt_left_components(gt_state *st, char *nullable, int *comp) {
+  int n = st->vars_len;
+  int *index = (int *)malloc(sizeof(int) * (n + 1));
+  int *low = (int *)malloc(sizeof(int) * (n + 1));
+  int *stack = (int *)malloc(sizeof(int) * (n + 1));
+  int *calls = (int *)malloc(sizeof(int) * (n + 1));
+  int *pos = (int *)malloc(sizeof(int) * (n + 1));
+  gt_rhs **edges = (gt_rhs **)malloc(sizeof(gt_rhs *) * (n + 1));
+  char *on_stack = (char *)malloc(sizeof(char) * (n + 1));
+  int ok = index != NULL && low != NULL && stack != NULL && calls != NULL &&
+           pos != NULL && edges != NULL && on_stack != NULL;
+  int next_index = 0;
+  int comps = 0;
+  int top = 0;
+
+  for (int i = 0; ok && i < n; i++) {
+    index[i] = -1;
+    on_stack[i] = 0;
+  }
+
+  for (int root = 0; ok && root < n; root++) {
+    if (index[root] >= 0)
+      continue;
+
+    int depth = 0;
+
+    calls[depth] = root;
+    edges[root] = st->rhs[root];
+    pos[root] = 0;
+    index[root] = low[root] = next_index++;
+    stack[top++] = root;
+    on_stack[root] = 1;
+
+    while (depth >= 0) {
+      int v = calls[depth];
+      gt_rhs *r = edges[v];
+
+      if (r != NULL) {
+        int w = gt_left_corner(r, pos[v]++, nullable);
+
+        if (w < 0) {
+          edges[v] = r->next;
+          pos[v] = 0;
+        } else if (index[w] < 0) {
+          index[w] = low[w] = next_index++;
+          edges[w] = st->rhs[w];
+          pos[w] = 0;
+          stack[top++] = w;
+          on_stack[w] = 1;
+          calls[++depth] = w;
+        } else if (on_stack[w] && index[w] < low[v]) {
+          low[v] = index[w];
+        }
+        continue;
+      }
+
+      if (low[v] == index[v]) {
+        int w;
+
+        do {
+          w = stack[--top];
+          on_stack[w] = 0;
+          comp[w] = comps;
+        } while (w != v);
+
+        comps++;
+      }
+
+      depth--;
+      if (depth >= 0 && low[v] < low[calls[depth]])
+        low[calls[depth]] = low[v];
+    }
+  }
+
+  free(index);
+  free(low);
+  free(stack);
+  free(calls);
+  free(pos);
+  free(edges);
+  free(on_stack);
+
+  return ok ? 0 : -1;
+}
+
+// left recursion through a variable deriving epsilon, A -> B A with B
+// nullable, would need epsilon removed first. substituting into it would
+// also never end, so it is refused before anything is rewritten.
+static int gt_hidden_recursion(gt_state *st, char *nullable, int *comp) {
+  for (int v = 0; v < st->vars_len; v++) {
+    for (gt_rhs *r = st->rhs[v]; r != NULL; r = r->next) {
+      int w;
+
+      for (int k = 0; (w = gt_left_corner(r, k, nullable)) >= 0; k++) {
+        if (k > 0 && comp[w] == comp[v])
+          return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// r followed by everything of s after its leading variable. the levels of s
+// that come before that variable still apply first, the others move right
+// by the symbols r adds.
+static gt_rhs *gt_substitute(gt_state *st, gt_rhs *r, gt_rhs *s) {
+  gt_rhs *n =
+      gt_new_rhs(st, r->len + s->len - 1, r->levels_len + s->levels_len);
+  if (n == NULL)
+    return NULL;
+
+  if (r->len > 0)
+    memcpy(n->syms, r->syms, sizeof(symbol_id) * r->len);
+  if (s->len > 1)
+    memcpy(&n->syms[r->len], &s->syms[1], sizeof(symbol_id) * (s->len - 1));
+
+  int l = 0;
+  int k = 0;
+
+  while (k < s->levels_len && s->levels[k].at == 0)
+    n->levels[l++] = s->levels[k++];
+
+  for (int j = 0; j < r->levels_len; j++)
+    n->levels[l++] = r->levels[j];
+
+  for (; k < s->levels_len; k++) {
+    n->levels[l] = s->levels[k];
+    n->levels[l++].at += r->len - 1;
+  }
+
+  return n;
+}
+
+// Paull's step for variable i: right hand sides starting with an earlier
+// variable of its component are replaced by that variable's right hand
+// sides, which by now start with a later one, a terminal or a fresh
+// variable. the expansions are scanned again until none is left. a
+// variable deriving only itself adds nothing and is dropped.
+static int gt_expand_earlier(gt_state *st, int i, int *comp) {
+  gt_rhs **link = &st->rhs[i];
+
+  while (*link != NULL) {
+    gt_rhs *s = *link;
+
+    if (s->len == 1 && s->syms[0] == var_symbol(i)) {
+      *link = s->next;
+      continue;
+    }
+
+    if (!gt_starts_with_var(s)) {
+      link = &s->next;
+      continue;
+    }
+
+    int j = symbol_index(s->syms[0]);
+
+    if (j >= i || j >= st->source->vars_len || comp[j] != comp[i]) {
+      link = &s->next;
+      continue;
+    }
+
+    gt_rhs *first = NULL;
+    gt_rhs **tail = &first;
+
+    for (gt_rhs *r = st->rhs[j]; r != NULL; r = r->next) {
+      gt_rhs *n = gt_substitute(st, r, s);
+      if (n == NULL)
+        return -1;
+
+      *tail = n;
+      tail = &n->next;
+    }
+
+    *tail = s->next;
+    *link = first;
+  }
+
+  return 0;
+}
+
+// A -> A a | b becomes A -> b A', A' -> a A' | eps. the levels of b rebuild
+// the first A node, those of A a take it as their leftmost symbol to build
+// the next one.
+static int gt_remove_direct(gt_state *st, int i) {
+  symbol_id var = var_symbol(i);
+  gt_rhs *base = NULL;
+  gt_rhs **base_tail = &base;
+  gt_rhs *rec = NULL;
+  gt_rhs **rec_tail = &rec;
+
+  for (gt_rhs *r = st->rhs[i]; r != NULL; r = r->next) {
+    if (r->len > 0 && r->syms[0] == var) {
+      if (r->len == 1)
+        continue;
+
+      // a level before the leftmost symbol means the recursion went
+      // through a variable deriving epsilon
+      if (r->levels_len > 0 && r->levels[0].at == 0)
+        return GRAMMAR_TRANSFORM_HIDDEN_RECURSION;
+
+      *rec_tail = r;
+      rec_tail = &r->next;
+    } else {
+      *base_tail = r;
+      base_tail = &r->next;
+    }
+  }
+
+  *base_tail = NULL;
+  *rec_tail = NULL;
+  st->rhs[i] = base;
+
+  // without a way out the variable derives nothing, like it did before
+  if (rec == NULL || base == NULL)
+    return GRAMMAR_TRANSFORM_SUCCESS;
+
+  int t = gt_add_var(st, i, GRAMMAR_ORIGIN_TAIL);
+  if (t < 0)
+    return GRAMMAR_TRANSFORM_ERROR;
+
+  gt_rhs *first = NULL;
+  gt_rhs **tail = &first;
+
+  for (gt_rhs *b = st->rhs[i]; b != NULL; b = b->next) {
+    gt_rhs *n = gt_new_rhs(st, b->len + 1, b->levels_len);
+    if (n == NULL)
+      return GRAMMAR_TRANSFORM_ERROR;
+
+    if (b->len > 0)
+      memcpy(n->syms, b->syms, sizeof(symbol_id) * b->len);
+    n->syms[b->len] = var_symbol(t);
+    memcpy(n->levels, b->levels, sizeof(grammar_origin_level) * b->levels_len);
+
+    *tail = n;
+    tail = &n->next;
+  }
+
+  st->rhs[i] = first;
+  tail = &st->rhs[t];
+
+  for (gt_rhs *r = rec; r != NULL; r = r->next) {
+    gt_rhs *n = gt_new_rhs(st, r->len, r->levels_len);
+    if (n == NULL)
+      return GRAMMAR_TRANSFORM_ERROR;
+
+    memcpy(n->syms, &r->syms[1], sizeof(symbol_id) * (r->len - 1));
+    n->syms[r->len - 1] = var_symbol(t);
+
+    for (int k = 0; k < r->levels_len; k++) {
+      n->levels[k] = r->levels[k];
+      n->levels[k].at--;
+    }
+
+    *tail = n;
+    tail = &n->next;
+  }
+
+  *tail = gt_new_rhs(st, 0, 0);
+  if (*tail == NULL)
+    return GRAMMAR_TRANSFORM_ERROR;
+
+  return GRAMMAR_TRANSFORM_SUCCESS;
+}
+
+// variables deriving some string of terminals, variables added later are.
+// the table ignores alternatives that start with one that does not, after
+// a split its suffixes would not be ignored.
+static int gt_productive(gt_state *st) {
+  st->productive_len = st->vars_len;
+  st->productive = (char *)calloc(st->vars_len + 1, sizeof(char));
+  if (st->productive == NULL)
+    return -1;
+
+  for (int changed = 1; changed;) {
+    changed = 0;
+
+    for (int v = 0; v < st->vars_len; v++) {
+      for (gt_rhs *r = st->rhs[v]; r != NULL && !st->productive[v];
+           r = r->next) {
+        int k = 0;
+
+        while (k < r->len && (symbol_is_terminal(r->syms[k]) ||
+                              st->productive[symbol_index(r->syms[k])]))
+          k++;
+
+        if (k == r->len) {
+          st->productive[v] = 1;
+          changed = 1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+// the levels of a and b that apply before symbol len are the same
+static int gt_same_levels(gt_rhs *a, gt_rhs *b, int len) {
+  int k = 0;
+
+  for (; k < a->levels_len && a->levels[k].at < len; k++) {
+    if (k >= b->levels_len || b->levels[k].prod != a->levels[k].prod ||
+        b->levels[k].at != a->levels[k].at)
+      return 0;
+  }
+
+  return k == b->levels_len || b->levels[k].at >= len;
+}
+
+// the right hand sides of v starting with the same symbol as first share
+// their longest common prefix, unless they rebuild different source nodes
+// inside it. returns that length.
+static int gt_common_prefix(gt_state *st, gt_rhs *first) {
+  int len = 0;
+  int others = 0;
+
+  while (len < first->len &&
+         (symbol_is_terminal(first->syms[len]) ||
+          symbol_index(first->syms[len]) >= st->productive_len ||
+          st->productive[symbol_index(first->syms[len])]))
+    len++;
+
+  for (gt_rhs *r = first->next; r != NULL && len > 0; r = r->next) {
+    if (r->len == 0 || r->syms[0] != first->syms[0])
+      continue;
+
+    int k = 0;
+
+    while (k < len && k < r->len && r->syms[k] == first->syms[k])
+      k++;
+
+    len = k;
+    others++;
+  }
+
+  if (others == 0)
+    return 0;
+
+  for (gt_rhs *r = first->next; r != NULL && len > 0; r = r->next) {
+    if (r->len == 0 || r->syms[0] != first->syms[0])
+      continue;
+
+    while (len > 0 && !gt_same_levels(first, r, len))
+      len--;
+  }
+
+  return len;
+}
+
+// A -> p a | p b becomes A -> p A', A' -> a | b. the levels inside p are
+// shared and stay with A, the others move to A'.
+static int gt_factor(gt_state *st, int v) {
+  gt_rhs *prev = NULL;
+
+  // st->rhs moves when variables are added, prev stands in for a link
+  for (gt_rhs *first = st->rhs[v]; first != NULL;
+       prev = first, first = first->next) {
+
+    if (first->len == 0)
+      continue;
+
+    int p = gt_common_prefix(st, first);
+    if (p == 0)
+      continue;
+
+    int f = gt_add_var(st, v, GRAMMAR_ORIGIN_FACTOR);
+    if (f < 0)
+      return -1;
+
+    int shared = 0;
+
+    while (shared < first->levels_len && first->levels[shared].at < p)
+      shared++;
+
+    gt_rhs *prefix = gt_new_rhs(st, p + 1, shared);
+    if (prefix == NULL)
+      return -1;
+
+    memcpy(prefix->syms, first->syms, sizeof(symbol_id) * p);
+    prefix->syms[p] = var_symbol(f);
+    memcpy(prefix->levels, first->levels,
+           sizeof(grammar_origin_level) * shared);
+
+    gt_rhs **tail = &st->rhs[f];
+    gt_rhs **keep = &prefix->next;
+    symbol_id lead = first->syms[0];
+
+    for (gt_rhs *r = first; r != NULL; r = r->next) {
+      if (r->len == 0 || r->syms[0] != lead) {
+        *keep = r;
+        keep = &r->next;
+        continue;
+      }
+
+      gt_rhs *n = gt_new_rhs(st, r->len - p, r->levels_len - shared);
+      if (n == NULL)
+        return -1;
+
+      if (r->len > p)
+        memcpy(n->syms, &r->syms[p], sizeof(symbol_id) * (r->len - p));
+
+      for (int k = shared; k < r->levels_len; k++) {
+        n->levels[k - shared] = r->levels[k];
+        n->levels[k - shared].at -= p;
+      }
+
+      *tail = n;
+      tail = &n->next;
+    }
+
+    *keep = NULL;
+    first = prefix;
+
+    if (prev == NULL)
+      st->rhs[v] = prefix;
+    else
+      prev->next = prefix;
+  }
+
+  return 0;
+}
+
+static int gt_build(gt_state *st, grammar_transform *t) {
+  int prods_len = 0;
+  int levels_len = 0;
+
+  for (int v = 0; v < st->vars_len; v++) {
+    for (gt_rhs *r = st->rhs[v]; r != NULL; r = r->next) {
+      prods_len++;
+      levels_len += r->levels_len;
+    }
+  }
+
+  t->vars_len = st->vars_len;
+  t->prods_len = prods_len;
+  t->var_origins = (symbol_id *)malloc(sizeof(symbol_id) * (st->vars_len + 1));
+  t->var_kinds = (char *)malloc(sizeof(char) * (st->vars_len + 1));
+  t->level_offsets = (int *)malloc(sizeof(int) * (prods_len + 1));
+  t->levels = (grammar_origin_level *)malloc(sizeof(grammar_origin_level) *
+                                             (levels_len + 1));
+
+  if (t->var_origins == NULL || t->var_kinds == NULL ||
+      t->level_offsets == NULL || t->levels == NULL)
+    return -1;
+
+  memcpy(t->var_origins, st->origins, sizeof(symbol_id) * st->vars_len);
+  memcpy(t->var_kinds, st->kinds, sizeof(char) * st->vars_len);
+  levels_len = 0;
+
+  // ids are handed out in the order the right hand sides are added
+  for (int v = 0; v < st->vars_len; v++) {
+    for (gt_rhs *r = st->rhs[v]; r != NULL; r = r->next) {
+      int id = st->g->productions_table->len;
+
+      if (add_production_symbols(st->g, var_symbol(v), r->syms, r->len) !=
+          SUCCESS_ADD_PROD)
+        return -1;
+
+      t->level_offsets[id] = levels_len;
+      memcpy(&t->levels[levels_len], r->levels,
+             sizeof(grammar_origin_level) * r->levels_len);
+      levels_len += r->levels_len;
+    }
+  }
+
+  t->level_offsets[prods_len] = levels_len;
+  return 0;
+}
+
+static int gt_run(gt_state *st, grammar_transform *t) {
+  if (gt_load(st) != 0)
+    return GRAMMAR_TRANSFORM_ERROR;
+
+  int *comp = (int *)malloc(sizeof(int) * (st->vars_len + 1));
+  char *nullable = (char *)malloc(sizeof(char) * (st->vars_len + 1));
+  int res = GRAMMAR_TRANSFORM_SUCCESS;
+
+  if (comp == NULL || nullable == NULL) {
+    res = GRAMMAR_TRANSFORM_ERROR;
+  } else {
+    gt_nullable(st, nullable);
+
+    if (gt_left_components(st, nullable, comp) != 0)
+      res = GRAMMAR_TRANSFORM_ERROR;
+    else if (gt_hidden_recursion(st, nullable, comp))
+      res = GRAMMAR_TRANSFORM_HIDDEN_RECURSION;
+  }
+
+  for (int i = 0; res == GRAMMAR_TRANSFORM_SUCCESS && i < st->source->vars_len;
+       i++) {
+    if (gt_expand_earlier(st, i, comp) != 0)
+      res = GRAMMAR_TRANSFORM_ERROR;
+    else
+      res = gt_remove_direct(st, i);
+  }
+
+  free(comp);
+  free(nullable);
+
+  if (res != GRAMMAR_TRANSFORM_SUCCESS)
+    return res;
+
+  if (gt_productive(st) != 0)
+    return GRAMMAR_TRANSFORM_ERROR;
+
+  // factoring may add variables, which are factored in turn
+  for (int v = 0; v < st->vars_len; v++) {
+    if (gt_factor(st, v) != 0)
+      return GRAMMAR_TRANSFORM_ERROR;
+  }
+
+  if (gt_build(st, t) != 0)
+    return GRAMMAR_TRANSFORM_ERROR;
+
+  return GRAMMAR_TRANSFORM_SUCCESS;
+}
+
+// g keeps the terminals, tokens and variables of source at the same
+// indices, fresh variables follow them, named after the variable they were
+// split from with primes appended. var_origins maps every variable of g to
+// the variable of source it belongs to, var_kinds tells GRAMMAR_ORIGIN_TAIL
+// for the lists that replace left recursion and GRAMMAR_ORIGIN_FACTOR for the
+// suffixes after a common prefix. left recursion hidden behind nullable
+// variables cannot be removed this way and fails the transformation.
+//
+// every right hand side of g spells out a piece of a derivation of source.
+// its levels, levels[level_offsets[id]] up to level_offsets[id + 1], rebuild
+// that piece while the symbols are walked left to right: once at of them
+// went by, the last len symbols or rebuilt nodes become the children of a
+// node for source right hand side prod, len being the length of prod.
+grammar_transform *new_grammar_transform(grammar *source, int *res) {
+  int status = GRAMMAR_TRANSFORM_ERROR;
+  grammar_transform *t = NULL;
+
+  if (source != NULL)
+    t = (grammar_transform *)malloc(sizeof(grammar_transform));
+
+  if (t != NULL) {
+    t->source = source;
+    t->g = new_empty_grammar();
+    t->vars_len = 0;
+    t->var_origins = NULL;
+    t->var_kinds = NULL;
+    t->prods_len = 0;
+    t->level_offsets = NULL;
+    t->levels = NULL;
+    t->source_prods = (production_rhs **)malloc(
+        sizeof(production_rhs *) * (source->productions_table->len + 1));
+  }
+
+  if (t != NULL && t->g != NULL && t->source_prods != NULL) {
+    gt_state st;
+
+    st.source = source;
+    st.g = t->g;
+    st.a = new_arena(ARENA_DEFAULT_BLOCK_SIZE);
+    st.vars_len = 0;
+    st.vars_max = 0;
+    st.rhs = NULL;
+    st.origins = NULL;
+    st.kinds = NULL;
+    st.productive_len = 0;
+    st.productive = NULL;
+
+    for (int i = 0; i < source->vars_len; i++) {
+      production *p = &source->productions_table->productions[i];
+
+      for (production_rhs *r = p->first_rhs; r != NULL; r = r->next)
+        t->source_prods[r->id] = r;
+    }
+
+    if (st.a != NULL)
+      status = gt_run(&st, t);
+
+    if (st.a != NULL)
+      free_arena(st.a);
+    free(st.rhs);
+    free(st.origins);
+    free(st.kinds);
+    free(st.productive);
+  }
+
+  if (res != NULL)
+    *res = status;
+
+  if (status != GRAMMAR_TRANSFORM_SUCCESS) {
+    if (t != NULL)
+      free_grammar_transform(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+symbol_id grammar_transform_origin(grammar_transform *t, symbol_id sym) {
+  if (!symbol_is_var(sym))
+    return sym;
+  if (symbol_index(sym) >= t->vars_len)
+    return SYMBOL_NONE;
+
+  return t->var_origins[symbol_index(sym)];
+}
+
+// a node of g being walked: the next child k and the next level l of rhs
+typedef struct gt_restore_frame {
+  ll1_parse_node *n;
+  production_rhs *rhs;
+  grammar_origin_level *levels;
+  int levels_len;
+  int l;
+  int k;
+} gt_restore_frame;
+
+// nodes of the source tree waiting to become children, with the tree they
+// are carved from, and the nodes of g still being walked
+typedef struct gt_restore {
+  grammar_transform *t;
+  ll1_parse_tree *out;
+  int top;
+  int max;
+  ll1_parse_node **stack;
+  int frames_top;
+  int frames_max;
+  gt_restore_frame *frames;
+} gt_restore;
+
+static int gt_restore_push(gt_restore *r, ll1_parse_node *n) {
+  if (n == NULL)
+    return -1;
+
+  if (r->top == r->max) {
+    ll1_parse_node **temp = (ll1_parse_node **)realloc(
+        r->stack, sizeof(ll1_parse_node *) * r->max * 2);
+    if (temp == NULL)
+      return -1;
+
+    r->stack = temp;
+    r->max *= 2;
+  }
+
+  r->stack[r->top++] = n;
+  r->out->nodes++;
+
+  return 0;
+}
+
+static int gt_restore_level(gt_restore *r, grammar_origin_level *level) {
+  production_rhs *prod = r->t->source_prods[level->prod];
+  int len = prod->len;
+
+  if (r->top < len)
+    return -1;
+
+  ll1_parse_node *n = new_ll1_parse_node(r->out->node_arena, NULL,
+                                         prod->for_var, len > 0 ? len : 1);
+  if (n == NULL)
+    return -1;
+
+  if (len == 0) {
+    n->children[0] =
+        new_ll1_parse_node(r->out->node_arena, n, SYMBOL_EPSILON, 0);
+    if (n->children[0] == NULL)
+      return -1;
+
+    n->children_len = 1;
+    r->out->nodes++;
+  }
+
+  for (int k = 0; k < len; k++) {
+    n->children[k] = r->stack[r->top - len + k];
+    n->children[k]->parent = n;
+  }
+
+  n->children_len = len > 0 ? len : 1;
+  r->top -= len;
+
+  return gt_restore_push(r, n);
+}
+
+// the right hand side of g a node was expanded with, recognized by the
+// symbols of its children
+static production_rhs *gt_node_rhs(grammar *g, ll1_parse_node *n) {
+  int len = n->children_len;
+
+  if (len == 1 && n->children[0]->sym == SYMBOL_EPSILON)
+    len = 0;
+
+  production *p = &g->productions_table->productions[symbol_index(n->sym)];
+
+  for (production_rhs *rhs = p->first_rhs; rhs != NULL; rhs = rhs->next) {
+    int k = 0;
+
+    if (rhs->len != len)
+      continue;
+
+    while (k < len && rhs->syms[k] == n->children[k]->sym)
+      k++;
+
+    if (k == len)
+      return rhs;
+  }
+
+  return NULL;
+}
+
+// applies the levels of f that are due once k children went by
+static int gt_restore_levels(gt_restore *r, gt_restore_frame *f) {
+  while (f->l < f->levels_len && f->levels[f->l].at == f->k) {
+    if (gt_restore_level(r, &f->levels[f->l++]) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+static int gt_restore_enter(gt_restore *r, gt_restore_frame *f,
+                            ll1_parse_node *n) {
+  grammar_transform *t = r->t;
+
+  if (!symbol_is_var(n->sym) || symbol_index(n->sym) >= t->vars_len)
+    return -1;
+
+  f->n = n;
+  f->rhs = gt_node_rhs(t->g, n);
+  if (f->rhs == NULL)
+    return -1;
+
+  f->levels = &t->levels[t->level_offsets[f->rhs->id]];
+  f->levels_len =
+      t->level_offsets[f->rhs->id + 1] - t->level_offsets[f->rhs->id];
+  f->l = 0;
+  f->k = 0;
+
+  return gt_restore_levels(r, f);
+}
+
+static int gt_restore_frame_push(gt_restore *r, ll1_parse_node *n) {
+  if (r->frames_top == r->frames_max) {
+    gt_restore_frame *temp = (gt_restore_frame *)realloc(
+        r->frames, sizeof(gt_restore_frame) * r->frames_max * 2);
+    if (temp == NULL)
+      return -1;
+
+    r->frames = temp;
+    r->frames_max *= 2;
+  }
+
+  return gt_restore_enter(r, &r->frames[r->frames_top++], n);
+}
+
+// walks the tree of g in preorder, pushing terminals and applying the levels
+// of each right hand side. fresh variables work on what is on the stack
+// already, a trailing one takes over the frame of its parent so lists do not
+// grow the frames.
+static int gt_restore_node(gt_restore *r, ll1_parse_node *root) {
+  grammar_transform *t = r->t;
+
+  if (gt_restore_frame_push(r, root) != 0)
+    return -1;
+
+  while (r->frames_top > 0) {
+    gt_restore_frame *f = &r->frames[r->frames_top - 1];
+
+    if (f->k == f->rhs->len) {
+      r->frames_top--;
+
+      if (r->frames_top > 0 &&
+          gt_restore_levels(r, &r->frames[r->frames_top - 1]) != 0)
+        return -1;
+      continue;
+    }
+
+    ll1_parse_node *c = f->n->children[f->k++];
+
+    if (symbol_is_terminal(c->sym)) {
+      if (gt_restore_push(r, new_ll1_parse_node(r->out->node_arena, NULL,
+                                                c->sym, 0)) != 0 ||
+          gt_restore_levels(r, f) != 0)
+        return -1;
+    } else if (f->k == f->rhs->len && f->l == f->levels_len &&
+               t->var_kinds[symbol_index(c->sym)] != GRAMMAR_ORIGIN_SAME) {
+      if (gt_restore_enter(r, f, c) != 0)
+        return -1;
+    } else if (gt_restore_frame_push(r, c) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+ll1_parse_tree *grammar_transform_restore_tree(grammar_transform *t,
+                                               ll1_parse_tree *tree) {
+  if (t == NULL || tree == NULL || tree->root == NULL)
+    return NULL;
+
+  gt_restore r;
+
+  r.t = t;
+  r.out = new_ll1_parse_tree(t->source->start_var);
+  r.top = 0;
+  r.max = GRAMMAR_TRANSFORM_RESTORE_STACK_LEN;
+  r.stack = (ll1_parse_node **)malloc(sizeof(ll1_parse_node *) * r.max);
+  r.frames_top = 0;
+  r.frames_max = GRAMMAR_TRANSFORM_RESTORE_STACK_LEN;
+  r.frames =
+      (gt_restore_frame *)malloc(sizeof(gt_restore_frame) * r.frames_max);
+
+  int ok = r.out != NULL && r.stack != NULL && r.frames != NULL;
+
+  if (ok) {
+    // the root made by the reset is replaced
+    r.out->nodes = 0;
+    ok = gt_restore_node(&r, tree->root) == 0 && r.top == 1;
+  }
+
+  if (ok)
+    r.out->root = r.stack[0];
+
+  free(r.stack);
+  free(r.frames);
+
+  if (!ok) {
+    if (r.out != NULL)
+      free_ll1_parse_tree(r.out);
+    return NULL;
+  }
+
+  return r.out;
+}
+
+void free_grammar_transform(grammar_transform *t) {
+  if (t->g != NULL)
+    free_grammar(t->g);
+  free(t->var_origins);
+  free(t->var_kinds);
+  free(t->level_offsets);
+  free(t->levels);
+  free(t->source_prods);
+  free(t);
+}
@@ -0,0 +1,957 @@
+#include "../include/lexer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the token definitions are turned into one thompson NFA, every pattern
+// accepting in its own end state. subset construction over byte classes gives
+// a DFA, which is then minimized by refining the partition of its states
+// until the blocks stop splitting.
+//
+// patterns know literal bytes, ., [...] and [^...] classes with ranges, the
+// escapes \d \w \s \n \t \r (anything else escaped is literal), grouping and
+// the * + ? | operators.
+
+typedef struct lexer_nfa_state {
+  int has_bytes;
+  bitset_word bytes[LEXER_BYTE_WORDS];
+  int out;
+  int out2;
+  int accept;
+} lexer_nfa_state;
+
+typedef struct lexer_nfa {
+  int len;
+  int max;
+  lexer_nfa_state *states;
+} lexer_nfa;
+
+typedef struct lexer_fragment {
+  int start;
+  int end;
+} lexer_fragment;
+
+typedef struct lexer_regex {
+  const char *text;
+  int len;
+  int i;
+  int error;
+  lexer_nfa *nfa;
+} lexer_regex;
+
+// interns fixed width keys, returns the index of the key and adds it when it
+// is new. used for DFA state sets and for partition signatures.
+typedef struct lexer_pool {
+  int width;
+  int len;
+  int max;
+  char *keys;
+  int buckets_len;
+  int *buckets;
+} lexer_pool;
+
+static int new_lexer_nfa_state(lexer_nfa *n) {
+  if (n->len == n->max) {
+    int max = n->max > 0 ? n->max * 2 : 64;
+    lexer_nfa_state *temp = (lexer_nfa_state *)realloc(
+        n->states, sizeof(lexer_nfa_state) * max);
+
+    if (temp == NULL)
+      return -1;
+
+    n->states = temp;
+    n->max = max;
+  }
+
+  lexer_nfa_state *s = &n->states[n->len];
+  s->has_bytes = 0;
+  bitset_clear(s->bytes, LEXER_BYTE_WORDS);
+  s->out = -1;
+  s->out2 = -1;
+  s->accept = LEXER_NO_ACCEPT;
+
+  return n->len++;
+}
+
+// a fragment whose start reads one byte of bytes, end is an epsilon state
+// that later pieces are chained to
+static lexer_fragment lexer_bytes_fragment(lexer_regex *r,
+                                           const bitset_word *bytes) {
+  lexer_fragment f;
+  f.start = new_lexer_nfa_state(r->nfa);
+  f.end = new_lexer_nfa_state(r->nfa);
+
+  if (f.start < 0 || f.end < 0) {
+    r->error = 1;
+    return f;
+  }
+
+  lexer_nfa_state *s = &r->nfa->states[f.start];
+  s->has_bytes = 1;
+  memcpy(s->bytes, bytes, sizeof(bitset_word) * LEXER_BYTE_WORDS);
+  s->out = f.end;
+
+  return f;
+}
+
+static lexer_fragment lexer_empty_fragment(lexer_regex *r) {
+  lexer_fragment f;
+  f.start = f.end = new_lexer_nfa_state(r->nfa);
+
+  if (f.start < 0)
+    r->error = 1;
+
+  return f;
+}
+
+static void lexer_set_range(bitset_word *bytes, int from, int to) {
+  for (int b = from; b <= to; b++)
+    bitset_set(bytes, b);
+}
+
+static void lexer_set_escape(bitset_word *bytes, char c) {
+  switch (c) {
+  case 'd':
+    lexer_set_range(bytes, '0', '9');
+    break;
+  case 'w':
+    lexer_set_range(bytes, '0', '9');
+    lexer_set_range(bytes, 'a', 'z');
+    lexer_set_range(bytes, 'A', 'Z');
+    bitset_set(bytes, '_');
+    break;
+  case 's':
+    lexer_set_range(bytes, '\t', '\r');
+    bitset_set(bytes, ' ');
+    break;
+  case 'n':
+    bitset_set(bytes, '\n');
+    break;
+  case 't':
+    bitset_set(bytes, '\t');
+    break;
+  case 'r':
+    bitset_set(bytes, '\r');
+    break;
+  default:
+    bitset_set(bytes, (unsigned char)c);
+  }
+}
+
+static lexer_fragment lexer_parse_alt(lexer_regex *r);
+
+static lexer_fragment lexer_parse_class(lexer_regex *r) {
+  bitset_word bytes[LEXER_BYTE_WORDS];
+  bitset_clear(bytes, LEXER_BYTE_WORDS);
+
+  int negate = r->i < r->len && r->text[r->i] == '^';
+  if (negate)
+    r->i++;
+
+  int first = 1;
+
+  while (r->i < r->len && (first || r->text[r->i] != ']')) {
+    unsigned char c = r->text[r->i++];
+    first = 0;
+
+    if (c == '\\' && r->i < r->len) {
+      lexer_set_escape(bytes, r->text[r->i++]);
+      continue;
+    }
+
+    if (r->i + 1 < r->len && r->text[r->i] == '-' &&
+        r->text[r->i + 1] != ']') {
+      unsigned char to = r->text[r->i + 1];
+      r->i += 2;
+
+      if (to < c) {
+        r->error = 1;
+        break;
+      }
+
+      lexer_set_range(bytes, c, to);
+      continue;
+    }
+
+    bitset_set(bytes, c);
+  }
+
+  if (r->i >= r->len)
+    r->error = 1;
+  else
+    r->i++;
+
+  if (negate) {
+    for (int w = 0; w < LEXER_BYTE_WORDS; w++)
+      bytes[w] = ~bytes[w];
+  }
+
+  return lexer_bytes_fragment(r, bytes);
+}
+
+static lexer_fragment lexer_parse_atom(lexer_regex *r) {
+  bitset_word bytes[LEXER_BYTE_WORDS];
+  bitset_clear(bytes, LEXER_BYTE_WORDS);
+
+  char c = r->text[r->i++];
+
+  switch (c) {
+  case '(': {
+    lexer_fragment f = lexer_parse_alt(r);
+
+    if (r->i >= r->len || r->text[r->i] != ')')
+      r->error = 1;
+    else
+      r->i++;
+
+    return f;
+  }
+  case '[':
+    return lexer_parse_class(r);
+  case '.':
+    lexer_set_range(bytes, 0, GRAMMAR_BYTES_LEN - 1);
+    bytes['\n' / BITSET_WORD_BITS] &= ~((bitset_word)1 << '\n');
+    break;
+  case '\\':
+    if (r->i >= r->len) {
+      r->error = 1;
+      return lexer_empty_fragment(r);
+    }
+
+    lexer_set_escape(bytes, r->text[r->i++]);
+    break;
+  case '*':
+  case '+':
+  case '?':
+  case '|':
+  case ')':
+    r->error = 1;
+    return lexer_empty_fragment(r);
+  default:
+    bitset_set(bytes, (unsigned char)c);
+  }
+
+  return lexer_bytes_fragment(r, bytes);
+}
+
+static lexer_fragment lexer_parse_repeat(lexer_regex *r) {
+  lexer_fragment f = lexer_parse_atom(r);
+
+  while (!r->error && r->i < r->len) {
+    char op = r->text[r->i];
+
+    if (op != '*' && op != '+' && op != '?')
+      break;
+
+    r->i++;
+
+    int start = new_lexer_nfa_state(r->nfa);
+    int end = new_lexer_nfa_state(r->nfa);
+
+    if (start < 0 || end < 0) {
+      r->error = 1;
+      break;
+    }
+
+    lexer_nfa_state *s = r->nfa->states;
+
+    // start either enters f or skips it, the end of f loops back for * and +
+    s[start].out = f.start;
+    s[start].out2 = op == '+' ? -1 : end;
+    s[f.end].out = op == '?' ? end : f.start;
+    s[f.end].out2 = op == '?' ? -1 : end;
+
+    f.start = op == '+' ? f.start : start;
+    f.end = end;
+  }
+
+  return f;
+}
+
+static lexer_fragment lexer_parse_concat(lexer_regex *r) {
+  lexer_fragment f = lexer_empty_fragment(r);
+
+  while (!r->error && r->i < r->len && r->text[r->i] != '|' &&
+         r->text[r->i] != ')') {
+    lexer_fragment next = lexer_parse_repeat(r);
+
+    if (r->error)
+      break;
+
+    r->nfa->states[f.end].out = next.start;
+    f.end = next.end;
+  }
+
+  return f;
+}
+
+static lexer_fragment lexer_parse_alt(lexer_regex *r) {
+  lexer_fragment f = lexer_parse_concat(r);
+
+  while (!r->error && r->i < r->len && r->text[r->i] == '|') {
+    r->i++;
+
+    lexer_fragment other = lexer_parse_concat(r);
+    int start = new_lexer_nfa_state(r->nfa);
+    int end = new_lexer_nfa_state(r->nfa);
+
+    if (r->error || start < 0 || end < 0) {
+      r->error = 1;
+      break;
+    }
+
+    lexer_nfa_state *s = r->nfa->states;
+    s[start].out = f.start;
+    s[start].out2 = other.start;
+    s[f.end].out = end;
+    s[other.end].out = end;
+
+    f.start = start;
+    f.end = end;
+  }
+
+  return f;
+}
+
+// builds the NFA of one token definition, returns its start state or -1
+static int lexer_add_token_def(lexer_nfa *n, token_def *t, int accept) {
+  lexer_regex r;
+  r.text = t->text;
+  r.len = t->len;
+  r.i = 0;
+  r.error = 0;
+  r.nfa = n;
+
+  lexer_fragment f;
+
+  if (t->kind == TOKEN_LITERAL) {
+    f = lexer_empty_fragment(&r);
+
+    for (int i = 0; !r.error && i < t->len; i++) {
+      bitset_word bytes[LEXER_BYTE_WORDS];
+      bitset_clear(bytes, LEXER_BYTE_WORDS);
+      bitset_set(bytes, (unsigned char)t->text[i]);
+
+      lexer_fragment next = lexer_bytes_fragment(&r, bytes);
+      if (r.error)
+        break;
+
+      n->states[f.end].out = next.start;
+      f.end = next.end;
+    }
+  } else {
+    f = lexer_parse_alt(&r);
+
+    if (r.i < r.len)
+      r.error = 1;
+  }
+
+  if (r.error)
+    return -1;
+
+  n->states[f.end].accept = accept;
+  return f.start;
+}
+
+static void lexer_closure(lexer_nfa *n, bitset_word *set, int *stack) {
+  int top = 0;
+
+  for (int s = 0; s < n->len; s++) {
+    if (bitset_test(set, s))
+      stack[top++] = s;
+  }
+
+  while (top > 0) {
+    lexer_nfa_state *s = &n->states[stack[--top]];
+
+    if (s->has_bytes)
+      continue;
+
+    int outs[2] = {s->out, s->out2};
+
+    for (int i = 0; i < 2; i++) {
+      if (outs[i] >= 0 && !bitset_test(set, outs[i])) {
+        bitset_set(set, outs[i]);
+        stack[top++] = outs[i];
+      }
+    }
+  }
+}
+
+static unsigned int lexer_pool_hash(const char *key, int width) {
+  unsigned int h = 2166136261u;
+
+  for (int i = 0; i < width; i++) {
+    h ^= (unsigned char)key[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static int init_lexer_pool(lexer_pool *p, int width) {
+  p->width = width;
+  p->len = 0;
+  p->max = 16;
+  p->buckets_len = 32;
+  p->keys = (char *)malloc(width * p->max);
+  p->buckets = (int *)calloc(p->buckets_len, sizeof(int));
+
+  if (p->keys == NULL || p->buckets == NULL) {
+    free(p->keys);
+    free(p->buckets);
+    return -1;
+  }
+
+  return 0;
+}
+
+static void free_lexer_pool(lexer_pool *p) {
+  free(p->keys);
+  free(p->buckets);
+}
+
+// buckets hold index + 1 of the key, 0 marks an empty bucket
+static int lexer_pool_intern(lexer_pool *p, const void *key) {
+  unsigned int mask = p->buckets_len - 1;
+  unsigned int b = lexer_pool_hash((const char *)key, p->width) & mask;
+
+  while (p->buckets[b] != 0) {
+    int i = p->buckets[b] - 1;
+
+    if (memcmp(&p->keys[i * p->width], key, p->width) == 0)
+      return i;
+
+    b = (b + 1) & mask;
+  }
+
+  if (p->len == p->max) {
+    char *keys = (char *)realloc(p->keys, p->width * p->max * 2);
+    if (keys == NULL)
+      return -1;
+
+    p->keys = keys;
+    p->max *= 2;
+  }
+
+  memcpy(&p->keys[p->len * p->width], key, p->width);
+  p->buckets[b] = ++p->len;
+
+  if (p->len * 2 > p->buckets_len) {
+    int buckets_len = p->buckets_len * 2;
+    int *buckets = (int *)calloc(buckets_len, sizeof(int));
+    if (buckets == NULL)
+      return -1;
+
+    for (int i = 0; i < p->len; i++) {
+      unsigned int nb = lexer_pool_hash(&p->keys[i * p->width], p->width) &
+                        (buckets_len - 1);
+
+      while (buckets[nb] != 0)
+        nb = (nb + 1) & (buckets_len - 1);
+
+      buckets[nb] = i + 1;
+    }
+
+    free(p->buckets);
+    p->buckets = buckets;
+    p->buckets_len = buckets_len;
+  }
+
+  return p->len - 1;
+}
+
+// splits the bytes into classes of bytes that every NFA byte set either
+// contains all of or none of. returns the number of classes.
+static int lexer_byte_classes(lexer_nfa *n, unsigned char *classes,
+                              int *reps) {
+  int len = 1;
+  memset(classes, 0, GRAMMAR_BYTES_LEN);
+
+  for (int s = 0; s < n->len; s++) {
+    if (!n->states[s].has_bytes)
+      continue;
+
+    int split[GRAMMAR_BYTES_LEN][2];
+    int new_len = 0;
+
+    for (int c = 0; c < len; c++)
+      split[c][0] = split[c][1] = -1;
+
+    for (int b = 0; b < GRAMMAR_BYTES_LEN; b++) {
+      int in = bitset_test(n->states[s].bytes, b);
+      int *to = &split[classes[b]][in];
+
+      if (*to < 0)
+        *to = new_len++;
+
+      classes[b] = *to;
+    }
+
+    len = new_len;
+  }
+
+  for (int c = 0; c < len; c++)
+    reps[c] = -1;
+
+  for (int b = 0; b < GRAMMAR_BYTES_LEN; b++) {
+    if (reps[classes[b]] < 0)
+      reps[classes[b]] = b;
+  }
+
+  return len;
+}
+
+// subset construction, fills trans and accepts of the unminimized DFA and
+// returns its number of states or -1
+static int lexer_build_dfa(lexer_nfa *n, const int *starts, int starts_len,
+                           const int *accept_cols, int classes_len,
+                           const int *reps, int **trans_out,
+                           int **accepts_out) {
+  int words = bitset_words(n->len);
+  int width = sizeof(bitset_word) * words;
+
+  lexer_pool sets;
+  if (init_lexer_pool(&sets, width) != 0)
+    return -1;
+
+  bitset_word *set = new_bitset(words);
+  int *stack = (int *)malloc(sizeof(int) * (n->len + 1));
+  int trans_max = 16;
+  int *trans = (int *)malloc(sizeof(int) * trans_max * classes_len);
+  int *accepts = (int *)malloc(sizeof(int) * trans_max);
+  int ok = set != NULL && stack != NULL && trans != NULL && accepts != NULL;
+
+  if (ok) {
+    for (int i = 0; i < starts_len; i++)
+      bitset_set(set, starts[i]);
+
+    lexer_closure(n, set, stack);
+    ok = lexer_pool_intern(&sets, set) == 0;
+  }
+
+  for (int d = 0; ok && d < sets.len; d++) {
+    if (sets.len > trans_max) {
+      while (sets.len > trans_max)
+        trans_max *= 2;
+
+      int *temp = (int *)realloc(trans, sizeof(int) * trans_max * classes_len);
+      if (temp != NULL)
+        trans = temp;
+
+      int *temp_accepts = (int *)realloc(accepts, sizeof(int) * trans_max);
+      if (temp_accepts != NULL)
+        accepts = temp_accepts;
+
+      ok = temp != NULL && temp_accepts != NULL;
+      if (!ok)
+        break;
+    }
+
+    // the earliest definition wins, accept_cols is indexed by definition
+    const bitset_word *curr = (const bitset_word *)&sets.keys[d * width];
+    int best = -1;
+
+    for (int s = 0; s < n->len; s++) {
+      int accept = n->states[s].accept;
+
+      if (bitset_test(curr, s) && accept != LEXER_NO_ACCEPT &&
+          (best < 0 || accept < best))
+        best = accept;
+    }
+
+    accepts[d] = best >= 0 ? accept_cols[best] : LEXER_NO_ACCEPT;
+
+    for (int c = 0; ok && c < classes_len; c++) {
+      // interning may move the keys
+      curr = (const bitset_word *)&sets.keys[d * width];
+      int empty = 1;
+
+      bitset_clear(set, words);
+
+      for (int s = 0; s < n->len; s++) {
+        lexer_nfa_state *st = &n->states[s];
+
+        if (st->has_bytes && bitset_test(curr, s) &&
+            bitset_test(st->bytes, reps[c])) {
+          bitset_set(set, st->out);
+          empty = 0;
+        }
+      }
+
+      if (empty) {
+        trans[d * classes_len + c] = LEXER_DEAD_STATE;
+        continue;
+      }
+
+      lexer_closure(n, set, stack);
+
+      int next = lexer_pool_intern(&sets, set);
+      ok = next >= 0;
+      trans[d * classes_len + c] = next;
+    }
+  }
+
+  int len = sets.len;
+
+  free_lexer_pool(&sets);
+  free(set);
+  free(stack);
+
+  if (!ok) {
+    free(trans);
+    free(accepts);
+    return -1;
+  }
+
+  *trans_out = trans;
+  *accepts_out = accepts;
+  return len;
+}
+
+// refines the partition of the states, starting from their accepts, until no
+// block splits. blocks are numbered by their first state, so the start state
+// stays 0. returns the number of blocks or -1.
+static int lexer_minimize(int states_len, int classes_len, const int *trans,
+                          const int *accepts, int *blocks) {
+  int *sig = (int *)malloc(sizeof(int) * (classes_len + 1));
+  if (sig == NULL)
+    return -1;
+
+  int len = 0;
+  int prev_len = -1;
+
+  for (int s = 0; s < states_len; s++)
+    blocks[s] = accepts[s];
+
+  // the first round partitions by accept alone, then by the blocks reached
+  for (int round = 0; len != prev_len; round++) {
+    lexer_pool p;
+    int width = round == 0 ? 1 : classes_len + 1;
+
+    if (init_lexer_pool(&p, sizeof(int) * width) != 0) {
+      free(sig);
+      return -1;
+    }
+
+    int *next = (int *)malloc(sizeof(int) * states_len);
+    if (next == NULL) {
+      free_lexer_pool(&p);
+      free(sig);
+      return -1;
+    }
+
+    for (int s = 0; s < states_len; s++) {
+      sig[0] = blocks[s];
+
+      for (int c = 0; round > 0 && c < classes_len; c++) {
+        int t = trans[s * classes_len + c];
+        sig[c + 1] = t == LEXER_DEAD_STATE ? LEXER_DEAD_STATE : blocks[t];
+      }
+
+      next[s] = lexer_pool_intern(&p, sig);
+      if (next[s] < 0) {
+        free(next);
+        free_lexer_pool(&p);
+        free(sig);
+        return -1;
+      }
+    }
+
+    prev_len = round == 0 ? -1 : len;
+    len = p.len;
+    memcpy(blocks, next, sizeof(int) * states_len);
+
+    free(next);
+    free_lexer_pool(&p);
+  }
+
+  free(sig);
+  return len;
+}
+
+// collects the bytes that lead from state s back to s as ranges
+static void lexer_fill_run(lexer *l, int s) {
+  lexer_run *r = &l->runs[s];
+  r->len = 0;
+
+  for (int b = 0; b < GRAMMAR_BYTES_LEN; b++) {
+    if (l->trans[s * l->classes_len + l->byte_classes[b]] != s)
+      continue;
+
+    int to = b;
+    while (to + 1 < GRAMMAR_BYTES_LEN &&
+           l->trans[s * l->classes_len + l->byte_classes[to + 1]] == s)
+      to++;
+
+    if (r->len == LEXER_RUN_RANGES) {
+      r->len = 0;
+      return;
+    }
+
+    r->lo[r->len] = b;
+    r->span[r->len] = to - b;
+    r->len++;
+    b = to;
+  }
+}
+
+// bytes are first mapped to classes of bytes no definition tells apart,
+// trans has one row per state and one column per class. accepts holds the
+// terminal column a state accepts, LEXER_SKIP or LEXER_NO_ACCEPT.
+lexer *new_lexer(grammar *g) {
+  if (g == NULL || g->tokens_len == 0)
+    return NULL;
+
+  lexer *l = (lexer *)malloc(sizeof(lexer));
+  if (l == NULL)
+    return NULL;
+
+  l->states_len = 0;
+  l->trans = NULL;
+  l->accepts = NULL;
+  l->runs = NULL;
+
+  lexer_nfa n;
+  n.len = 0;
+  n.max = 0;
+  n.states = NULL;
+
+  int *starts = (int *)malloc(sizeof(int) * g->tokens_len);
+  int *accept_cols = (int *)malloc(sizeof(int) * g->tokens_len);
+  int *trans = NULL;
+  int *accepts = NULL;
+  int *blocks = NULL;
+  int dfa_len = -1;
+  int reps[GRAMMAR_BYTES_LEN];
+  int ok = starts != NULL && accept_cols != NULL;
+
+  for (int i = 0; ok && i < g->tokens_len; i++) {
+    token_def *t = &g->tokens[i];
+
+    starts[i] = lexer_add_token_def(&n, t, i);
+    accept_cols[i] =
+        t->terminal == SYMBOL_NONE ? LEXER_SKIP : symbol_index(t->terminal);
+    ok = starts[i] >= 0;
+  }
+
+  if (ok) {
+    l->classes_len = lexer_byte_classes(&n, l->byte_classes, reps);
+    dfa_len = lexer_build_dfa(&n, starts, g->tokens_len, accept_cols,
+                              l->classes_len, reps, &trans, &accepts);
+    ok = dfa_len >= 0;
+  }
+
+  if (ok) {
+    blocks = (int *)malloc(sizeof(int) * dfa_len);
+    ok = blocks != NULL;
+  }
+
+  if (ok) {
+    l->states_len =
+        lexer_minimize(dfa_len, l->classes_len, trans, accepts, blocks);
+    ok = l->states_len >= 0;
+  }
+
+  if (ok) {
+    l->trans = (int *)malloc(sizeof(int) * l->states_len * l->classes_len);
+    l->accepts = (int *)malloc(sizeof(int) * l->states_len);
+    l->runs = (lexer_run *)malloc(sizeof(lexer_run) * l->states_len);
+    ok = l->trans != NULL && l->accepts != NULL && l->runs != NULL;
+  }
+
+  if (ok) {
+    // every state of a block behaves the same, the last one written stands
+    for (int s = 0; s < dfa_len; s++) {
+      int b = blocks[s];
+      l->accepts[b] = accepts[s];
+
+      for (int c = 0; c < l->classes_len; c++) {
+        int t = trans[s * l->classes_len + c];
+        l->trans[b * l->classes_len + c] =
+            t == LEXER_DEAD_STATE ? LEXER_DEAD_STATE : blocks[t];
+      }
+    }
+
+    for (int s = 0; s < l->states_len; s++)
+      lexer_fill_run(l, s);
+  }
+
+  free(n.states);
+  free(starts);
+  free(accept_cols);
+  free(trans);
+  free(accepts);
+  free(blocks);
+
+  if (!ok) {
+    free_lexer(l);
+    return NULL;
+  }
+
+  return l;
+}
+
+static int lexer_run_has(const lexer_run *r, unsigned char b) {
+  for (int k = 0; k < r->len; k++) {
+    if ((unsigned char)(b - r->lo[k]) <= r->span[k])
+      return 1;
+  }
+
+  return 0;
+}
+
+// returns the offset of the first byte from i on that is not in the run
+// runs of bytes keeping the state (whitespace, identifier tails) are
+// skipped 16 bytes at a time instead of stepping the DFA per byte
+static int lexer_skip_run(const lexer_run *r, const char *str, int i,
+                          int str_len) {
+#if defined(__SSE2__)
+  while (i + 16 <= str_len) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(str + i));
+    __m128i in = _mm_setzero_si128();
+
+    // b - lo, saturated down by span, is zero exactly for bytes in range
+    for (int k = 0; k < r->len; k++) {
+      __m128i d = _mm_sub_epi8(x, _mm_set1_epi8((char)r->lo[k]));
+      d = _mm_subs_epu8(d, _mm_set1_epi8((char)r->span[k]));
+      in = _mm_or_si128(in, _mm_cmpeq_epi8(d, _mm_setzero_si128()));
+    }
+
+    int mask = _mm_movemask_epi8(in);
+    if (mask != 0xffff)
+      return i + __builtin_ctz(~mask);
+
+    i += 16;
+  }
+#endif
+
+  while (i < str_len && lexer_run_has(r, str[i]))
+    i++;
+
+  return i;
+}
+
+// longest match from every position, skipped tokens are dropped. returns
+// LEXER_SUCCESS, the offset of the first byte no token matches, or
+// LEXER_ERROR.
+int lex_string(lexer *l, const char *str, int str_len, lexer_tokens *out) {
+  if (l == NULL || out == NULL || (str == NULL && str_len != 0) || str_len < 0)
+    return LEXER_ERROR;
+
+  out->len = 0;
+
+  int i = 0;
+  int classes_len = l->classes_len;
+
+  while (i < str_len) {
+    int state = 0;
+    int j = i;
+    int end = -1;
+    int accept = LEXER_NO_ACCEPT;
+
+    while (j < str_len) {
+      state = l->trans[state * classes_len +
+                       l->byte_classes[(unsigned char)str[j]]];
+      if (state == LEXER_DEAD_STATE)
+        break;
+
+      j++;
+
+      if (l->runs[state].len > 0)
+        j = lexer_skip_run(&l->runs[state], str, j, str_len);
+
+      if (l->accepts[state] != LEXER_NO_ACCEPT) {
+        end = j;
+        accept = l->accepts[state];
+      }
+    }
+
+    if (end <= i)
+      return i;
+
+    if (accept != LEXER_SKIP &&
+        lexer_tokens_push(out, accept, i, end - i) != 0)
+      return LEXER_ERROR;
+
+    i = end;
+  }
+
+  return LEXER_SUCCESS;
+}
+
+lexer_tokens *new_lexer_tokens(int max) {
+  lexer_tokens *t = (lexer_tokens *)malloc(sizeof(lexer_tokens));
+  if (t == NULL)
+    return NULL;
+
+  if (max < 1)
+    max = LEXER_TOKENS_INITIAL_LEN;
+
+  t->len = 0;
+  t->max = max;
+  t->cols = (int *)malloc(sizeof(int) * max);
+  t->offsets = (int *)malloc(sizeof(int) * max);
+  t->lens = (int *)malloc(sizeof(int) * max);
+
+  if (t->cols == NULL || t->offsets == NULL || t->lens == NULL) {
+    free_lexer_tokens(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+int lexer_tokens_push(lexer_tokens *t, int col, int offset, int len) {
+  if (t->len == t->max) {
+    int max = t->max * 2;
+
+    int *cols = (int *)realloc(t->cols, sizeof(int) * max);
+    if (cols == NULL)
+      return -1;
+    t->cols = cols;
+
+    int *offsets = (int *)realloc(t->offsets, sizeof(int) * max);
+    if (offsets == NULL)
+      return -1;
+    t->offsets = offsets;
+
+    int *lens = (int *)realloc(t->lens, sizeof(int) * max);
+    if (lens == NULL)
+      return -1;
+    t->lens = lens;
+
+    t->max = max;
+  }
+
+  t->cols[t->len] = col;
+  t->offsets[t->len] = offset;
+  t->lens[t->len] = len;
+  t->len++;
+
+  return 0;
+}
+
+void print_lexer_tokens(lexer_tokens *t, symbol_table *s) {
+  printf("Tokens:\n");
+
+  for (int i = 0; i < t->len; i++) {
+    printf("   %s at %d, %d bytes\n", symbol_name(s, terminal_symbol(t->cols[i])),
+           t->offsets[i], t->lens[i]);
+  }
+}
+
+void free_lexer(lexer *l) {
+  free(l->trans);
+  free(l->accepts);
+  free(l->runs);
+  free(l);
+}
+
+void free_lexer_tokens(lexer_tokens *t) {
+  free(t->cols);
+  free(t->offsets);
+  free(t->lens);
+  free(t);
+}
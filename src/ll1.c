@@ -1,148 +1,709 @@
-#include "../include/ll1.h"
+#include "../include/ll1_internal.h"
+
+// makes room for len more entries above top, the stack moves to the heap on
+// the first growth. returns -1 with the stack left as it was when out of
+// memory.
+int ll1_stack_reserve(int **stack, int *max, int *stack_buf, int top,
+                      int len) {
+  if (top + len < *max)
+    return 0;
 
-int create_parse_tree_with_string(ll1_table *table,
-                                  ll1_parse_tree **output_tree, char start_var,
-                                  const char *str, int str_len) {
-  if (str_len == 0 || str == NULL || table == NULL)
-    return STRING_PARSE_ERROR;
+  int new_max = *max;
 
-  char_stack *char_s = new_char_stack(table->terminals_len * 2);
+  while (top + len >= new_max)
+    new_max *= 2;
 
-  if (char_s == NULL)
-    return STRING_PARSE_ERROR;
+  int *temp;
 
-  ll1_parse_node_stack *node_s = new_ll1_parse_node_stack(char_s->max);
-  if (node_s == NULL) {
-    free_char_stack(char_s);
-    return STRING_PARSE_ERROR;
+  if (*stack == stack_buf) {
+    temp = (int *)malloc(sizeof(int) * new_max);
+    if (temp != NULL)
+      memcpy(temp, stack_buf, sizeof(int) * (top + 1));
+  } else {
+    temp = (int *)realloc(*stack, sizeof(int) * new_max);
   }
 
-  ll1_parse_tree *tree = new_ll1_parse_tree(start_var, char_s->max);
-  if (tree == NULL) {
-    free_char_stack(char_s);
-    free_ll1_parse_node_stack(node_s);
+  if (temp == NULL)
+    return -1;
+
+  *stack = temp;
+  *max = new_max;
+  return 0;
+}
+
+#ifdef LL1_STATS
+#define LL1_STAT_ADD(s, field, n) ((s)->field += (n))
+#define LL1_STAT_MAX(s, field, v)                                             \
+  ((s)->field = (v) > (s)->field ? (v) : (s)->field)
+
+// there is no fetch and max, it is a compare and swap loop
+static void ll1_parse_stats_max(long *dst, long v) {
+  long curr = __atomic_load_n(dst, __ATOMIC_RELAXED);
+
+  while (v > curr && !__atomic_compare_exchange_n(dst, &curr, v, 1,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED))
+    ;
+}
+
+// a parse counts into a local copy and adds it to the caller's stats before
+// returning, so one stats struct can aggregate the parses of several threads
+static void ll1_parse_stats_add(ll1_parse_stats *dst, ll1_parse_stats *src) {
+  __atomic_fetch_add(&dst->parses, src->parses, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->table_lookups, src->table_lookups,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->terminal_matches, src->terminal_matches,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->epsilon_expansions, src->epsilon_expansions,
+                     __ATOMIC_RELAXED);
+  ll1_parse_stats_max(&dst->max_stack_depth, src->max_stack_depth);
+  __atomic_fetch_add(&dst->nodes_allocated, src->nodes_allocated,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->stack_reallocs, src->stack_reallocs,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dst->bytes_allocated, src->bytes_allocated,
+                     __ATOMIC_RELAXED);
+}
+#else
+// s is still evaluated, so counters passed along are not unused
+#define LL1_STAT_ADD(s, field, n) ((void)(s))
+#define LL1_STAT_MAX(s, field, v) ((void)(s))
+#endif
+
+int create_parse_tree_with_string(ll1_table *table,
+                                  ll1_parse_tree **output_tree,
+                                  symbol_id start_var, const char *str,
+                                  int str_len, ll1_parse_stats *stats) {
+  if (str_len == 0 || str == NULL || table == NULL)
     return STRING_PARSE_ERROR;
-  }
 
-  int i = 0;
-  char *curr_char;
-  ll1_parse_node *curr_node;
-  char *string = (char *)str;
+  ll1_parse_tree *tree = new_ll1_parse_tree(start_var);
+  if (tree == NULL)
+    return STRING_PARSE_ERROR;
 
-  if (char_stack_push(char_s, &start_var) != 0) {
-    free_char_stack(char_s);
-    free_ll1_parse_node_stack(node_s);
+#ifdef LL1_STATS
+  if (stats != NULL)
+    __atomic_fetch_add(&stats->bytes_allocated,
+                       (long)(sizeof(ll1_parse_tree) + sizeof(arena) +
+                              tree->node_arena->capacity),
+                       __ATOMIC_RELAXED);
+#endif
+
+  if (fill_parse_tree_with_string(table, tree, start_var, str, str_len,
+                                  stats) != STRING_PARSE_SUCCESS) {
     free_ll1_parse_tree(tree);
     return STRING_PARSE_ERROR;
   }
-  if (ll1_parse_node_stack_push(node_s, tree->root) != 0) {
-    free_char_stack(char_s);
-    free_ll1_parse_node_stack(node_s);
-    free_ll1_parse_tree(tree);
-    return STRING_PARSE_ERROR;
+
+  *output_tree = tree;
+  return STRING_PARSE_SUCCESS;
+}
+
+// the stack keeps the largest size any parse needed, so a reused context
+// stops allocating once it has seen the deepest input
+ll1_parser_ctx *new_ll1_parser_ctx(ll1_table *table) {
+  if (table == NULL)
+    return NULL;
+
+  ll1_parser_ctx *ctx = (ll1_parser_ctx *)malloc(sizeof(ll1_parser_ctx));
+  if (ctx == NULL)
+    return NULL;
+
+  ctx->table = table;
+  ctx->max = LL1_PARSER_CTX_STACK_LEN;
+  ctx->stack =
+      (ll1_parser_entry *)malloc(sizeof(ll1_parser_entry) * ctx->max);
+
+  if (ctx->stack == NULL) {
+    free(ctx);
+    return NULL;
   }
 
-  while (!ll1_parse_node_stack_is_empty(node_s) &&
-         !char_stack_is_empty(char_s) && i < str_len) {
-    if (char_stack_pop(char_s, &curr_char) != 0) {
-      free_char_stack(char_s);
-      free_ll1_parse_node_stack(node_s);
-      free_ll1_parse_tree(tree);
-      return STRING_PARSE_ERROR;
-    }
-    if (ll1_parse_node_stack_pop(node_s, &curr_node) != 0) {
-      free_char_stack(char_s);
-      free_ll1_parse_node_stack(node_s);
-      free_ll1_parse_tree(tree);
-      return STRING_PARSE_ERROR;
+  return ctx;
+}
+
+// the stack only grows, by doubling, and keeps its size for the next parse
+static int ll1_parser_ctx_reserve(ll1_parser_ctx *ctx, int len,
+                                  ll1_parse_stats *local) {
+  int max = ctx->max;
+
+  while (max < len)
+    max *= 2;
+
+  ll1_parser_entry *temp = (ll1_parser_entry *)realloc(
+      ctx->stack, sizeof(ll1_parser_entry) * max);
+  if (temp == NULL)
+    return -1;
+
+  LL1_STAT_ADD(local, stack_reallocs, 1);
+  LL1_STAT_ADD(local, bytes_allocated, (long)sizeof(ll1_parser_entry) * max);
+
+  ctx->stack = temp;
+  ctx->max = max;
+  return 0;
+}
+
+// the input is either bytes mapped through terminal_cols or, when str is
+// NULL, terminal columns produced by a lexer. every entry of the stack is
+// a symbol still to derive together with its node in the tree. node is
+// derived from input from on and has to end at to, the input after it is
+// still read for lookahead. with spans an expanded variable leaves an
+// SYMBOL_EPSILON entry under its right hand side, popping it sets its len.
+static int ll1_parser_ctx_run(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                              ll1_parse_node *node, const char *str,
+                              const int *tokens, int from, int to,
+                              int str_len, int spans, ll1_parse_stats *local) {
+  ll1_table *table = ctx->table;
+  int top = 0;
+  int i = from;
+
+  ctx->stack[0].sym = node->sym;
+  ctx->stack[0].node = node;
+
+  while (top >= 0) {
+    symbol_id curr_sym = ctx->stack[top].sym;
+    ll1_parse_node *curr_node = ctx->stack[top--].node;
+    int col = LL1_END_COL;
+
+    if (curr_sym == SYMBOL_EPSILON) {
+      curr_node->len = i - curr_node->len;
+      continue;
     }
 
-    if (*curr_char == string[i]) {
+    if (i < str_len)
+      col = str != NULL ? table->terminal_cols[(unsigned char)str[i]]
+                        : ll1_table_token_col(table, tokens[i]);
+
+    if (symbol_is_terminal(curr_sym)) {
+      if (i == str_len || symbol_index(curr_sym) != col)
+        return STRING_PARSE_ERROR;
+
+      LL1_STAT_ADD(local, terminal_matches, 1);
+      if (spans)
+        curr_node->len = 1;
+
       i++;
       continue;
     }
 
-    if (*curr_char != curr_node->c) {
-      free_char_stack(char_s);
-      free_ll1_parse_node_stack(node_s);
-      free_ll1_parse_tree(tree);
+    if (col == LL1_NO_INDEX)
       return STRING_PARSE_ERROR;
-    }
 
-    rhs_hashmap *rhs_hm;
-    if (search_ll1_hashmap(table->table, *curr_char, &rhs_hm) ==
-        HASHMAP_KEY_FOUND_SUCCESS) {
-      production_rhs *rhs;
-
-      if (search_rhs_hashmap(rhs_hm, string[i], &rhs) ==
-          HASHMAP_KEY_FOUND_SUCCESS) {
-        int rhs_len = strlen(rhs->rhs);
-
-        if (rhs->rhs[0] == EPSILON) {
-          if (ll1_parse_tree_add_child(tree, curr_node, EPSILON,
-                                       tree->root->max_children) !=
-              PARSE_TREE_ADD_NODE_SUCCESS) {
-            free_char_stack(char_s);
-            free_ll1_parse_node_stack(node_s);
-            free_ll1_parse_tree(tree);
-            return STRING_PARSE_ERROR;
-          }
-          continue;
-        }
+    LL1_STAT_ADD(local, table_lookups, 1);
 
-        for (int i = rhs_len - 1; i >= 0; i--) {
-          char *c = &rhs->rhs[i];
-          if (char_stack_push(char_s, c) != 0) {
-            free_char_stack(char_s);
-            free_ll1_parse_node_stack(node_s);
-            free_ll1_parse_tree(tree);
-            return STRING_PARSE_ERROR;
-          }
-          if (ll1_parse_tree_add_child(tree, curr_node, *c,
-                                       tree->root->max_children) !=
-              PARSE_TREE_ADD_NODE_SUCCESS) {
-            free_char_stack(char_s);
-            free_ll1_parse_node_stack(node_s);
-            free_ll1_parse_tree(tree);
-            return STRING_PARSE_ERROR;
-          }
-        }
+    production_rhs *rhs =
+        ll1_table_predict(table, curr_sym, terminal_symbol(col));
 
-        for (int i = 0; i < curr_node->children_len; i++) {
-          if (ll1_parse_node_stack_push(node_s, curr_node->children[i]) != 0) {
-            free_char_stack(char_s);
-            free_ll1_parse_node_stack(node_s);
-            free_ll1_parse_tree(tree);
-            return STRING_PARSE_ERROR;
-          }
-        }
-      } else {
-        free_char_stack(char_s);
-        free_ll1_parse_node_stack(node_s);
-        free_ll1_parse_tree(tree);
+    if (rhs == NULL)
+      return STRING_PARSE_ERROR;
+
+    if (rhs->len == 0) {
+      LL1_STAT_ADD(local, epsilon_expansions, 1);
+
+      if (ll1_parse_tree_add_child(tree, curr_node, SYMBOL_EPSILON, 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
         return STRING_PARSE_ERROR;
-      }
-    } else {
-      free_char_stack(char_s);
-      free_ll1_parse_node_stack(node_s);
-      free_ll1_parse_tree(tree);
+      continue;
+    }
+
+    if (ll1_parse_node_reserve_children(tree, curr_node, rhs->len) !=
+        PARSE_TREE_ADD_NODE_SUCCESS)
+      return STRING_PARSE_ERROR;
+
+    for (int k = 0; k < rhs->len; k++) {
+      if (ll1_parse_tree_add_child(tree, curr_node, rhs->syms[k], 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
+        return STRING_PARSE_ERROR;
+    }
+
+    if (top + 2 + rhs->len > ctx->max &&
+        ll1_parser_ctx_reserve(ctx, top + 2 + rhs->len, local) != 0)
       return STRING_PARSE_ERROR;
+
+    if (spans) {
+      top++;
+      ctx->stack[top].sym = SYMBOL_EPSILON;
+      ctx->stack[top].node = curr_node;
+      curr_node->len = i;
     }
+
+    for (int k = rhs->len - 1; k >= 0; k--) {
+      top++;
+      ctx->stack[top].sym = rhs->syms[k];
+      ctx->stack[top].node = curr_node->children[k];
+    }
+
+    LL1_STAT_MAX(local, max_stack_depth, (long)top + 1);
   }
 
-  if (i < str_len - 1) {
-    free_char_stack(char_s);
-    free_ll1_parse_node_stack(node_s);
-    free_ll1_parse_tree(tree);
+  if (i != to)
+    return STRING_PARSE_ERROR;
+
+  return STRING_PARSE_SUCCESS;
+}
+
+static int ll1_parser_ctx_fill(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                               symbol_id start_var, const char *str,
+                               const int *tokens, int str_len, int spans,
+                               ll1_parse_stats *stats) {
+  ll1_parse_stats local;
+
+#ifdef LL1_STATS
+  size_t capacity = tree->node_arena->capacity;
+
+  memset(&local, 0, sizeof(local));
+  local.parses = 1;
+  local.max_stack_depth = 1;
+
+  // resetting a chain of blocks merges it into a new one
+  if (tree->node_arena->head->next != NULL)
+    local.bytes_allocated += capacity;
+#endif
+
+  if (ll1_parse_tree_reset(tree, start_var) != PARSE_TREE_ADD_NODE_SUCCESS)
+    return STRING_PARSE_ERROR;
+
+  int res = ll1_parser_ctx_run(ctx, tree, tree->root, str, tokens, 0, str_len,
+                               str_len, spans, &local);
+
+  tree->spans = spans && res == STRING_PARSE_SUCCESS;
+
+#ifdef LL1_STATS
+  local.nodes_allocated = tree->nodes;
+  local.bytes_allocated += tree->node_arena->capacity - capacity;
+
+  if (stats != NULL)
+    ll1_parse_stats_add(stats, &local);
+#else
+  (void)stats;
+#endif
+
+  return res;
+}
+
+int ll1_parser_ctx_parse_string(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                                symbol_id start_var, const char *str,
+                                int str_len, ll1_parse_stats *stats) {
+  if (str_len == 0 || str == NULL || ctx == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  return ll1_parser_ctx_fill(ctx, tree, start_var, str, NULL, str_len, 0,
+                             stats);
+}
+
+int ll1_parser_ctx_parse_tokens(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                                symbol_id start_var, const int *tokens,
+                                int tokens_len, ll1_parse_stats *stats) {
+  if (tokens_len == 0 || tokens == NULL || ctx == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  return ll1_parser_ctx_fill(ctx, tree, start_var, NULL, tokens, tokens_len, 0,
+                             stats);
+}
+
+// one off parses pay for a context of their own
+static int fill_parse_tree(ll1_table *table, ll1_parse_tree *tree,
+                           symbol_id start_var, const char *str,
+                           const int *tokens, int str_len,
+                           ll1_parse_stats *stats) {
+  ll1_parser_ctx *ctx = new_ll1_parser_ctx(table);
+  if (ctx == NULL)
+    return STRING_PARSE_ERROR;
+
+#ifdef LL1_STATS
+  if (stats != NULL)
+    __atomic_fetch_add(&stats->bytes_allocated,
+                       (long)(sizeof(ll1_parser_ctx) +
+                              sizeof(ll1_parser_entry) * ctx->max),
+                       __ATOMIC_RELAXED);
+#endif
+
+  int res = ll1_parser_ctx_fill(ctx, tree, start_var, str, tokens, str_len, 0,
+                                stats);
+
+  free_ll1_parser_ctx(ctx);
+
+  return res;
+}
+
+int fill_parse_tree_with_string(ll1_table *table, ll1_parse_tree *tree,
+                                symbol_id start_var, const char *str,
+                                int str_len, ll1_parse_stats *stats) {
+  if (str_len == 0 || str == NULL || table == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  return fill_parse_tree(table, tree, start_var, str, NULL, str_len, stats);
+}
+
+int fill_parse_tree_with_tokens(ll1_table *table, ll1_parse_tree *tree,
+                                symbol_id start_var, const int *tokens,
+                                int tokens_len, ll1_parse_stats *stats) {
+  if (tokens_len == 0 || tokens == NULL || table == NULL || tree == NULL)
     return STRING_PARSE_ERROR;
+
+  return fill_parse_tree(table, tree, start_var, NULL, tokens, tokens_len,
+                         stats);
+}
+
+// the production node was expanded with is still the one predicted for col
+static int ll1_reparse_same_rhs(ll1_table *table, ll1_parse_node *node,
+                                int col) {
+  if (col == LL1_NO_INDEX)
+    return 0;
+
+  production_rhs *rhs =
+      ll1_table_predict(table, node->sym, terminal_symbol(col));
+
+  if (rhs == NULL)
+    return 0;
+
+  if (rhs->len == 0)
+    return node->children_len == 1 &&
+           node->children[0]->sym == SYMBOL_EPSILON;
+
+  if (rhs->len != node->children_len)
+    return 0;
+
+  for (int k = 0; k < rhs->len; k++) {
+    if (rhs->syms[k] != node->children[k]->sym)
+      return 0;
   }
 
-  *output_tree = tree;
-  free_char_stack(char_s);
-  free_ll1_parse_node_stack(node_s);
+  return 1;
+}
+
+// walks the subtree of node on the context stack. with col every variable
+// in it has to still predict the same, returns 1 when they do, and without
+// it the nodes are counted. returns -1 when the stack cannot grow.
+static int ll1_reparse_walk(ll1_parser_ctx *ctx, ll1_parse_node *node,
+                            int col, int check, ll1_parse_stats *local) {
+  int top = 0;
+  int nodes = 0;
+
+  ctx->stack[0].node = node;
+
+  while (top >= 0) {
+    ll1_parse_node *n = ctx->stack[top--].node;
+
+    nodes++;
+
+    if (check && symbol_is_var(n->sym) &&
+        !ll1_reparse_same_rhs(ctx->table, n, col))
+      return 0;
+
+    if (top + 1 + n->children_len > ctx->max &&
+        ll1_parser_ctx_reserve(ctx, top + 1 + n->children_len, local) != 0)
+      return -1;
+
+    for (int k = 0; k < n->children_len; k++)
+      ctx->stack[++top].node = n->children[k];
+  }
+
+  return check ? 1 : nodes;
+}
+
+// the nodes predicted at the start of node before it was expanded, its
+// ancestors that start there and the empty subtrees right before it, saw
+// the input at that start as lookahead. node is only reparsed alone when
+// an edit there leaves all of their predictions as they were.
+static int ll1_reparse_prefix_fits(ll1_parser_ctx *ctx, ll1_parse_node *node,
+                                   int col, ll1_parse_stats *local) {
+  for (ll1_parse_node *n = node; n->parent != NULL; n = n->parent) {
+    ll1_parse_node *p = n->parent;
+    int empty = 0;
+    int k = 0;
+
+    for (; p->children[k] != n; k++) {
+      if (p->children[k]->len > 0)
+        empty = k + 1;
+    }
+
+    for (int j = empty; j < k; j++) {
+      if (ll1_reparse_walk(ctx, p->children[j], col, 1, local) != 1)
+        return 0;
+    }
+
+    // the parent starts earlier, so did everything predicted before it
+    if (empty > 0)
+      return 1;
+
+    if (!ll1_reparse_same_rhs(ctx->table, p, col))
+      return 0;
+  }
+
+  return 1;
+}
+
+// len is relative: a node starts where its parent does plus the len of the
+// siblings before it, so an edit only changes the len of its ancestors.
+//
+// parses node again from start, it has to end where it did moved by delta.
+// on success the new subtree takes its place and its ancestors grow.
+static int ll1_reparse_node(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                            ll1_parse_node *node, int start, int delta,
+                            const char *str, const int *tokens, int str_len,
+                            ll1_parse_stats *local) {
+  ll1_parse_node *p = node->parent;
+  int nodes = tree->nodes;
+  ll1_parse_node *n =
+      new_ll1_parse_node(tree->node_arena, p, node->sym, 0);
+
+  if (n == NULL)
+    return STRING_PARSE_ERROR;
+
+  tree->nodes++;
+
+  if (ll1_parser_ctx_run(ctx, tree, n, str, tokens, start,
+                         start + node->len + delta, str_len, 1,
+                         local) != STRING_PARSE_SUCCESS) {
+    tree->dead += tree->nodes - nodes;
+    tree->nodes = nodes;
+    return STRING_PARSE_ERROR;
+  }
+
+  int old = ll1_reparse_walk(ctx, node, LL1_NO_INDEX, 0, local);
+  if (old < 0) {
+    tree->dead += tree->nodes - nodes;
+    tree->nodes = nodes;
+    return STRING_PARSE_ERROR;
+  }
+
+  int k = 0;
+  while (p->children[k] != node)
+    k++;
+
+  p->children[k] = n;
+  tree->nodes -= old;
+  tree->dead += old;
+
+  for (ll1_parse_node *q = p; q != NULL; q = q->parent)
+    q->len += delta;
+
   return STRING_PARSE_SUCCESS;
 }
 
+static int ll1_reparse(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                       symbol_id start_var, const char *str,
+                       const int *tokens, int str_len, ll1_edit *edit,
+                       ll1_parse_stats *stats) {
+  // a full parse also reclaims the arena once replaced subtrees outgrow
+  // the tree
+  if (edit == NULL || !tree->spans || tree->root->sym != start_var ||
+      tree->dead > tree->nodes * LL1_REPARSE_DEAD_RATIO || edit->offset < 0 ||
+      edit->deleted < 0 || edit->inserted < 0 ||
+      edit->offset + edit->deleted > tree->root->len ||
+      tree->root->len + edit->inserted - edit->deleted != str_len)
+    return ll1_parser_ctx_fill(ctx, tree, start_var, str, tokens, str_len, 1,
+                               stats);
+
+  int off = edit->offset;
+  int end = edit->offset + edit->deleted;
+  ll1_parse_node *node = tree->root;
+  int start = 0;
+
+  // down to the smallest variable whose span holds the deleted input
+  for (;;) {
+    ll1_parse_node *next = NULL;
+    int at = start;
+
+    for (int k = 0; k < node->children_len && at <= off; k++) {
+      ll1_parse_node *c = node->children[k];
+
+      if (symbol_is_var(c->sym) && end <= at + c->len) {
+        next = c;
+        break;
+      }
+
+      at += c->len;
+    }
+
+    if (next == NULL)
+      break;
+
+    node = next;
+    start = at;
+  }
+
+  ll1_parse_stats local;
+
+#ifdef LL1_STATS
+  size_t capacity = tree->node_arena->capacity;
+  int nodes = tree->nodes;
+
+  memset(&local, 0, sizeof(local));
+  local.max_stack_depth = 1;
+#endif
+
+  int col = LL1_END_COL;
+
+  if (off < str_len)
+    col = str != NULL ? ctx->table->terminal_cols[(unsigned char)str[off]]
+                      : ll1_table_token_col(ctx->table, tokens[off]);
+
+  int res = STRING_PARSE_ERROR;
+  int dead = tree->dead;
+
+  // every failed attempt climbs one level, each a larger subtree. once they
+  // cost as much as the tree a full parse is cheaper, which also keeps
+  // right recursive lists from making the climb quadratic.
+  while (node != tree->root && res != STRING_PARSE_SUCCESS &&
+         tree->dead - dead <= tree->nodes) {
+    if (start < off || ll1_reparse_prefix_fits(ctx, node, col, &local))
+      res = ll1_reparse_node(ctx, tree, node, start,
+                             edit->inserted - edit->deleted, str, tokens,
+                             str_len, &local);
+
+    if (res == STRING_PARSE_SUCCESS)
+      continue;
+
+    ll1_parse_node *p = node->parent;
+
+    for (int k = 0; p->children[k] != node; k++)
+      start -= p->children[k]->len;
+
+    node = p;
+  }
+
+#ifdef LL1_STATS
+  local.parses = res == STRING_PARSE_SUCCESS;
+  local.nodes_allocated = tree->nodes > nodes ? tree->nodes - nodes : 0;
+  local.bytes_allocated += tree->node_arena->capacity - capacity;
+
+  if (stats != NULL)
+    ll1_parse_stats_add(stats, &local);
+#endif
+
+  if (res == STRING_PARSE_SUCCESS)
+    return res;
+
+  return ll1_parser_ctx_fill(ctx, tree, start_var, str, tokens, str_len, 1,
+                             stats);
+}
+
+// parses str, the whole input with edit applied, into a tree that was
+// built by these functions from the input before the edit. the smallest
+// variable whose span holds the edit is parsed again from its start, with
+// the input after it as lookahead, and kept if it ends where it used to
+// moved by the edit. otherwise its parent is tried, up to a parse of the
+// whole input. so the work grows with the depth of the edit and the size
+// of the subtree around it, not with the input. the replaced subtree stays
+// in the tree's arena until the next full parse, which is forced once such
+// nodes outnumber the live ones. without an edit, or with a tree these
+// functions did not build, the whole input is parsed.
+int ll1_reparse_with_string(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                            symbol_id start_var, const char *str, int str_len,
+                            ll1_edit *edit, ll1_parse_stats *stats) {
+  if (ctx == NULL || tree == NULL || (str == NULL && str_len != 0) ||
+      str_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return ll1_reparse(ctx, tree, start_var, str, NULL, str_len, edit, stats);
+}
+
+int ll1_reparse_with_tokens(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                            symbol_id start_var, const int *tokens,
+                            int tokens_len, ll1_edit *edit,
+                            ll1_parse_stats *stats) {
+  if (ctx == NULL || tree == NULL || (tokens == NULL && tokens_len != 0) ||
+      tokens_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return ll1_reparse(ctx, tree, start_var, NULL, tokens, tokens_len, edit,
+                     stats);
+}
+
+void free_ll1_parser_ctx(ll1_parser_ctx *ctx) {
+  free(ctx->stack);
+  free(ctx);
+}
+
+static int ll1_recognize_input(ll1_table *table, symbol_id start_var,
+                               const char *str, const int *tokens,
+                               int str_len) {
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= table->vars_len)
+    return STRING_RECOGNIZE_ERROR;
+
+  int stack_buf[LL1_RECOGNIZE_STACK_LEN];
+  int *stack = stack_buf;
+  int max = LL1_RECOGNIZE_STACK_LEN;
+  int top = 0;
+  int cols = table->cols;
+  int i = 0;
+  int failed = 0;
+
+  stack[top] = cols + symbol_index(start_var);
+
+  while (top >= 0 && !failed) {
+    int sym = stack[top--];
+    int col = LL1_END_COL;
+
+    if (i < str_len) {
+      col = str != NULL ? table->terminal_cols[(unsigned char)str[i]]
+                        : ll1_table_token_col(table, tokens[i]);
+
+      if (col == LL1_NO_INDEX) {
+        failed = 1;
+        continue;
+      }
+    }
+
+    if (sym < cols) {
+      if (sym != col || i == str_len)
+        failed = 1;
+      else
+        i++;
+      continue;
+    }
+
+    int p = table->cells[(sym - cols) * cols + col];
+    if (p == LL1_NO_PRODUCTION) {
+      failed = 1;
+      continue;
+    }
+
+    int from = table->prod_offsets[p];
+    int len = table->prod_offsets[p + 1] - from;
+
+    if (ll1_stack_reserve(&stack, &max, stack_buf, top, len) != 0) {
+      if (stack != stack_buf)
+        free(stack);
+      return STRING_RECOGNIZE_ERROR;
+    }
+
+    memcpy(&stack[top + 1], &table->prod_syms[from], sizeof(int) * len);
+    top += len;
+  }
+
+  if (stack != stack_buf)
+    free(stack);
+
+  if (failed || i < str_len)
+    return i;
+
+  return STRING_RECOGNIZE_SUCCESS;
+}
+
+int ll1_recognize(ll1_table *table, symbol_id start_var, const char *str,
+                  int str_len) {
+  if (table == NULL || (str == NULL && str_len != 0) || str_len < 0)
+    return STRING_RECOGNIZE_ERROR;
+
+  return ll1_recognize_input(table, start_var, str, NULL, str_len);
+}
+
+int ll1_recognize_tokens(ll1_table *table, symbol_id start_var,
+                         const int *tokens, int tokens_len) {
+  if (table == NULL || (tokens == NULL && tokens_len != 0) || tokens_len < 0)
+    return STRING_RECOGNIZE_ERROR;
+
+  return ll1_recognize_input(table, start_var, NULL, tokens, tokens_len);
+}
+
+// one row per variable and one column per terminal, both numbered by symbol
+// index so the end of input marker is column 0. prod_syms holds every right
+// hand side reversed (in push order) starting at prod_offsets[id], terminals
+// as their column and variables as cols + row. terminal_cols maps input
+// bytes to the columns of single byte terminals.
 ll1_table *new_ll1_table(grammar *g, ff_table *fft) {
   if (g == NULL || fft == NULL)
     return NULL;
@@ -151,100 +712,165 @@ ll1_table *new_ll1_table(grammar *g, ff_table *fft) {
   if (nt == NULL)
     return NULL;
 
+  nt->symbols = g->symbols;
   nt->vars_len = g->vars_len;
   nt->terminals_len = g->terminals_len;
-
-  ll1_hashmap *ll1_hm = new_ll1_hashmap(nt->vars_len);
-  if (ll1_hm == NULL) {
-    free(nt);
+  nt->cols = g->terminals_len;
+  nt->table = NULL;
+  nt->cells = NULL;
+  nt->prods = NULL;
+  nt->prod_offsets = NULL;
+  nt->prod_syms = NULL;
+  nt->prods_len = g->productions_table->len;
+
+  // bytes that do not name a terminal stay at LL1_NO_INDEX
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++)
+    nt->terminal_cols[i] = g->byte_terminals[i];
+
+  nt->prods = (production_rhs **)malloc(sizeof(production_rhs *) *
+                                        (nt->prods_len + 1));
+  if (nt->prods == NULL) {
+    free_ll1_table(nt);
     return NULL;
   }
 
-  for (int i = 0; i < nt->vars_len; i++) {
-    char var = g->vars[i];
+  int syms_len = 0;
 
-    int index = var - PRODS_INDEX_SHIFT;
-    var_firsts fr = fft->firsts[index];
-    var_follows fl = fft->follows[index];
-    int has_epsilon_first = var_has_epsilon_rhs(g, var);
-    production p = g->productions_table->productions[index];
-    production_rhs *epsilon_production_rhs = NULL;
+  for (int i = 0; i < nt->vars_len; i++) {
+    production_rhs *curr = g->productions_table->productions[i].first_rhs;
 
-    rhs_hashmap *rhs_hm = new_rhs_hashmap(nt->terminals_len + 1);
-    if (rhs_hm == NULL) {
-      free_ll1_hashmap(ll1_hm);
-      free(nt);
-      return NULL;
+    while (curr != NULL) {
+      nt->prods[curr->id] = curr;
+      syms_len += curr->len;
+      curr = curr->next;
     }
+  }
 
-    for (int j = 0; j < fr.firsts_len; j++) {
-      first fi = fr.firsts[j];
+  nt->cells = (int *)malloc(sizeof(int) * (nt->vars_len * nt->cols + 1));
+  nt->prod_offsets = (int *)malloc(sizeof(int) * (nt->prods_len + 1));
+  nt->prod_syms = (int *)malloc(sizeof(int) * (syms_len + 1));
+  if (nt->cells == NULL || nt->prod_offsets == NULL || nt->prod_syms == NULL) {
+    free_ll1_table(nt);
+    return NULL;
+  }
 
-      if (fi.c == EPSILON) {
-        epsilon_production_rhs = fi.rhs;
-        continue;
-      }
+  for (int i = 0; i < nt->vars_len * nt->cols; i++)
+    nt->cells[i] = LL1_NO_PRODUCTION;
 
-      int res = insert_into_rhs_hashmap(rhs_hm, fi.c, fi.rhs);
-      if (res != HASHMAP_INSERT_SUCCESS) {
-        free_rhs_hashmap(rhs_hm);
-        free_ll1_hashmap(ll1_hm);
-        free(nt);
-        return NULL;
-      }
+  syms_len = 0;
+
+  for (int i = 0; i < nt->prods_len; i++) {
+    production_rhs *rhs = nt->prods[i];
+    nt->prod_offsets[i] = syms_len;
+
+    for (int j = rhs->len - 1; j >= 0; j--) {
+      symbol_id s = rhs->syms[j];
+
+      if (symbol_is_var(s))
+        nt->prod_syms[syms_len++] = nt->cols + symbol_index(s);
+      else
+        nt->prod_syms[syms_len++] = symbol_index(s);
     }
+  }
 
-    if (has_epsilon_first && epsilon_production_rhs != NULL) {
-      for (int j = 0; j < fl.follows_len; j++) {
-        follow fo = fl.follows[j];
+  nt->prod_offsets[nt->prods_len] = syms_len;
 
-        int res = insert_into_rhs_hashmap(rhs_hm, fo.c, epsilon_production_rhs);
-        if (res != HASHMAP_INSERT_SUCCESS) {
+#ifdef LL1_USE_HASHMAP
+  nt->table = new_ll1_hashmap(nt->vars_len > 0 ? nt->vars_len : 1);
+  if (nt->table == NULL) {
+    free_ll1_table(nt);
+    return NULL;
+  }
+#endif
+
+  for (int i = 0; i < nt->vars_len; i++) {
+    production p = g->productions_table->productions[i];
+    int *row = &nt->cells[i * nt->cols];
+
+#ifdef LL1_USE_HASHMAP
+    rhs_hashmap *rhs_hm = new_rhs_hashmap(nt->cols);
+    if (rhs_hm == NULL) {
+      free_ll1_table(nt);
+      return NULL;
+    }
+#endif
+
+    // every right hand side is predicted on its own FIRST set, and on the
+    // FOLLOW set of the variable when it can derive epsilon. two right hand
+    // sides landing on the same cell is a conflict.
+    for (production_rhs *curr = p.first_rhs; curr != NULL;
+         curr = curr->next) {
+      bitset_word *first_set = ff_rhs_first_set(fft, curr, 0);
+      bitset_word *follow_set = ff_follow_set(fft, p.var);
+      int nullable = ff_rhs_nullable(fft, curr, 0);
+
+      for (int j = 0; j < nt->cols; j++) {
+        if (!bitset_test(first_set, j) &&
+            !(nullable && bitset_test(follow_set, j)))
+          continue;
+
+        int conflict = row[j] != LL1_NO_PRODUCTION;
+#ifdef LL1_USE_HASHMAP
+        conflict = conflict || insert_into_rhs_hashmap(rhs_hm, j, curr) !=
+                                   HASHMAP_INSERT_SUCCESS;
+        if (conflict)
           free_rhs_hashmap(rhs_hm);
-          free_ll1_hashmap(ll1_hm);
-          free(nt);
+#endif
+        if (conflict) {
+          free_ll1_table(nt);
           return NULL;
         }
+
+        row[j] = curr->id;
       }
     }
 
-    int res = insert_into_ll1_hashmap(ll1_hm, var, rhs_hm);
+#ifdef LL1_USE_HASHMAP
+    int res = insert_into_ll1_hashmap(nt->table, i, rhs_hm);
     if (res != HASHMAP_INSERT_SUCCESS) {
       free_rhs_hashmap(rhs_hm);
-      free_ll1_hashmap(ll1_hm);
-      free(nt);
+      free_ll1_table(nt);
       return NULL;
     }
+#endif
   }
 
-  nt->terminals = (char *)malloc(sizeof(char) * nt->terminals_len + 1);
-  if (nt->terminals == NULL) {
-    free_ll1_hashmap(ll1_hm);
-    free(nt);
-    return NULL;
-  }
+  return nt;
+}
 
-  nt->vars = (char *)malloc(sizeof(char) * nt->vars_len + 1);
-  if (nt->vars == NULL) {
-    free_ll1_hashmap(ll1_hm);
-    free(nt->terminals);
-    free(nt);
+production_rhs *ll1_table_predict(ll1_table *t, symbol_id var,
+                                  symbol_id terminal) {
+  if (!symbol_is_var(var) || symbol_index(var) >= t->vars_len ||
+      !symbol_is_terminal(terminal) || symbol_index(terminal) >= t->cols)
     return NULL;
+
+#ifdef LL1_USE_HASHMAP
+  // tables loaded from a compiled grammar have no hashmap
+  if (t->table != NULL) {
+    rhs_hashmap *rhs_hm;
+    production_rhs *rhs;
+
+    if (search_ll1_hashmap(t->table, symbol_index(var), &rhs_hm) !=
+        HASHMAP_KEY_FOUND_SUCCESS)
+      return NULL;
+    if (search_rhs_hashmap(rhs_hm, symbol_index(terminal), &rhs) !=
+        HASHMAP_KEY_FOUND_SUCCESS)
+      return NULL;
+
+    return rhs;
   }
+#endif
 
-  if (strcpy(nt->vars, g->vars) == NULL ||
-      strcpy(nt->terminals, g->terminals) == NULL) {
-    free_ll1_hashmap(ll1_hm);
-    free(nt->terminals);
-    free(nt->vars);
-    free(nt);
+  int p = t->cells[symbol_index(var) * t->cols + symbol_index(terminal)];
+  if (p == LL1_NO_PRODUCTION)
     return NULL;
-  }
 
-  nt->table = ll1_hm;
-  return nt;
+  return t->prods[p];
 }
 
+// sets of variable v live at v's index. suffix_firsts holds FIRST of every
+// suffix of every right hand side, the suffixes of production id start at
+// suffix_offsets[id] and run up to and including the empty one.
 ff_table *new_ff_table(grammar *g) {
   if (g == NULL)
     return NULL;
@@ -253,552 +879,469 @@ ff_table *new_ff_table(grammar *g) {
   if (nt == NULL)
     return NULL;
 
-  nt->firsts = (var_firsts *)malloc(sizeof(var_firsts) * MAX_PRODS);
-  if (nt->firsts == NULL) {
-    free(nt);
-    return NULL;
-  }
+  production_table *t = g->productions_table;
 
-  nt->follows = (var_follows *)malloc(sizeof(var_follows) * MAX_PRODS);
-  if (nt->follows == NULL) {
-    free(nt->firsts);
+  nt->symbols = g->symbols;
+  nt->vars_len = g->vars_len;
+  nt->terminals_len = g->terminals_len;
+  nt->words = bitset_words(nt->terminals_len);
+  nt->prods_len = t->len;
+  nt->nullable = NULL;
+  nt->first_sets = NULL;
+  nt->follow_sets = NULL;
+  nt->suffix_offsets = NULL;
+  nt->suffix_nullable = NULL;
+  nt->suffix_firsts = NULL;
+
+  nt->prods =
+      (production_rhs **)malloc(sizeof(production_rhs *) * (t->len + 1));
+  if (nt->prods == NULL) {
     free(nt);
     return NULL;
   }
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    nt->firsts[i].firsts = NULL;
-    nt->follows[i].follows = NULL;
-    nt->firsts[i].firsts_len = FOLLOW_LEN_NOT_CALCULATED;
-    nt->follows[i].follows_len = FOLLOW_LEN_NOT_CALCULATED;
+  int suffixes_len = 0;
 
-    production_table *t = g->productions_table;
-    production p = t->productions[i];
+  for (int i = 0; i < nt->vars_len; i++) {
+    production_rhs *curr = t->productions[i].first_rhs;
 
-    if (p.first_rhs == NULL) {
-      nt->firsts[i].var = '\0';
-      nt->follows[i].var = '\0';
-    } else {
-      nt->firsts[i].var = p.var;
-      nt->follows[i].var = p.var;
+    while (curr != NULL) {
+      nt->prods[curr->id] = curr;
+      suffixes_len += curr->len + 1;
+      curr = curr->next;
     }
   }
 
-  return nt;
-}
-
-int calculate_firsts(grammar *g, ff_table *fft) {
-  production_table *t = g->productions_table;
-
-  for (int i = 0; i < MAX_PRODS; i++) {
-    production p = t->productions[i];
-
-    if (p.first_rhs != NULL) {
-      int res = find_first(t, fft, p.var);
-      if (res != SUCCESS_ON_FIRST_CALC)
-        return res;
-    }
+  nt->nullable = (char *)calloc(nt->vars_len + 1, sizeof(char));
+  nt->first_sets = new_bitset(nt->vars_len * nt->words);
+  nt->follow_sets = new_bitset(nt->vars_len * nt->words);
+  nt->suffix_offsets = (int *)malloc(sizeof(int) * (nt->prods_len + 1));
+  nt->suffix_nullable = (char *)calloc(suffixes_len + 1, sizeof(char));
+  nt->suffix_firsts = new_bitset(suffixes_len * nt->words);
+  if (nt->nullable == NULL || nt->first_sets == NULL ||
+      nt->follow_sets == NULL || nt->suffix_offsets == NULL ||
+      nt->suffix_nullable == NULL || nt->suffix_firsts == NULL) {
+    free_ff_table(nt);
+    return NULL;
   }
 
-  return SUCCESS_ON_FIRST_CALC;
-}
+  suffixes_len = 0;
 
-int calculate_follows(grammar *g, ff_table *fft) {
-  production_table *t = g->productions_table;
+  for (int i = 0; i < nt->prods_len; i++) {
+    nt->suffix_offsets[i] = suffixes_len;
+    suffixes_len += nt->prods[i]->len + 1;
+  }
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    production p = t->productions[i];
+  nt->suffix_offsets[nt->prods_len] = suffixes_len;
 
-    if (p.first_rhs != NULL) {
-      var_follows curr = fft->follows[i];
+  return nt;
+}
 
-      if (curr.follows == NULL &&
-          curr.follows_len == FOLLOW_LEN_NOT_CALCULATED && curr.var != '\0') {
-        int res = find_follow(t, &fft, p.var, g->start_var);
+bitset_word *ff_first_set(ff_table *t, symbol_id var) {
+  return &t->first_sets[symbol_index(var) * t->words];
+}
 
-        if (res == FOLLOW_ALREADY_CALCULATED)
-          continue;
-        if (res != SUCCESS_ON_FOLLOW_CALC)
-          return res;
-      }
-    }
-  }
+bitset_word *ff_follow_set(ff_table *t, symbol_id var) {
+  return &t->follow_sets[symbol_index(var) * t->words];
+}
 
-  return SUCCESS_ON_FOLLOW_CALC;
+bitset_word *ff_rhs_first_set(ff_table *t, production_rhs *rhs, int from) {
+  return &t->suffix_firsts[(t->suffix_offsets[rhs->id] + from) * t->words];
 }
 
-int find_first(production_table *t, ff_table *fft, char var) {
-  if (var < MIN_PROD_CHAR || var > MAX_PROD_CHAR) {
-    return INCORRECT_VAR_SIGN;
-  }
+int ff_rhs_nullable(ff_table *t, production_rhs *rhs, int from) {
+  return t->suffix_nullable[t->suffix_offsets[rhs->id] + from];
+}
 
-  production_rhs_stack *s = new_production_rhs_stack(t->len);
+// worklist fixpoint over the variables, a variable is revisited whenever the
+// FIRST set or nullability of a variable used in one of its right hand sides
+// grows. afterwards FIRST of every right hand side suffix is stored once.
+int calculate_firsts(grammar *g, ff_table *fft) {
+  production_table *t = g->productions_table;
+  int vars_len = fft->vars_len;
+  int words = fft->words;
 
-  if (s == NULL) {
+  if (vars_len < 0)
     return ERROR_ON_FIRST_CALC;
-  }
-
-  int l = 0;
-  int max = 5;
-  first *f = (first *)malloc(sizeof(first) * max);
 
-  if (f == NULL) {
-    free_production_rhs_stack(s);
+  // users[user_offsets[B]..user_offsets[B + 1]] are the variables with B in
+  // one of their right hand sides, marks keeps each user from being listed
+  // twice for the same B
+  int *user_offsets = (int *)calloc(vars_len + 1, sizeof(int));
+  int *filled = (int *)malloc(sizeof(int) * (vars_len + 1));
+  int *marks = (int *)malloc(sizeof(int) * (vars_len + 1));
+  int *queue = (int *)malloc(sizeof(int) * (vars_len + 1));
+  char *queued = (char *)malloc(sizeof(char) * (vars_len + 1));
+  int *users = NULL;
+
+  if (user_offsets == NULL || filled == NULL || marks == NULL ||
+      queue == NULL || queued == NULL) {
+    free(user_offsets);
+    free(filled);
+    free(marks);
+    free(queue);
+    free(queued);
     return ERROR_ON_FIRST_CALC;
   }
 
-  int index = var - PRODS_INDEX_SHIFT;
-  production p = t->productions[index];
-  production_rhs *curr_rhs = p.first_rhs;
-  production_rhs *selected_rhs = p.first_rhs;
-
-  if (curr_rhs == NULL || fft->firsts[index].var == '\0') {
-    free(f);
-    free_production_rhs_stack(s);
-    return UNDEFINED_PRODUCTION;
-  }
+  for (int pass = 0; pass < 2; pass++) {
+    for (int b = 0; b < vars_len; b++) {
+      filled[b] = 0;
+      marks[b] = -1;
+    }
 
-  while (curr_rhs != NULL) {
-    char fi = curr_rhs->rhs[0];
+    for (int i = 0; i < vars_len; i++) {
+      for (production_rhs *curr = t->productions[i].first_rhs; curr != NULL;
+           curr = curr->next) {
+        for (int j = 0; j < curr->len; j++) {
+          if (!symbol_is_var(curr->syms[j]))
+            continue;
 
-    if (fi >= MIN_PROD_CHAR && fi <= MAX_PROD_CHAR) {
-      if (curr_rhs->next) {
-        if (production_rhs_stack_push(s, curr_rhs->next) != 0) {
-          free(f);
-          free_production_rhs_stack(s);
-          return UNDEFINED_PRODUCTION;
-        }
-      }
+          int b = symbol_index(curr->syms[j]);
 
-      int nindex = fi - PRODS_INDEX_SHIFT;
-      production np = t->productions[nindex];
-      curr_rhs = np.first_rhs;
-      continue;
-    }
+          if (marks[b] == i)
+            continue;
 
-    if (check_first_duplicate(f, l, fi) == DUPLICATED_FIRST_NOT_FOUND) {
-      if (l == max) {
-        max *= 2;
-        first *temp = (first *)realloc(f, sizeof(first) * max);
+          marks[b] = i;
 
-        if (temp == NULL) {
-          free(f);
-          free_production_rhs_stack(s);
-          return ERROR_ON_FIRST_CALC;
+          if (pass == 0)
+            user_offsets[b + 1]++;
+          else
+            users[user_offsets[b] + filled[b]++] = i;
         }
-
-        f = temp;
       }
-
-      f[l].c = fi;
-      f[l].rhs = selected_rhs;
-      l++;
     }
 
-    if (curr_rhs->next == NULL) {
-      if (production_rhs_stack_is_empty(s)) {
-        curr_rhs = NULL;
-      } else {
-        if (production_rhs_stack_pop(s, &curr_rhs) != 0) {
-          free(f);
-          free_production_rhs_stack(s);
-          return UNDEFINED_PRODUCTION;
-        }
+    if (pass == 0) {
+      for (int b = 0; b < vars_len; b++)
+        user_offsets[b + 1] += user_offsets[b];
+
+      users = (int *)malloc(sizeof(int) * (user_offsets[vars_len] + 1));
+      if (users == NULL) {
+        free(user_offsets);
+        free(filled);
+        free(marks);
+        free(queue);
+        free(queued);
+        return ERROR_ON_FIRST_CALC;
       }
-    } else {
-      curr_rhs = curr_rhs->next;
     }
-
-    if (curr_rhs != NULL && curr_rhs->for_var == var)
-      selected_rhs = curr_rhs;
-  }
-
-  fft->firsts[index].firsts = f;
-  fft->firsts[index].firsts_len = l;
-
-  free_production_rhs_stack(s);
-  return SUCCESS_ON_FIRST_CALC;
-}
-
-int find_follow(production_table *t, ff_table **fft, char var, char start_var) {
-  if (var < MIN_PROD_CHAR || var > MAX_PROD_CHAR) {
-    return INCORRECT_VAR_SIGN;
   }
 
-  production_rhs_stack *s = new_production_rhs_stack(t->len * 2);
-  char_stack *matches = new_char_stack(t->len * 2);
-
-  if (s == NULL) {
-    return ERROR_ON_FOLLOW_CALC;
-  }
+  int head = 0;
+  int queue_len = 0;
 
-  int l = 0;
-  int max = 5;
-  follow *f = (follow *)malloc(sizeof(follow) * max);
+  bitset_clear(fft->first_sets, vars_len * words);
+  memset(fft->nullable, 0, sizeof(*fft->nullable) * vars_len);
 
-  if (f == NULL) {
-    free_char_stack(matches);
-    free_production_rhs_stack(s);
-    return ERROR_ON_FOLLOW_CALC;
+  for (int i = 0; i < vars_len; i++) {
+    queued[i] = t->productions[i].first_rhs != NULL;
+    if (queued[i])
+      queue[queue_len++] = i;
   }
 
-  int index = var - PRODS_INDEX_SHIFT;
-  var_follows *fl = &(*fft)->follows[index];
-  int is_calculated = fl->follows_len != FOLLOW_LEN_CALCULATING &&
-                      fl->follows_len != FOLLOW_LEN_NOT_CALCULATED;
-
-  if ((*fft)->follows[index].var == '\0') {
-    free(f);
-    free_char_stack(matches);
-    free_production_rhs_stack(s);
-    return UNDEFINED_PRODUCTION;
-  }
+  while (queue_len > 0) {
+    int a = queue[head];
+    head = (head + 1) % vars_len;
+    queue_len--;
+    queued[a] = 0;
 
-  if (is_calculated) {
-    free(f);
-    free_char_stack(matches);
-    free_production_rhs_stack(s);
-    return FOLLOW_ALREADY_CALCULATED;
-  }
+    bitset_word *first_a = &fft->first_sets[a * words];
+    int changed = 0;
 
-  fl->follows_len = FOLLOW_LEN_CALCULATING;
+    for (production_rhs *curr = t->productions[a].first_rhs; curr != NULL;
+         curr = curr->next) {
+      int nullable = 1;
 
-  if (var == start_var) {
-    f[l].c = TERMINATE_SYMBOL;
-    l++;
-  }
+      for (int j = 0; nullable && j < curr->len; j++) {
+        symbol_id s = curr->syms[j];
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    production p = t->productions[i];
-    production_rhs *curr = p.first_rhs;
+        if (symbol_is_var(s)) {
+          changed |= bitset_union(first_a, ff_first_set(fft, s), words);
+          nullable = fft->nullable[symbol_index(s)];
+        } else {
+          int index = symbol_index(s);
 
-    while (curr != NULL) {
-      char *match = strchr(curr->rhs, var);
-      if (match != NULL) {
-        if (production_rhs_stack_push(s, curr) != 0) {
-          free(f);
-          free_char_stack(matches);
-          free_production_rhs_stack(s);
-          return ERROR_ON_FOLLOW_CALC;
-        }
-        if (char_stack_push(matches, match) != 0) {
-          free(f);
-          free_char_stack(matches);
-          free_production_rhs_stack(s);
-          return ERROR_ON_FOLLOW_CALC;
+          if (!bitset_test(first_a, index)) {
+            bitset_set(first_a, index);
+            changed = 1;
+          }
+          nullable = 0;
         }
       }
 
-      curr = curr->next;
+      if (nullable && !fft->nullable[a]) {
+        fft->nullable[a] = 1;
+        changed = 1;
+      }
     }
-  }
 
-  if (production_rhs_stack_is_empty(s)) {
-    fl->follows = f;
-    fl->follows_len = l;
-
-    free_char_stack(matches);
-    free_production_rhs_stack(s);
-    return SUCCESS_ON_FOLLOW_CALC;
-  }
+    if (!changed)
+      continue;
 
-  production_rhs *top;
-  char *match;
+    for (int u = user_offsets[a]; u < user_offsets[a + 1]; u++) {
+      int user = users[u];
 
-  while (!char_stack_is_empty(matches) && !production_rhs_stack_is_empty(s)) {
-    if (production_rhs_stack_pop(s, &top) != 0) {
-      free(f);
-      free_char_stack(matches);
-      free_production_rhs_stack(s);
-      return ERROR_ON_FOLLOW_CALC;
+      if (!queued[user]) {
+        queued[user] = 1;
+        queue[(head + queue_len) % vars_len] = user;
+        queue_len++;
+      }
     }
+  }
 
-    if (char_stack_pop(matches, &match) != 0) {
-      free(f);
-      free_char_stack(matches);
-      free_production_rhs_stack(s);
-      return ERROR_ON_FOLLOW_CALC;
-    }
+  free(users);
+  free(user_offsets);
+  free(filled);
+  free(marks);
+  free(queue);
+  free(queued);
 
-    char *next = (match + sizeof(char));
+  for (int i = 0; i < fft->prods_len; i++) {
+    production_rhs *rhs = fft->prods[i];
+    int len = rhs->len;
+    int offset = fft->suffix_offsets[i];
 
-    if ((*next == '\0') || (*next >= MIN_PROD_CHAR && *next <= MAX_PROD_CHAR)) {
-      char *curr_char = next;
-      int is_reached_non_epsilon_var = 0;
+    bitset_clear(&fft->suffix_firsts[offset * words], (len + 1) * words);
+    fft->suffix_nullable[offset + len] = 1;
 
-      while (*curr_char >= MIN_PROD_CHAR && *curr_char <= MAX_PROD_CHAR) {
-        var_firsts curr_char_firsts =
-            (*fft)->firsts[*curr_char - PRODS_INDEX_SHIFT];
+    for (int j = len - 1; j >= 0; j--) {
+      bitset_word *suffix = &fft->suffix_firsts[(offset + j) * words];
+      symbol_id s = rhs->syms[j];
 
-        if (curr_char_firsts.firsts == NULL || curr_char_firsts.var == '\0') {
-          free(f);
-          free_char_stack(matches);
-          free_production_rhs_stack(s);
-          return ERROR_ON_FOLLOW_CALC;
-        }
+      if (symbol_is_var(s)) {
+        int nullable = fft->nullable[symbol_index(s)];
+
+        bitset_union(suffix, ff_first_set(fft, s), words);
+        if (nullable)
+          bitset_union(suffix, suffix + words, words);
 
-        int contains_epsilon = 0;
+        fft->suffix_nullable[offset + j] =
+            nullable && fft->suffix_nullable[offset + j + 1];
+      } else {
+        bitset_set(suffix, symbol_index(s));
+        fft->suffix_nullable[offset + j] = 0;
+      }
+    }
+  }
 
-        for (int i = 0; i < curr_char_firsts.firsts_len; i++) {
-          first fi = curr_char_firsts.firsts[i];
+  return SUCCESS_ON_FIRST_CALC;
+}
 
-          if (fi.c == EPSILON) {
-            contains_epsilon = 1;
-            continue;
-          }
+// FOLLOW(X) gets FIRST of whatever comes after X in a right hand side, and
+// every production A -> ...X where the rest after X is nullable adds an edge
+// A -> X meaning FOLLOW(A) flows into FOLLOW(X). the sets are then pushed
+// along the edges with a worklist until nothing grows, cycles included.
+int calculate_follows(grammar *g, ff_table *fft) {
+  int vars_len = fft->vars_len;
+  int words = fft->words;
+
+  int *edge_offsets = (int *)calloc(vars_len + 1, sizeof(int));
+  int *filled = (int *)calloc(vars_len + 1, sizeof(int));
+  int *queue = (int *)malloc(sizeof(int) * (vars_len + 1));
+  char *queued = (char *)malloc(sizeof(char) * (vars_len + 1));
+  int edges_len = 0;
+
+  if (edge_offsets == NULL || filled == NULL || queue == NULL ||
+      queued == NULL) {
+    free(edge_offsets);
+    free(filled);
+    free(queue);
+    free(queued);
+    return ERROR_ON_FOLLOW_CALC;
+  }
 
-          if (check_follow_duplicate(f, l, fi.c) == DUPLICATED_FOLLOW_FOUND) {
-            continue;
-          }
+  bitset_clear(fft->follow_sets, vars_len * words);
 
-          if (l == max) {
-            max *= 2;
-            follow *temp = (follow *)realloc(f, sizeof(follow) * max);
+  if (symbol_is_var(g->start_var))
+    bitset_set(ff_follow_set(fft, g->start_var),
+               symbol_index(SYMBOL_TERMINATE));
 
-            if (temp == NULL) {
-              free(f);
-              free_char_stack(matches);
-              free_production_rhs_stack(s);
-              return ERROR_ON_FOLLOW_CALC;
-            }
+  for (int i = 0; i < fft->prods_len; i++) {
+    production_rhs *rhs = fft->prods[i];
 
-            f = temp;
-          }
+    for (int j = 0; j < rhs->len; j++) {
+      symbol_id s = rhs->syms[j];
 
-          f[l].c = fi.c;
-          l++;
-        }
+      if (!symbol_is_var(s))
+        continue;
 
-        if (!contains_epsilon) {
-          is_reached_non_epsilon_var = 1;
-          break;
-        }
+      bitset_union(ff_follow_set(fft, s), ff_rhs_first_set(fft, rhs, j + 1),
+                   words);
 
-        curr_char = curr_char + sizeof(char);
+      if (s != rhs->for_var && ff_rhs_nullable(fft, rhs, j + 1)) {
+        edge_offsets[symbol_index(rhs->for_var) + 1]++;
+        edges_len++;
       }
+    }
+  }
 
-      if (*curr_char != '\0' && !is_reached_non_epsilon_var) {
-        if (check_follow_duplicate(f, l, *curr_char) ==
-            DUPLICATED_FOLLOW_NOT_FOUND) {
-          if (l == max) {
-            max *= 2;
-            follow *temp = (follow *)realloc(f, sizeof(follow) * max);
-
-            if (temp == NULL) {
-              free(f);
-              free_char_stack(matches);
-              free_production_rhs_stack(s);
-              return ERROR_ON_FOLLOW_CALC;
-            }
-
-            f = temp;
-          }
+  for (int i = 0; i < vars_len; i++)
+    edge_offsets[i + 1] += edge_offsets[i];
 
-          f[l].c = *curr_char;
-          l++;
-        }
-      }
+  int *edges = (int *)malloc(sizeof(int) * (edges_len + 1));
+  if (edges == NULL) {
+    free(edge_offsets);
+    free(filled);
+    free(queue);
+    free(queued);
+    return ERROR_ON_FOLLOW_CALC;
+  }
 
-      if (*curr_char == '\0' && !is_reached_non_epsilon_var) {
-        char top_lhs = top->for_var;
-
-        if (top_lhs != *match) {
-          var_follows top_lhs_follows =
-              (*fft)->follows[top_lhs - PRODS_INDEX_SHIFT];
-
-          int lhs_follows_is_calculated =
-              top_lhs_follows.follows_len != FOLLOW_LEN_CALCULATING &&
-              top_lhs_follows.follows_len != FOLLOW_LEN_NOT_CALCULATED;
-
-          int lhs_follows_is_calculating =
-              top_lhs_follows.follows_len == FOLLOW_LEN_CALCULATING;
-
-          if (lhs_follows_is_calculating) {
-            fl->follows = NULL;
-            fl->follows_len = FOLLOW_LEN_NOT_CALCULATED;
-
-            free(f);
-            free_char_stack(matches);
-            free_production_rhs_stack(s);
-            return GRAMMAR_IS_NOT_LL1;
-          } else if (lhs_follows_is_calculated) {
-            for (int i = 0; i < top_lhs_follows.follows_len; i++) {
-              follow fo = top_lhs_follows.follows[i];
-
-              if (check_follow_duplicate(f, l, fo.c) ==
-                  DUPLICATED_FOLLOW_FOUND) {
-                continue;
-              }
-
-              if (l == max) {
-                max *= 2;
-                follow *temp = (follow *)realloc(f, sizeof(follow) * max);
-
-                if (temp == NULL) {
-                  free(f);
-                  free_char_stack(matches);
-                  free_production_rhs_stack(s);
-                  return ERROR_ON_FOLLOW_CALC;
-                }
-
-                f = temp;
-              }
-
-              f[l].c = fo.c;
-              l++;
-            }
-          } else {
-            int res = find_follow(t, fft, top_lhs, start_var);
-
-            if (res != SUCCESS_ON_FOLLOW_CALC) {
-              free(f);
-              free_char_stack(matches);
-              free_production_rhs_stack(s);
-              return res;
-            }
-
-            var_follows updated_top_lhs_follows =
-                (*fft)->follows[top_lhs - PRODS_INDEX_SHIFT];
-
-            for (int i = 0; i < updated_top_lhs_follows.follows_len; i++) {
-              follow fo = updated_top_lhs_follows.follows[i];
-
-              if (check_follow_duplicate(f, l, fo.c) ==
-                  DUPLICATED_FOLLOW_FOUND) {
-                continue;
-              }
-
-              if (l == max) {
-                max *= 2;
-                follow *temp = (follow *)realloc(f, sizeof(follow) * max);
-
-                if (temp == NULL) {
-                  free(f);
-                  free_char_stack(matches);
-                  free_production_rhs_stack(s);
-                  return ERROR_ON_FOLLOW_CALC;
-                }
-
-                f = temp;
-              }
-
-              f[l].c = fo.c;
-              l++;
-            }
-          }
-        }
-      }
-    } else {
-      if (check_follow_duplicate(f, l, *next) == DUPLICATED_FOLLOW_NOT_FOUND) {
-        if (l == max) {
-          max *= 2;
-          follow *temp = (follow *)realloc(f, sizeof(follow) * max);
-
-          if (temp == NULL) {
-            free(f);
-            free_char_stack(matches);
-            free_production_rhs_stack(s);
-            return ERROR_ON_FOLLOW_CALC;
-          }
+  for (int i = 0; i < fft->prods_len; i++) {
+    production_rhs *rhs = fft->prods[i];
+    int from = symbol_index(rhs->for_var);
 
-          f = temp;
-        }
+    for (int j = 0; j < rhs->len; j++) {
+      symbol_id s = rhs->syms[j];
 
-        f[l].c = *next;
-        l++;
-      }
+      if (symbol_is_var(s) && s != rhs->for_var &&
+          ff_rhs_nullable(fft, rhs, j + 1))
+        edges[edge_offsets[from] + filled[from]++] = symbol_index(s);
     }
   }
 
-  fl->follows = f;
-  fl->follows_len = l;
-  free_char_stack(matches);
-  free_production_rhs_stack(s);
-  return SUCCESS_ON_FOLLOW_CALC;
-}
+  int head = 0;
+  int queue_len = 0;
 
-int check_first_duplicate(first *f, int f_len, char c) {
-  for (int i = 0; i < f_len; i++) {
-    if (f[i].c == c)
-      return DUPLICATED_FIRST_FOUND;
+  for (int i = 0; i < vars_len; i++) {
+    queued[i] = edge_offsets[i] != edge_offsets[i + 1];
+    if (queued[i])
+      queue[queue_len++] = i;
   }
 
-  return DUPLICATED_FIRST_NOT_FOUND;
-}
+  while (queue_len > 0) {
+    int a = queue[head];
+    head = (head + 1) % vars_len;
+    queue_len--;
+    queued[a] = 0;
+
+    bitset_word *follow_a = &fft->follow_sets[a * words];
 
-int check_follow_duplicate(follow *f, int f_len, char c) {
-  for (int i = 0; i < f_len; i++) {
-    if (f[i].c == c)
-      return DUPLICATED_FOLLOW_FOUND;
+    for (int e = edge_offsets[a]; e < edge_offsets[a + 1]; e++) {
+      int b = edges[e];
+
+      if (bitset_union(&fft->follow_sets[b * words], follow_a, words) &&
+          !queued[b]) {
+        queued[b] = 1;
+        queue[(head + queue_len) % vars_len] = b;
+        queue_len++;
+      }
+    }
   }
 
-  return DUPLICATED_FOLLOW_NOT_FOUND;
+  free(edges);
+  free(edge_offsets);
+  free(filled);
+  free(queue);
+  free(queued);
+
+  return SUCCESS_ON_FOLLOW_CALC;
 }
 
-ll1_parse_node *new_ll1_parse_node(ll1_parse_node *parent, char val,
-                                   int max_children) {
-  ll1_parse_node *n = (ll1_parse_node *)malloc(sizeof(ll1_parse_node));
+ll1_parse_node *new_ll1_parse_node(arena *a, ll1_parse_node *parent,
+                                   symbol_id val, int max_children) {
+  ll1_parse_node *n = (ll1_parse_node *)arena_alloc(a, sizeof(ll1_parse_node));
 
   if (n == NULL)
     return NULL;
 
   n->parent = parent;
-  n->c = val;
+  n->sym = val;
   n->max_children = max_children;
   n->children_len = 0;
-  n->children =
-      (ll1_parse_node **)malloc(sizeof(ll1_parse_node *) * n->max_children);
+  n->len = 0;
+  n->children = NULL;
 
-  if (n->children == NULL) {
-    free(n);
-    return NULL;
+  if (max_children > 0) {
+    n->children = (ll1_parse_node **)arena_alloc(
+        a, sizeof(ll1_parse_node *) * max_children);
+
+    if (n->children == NULL)
+      return NULL;
   }
 
   return n;
 }
 
-ll1_parse_tree *new_ll1_parse_tree(char start_var, int max_children) {
-  ll1_parse_node *root = new_ll1_parse_node(NULL, start_var, max_children);
-  if (root == NULL)
+ll1_parse_tree *new_ll1_parse_tree(symbol_id start_var) {
+  ll1_parse_tree *tree = (ll1_parse_tree *)malloc(sizeof(ll1_parse_tree));
+  if (tree == NULL)
     return NULL;
 
-  ll1_parse_tree *tree = (ll1_parse_tree *)malloc(sizeof(ll1_parse_tree));
-  if (tree == NULL) {
-    free_ll1_parse_node(root);
+  tree->node_arena = new_arena(ARENA_DEFAULT_BLOCK_SIZE);
+  if (tree->node_arena == NULL) {
+    free(tree);
     return NULL;
   }
 
-  tree->root = root;
-  tree->nodes = 1;
+  if (ll1_parse_tree_reset(tree, start_var) != PARSE_TREE_ADD_NODE_SUCCESS) {
+    free_ll1_parse_tree(tree);
+    return NULL;
+  }
 
   return tree;
 }
 
-int ll1_parse_tree_add_child(ll1_parse_tree *t, ll1_parse_node *node, char val,
-                             int max_children) {
-  ll1_parse_node *new_node = new_ll1_parse_node(node, val, max_children);
+int ll1_parse_tree_reset(ll1_parse_tree *t, symbol_id start_var) {
+  arena_reset(t->node_arena);
 
-  if (new_node == NULL)
+  t->nodes = 0;
+  t->spans = 0;
+  t->dead = 0;
+  t->root = new_ll1_parse_node(t->node_arena, NULL, start_var, 0);
+
+  if (t->root == NULL)
     return PARSE_TREE_ADD_NODE_ERROR;
 
-  if (node->children_len >= max_children - 1) {
-    node->max_children *= 2;
-    ll1_parse_node **temp = (ll1_parse_node **)realloc(
-        node->children, sizeof(ll1_parse_node *) * node->max_children);
+  t->nodes = 1;
+  return PARSE_TREE_ADD_NODE_SUCCESS;
+}
+
+int ll1_parse_node_reserve_children(ll1_parse_tree *t, ll1_parse_node *node,
+                                    int max_children) {
+  if (node->max_children - node->children_len >= max_children)
+    return PARSE_TREE_ADD_NODE_SUCCESS;
 
-    if (temp == NULL)
-      return PARSE_TREE_ADD_NODE_ERROR;
+  int new_max = node->children_len + max_children;
+  ll1_parse_node **temp = (ll1_parse_node **)arena_alloc(
+      t->node_arena, sizeof(ll1_parse_node *) * new_max);
+
+  if (temp == NULL)
+    return PARSE_TREE_ADD_NODE_ERROR;
+
+  if (node->children_len > 0)
+    memcpy(temp, node->children, sizeof(ll1_parse_node *) * node->children_len);
+
+  node->children = temp;
+  node->max_children = new_max;
+
+  return PARSE_TREE_ADD_NODE_SUCCESS;
+}
 
-    node->children = temp;
+int ll1_parse_tree_add_child(ll1_parse_tree *t, ll1_parse_node *node,
+                             symbol_id val, int max_children) {
+  if (node->children_len == node->max_children) {
+    int grow = node->max_children > 0 ? node->max_children : 1;
+
+    if (ll1_parse_node_reserve_children(t, node, grow) !=
+        PARSE_TREE_ADD_NODE_SUCCESS)
+      return PARSE_TREE_ADD_NODE_ERROR;
   }
 
+  ll1_parse_node *new_node =
+      new_ll1_parse_node(t->node_arena, node, val, max_children);
+
+  if (new_node == NULL)
+    return PARSE_TREE_ADD_NODE_ERROR;
+
   node->children[node->children_len++] = new_node;
   t->nodes++;
 
   return PARSE_TREE_ADD_NODE_SUCCESS;
 }
 
-ll1_hashmap_node *new_ll1_hashmap_node(char k, rhs_hashmap *v) {
+ll1_hashmap_node *new_ll1_hashmap_node(int k, rhs_hashmap *v) {
   ll1_hashmap_node *n = (ll1_hashmap_node *)malloc(sizeof(ll1_hashmap_node));
 
   if (n == NULL)
@@ -830,7 +1373,7 @@ ll1_hashmap *new_ll1_hashmap(int max) {
   return n;
 }
 
-rhs_hashmap_node *new_rhs_hashmap_node(char k, production_rhs *v) {
+rhs_hashmap_node *new_rhs_hashmap_node(int k, production_rhs *v) {
   rhs_hashmap_node *n = (rhs_hashmap_node *)malloc(sizeof(rhs_hashmap_node));
 
   if (n == NULL)
@@ -862,7 +1405,7 @@ rhs_hashmap *new_rhs_hashmap(int max) {
   return n;
 }
 
-int insert_into_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap *v) {
+int insert_into_ll1_hashmap(ll1_hashmap *hm, int k, rhs_hashmap *v) {
   int index = ll1_hashmap_hash_func(hm, k);
   if (index >= hm->max)
     return HASHMAP_INSERT_FAILED;
@@ -874,8 +1417,10 @@ int insert_into_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap *v) {
   ll1_hashmap_node **curr_node = &hm->nodes[index];
 
   while ((*curr_node) != NULL) {
-    if ((*curr_node)->key == k)
+    if ((*curr_node)->key == k) {
+      free(new_node);
       return HASHMAP_INSERT_DUPLICATE;
+    }
 
     curr_node = &(*curr_node)->next;
   }
@@ -885,7 +1430,7 @@ int insert_into_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap *v) {
   return HASHMAP_INSERT_SUCCESS;
 }
 
-int search_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap **output) {
+int search_ll1_hashmap(ll1_hashmap *hm, int k, rhs_hashmap **output) {
   int index = ll1_hashmap_hash_func(hm, k);
   if (index >= hm->max)
     return HASHMAP_KEY_FOUND_ERROR;
@@ -904,7 +1449,7 @@ int search_ll1_hashmap(ll1_hashmap *hm, char k, rhs_hashmap **output) {
   return HASHMAP_KEY_NOT_FOUND;
 }
 
-int insert_into_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs *v) {
+int insert_into_rhs_hashmap(rhs_hashmap *hm, int k, production_rhs *v) {
   int index = rhs_hashmap_hash_func(hm, k);
   if (index >= hm->max)
     return HASHMAP_INSERT_FAILED;
@@ -916,8 +1461,10 @@ int insert_into_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs *v) {
   rhs_hashmap_node **curr_node = &hm->nodes[index];
 
   while ((*curr_node) != NULL) {
-    if ((*curr_node)->key == k)
+    if ((*curr_node)->key == k) {
+      free(new_node);
       return HASHMAP_INSERT_DUPLICATE;
+    }
 
     curr_node = &(*curr_node)->next;
   }
@@ -927,7 +1474,7 @@ int insert_into_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs *v) {
   return HASHMAP_INSERT_SUCCESS;
 }
 
-int search_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs **output) {
+int search_rhs_hashmap(rhs_hashmap *hm, int k, production_rhs **output) {
   int index = rhs_hashmap_hash_func(hm, k);
   if (index >= hm->max)
     return HASHMAP_KEY_FOUND_ERROR;
@@ -946,273 +1493,365 @@ int search_rhs_hashmap(rhs_hashmap *hm, char k, production_rhs **output) {
   return HASHMAP_KEY_NOT_FOUND;
 }
 
-int ll1_hashmap_hash_func(ll1_hashmap *hm, char k) { return k % hm->max; }
-int rhs_hashmap_hash_func(rhs_hashmap *hm, char k) { return k % hm->max; }
+int ll1_hashmap_hash_func(ll1_hashmap *hm, int k) { return k % hm->max; }
+int rhs_hashmap_hash_func(rhs_hashmap *hm, int k) { return k % hm->max; }
 
-void print_ll1_parse_tree(ll1_parse_tree *t) {
-  if (t->root == NULL || t->nodes < 1) {
-    printf("Empty Tree\n");
+void print_ll1_parse_tree(ll1_parse_tree *t, symbol_table *s) {
+  output_buffer *o = new_output_buffer(stdout, OUTPUT_BUFFER_LEN);
+  if (o == NULL)
     return;
-  }
 
-  print_ll1_parse_node(t->root, 0);
+  write_ll1_parse_tree(o, t, s);
+  output_flush(o);
+  free_output_buffer(o);
 }
 
-void print_ll1_parse_node(ll1_parse_node *n, int level) {
-  int padding_factor = 4;
-
-  for (int i = 0; i < level; i++) {
-    for (int j = 0; j < level; j++) {
-      if (i == j)
-        printf("|-");
-    }
+int write_ll1_parse_tree(output_buffer *o, ll1_parse_tree *t,
+                         symbol_table *s) {
+  if (t->root == NULL || t->nodes < 1) {
+    output_str(o, "Empty Tree\n");
+    return OUTPUT_SUCCESS;
   }
 
-  if (n->c == EPSILON) {
-    printf("eps");
-  } else {
-    printf("%c", n->c);
-  }
+  return write_ll1_parse_node(o, t->root, s, 0);
+}
 
-  if (n->children_len == 0) {
-    printf(" --- ");
-  }
+void print_ll1_parse_stats(ll1_parse_stats *s) {
+  printf("Parse Stats:\n");
+  printf("   parses:                %ld\n", s->parses);
+  printf("   table lookups:         %ld\n", s->table_lookups);
+  printf("   terminal matches:      %ld\n", s->terminal_matches);
+  printf("   epsilon expansions:    %ld\n", s->epsilon_expansions);
+  printf("   max stack depth:       %ld\n", s->max_stack_depth);
+  printf("   nodes allocated:       %ld\n", s->nodes_allocated);
+  printf("   stack reallocs:        %ld\n", s->stack_reallocs);
+  printf("   bytes allocated:       %ld\n", s->bytes_allocated);
+}
 
-  printf("\n");
+void print_ll1_parse_node(ll1_parse_node *n, symbol_table *s, int level) {
+  output_buffer *o = new_output_buffer(stdout, OUTPUT_BUFFER_LEN);
+  if (o == NULL)
+    return;
 
-  for (int i = 0; i < n->children_len; i++)
-    print_ll1_parse_node(n->children[i], level + 1);
+  write_ll1_parse_node(o, n, s, level);
+  output_flush(o);
+  free_output_buffer(o);
 }
 
-void print_ll1_table(ll1_table *t) {
-  printf("LL1 Table:\n\n");
-  printf("      |");
+// a node still to be printed and its depth
+typedef struct ll1_print_entry {
+  ll1_parse_node *node;
+  int level;
+} ll1_print_entry;
 
-  int padding;
-  production_rhs *max_len_rhs = NULL;
+// grows indent to hold level copies of "|-"
+static char *ll1_print_indent(char *indent, int *max, int level) {
+  if (level * 2 <= *max)
+    return indent;
 
-  for (int i = 0; i < t->vars_len; i++) {
-    char var = t->vars[i];
-    rhs_hashmap *rhs_hm;
+  int m = *max;
 
-    production_rhs *curr_rhs = NULL;
+  while (m < level * 2)
+    m *= 2;
 
-    if (search_ll1_hashmap(t->table, var, &rhs_hm) ==
-        HASHMAP_KEY_FOUND_SUCCESS) {
+  char *temp = (char *)realloc(indent, m);
+  if (temp == NULL)
+    return NULL;
 
-      for (int j = 0; j < t->terminals_len + 1; j++) {
-        char terminal;
+  for (int i = *max; i < m; i++)
+    temp[i] = i % 2 == 0 ? '|' : '-';
 
-        if (j == t->terminals_len) {
-          terminal = TERMINATE_SYMBOL;
-        } else {
-          terminal = t->terminals[j];
-        }
+  *max = m;
+  return temp;
+}
 
-        if (search_rhs_hashmap(rhs_hm, terminal, &curr_rhs) ==
-            HASHMAP_KEY_FOUND_SUCCESS) {
-          if (max_len_rhs == NULL) {
-            max_len_rhs = curr_rhs;
-            continue;
-          }
+// preorder with an explicit stack, so any depth prints without recursing.
+// the stack holds the siblings still to come along the current path.
+int write_ll1_parse_node(output_buffer *o, ll1_parse_node *n, symbol_table *s,
+                         int level) {
+  int max = LL1_PRINT_STACK_LEN;
+  int indent_max = LL1_PRINT_STACK_LEN;
+  int top = 0;
+  ll1_print_entry *stack =
+      (ll1_print_entry *)malloc(sizeof(ll1_print_entry) * max);
+  char *indent = (char *)malloc(indent_max);
+  int ok = stack != NULL && indent != NULL;
+
+  if (ok) {
+    stack[0].node = n;
+    stack[0].level = level;
+
+    for (int i = 0; i < indent_max; i++)
+      indent[i] = i % 2 == 0 ? '|' : '-';
+  }
 
-          if (strlen(max_len_rhs->rhs) < strlen(curr_rhs->rhs)) {
-            max_len_rhs = curr_rhs;
-          }
-        }
+  while (ok && top >= 0) {
+    ll1_parse_node *node = stack[top].node;
+    int l = stack[top--].level;
+
+    char *temp = ll1_print_indent(indent, &indent_max, l);
+    if (temp == NULL) {
+      ok = 0;
+      continue;
+    }
+
+    indent = temp;
+    output_write(o, indent, l * 2);
+    output_str(o, symbol_name(s, node->sym));
+
+    if (node->children_len == 0)
+      output_write(o, " --- ", 5);
+
+    output_char(o, '\n');
+
+    if (top + 1 + node->children_len > max) {
+      while (top + 1 + node->children_len > max)
+        max *= 2;
+
+      ll1_print_entry *grown = (ll1_print_entry *)realloc(
+          stack, sizeof(ll1_print_entry) * max);
+      if (grown == NULL) {
+        ok = 0;
+        continue;
       }
+
+      stack = grown;
+    }
+
+    for (int i = node->children_len - 1; i >= 0; i--) {
+      top++;
+      stack[top].node = node->children[i];
+      stack[top].level = l + 1;
     }
   }
 
-  if (max_len_rhs != NULL) {
-    padding = strlen(max_len_rhs->rhs) + 1;
+  free(stack);
+  free(indent);
 
-    if (padding % 2 == 1)
-      padding++;
-  } else {
-    padding = 6;
+  return ok && !o->failed ? OUTPUT_SUCCESS : OUTPUT_ERROR;
+}
+
+// the end of input column is printed last
+static int ll1_table_print_col(ll1_table *t, int i) {
+  return i == t->cols - 1 ? LL1_END_COL : i + 1;
+}
+
+// every right hand side formatted once, text of production id is
+// texts[offsets[id]] up to offsets[id + 1]
+static char *ll1_table_rhs_texts(ll1_table *t, int *offsets) {
+  int len = 0;
+
+  for (int i = 0; i < t->prods_len; i++) {
+    offsets[i] = len;
+    len += format_production_rhs(t->symbols, t->prods[i], NULL, 0);
   }
 
-  int totalspace = padding * 2 + 1;
+  offsets[t->prods_len] = len;
 
-  for (int i = 0; i < t->terminals_len + 1; i++) {
-    char terminal;
+  char *texts = (char *)malloc(len + 1);
+  if (texts == NULL)
+    return NULL;
 
-    if (i == t->terminals_len) {
-      terminal = TERMINATE_SYMBOL;
-    } else {
-      terminal = t->terminals[i];
-    }
+  for (int i = 0; i < t->prods_len; i++)
+    format_production_rhs(t->symbols, t->prods[i], &texts[offsets[i]],
+                          offsets[i + 1] - offsets[i] + 1);
 
-    for (int j = 0; j < padding; j++) {
-      printf(" ");
-    }
+  return texts;
+}
 
-    printf("%c", terminal);
+void print_ll1_table(ll1_table *t) {
+  output_buffer *o = new_output_buffer(stdout, OUTPUT_BUFFER_LEN);
+  if (o == NULL)
+    return;
 
-    for (int j = 0; j < padding; j++) {
-      printf(" ");
-    }
+  write_ll1_table(o, t);
+  output_flush(o);
+  free_output_buffer(o);
+}
 
-    printf("|");
+int write_ll1_table(output_buffer *o, ll1_table *t) {
+  symbol_table *s = t->symbols;
+  int *offsets = (int *)malloc(sizeof(int) * (t->prods_len + 1));
+  char *texts = offsets != NULL ? ll1_table_rhs_texts(t, offsets) : NULL;
+
+  if (texts == NULL) {
+    free(offsets);
+    return OUTPUT_ERROR;
   }
 
-  for (int i = 0; i < t->vars_len; i++) {
-    printf("\n");
+  output_str(o, "LL1 Table:\n\n");
 
-    printf("    -");
-    for (int j = 0; j < t->terminals_len + 1; j++) {
-      for (int k = 0; k < totalspace + 2; k++)
-        printf("-");
-    }
+  int max_rhs_len = 0;
+  int max_cell_len = 0;
+  int max_var_len = 1;
+
+  for (int i = 0; i < t->vars_len; i++) {
+    int var_len = symbol_name_len(s, var_symbol(i));
 
-    char var = t->vars[i];
-    printf("\n");
-    printf("    ");
-    printf("%c |", var);
+    if (var_len > max_var_len)
+      max_var_len = var_len;
 
-    rhs_hashmap *rhs_hm;
-    if (search_ll1_hashmap(t->table, var, &rhs_hm) ==
-        HASHMAP_KEY_FOUND_SUCCESS) {
-      production_rhs *rhs;
+    for (int j = 0; j < t->cols; j++) {
+      int p = t->cells[i * t->cols + j];
+      if (p == LL1_NO_PRODUCTION)
+        continue;
 
-      for (int j = 0; j < t->terminals_len + 1; j++) {
-        char terminal;
+      int rhs_len = offsets[p + 1] - offsets[p];
 
-        if (j == t->terminals_len) {
-          terminal = TERMINATE_SYMBOL;
-        } else {
-          terminal = t->terminals[j];
-        }
+      if (rhs_len > max_rhs_len)
+        max_rhs_len = rhs_len;
+      if (var_len + 4 + rhs_len > max_cell_len)
+        max_cell_len = var_len + 4 + rhs_len;
+    }
+  }
 
-        if (search_rhs_hashmap(rhs_hm, terminal, &rhs) ==
-            HASHMAP_KEY_FOUND_SUCCESS) {
-          int rhs_len;
+  int padding = 6;
 
-          if (rhs->rhs[0] == EPSILON) {
-            rhs_len = 3 + 5;
-          } else {
-            rhs_len = strlen(rhs->rhs) + 5;
-          }
+  if (max_rhs_len > 0) {
+    padding = max_rhs_len + 1;
 
-          int pd = (totalspace - rhs_len);
+    if (padding % 2 == 1)
+      padding++;
+  }
 
-          for (int k = 0; k < pd / 2; k++)
-            printf(" ");
+  int totalspace = padding * 2 + 1;
 
-          if (rhs->rhs[0] == EPSILON) {
-            printf("%c -> eps", var);
-          } else {
-            printf("%c -> %s", var, rhs->rhs);
-          }
+  if (totalspace < max_cell_len)
+    totalspace = max_cell_len;
 
-          for (int k = 0; k < pd / 2; k++)
-            printf(" ");
+  output_fill(o, ' ', max_var_len + 5);
+  output_char(o, '|');
 
-          if (pd % 2 == 1) {
-            printf(" ");
-          }
+  for (int i = 0; i < t->cols; i++) {
+    symbol_id terminal = terminal_symbol(ll1_table_print_col(t, i));
+    int name_len = symbol_name_len(s, terminal);
+    int pd = totalspace - name_len;
 
-          printf("|");
-        } else {
-          for (int k = 0; k < totalspace; k++)
-            printf(" ");
+    output_fill(o, ' ', pd / 2);
+    output_write(o, symbol_name(s, terminal), name_len);
+    output_fill(o, ' ', pd - pd / 2);
+    output_char(o, '|');
+  }
 
-          printf("|");
-        }
+  for (int i = 0; i < t->vars_len; i++) {
+    symbol_id var = var_symbol(i);
+    const char *var_name = symbol_name(s, var);
+    int var_len = symbol_name_len(s, var);
+
+    output_str(o, "\n    -");
+    output_fill(o, '-', t->cols * (totalspace + 2));
+    output_str(o, "\n    ");
+    output_fill(o, ' ', max_var_len - var_len);
+    output_write(o, var_name, var_len);
+    output_write(o, " |", 2);
+
+    for (int j = 0; j < t->cols; j++) {
+      int p = t->cells[i * t->cols + ll1_table_print_col(t, j)];
+
+      if (p == LL1_NO_PRODUCTION) {
+        output_fill(o, ' ', totalspace);
+        output_char(o, '|');
+        continue;
       }
+
+      int rhs_len = offsets[p + 1] - offsets[p];
+      int pd = totalspace - (var_len + 4 + rhs_len);
+
+      output_fill(o, ' ', pd / 2);
+      output_write(o, var_name, var_len);
+      output_write(o, " -> ", 4);
+      output_write(o, &texts[offsets[p]], rhs_len);
+      output_fill(o, ' ', pd - pd / 2);
+      output_char(o, '|');
     }
   }
 
-  printf("\n");
+  output_char(o, '\n');
+
+  free(offsets);
+  free(texts);
+
+  return o->failed ? OUTPUT_ERROR : OUTPUT_SUCCESS;
 }
 
-void print_ff_table(ff_table *t) {
-  printf("FF Table:\n");
-  printf("   Firsts:\n");
+// writes the set members by name, the end of input marker last
+static void write_ff_set(output_buffer *o, symbol_table *s, bitset_word *set,
+                         int terminals_len, int nullable) {
+  int first = 1;
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    var_firsts fr = t->firsts[i];
+  for (int i = 1; i <= terminals_len; i++) {
+    int index = i == terminals_len ? 0 : i;
 
-    if (fr.var != '\0' && fr.firsts != NULL) {
-      printf("      %c = {", fr.var);
+    if (!bitset_test(set, index))
+      continue;
 
-      for (int j = 0; j < fr.firsts_len; j++) {
-        first f = fr.firsts[j];
+    if (!first)
+      output_char(o, ',');
 
-        if (j == fr.firsts_len - 1) {
-          if (f.c == EPSILON) {
-            printf("epsilon");
-          } else {
-            printf("%c", f.c);
-          }
-        } else {
-          if (f.c == EPSILON) {
-            printf("epsilon,");
-          } else {
-            printf("%c,", f.c);
-          }
-        }
-      }
-      printf("}");
-      printf("\n");
-    }
+    output_write(o, symbol_name(s, terminal_symbol(index)),
+                 symbol_name_len(s, terminal_symbol(index)));
+    first = 0;
   }
 
-  printf("\n");
-  printf("   Follows:\n");
+  if (nullable)
+    output_str(o, first ? "epsilon" : ",epsilon");
+}
 
-  for (int i = 0; i < MAX_PRODS; i++) {
-    var_follows fl = t->follows[i];
+static void write_ff_sets(output_buffer *o, ff_table *t, int follows) {
+  for (int i = 0; i < t->vars_len; i++) {
+    symbol_id var = var_symbol(i);
 
-    if (fl.var != '\0' && fl.follows != NULL) {
-      printf("      %c = {", fl.var);
+    output_str(o, "      ");
+    output_write(o, symbol_name(t->symbols, var),
+                 symbol_name_len(t->symbols, var));
+    output_str(o, " = {");
 
-      for (int j = 0; j < fl.follows_len; j++) {
-        follow f = fl.follows[j];
+    if (follows)
+      write_ff_set(o, t->symbols, ff_follow_set(t, var), t->terminals_len, 0);
+    else
+      write_ff_set(o, t->symbols, ff_first_set(t, var), t->terminals_len,
+                   t->nullable[i]);
 
-        if (j == fl.follows_len - 1) {
-          if (f.c == EPSILON) {
-            printf("epsilon");
-          } else {
-            printf("%c", f.c);
-          }
-        } else {
-          if (f.c == EPSILON) {
-            printf("epsilon,");
-          } else {
-            printf("%c,", f.c);
-          }
-        }
-      }
-      printf("}");
-      printf("\n");
-    }
+    output_str(o, "}\n");
   }
 }
 
-void print_ll1_hashmap_node(ll1_hashmap_node *n) {
-  printf("      %c: \n", n->key);
+void print_ff_table(ff_table *t) {
+  output_buffer *o = new_output_buffer(stdout, OUTPUT_BUFFER_LEN);
+  if (o == NULL)
+    return;
+
+  write_ff_table(o, t);
+  output_flush(o);
+  free_output_buffer(o);
+}
+
+int write_ff_table(output_buffer *o, ff_table *t) {
+  output_str(o, "FF Table:\n   Firsts:\n");
+  write_ff_sets(o, t, 0);
+  output_str(o, "\n   Follows:\n");
+  write_ff_sets(o, t, 1);
+
+  return o->failed ? OUTPUT_ERROR : OUTPUT_SUCCESS;
+}
+
+void print_ll1_hashmap_node(ll1_hashmap_node *n, symbol_table *s) {
+  printf("      %s: \n", symbol_name(s, var_symbol(n->key)));
   rhs_hashmap *hm = n->data;
 
   for (int i = 0; i < hm->max; i++) {
     rhs_hashmap_node *curr_node = hm->nodes[i];
 
     while (curr_node != NULL) {
-      printf("         %c: ", curr_node->key);
-      production p;
-      p.var = curr_node->data->for_var;
-      p.first_rhs = curr_node->data;
-      p.first_rhs->next = NULL;
-      p.len = 1;
-      print_production(p, 0);
+      printf("   ");
+      print_rhs_hashmap_node(curr_node, s);
       printf("\n");
       curr_node = curr_node->next;
     }
   }
 }
 
-void print_ll1_hashmap(ll1_hashmap *hm) {
+void print_ll1_hashmap(ll1_hashmap *hm, symbol_table *s) {
   printf("LL1 Hashmap:\n");
   printf("   Nodes:\n");
 
@@ -1220,24 +1859,22 @@ void print_ll1_hashmap(ll1_hashmap *hm) {
     ll1_hashmap_node *curr_node = hm->nodes[i];
 
     while (curr_node != NULL) {
-      print_ll1_hashmap_node(curr_node);
+      print_ll1_hashmap_node(curr_node, s);
       printf("\n");
       curr_node = curr_node->next;
     }
   }
 }
 
-void print_rhs_hashmap_node(rhs_hashmap_node *n) {
-  printf("      %c: ", n->key);
-  production p;
-  p.var = n->data->for_var;
-  p.first_rhs = n->data;
-  p.first_rhs->next = NULL;
-  p.len = 1;
-  print_production(p, 0);
+void print_rhs_hashmap_node(rhs_hashmap_node *n, symbol_table *s) {
+  char buff[256];
+
+  format_production_rhs(s, n->data, buff, sizeof(buff));
+  printf("      %s: %s -> %s", symbol_name(s, terminal_symbol(n->key)),
+         symbol_name(s, n->data->for_var), buff);
 }
 
-void print_rhs_hashmap(rhs_hashmap *hm) {
+void print_rhs_hashmap(rhs_hashmap *hm, symbol_table *s) {
   printf("RHS Hashmap:\n");
   printf("   Nodes:\n");
 
@@ -1245,53 +1882,36 @@ void print_rhs_hashmap(rhs_hashmap *hm) {
     rhs_hashmap_node *curr_node = hm->nodes[i];
 
     while (curr_node != NULL) {
-      print_rhs_hashmap_node(curr_node);
+      print_rhs_hashmap_node(curr_node, s);
       printf("\n");
       curr_node = curr_node->next;
     }
   }
 }
 
-void free_ll1_parse_node(ll1_parse_node *n) {
-  if (n == NULL)
-    return;
-
-  for (int i = 0; i < n->children_len; i++) {
-    free_ll1_parse_node(n->children[i]);
-  }
-
-  free(n->children);
-  free(n);
-}
-
 void free_ll1_parse_tree(ll1_parse_tree *t) {
-  free_ll1_parse_node(t->root);
+  free_arena(t->node_arena);
   free(t);
 }
 
 void free_ll1_table(ll1_table *t) {
-  free_ll1_hashmap(t->table);
-  free(t->terminals);
-  free(t->vars);
+  if (t->table != NULL)
+    free_ll1_hashmap(t->table);
+  free(t->cells);
+  free(t->prods);
+  free(t->prod_offsets);
+  free(t->prod_syms);
   free(t);
 }
 
 void free_ff_table(ff_table *t) {
-  for (int i = 0; i < MAX_PRODS; i++) {
-    var_firsts fr = t->firsts[i];
-    var_follows fl = t->follows[i];
-
-    if (fr.var != '\0' && fr.firsts != NULL) {
-      free(fr.firsts);
-    }
-
-    if (fl.var != '\0' && fl.follows != NULL) {
-      free(fl.follows);
-    }
-  }
-
-  free(t->firsts);
-  free(t->follows);
+  free(t->prods);
+  free(t->nullable);
+  free(t->first_sets);
+  free(t->follow_sets);
+  free(t->suffix_offsets);
+  free(t->suffix_nullable);
+  free(t->suffix_firsts);
   free(t);
 }
 
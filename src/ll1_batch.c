@@ -0,0 +1,383 @@
+#include "../include/ll1.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LL1_BATCH_HAS_AVX2 1
+#endif
+
+// lockstep recognizer, every lane runs its own parser stack over its own
+// string and all lanes take one step at a time. finished and failed lanes are
+// refilled with the next string so the lanes stay busy.
+//
+// the input of a window of strings is mapped to table columns up front, every
+// string followed by the end column, so a lane's lookahead is a single gather.
+// bytes that are no terminal map to an extra column that has no productions.
+
+typedef struct ll1_batch_lanes {
+  int top[LL1_BATCH_LANES];
+  int pos[LL1_BATCH_LANES];
+  int base[LL1_BATCH_LANES];
+  int active[LL1_BATCH_LANES];
+  int fail[LL1_BATCH_LANES];
+  int string[LL1_BATCH_LANES];
+} ll1_batch_lanes;
+
+// right hand sides are padded to rhs_width so a push is a fixed number of
+// full vector stores, prod_lens[LL1_NO_PRODUCTION + 1] is a zero length
+// production used by lanes that do not expand this step.
+typedef struct ll1_batch_table {
+  int cols;
+  int stride;
+  int end_col;
+  int invalid_col;
+  int rhs_width;
+  int *cells;
+  int *prod_lens;
+  int *prod_syms;
+} ll1_batch_table;
+
+// every lane pops its top symbol, matches it or pushes the predicted right
+// hand side. returns a mask of the lanes that failed, emptied their stack or
+// came close to overflowing it, those are left to the caller.
+static int ll1_batch_step_scalar(ll1_batch_lanes *l, int *stacks,
+                                 const int *colbuf, const ll1_batch_table *bt) {
+  int attention = 0;
+
+  for (int k = 0; k < LL1_BATCH_LANES; k++) {
+    l->fail[k] = 0;
+
+    if (!l->active[k])
+      continue;
+
+    int sym = stacks[l->top[k]];
+    int col = colbuf[l->pos[k]];
+
+    l->top[k]--;
+
+    if (sym < bt->cols) {
+      if (sym == col)
+        l->pos[k]++;
+      else
+        l->fail[k] = -1;
+    } else {
+      int cell = bt->cells[(sym - bt->cols) * bt->stride + col];
+
+      if (cell < 0) {
+        l->fail[k] = -1;
+      } else {
+        const int *rhs = &bt->prod_syms[(cell + 1) * bt->rhs_width];
+
+        for (int j = 0; j < bt->rhs_width; j++)
+          stacks[l->top[k] + 1 + j] = rhs[j];
+
+        l->top[k] += bt->prod_lens[cell + 1];
+      }
+    }
+
+    if (l->fail[k] || l->top[k] < l->base[k] ||
+        l->top[k] + bt->rhs_width >= l->base[k] + LL1_BATCH_STACK_LEN)
+      attention |= 1 << k;
+  }
+
+  return attention;
+}
+
+#ifdef LL1_BATCH_HAS_AVX2
+__attribute__((target("avx2"))) static int
+ll1_batch_step_avx2(ll1_batch_lanes *l, int *stacks, const int *colbuf,
+                    const ll1_batch_table *bt) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i none = _mm256_set1_epi32(LL1_NO_PRODUCTION);
+  __m256i cols = _mm256_set1_epi32(bt->cols);
+
+  __m256i active = _mm256_loadu_si256((__m256i *)l->active);
+  __m256i top = _mm256_loadu_si256((__m256i *)l->top);
+  __m256i pos = _mm256_loadu_si256((__m256i *)l->pos);
+  __m256i base = _mm256_loadu_si256((__m256i *)l->base);
+
+  __m256i sym = _mm256_mask_i32gather_epi32(zero, stacks, top, active, 4);
+  __m256i col = _mm256_mask_i32gather_epi32(zero, colbuf, pos, active, 4);
+
+  __m256i is_var =
+      _mm256_and_si256(_mm256_cmpgt_epi32(sym, _mm256_sub_epi32(cols, one)),
+                       active);
+  __m256i is_term = _mm256_andnot_si256(is_var, active);
+  __m256i match = _mm256_and_si256(is_term, _mm256_cmpeq_epi32(sym, col));
+
+  __m256i index = _mm256_add_epi32(
+      _mm256_mullo_epi32(_mm256_sub_epi32(sym, cols),
+                         _mm256_set1_epi32(bt->stride)),
+      col);
+  __m256i cell = _mm256_mask_i32gather_epi32(none, bt->cells, index, is_var, 4);
+
+  __m256i fail = _mm256_or_si256(
+      _mm256_andnot_si256(match, is_term),
+      _mm256_and_si256(is_var, _mm256_cmpgt_epi32(zero, cell)));
+
+  // failed lanes push the empty production
+  cell = _mm256_blendv_epi8(cell, none, fail);
+  __m256i slot = _mm256_add_epi32(cell, one);
+  __m256i len = _mm256_i32gather_epi32(bt->prod_lens, slot, 4);
+
+  top = _mm256_sub_epi32(top, _mm256_and_si256(active, one));
+  pos = _mm256_add_epi32(pos, _mm256_and_si256(match, one));
+
+  int tops[LL1_BATCH_LANES];
+  int slots[LL1_BATCH_LANES];
+  _mm256_storeu_si256((__m256i *)tops, top);
+  _mm256_storeu_si256((__m256i *)slots, slot);
+
+  // idle lanes store nothing, their top is not kept inside their region
+  for (int k = 0; k < LL1_BATCH_LANES; k++) {
+    if (!l->active[k])
+      continue;
+
+    const int *rhs = &bt->prod_syms[slots[k] * bt->rhs_width];
+    int *dst = &stacks[tops[k] + 1];
+
+    for (int j = 0; j < bt->rhs_width; j += 8)
+      _mm256_storeu_si256((__m256i *)(dst + j),
+                          _mm256_loadu_si256((const __m256i *)(rhs + j)));
+  }
+
+  top = _mm256_add_epi32(top, _mm256_and_si256(active, len));
+
+  __m256i limit = _mm256_add_epi32(
+      base, _mm256_set1_epi32(LL1_BATCH_STACK_LEN - bt->rhs_width - 1));
+  __m256i attention = _mm256_or_si256(
+      fail, _mm256_or_si256(_mm256_cmpgt_epi32(base, top),
+                            _mm256_cmpgt_epi32(top, limit)));
+  attention = _mm256_and_si256(attention, active);
+
+  _mm256_storeu_si256((__m256i *)l->top, top);
+  _mm256_storeu_si256((__m256i *)l->pos, pos);
+  _mm256_storeu_si256((__m256i *)l->fail, fail);
+
+  return _mm256_movemask_ps(_mm256_castsi256_ps(attention));
+}
+#endif
+
+static int new_ll1_batch_table(ll1_table *t, ll1_batch_table *bt) {
+  bt->cols = t->cols;
+  bt->stride = t->cols + 1;
+  bt->end_col = LL1_END_COL;
+  bt->invalid_col = t->cols;
+  bt->rhs_width = 8;
+
+  for (int i = 0; i < t->prods_len; i++) {
+    while (t->prod_offsets[i + 1] - t->prod_offsets[i] > bt->rhs_width)
+      bt->rhs_width += 8;
+  }
+
+  bt->cells = (int *)malloc(sizeof(int) * t->vars_len * bt->stride);
+  bt->prod_lens = (int *)malloc(sizeof(int) * (t->prods_len + 1));
+  bt->prod_syms =
+      (int *)malloc(sizeof(int) * (t->prods_len + 1) * bt->rhs_width);
+
+  if (bt->cells == NULL || bt->prod_lens == NULL || bt->prod_syms == NULL) {
+    free(bt->cells);
+    free(bt->prod_lens);
+    free(bt->prod_syms);
+    return -1;
+  }
+
+  for (int i = 0; i < t->vars_len; i++) {
+    for (int j = 0; j < t->cols; j++)
+      bt->cells[i * bt->stride + j] = t->cells[i * t->cols + j];
+
+    bt->cells[i * bt->stride + bt->invalid_col] = LL1_NO_PRODUCTION;
+  }
+
+  memset(bt->prod_syms, 0,
+         sizeof(int) * (t->prods_len + 1) * bt->rhs_width);
+  bt->prod_lens[0] = 0;
+
+  for (int i = 0; i < t->prods_len; i++) {
+    int from = t->prod_offsets[i];
+    int len = t->prod_offsets[i + 1] - from;
+
+    bt->prod_lens[i + 1] = len;
+    for (int j = 0; j < len; j++)
+      bt->prod_syms[(i + 1) * bt->rhs_width + j] = t->prod_syms[from + j];
+  }
+
+  return 0;
+}
+
+static void free_ll1_batch_table(ll1_batch_table *bt) {
+  free(bt->cells);
+  free(bt->prod_lens);
+  free(bt->prod_syms);
+}
+
+static int map_ll1_batch_window(ll1_table *t, const ll1_batch_table *bt,
+                                const char **strs, const int *str_lens,
+                                int from, int count, int **colbuf,
+                                int *colbuf_max, int *offsets) {
+  int used = 0;
+  int i = from;
+
+  while (i < count) {
+    int need = used + str_lens[i] + 1;
+
+    if (i > from && need > LL1_BATCH_WINDOW_LEN)
+      break;
+
+    if (need > *colbuf_max) {
+      int *temp = (int *)realloc(*colbuf, sizeof(int) * need);
+      if (temp == NULL)
+        return -1;
+
+      *colbuf = temp;
+      *colbuf_max = need;
+    }
+
+    int *out = *colbuf + used;
+    const char *str = strs[i];
+
+    for (int j = 0; j < str_lens[i]; j++) {
+      int col = t->terminal_cols[(unsigned char)str[j]];
+      out[j] = (col == LL1_NO_INDEX || col == bt->end_col) ? bt->invalid_col
+                                                           : col;
+    }
+
+    out[str_lens[i]] = bt->end_col;
+    offsets[i - from] = used;
+    used = need;
+    i++;
+  }
+
+  return i;
+}
+
+int ll1_recognize_batch(ll1_table *table, symbol_id start_var,
+                        const char **strs, const int *str_lens, int count,
+                        unsigned char *accepted) {
+  if (table == NULL || strs == NULL || str_lens == NULL || accepted == NULL ||
+      count < 0)
+    return STRING_RECOGNIZE_ERROR;
+
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= table->vars_len)
+    return STRING_RECOGNIZE_ERROR;
+
+  int start_row = symbol_index(start_var);
+
+  for (int i = 0; i < count; i++) {
+    if (str_lens[i] < 0 || (strs[i] == NULL && str_lens[i] != 0))
+      return STRING_RECOGNIZE_ERROR;
+  }
+
+  memset(accepted, 0, (count + 7) / 8);
+
+  ll1_batch_table bt;
+  if (new_ll1_batch_table(table, &bt) != 0)
+    return STRING_RECOGNIZE_ERROR;
+
+  int *stacks =
+      (int *)malloc(sizeof(int) * LL1_BATCH_LANES * LL1_BATCH_STACK_LEN);
+  int *offsets = (int *)malloc(sizeof(int) * LL1_BATCH_WINDOW_LEN);
+  int *colbuf = NULL;
+  int colbuf_max = 0;
+
+  if (stacks == NULL || offsets == NULL) {
+    free(stacks);
+    free(offsets);
+    free_ll1_batch_table(&bt);
+    return STRING_RECOGNIZE_ERROR;
+  }
+
+  int (*step)(ll1_batch_lanes *, int *, const int *,
+              const ll1_batch_table *) = ll1_batch_step_scalar;
+
+#ifdef LL1_BATCH_HAS_AVX2
+  if (__builtin_cpu_supports("avx2"))
+    step = ll1_batch_step_avx2;
+#endif
+
+  ll1_batch_lanes l;
+  for (int k = 0; k < LL1_BATCH_LANES; k++) {
+    l.active[k] = 0;
+    l.base[k] = k * LL1_BATCH_STACK_LEN;
+    l.top[k] = l.base[k] - 1;
+    l.pos[k] = 0;
+  }
+
+  int accepted_len = 0;
+  int window_from = 0;
+  int window_to = 0;
+  int next = 0;
+  int idle = LL1_BATCH_LANES;
+
+  while (1) {
+    if (idle > 0) {
+      for (int k = 0; k < LL1_BATCH_LANES && next < window_to; k++) {
+        if (l.active[k])
+          continue;
+
+        stacks[l.base[k]] = bt.cols + start_row;
+        l.top[k] = l.base[k];
+        l.pos[k] = offsets[next - window_from];
+        l.string[k] = next++;
+        l.active[k] = -1;
+        idle--;
+      }
+
+      if (idle == LL1_BATCH_LANES) {
+        if (next == count)
+          break;
+
+        window_from = next;
+        window_to = map_ll1_batch_window(table, &bt, strs, str_lens, next,
+                                         count, &colbuf, &colbuf_max, offsets);
+        if (window_to < 0) {
+          accepted_len = STRING_RECOGNIZE_ERROR;
+          break;
+        }
+        continue;
+      }
+    }
+
+    int attention = step(&l, stacks, colbuf, &bt);
+
+    while (attention != 0) {
+      int k = __builtin_ctz(attention);
+      int s = l.string[k];
+      attention &= attention - 1;
+
+      if (l.fail[k]) {
+        l.active[k] = 0;
+        idle++;
+        continue;
+      }
+
+      if (l.top[k] < l.base[k]) {
+        if (colbuf[l.pos[k]] == bt.end_col) {
+          accepted[s / 8] |= 1 << (s % 8);
+          accepted_len++;
+        }
+
+        l.active[k] = 0;
+        idle++;
+        continue;
+      }
+
+      // too deep for the lane, leave this one to the scalar recognizer
+      if (ll1_recognize(table, start_var, strs[s], str_lens[s]) ==
+          STRING_RECOGNIZE_SUCCESS) {
+        accepted[s / 8] |= 1 << (s % 8);
+        accepted_len++;
+      }
+
+      l.active[k] = 0;
+      idle++;
+    }
+  }
+
+  free(colbuf);
+  free(stacks);
+  free(offsets);
+  free_ll1_batch_table(&bt);
+
+  return accepted_len;
+}
@@ -0,0 +1,393 @@
+#include "../include/ll1_codegen.h"
+#include <ctype.h>
+
+static int codegen_prefix_ok(const char *prefix) {
+  int len = strlen(prefix);
+
+  if (len == 0 || len >= LL1_CODEGEN_PREFIX_LEN ||
+      !(isalpha((unsigned char)prefix[0]) || prefix[0] == '_'))
+    return 0;
+
+  for (int i = 1; i < len; i++) {
+    if (!(isalnum((unsigned char)prefix[i]) || prefix[i] == '_'))
+      return 0;
+  }
+
+  return 1;
+}
+
+// names go into // comments, so anything that could end the line or splice
+// it with the next one is replaced
+static void codegen_print_name(FILE *out, symbol_table *s, symbol_id sym) {
+  const char *name = symbol_name(s, sym);
+  int len = symbol_name_len(s, sym);
+
+  for (int i = 0; i < len; i++) {
+    unsigned char c = name[i];
+    fputc(isprint(c) && c != '\\' ? c : '?', out);
+  }
+}
+
+static void codegen_print_rhs(FILE *out, symbol_table *s,
+                              production_rhs *rhs) {
+  codegen_print_name(out, s, rhs->for_var);
+  fprintf(out, " ->");
+
+  if (rhs->len == 0)
+    fprintf(out, " eps");
+
+  for (int i = 0; i < rhs->len; i++) {
+    fputc(' ', out);
+    codegen_print_name(out, s, rhs->syms[i]);
+  }
+}
+
+static void codegen_print_helpers(FILE *out, ll1_table *t, const char *p,
+                                  int has_match, int has_epsilon) {
+  fprintf(out,
+          "static int %s_col(%s_state *s) {\n"
+          "  if (s->i >= s->len)\n"
+          "    return LL1_END_COL;\n"
+          "\n"
+          "  if (s->str != NULL)\n"
+          "    return %s_byte_cols[(unsigned char)s->str[s->i]];\n"
+          "\n"
+          "  int token = s->tokens[s->i];\n"
+          "  return token > LL1_END_COL && token < %d ? token : "
+          "LL1_NO_INDEX;\n"
+          "}\n\n",
+          p, p, p, t->cols);
+
+  if (has_match) {
+    fprintf(out,
+            "static int %s_match(%s_state *s, int col) {\n"
+            "  if (s->i >= s->len || %s_col(s) != col)\n"
+            "    return STRING_PARSE_ERROR;\n"
+            "\n"
+            "  s->i++;\n"
+            "  return STRING_PARSE_SUCCESS;\n"
+            "}\n\n",
+            p, p, p);
+  }
+
+  if (has_epsilon) {
+    fprintf(out,
+            "static int %s_epsilon(%s_state *s, ll1_parse_node *n) {\n"
+            "  if (s->tree != NULL &&\n"
+            "      ll1_parse_tree_add_child(s->tree, n, SYMBOL_EPSILON, 0) "
+            "!=\n"
+            "          PARSE_TREE_ADD_NODE_SUCCESS)\n"
+            "    return STRING_PARSE_ERROR;\n"
+            "\n"
+            "  return STRING_PARSE_SUCCESS;\n"
+            "}\n\n",
+            p, p);
+  }
+
+  fprintf(out,
+          "static int %s_expand(%s_state *s, ll1_parse_node *n,\n"
+          "%*sconst symbol_id *syms, int len) {\n"
+          "  if (s->tree == NULL)\n"
+          "    return STRING_PARSE_SUCCESS;\n"
+          "\n"
+          "  if (ll1_parse_node_reserve_children(s->tree, n, len) !=\n"
+          "      PARSE_TREE_ADD_NODE_SUCCESS)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  for (int i = 0; i < len; i++) {\n"
+          "    if (ll1_parse_tree_add_child(s->tree, n, syms[i], 0) !=\n"
+          "        PARSE_TREE_ADD_NODE_SUCCESS)\n"
+          "      return STRING_PARSE_ERROR;\n"
+          "  }\n"
+          "\n"
+          "  return STRING_PARSE_SUCCESS;\n"
+          "}\n\n"
+          "static ll1_parse_node *%s_child(ll1_parse_node *n, int i) {\n"
+          "  return n != NULL ? n->children[i] : NULL;\n"
+          "}\n\n",
+          p, p, (int)strlen(p) + 19, "", p);
+}
+
+// the body of one case, the symbols are matched or descended into left to
+// right and the last one is returned from directly so the C compiler can
+// turn it into a tail call. a variable ending its own right hand side
+// continues the enclosing loop instead.
+static void codegen_print_case(FILE *out, const char *p, production_rhs *rhs,
+                               int indent) {
+  symbol_id var = rhs->for_var;
+
+  if (rhs->len == 0) {
+    fprintf(out, "%*sreturn %s_epsilon(s, n);\n", indent, "", p);
+    return;
+  }
+
+  fprintf(out,
+          "%*sif (%s_expand(s, n, %s_rhs_%d, %d) != STRING_PARSE_SUCCESS)\n"
+          "%*s  return STRING_PARSE_ERROR;\n",
+          indent, "", p, p, rhs->id, rhs->len, indent, "");
+
+  for (int i = 0; i < rhs->len; i++) {
+    symbol_id sym = rhs->syms[i];
+    int last = i == rhs->len - 1;
+
+    if (symbol_is_terminal(sym)) {
+      if (last)
+        fprintf(out, "%*sreturn %s_match(s, %d);\n", indent, "", p,
+                symbol_index(sym));
+      else
+        fprintf(out,
+                "%*sif (%s_match(s, %d) != STRING_PARSE_SUCCESS)\n"
+                "%*s  return STRING_PARSE_ERROR;\n",
+                indent, "", p, symbol_index(sym), indent, "");
+      continue;
+    }
+
+    if (last && sym == var) {
+      fprintf(out, "%*sn = %s_child(n, %d);\n%*scontinue;\n", indent, "", p,
+              i, indent, "");
+    } else if (last) {
+      fprintf(out, "%*sreturn %s_parse_v%d(s, %s_child(n, %d), depth + 1);\n",
+              indent, "", p, symbol_index(sym), p, i);
+    } else {
+      fprintf(out,
+              "%*sif (%s_parse_v%d(s, %s_child(n, %d), depth + 1) !=\n"
+              "%*s    STRING_PARSE_SUCCESS)\n"
+              "%*s  return STRING_PARSE_ERROR;\n",
+              indent, "", p, symbol_index(sym), p, i, indent, "", indent, "");
+    }
+  }
+}
+
+static int codegen_var_loops(ll1_table *t, int row) {
+  symbol_id var = var_symbol(row);
+
+  for (int i = 0; i < t->prods_len; i++) {
+    production_rhs *rhs = t->prods[i];
+
+    if (rhs->for_var == var && rhs->len > 0 && rhs->syms[rhs->len - 1] == var)
+      return 1;
+  }
+
+  return 0;
+}
+
+static void codegen_print_var(FILE *out, ll1_table *t, const char *p,
+                              const char *up, int row) {
+  int *cells = &t->cells[row * t->cols];
+  int loops = codegen_var_loops(t, row);
+  int indent = loops ? 4 : 2;
+
+  fprintf(out, "// ");
+  codegen_print_name(out, t->symbols, var_symbol(row));
+  fprintf(out,
+          "\n"
+          "static int %s_parse_v%d(%s_state *s, ll1_parse_node *n, int depth) "
+          "{\n"
+          "  if (depth > %s_MAX_DEPTH) {\n"
+          "    s->too_deep = 1;\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "  }\n"
+          "\n",
+          p, row, p, up);
+
+  if (loops)
+    fprintf(out, "  for (;;) {\n");
+
+  fprintf(out, "%*sswitch (%s_col(s)) {\n", indent, "", p);
+
+  // columns predicting the same production share one case
+  for (int c = 0; c < t->cols; c++) {
+    int prod = cells[c];
+    int seen = 0;
+
+    for (int k = 0; k < c && !seen; k++)
+      seen = cells[k] == prod;
+
+    if (prod == LL1_NO_PRODUCTION || seen)
+      continue;
+
+    for (int k = c; k < t->cols; k++) {
+      if (cells[k] != prod)
+        continue;
+
+      fprintf(out, "%*scase %d: // ", indent, "", k);
+      if (k == LL1_END_COL)
+        fprintf(out, "$");
+      else
+        codegen_print_name(out, t->symbols, terminal_symbol(k));
+      fprintf(out, "\n");
+    }
+
+    fprintf(out, "%*s  // ", indent, "");
+    codegen_print_rhs(out, t->symbols, t->prods[prod]);
+    fprintf(out, "\n");
+    codegen_print_case(out, p, t->prods[prod], indent + 2);
+  }
+
+  fprintf(out,
+          "%*sdefault:\n"
+          "%*s  return STRING_PARSE_ERROR;\n"
+          "%*s}\n",
+          indent, "", indent, "", indent, "");
+
+  if (loops)
+    fprintf(out, "  }\n");
+
+  fprintf(out, "}\n\n");
+}
+
+static void codegen_print_entries(FILE *out, const char *p, int start_row,
+                                  symbol_id start_var) {
+  fprintf(out,
+          "static int %s_parse(%s_state *s) {\n"
+          "  ll1_parse_node *root = s->tree != NULL ? s->tree->root : NULL;\n"
+          "\n"
+          "  if (%s_parse_v%d(s, root, 0) != STRING_PARSE_SUCCESS || "
+          "s->i < s->len)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  return STRING_PARSE_SUCCESS;\n"
+          "}\n\n",
+          p, p, p, start_row);
+
+  fprintf(out,
+          "int %s_parse_string(ll1_parse_tree *tree, const char *str,\n"
+          "                    int str_len) {\n"
+          "  if (str_len == 0 || str == NULL || tree == NULL)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  if (ll1_parse_tree_reset(tree, 0x%08xu) != "
+          "PARSE_TREE_ADD_NODE_SUCCESS)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  %s_state s = {str, NULL, str_len, 0, tree, 0};\n"
+          "  return %s_parse(&s);\n"
+          "}\n\n",
+          p, start_var, p, p);
+
+  fprintf(out,
+          "int %s_parse_tokens(ll1_parse_tree *tree, const int *tokens,\n"
+          "                    int tokens_len) {\n"
+          "  if (tokens_len == 0 || tokens == NULL || tree == NULL)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  if (ll1_parse_tree_reset(tree, 0x%08xu) != "
+          "PARSE_TREE_ADD_NODE_SUCCESS)\n"
+          "    return STRING_PARSE_ERROR;\n"
+          "\n"
+          "  %s_state s = {NULL, tokens, tokens_len, 0, tree, 0};\n"
+          "  return %s_parse(&s);\n"
+          "}\n\n",
+          p, start_var, p, p);
+
+  fprintf(out,
+          "int %s_recognize(const char *str, int str_len) {\n"
+          "  %s_state s = {str, NULL, str_len, 0, NULL, 0};\n"
+          "\n"
+          "  if (%s_parse(&s) != STRING_PARSE_SUCCESS)\n"
+          "    return s.too_deep ? STRING_RECOGNIZE_ERROR : s.i;\n"
+          "\n"
+          "  return STRING_RECOGNIZE_SUCCESS;\n"
+          "}\n",
+          p, p, p);
+}
+
+// one function per variable switching on the lookahead column, the file only
+// needs ll1.h. the entry points return the same codes and build the same
+// trees as fill_parse_tree_with_string, fill_parse_tree_with_tokens and
+// ll1_recognize. nesting deeper than <PREFIX>_MAX_DEPTH fails the parse
+// instead of overflowing the C stack, <prefix>_recognize then returns
+// STRING_RECOGNIZE_ERROR rather than an offset so a resource limit is not
+// taken for a syntax error. a variable ending its own right hand side (list
+// tails) loops instead of recursing.
+int ll1_generate_parser(FILE *out, ll1_table *t, symbol_id start_var,
+                        const char *prefix) {
+  if (out == NULL || t == NULL || prefix == NULL || !codegen_prefix_ok(prefix))
+    return LL1_CODEGEN_ERROR;
+
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= t->vars_len)
+    return LL1_CODEGEN_ERROR;
+
+  char up[LL1_CODEGEN_PREFIX_LEN];
+  int prefix_len = strlen(prefix);
+
+  for (int i = 0; i <= prefix_len; i++)
+    up[i] = toupper((unsigned char)prefix[i]);
+
+  int has_match = 0;
+  int has_epsilon = 0;
+
+  for (int i = 0; i < t->prods_len; i++) {
+    production_rhs *rhs = t->prods[i];
+
+    has_epsilon |= rhs->len == 0;
+    for (int k = 0; k < rhs->len; k++)
+      has_match |= symbol_is_terminal(rhs->syms[k]);
+  }
+
+  fprintf(out,
+          "// generated by ll1_generate_parser, do not edit\n"
+          "//\n"
+          "// %s_recognize returns STRING_RECOGNIZE_SUCCESS or the offset of\n"
+          "// the syntax error, and STRING_RECOGNIZE_ERROR when the input nests\n"
+          "// deeper than %s_MAX_DEPTH. the parse functions fail with\n"
+          "// STRING_PARSE_ERROR in that case.\n"
+          "#include \"ll1.h\"\n"
+          "\n"
+          "#ifndef %s_MAX_DEPTH\n"
+          "#define %s_MAX_DEPTH %d\n"
+          "#endif\n"
+          "\n"
+          "typedef struct %s_state {\n"
+          "  const char *str;\n"
+          "  const int *tokens;\n"
+          "  int len;\n"
+          "  int i;\n"
+          "  ll1_parse_tree *tree;\n"
+          "  int too_deep;\n"
+          "} %s_state;\n"
+          "\n"
+          "static const int %s_byte_cols[%d] = {",
+          prefix, up, up, up, LL1_CODEGEN_MAX_DEPTH, prefix, prefix, prefix,
+          GRAMMAR_BYTES_LEN);
+
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++)
+    fprintf(out, "%s %d%s", i % 16 == 0 ? "\n   " : "", t->terminal_cols[i],
+            i < GRAMMAR_BYTES_LEN - 1 ? "," : "");
+  fprintf(out, "};\n\n");
+
+  for (int i = 0; i < t->prods_len; i++) {
+    production_rhs *rhs = t->prods[i];
+
+    if (rhs->len == 0)
+      continue;
+
+    fprintf(out, "// ");
+    codegen_print_rhs(out, t->symbols, rhs);
+    fprintf(out, "\nstatic const symbol_id %s_rhs_%d[%d] = {", prefix, rhs->id,
+            rhs->len);
+    for (int k = 0; k < rhs->len; k++)
+      fprintf(out, "%s0x%08xu", k > 0 ? ", " : "", rhs->syms[k]);
+    fprintf(out, "};\n");
+  }
+  fprintf(out, "\n");
+
+  for (int i = 0; i < t->vars_len; i++)
+    fprintf(out,
+            "static int %s_parse_v%d(%s_state *s, ll1_parse_node *n, "
+            "int depth);\n",
+            prefix, i, prefix);
+  fprintf(out, "\n");
+
+  codegen_print_helpers(out, t, prefix, has_match, has_epsilon);
+
+  for (int i = 0; i < t->vars_len; i++)
+    codegen_print_var(out, t, prefix, up, i);
+
+  codegen_print_entries(out, prefix, symbol_index(start_var), start_var);
+
+  if (ferror(out))
+    return LL1_CODEGEN_ERROR;
+
+  return LL1_CODEGEN_SUCCESS;
+}
@@ -0,0 +1,671 @@
+#include "../include/ll1_compiled.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct ll1_compiled_writer {
+  char *data;
+  size_t len;
+  size_t max;
+  int failed;
+} ll1_compiled_writer;
+
+static unsigned long long fingerprint_bytes(unsigned long long h,
+                                            const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+
+  return h;
+}
+
+static unsigned long long fingerprint_int(unsigned long long h, int v) {
+  return fingerprint_bytes(h, &v, sizeof(v));
+}
+
+static unsigned long long fingerprint_names(unsigned long long h,
+                                            symbol_names *n) {
+  h = fingerprint_int(h, n->len);
+
+  for (int i = 0; i < n->len; i++) {
+    h = fingerprint_int(h, n->name_lens[i]);
+    h = fingerprint_bytes(h, n->names[i], n->name_lens[i]);
+  }
+
+  return h;
+}
+
+// FNV-1a over everything the compiled file is built from: the symbols, the
+// start variable, the right hand sides in id order and the token definitions
+unsigned long long grammar_fingerprint(grammar *g) {
+  unsigned long long h = 14695981039346656037ull;
+
+  h = fingerprint_int(h, LL1_COMPILED_VERSION);
+  h = fingerprint_names(h, &g->symbols->vars);
+  h = fingerprint_names(h, &g->symbols->terminals);
+  h = fingerprint_bytes(h, &g->start_var, sizeof(symbol_id));
+
+  production_table *t = g->productions_table;
+  production_rhs **prods =
+      (production_rhs **)malloc(sizeof(production_rhs *) * (t->len + 1));
+
+  if (prods != NULL) {
+    for (int i = 0; i < g->vars_len; i++) {
+      for (production_rhs *curr = t->productions[i].first_rhs; curr != NULL;
+           curr = curr->next)
+        prods[curr->id] = curr;
+    }
+
+    h = fingerprint_int(h, t->len);
+
+    for (int i = 0; i < t->len; i++) {
+      h = fingerprint_bytes(h, &prods[i]->for_var, sizeof(symbol_id));
+      h = fingerprint_int(h, prods[i]->len);
+      h = fingerprint_bytes(h, prods[i]->syms,
+                            sizeof(symbol_id) * prods[i]->len);
+    }
+
+    free(prods);
+  }
+
+  h = fingerprint_int(h, g->tokens_len);
+
+  for (int i = 0; i < g->tokens_len; i++) {
+    token_def *d = &g->tokens[i];
+
+    h = fingerprint_bytes(h, &d->terminal, sizeof(symbol_id));
+    h = fingerprint_int(h, d->kind);
+    h = fingerprint_int(h, d->len);
+    h = fingerprint_bytes(h, d->text, d->len);
+  }
+
+  // 0 is LL1_COMPILED_ANY_FINGERPRINT
+  return h != LL1_COMPILED_ANY_FINGERPRINT ? h : 1;
+}
+
+static int writer_reserve(ll1_compiled_writer *w, size_t len) {
+  if (w->len + len <= w->max)
+    return 0;
+
+  size_t max = w->max > 0 ? w->max : 4096;
+
+  while (w->len + len > max)
+    max *= 2;
+
+  char *temp = (char *)realloc(w->data, max);
+  if (temp == NULL) {
+    w->failed = 1;
+    return -1;
+  }
+
+  w->data = temp;
+  w->max = max;
+  return 0;
+}
+
+// appends len bytes right after the previous ones
+static void writer_append(ll1_compiled_writer *w, const void *src,
+                          size_t len) {
+  if (writer_reserve(w, len) != 0)
+    return;
+
+  if (len > 0)
+    memcpy(w->data + w->len, src, len);
+
+  w->len += len;
+}
+
+// appends len bytes at the next aligned offset and returns that offset
+static unsigned long long writer_put(ll1_compiled_writer *w, const void *src,
+                                     size_t len) {
+  size_t pad = (LL1_COMPILED_ALIGNMENT - w->len % LL1_COMPILED_ALIGNMENT) %
+               LL1_COMPILED_ALIGNMENT;
+
+  if (writer_reserve(w, pad) != 0)
+    return 0;
+
+  if (pad > 0)
+    memset(w->data + w->len, 0, pad);
+  w->len += pad;
+
+  unsigned long long at = w->len;
+  writer_append(w, src, len);
+
+  return at;
+}
+
+static void writer_put_names(ll1_compiled_writer *w, symbol_names *n,
+                             int *names_len, unsigned long long *names_at,
+                             unsigned long long *lens_at,
+                             unsigned long long *buckets_at) {
+  int *offsets = (int *)malloc(sizeof(int) * (n->len + 1));
+  if (offsets == NULL) {
+    w->failed = 1;
+    return;
+  }
+
+  for (int i = 0; i < n->len; i++) {
+    offsets[i] = *names_len;
+    *names_len += n->name_lens[i] + 1;
+  }
+
+  *names_at = writer_put(w, offsets, sizeof(int) * n->len);
+  *lens_at = writer_put(w, n->name_lens, sizeof(int) * n->len);
+  *buckets_at = writer_put(w, n->buckets, sizeof(int) * n->buckets_len);
+
+  free(offsets);
+}
+
+int ll1_save_compiled(const char *path, grammar *g, ff_table *fft,
+                      ll1_table *t) {
+  if (path == NULL || g == NULL || fft == NULL || t == NULL ||
+      t->vars_len != fft->vars_len || t->cols != fft->terminals_len ||
+      t->prods_len != fft->prods_len)
+    return LL1_COMPILED_ERROR;
+
+  ll1_compiled_header h;
+  memset(&h, 0, sizeof(h));
+
+  memcpy(h.magic, LL1_COMPILED_MAGIC, sizeof(LL1_COMPILED_MAGIC));
+  h.version = LL1_COMPILED_VERSION;
+  h.byte_order = LL1_COMPILED_BYTE_ORDER;
+  h.fingerprint = grammar_fingerprint(g);
+  h.start_var = g->start_var;
+  h.vars_len = t->vars_len;
+  h.terminals_len = t->terminals_len;
+  h.cols = t->cols;
+  h.prods_len = t->prods_len;
+  h.syms_len = t->prod_offsets[t->prods_len];
+  h.words = fft->words;
+  h.suffixes_len = fft->suffix_offsets[fft->prods_len];
+  h.var_buckets_len = g->symbols->vars.buckets_len;
+  h.terminal_buckets_len = g->symbols->terminals.buckets_len;
+  memcpy(h.terminal_cols, t->terminal_cols, sizeof(h.terminal_cols));
+
+  ll1_compiled_writer w;
+  w.data = NULL;
+  w.len = 0;
+  w.max = 0;
+  w.failed = 0;
+
+  writer_put(&w, &h, sizeof(h));
+
+  h.cells_at = writer_put(&w, t->cells, sizeof(int) * t->vars_len * t->cols);
+  h.prod_offsets_at =
+      writer_put(&w, t->prod_offsets, sizeof(int) * (t->prods_len + 1));
+  h.prod_syms_at = writer_put(&w, t->prod_syms, sizeof(int) * h.syms_len);
+
+  ll1_compiled_rhs *rhs = (ll1_compiled_rhs *)malloc(
+      sizeof(ll1_compiled_rhs) * (t->prods_len + 1));
+  symbol_id *rhs_syms =
+      (symbol_id *)malloc(sizeof(symbol_id) * (h.syms_len + 1));
+
+  if (rhs == NULL || rhs_syms == NULL) {
+    free(rhs);
+    free(rhs_syms);
+    free(w.data);
+    return LL1_COMPILED_ERROR;
+  }
+
+  int syms_len = 0;
+
+  for (int i = 0; i < t->prods_len; i++) {
+    production_rhs *p = t->prods[i];
+
+    rhs[i].id = p->id;
+    rhs[i].len = p->len;
+    rhs[i].for_var = p->for_var;
+    rhs[i].syms_offset = syms_len;
+
+    if (p->len > 0)
+      memcpy(&rhs_syms[syms_len], p->syms, sizeof(symbol_id) * p->len);
+    syms_len += p->len;
+  }
+
+  h.rhs_at = writer_put(&w, rhs, sizeof(ll1_compiled_rhs) * t->prods_len);
+  h.rhs_syms_at = writer_put(&w, rhs_syms, sizeof(symbol_id) * syms_len);
+
+  free(rhs);
+  free(rhs_syms);
+
+  size_t set_bytes = sizeof(bitset_word) * fft->words;
+
+  h.nullable_at = writer_put(&w, fft->nullable, fft->vars_len);
+  h.first_sets_at =
+      writer_put(&w, fft->first_sets, set_bytes * fft->vars_len);
+  h.follow_sets_at =
+      writer_put(&w, fft->follow_sets, set_bytes * fft->vars_len);
+  h.suffix_offsets_at = writer_put(&w, fft->suffix_offsets,
+                                   sizeof(int) * (fft->prods_len + 1));
+  h.suffix_nullable_at =
+      writer_put(&w, fft->suffix_nullable, h.suffixes_len);
+  h.suffix_firsts_at =
+      writer_put(&w, fft->suffix_firsts, set_bytes * h.suffixes_len);
+
+  writer_put_names(&w, &g->symbols->vars, &h.names_len, &h.var_names_at,
+                   &h.var_name_lens_at, &h.var_buckets_at);
+  writer_put_names(&w, &g->symbols->terminals, &h.names_len,
+                   &h.terminal_names_at, &h.terminal_name_lens_at,
+                   &h.terminal_buckets_at);
+
+  h.names_at = writer_put(&w, NULL, 0);
+
+  symbol_names *names[2] = {&g->symbols->vars, &g->symbols->terminals};
+
+  // names are packed back to back, each with its terminating 0
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < names[k]->len; i++)
+      writer_append(&w, names[k]->names[i], names[k]->name_lens[i] + 1);
+  }
+
+  h.size = w.len;
+
+  if (w.failed) {
+    free(w.data);
+    return LL1_COMPILED_ERROR;
+  }
+
+  memcpy(w.data, &h, sizeof(h));
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    free(w.data);
+    return LL1_COMPILED_ERROR;
+  }
+
+  size_t written = fwrite(w.data, 1, w.len, f);
+  int closed = fclose(f);
+
+  free(w.data);
+
+  if (written != h.size || closed != 0) {
+    remove(path);
+    return LL1_COMPILED_ERROR;
+  }
+
+  return LL1_COMPILED_SUCCESS;
+}
+
+// a section of count elements of size bytes at offset at must lie inside
+// the file and be aligned
+static int ll1_compiled_section_ok(const ll1_compiled_header *h,
+                                   unsigned long long at, long long count,
+                                   size_t size) {
+  if (count < 0 || at % LL1_COMPILED_ALIGNMENT != 0 || at > h->size)
+    return 0;
+
+  return (unsigned long long)count <= (h->size - at) / (size > 0 ? size : 1);
+}
+
+static int ll1_compiled_header_ok(const ll1_compiled_header *h, size_t size) {
+  long long set_words = (long long)h->words;
+
+  if (memcmp(h->magic, LL1_COMPILED_MAGIC, sizeof(LL1_COMPILED_MAGIC)) != 0 ||
+      h->version != LL1_COMPILED_VERSION ||
+      h->byte_order != LL1_COMPILED_BYTE_ORDER || h->size != size ||
+      h->vars_len < 0 || h->cols < 1 || h->cols != h->terminals_len ||
+      h->prods_len < 0 || h->syms_len < 0 ||
+      h->words != bitset_words(h->cols) ||
+      h->suffixes_len < 0 || h->names_len < 0 || h->var_buckets_len < 1 ||
+      h->terminal_buckets_len < 1 ||
+      (h->var_buckets_len & (h->var_buckets_len - 1)) != 0 ||
+      (h->terminal_buckets_len & (h->terminal_buckets_len - 1)) != 0)
+    return 0;
+
+  return ll1_compiled_section_ok(h, h->cells_at,
+                                 (long long)h->vars_len * h->cols,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->prod_offsets_at, h->prods_len + 1,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->prod_syms_at, h->syms_len,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->rhs_at, h->prods_len,
+                                 sizeof(ll1_compiled_rhs)) &&
+         ll1_compiled_section_ok(h, h->rhs_syms_at, h->syms_len,
+                                 sizeof(symbol_id)) &&
+         ll1_compiled_section_ok(h, h->nullable_at, h->vars_len, 1) &&
+         ll1_compiled_section_ok(h, h->first_sets_at, set_words * h->vars_len,
+                                 sizeof(bitset_word)) &&
+         ll1_compiled_section_ok(h, h->follow_sets_at,
+                                 set_words * h->vars_len,
+                                 sizeof(bitset_word)) &&
+         ll1_compiled_section_ok(h, h->suffix_offsets_at, h->prods_len + 1,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->suffix_nullable_at, h->suffixes_len,
+                                 1) &&
+         ll1_compiled_section_ok(h, h->suffix_firsts_at,
+                                 set_words * h->suffixes_len,
+                                 sizeof(bitset_word)) &&
+         ll1_compiled_section_ok(h, h->var_names_at, h->vars_len,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->var_name_lens_at, h->vars_len,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->var_buckets_at, h->var_buckets_len,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->terminal_names_at, h->terminals_len,
+                                 sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->terminal_name_lens_at,
+                                 h->terminals_len, sizeof(int)) &&
+         ll1_compiled_section_ok(h, h->terminal_buckets_at,
+                                 h->terminal_buckets_len, sizeof(int)) &&
+         h->names_at <= h->size &&
+         h->size - h->names_at >= (size_t)h->names_len;
+}
+
+// a symbol a right hand side may hold, $ never appears in one
+static int ll1_compiled_symbol_ok(const ll1_compiled_header *h, symbol_id s) {
+  if (symbol_is_var(s))
+    return symbol_index(s) < h->vars_len;
+
+  return s != SYMBOL_TERMINATE && symbol_is_terminal(s) &&
+         symbol_index(s) < h->terminals_len;
+}
+
+// buckets hold index + 1 of a name or 0. every name is in at most one
+// bucket and there are more buckets than names, so a lookup that probes
+// from any bucket meets an empty one and stops.
+static int ll1_compiled_buckets_ok(const int *buckets, int buckets_len,
+                                   int len) {
+  if (buckets_len <= len)
+    return 0;
+
+  char *seen = (char *)calloc(len + 1, 1);
+  if (seen == NULL)
+    return 0;
+
+  int ok = 1;
+
+  for (int b = 0; ok && b < buckets_len; b++) {
+    if (buckets[b] < 0 || buckets[b] > len)
+      ok = 0;
+    else if (buckets[b] > 0 && seen[buckets[b]]++)
+      ok = 0;
+  }
+
+  free(seen);
+  return ok;
+}
+
+// every index and symbol id the parser or the printers follow is checked
+// once, so a damaged file fails to load instead of sending them out of
+// bounds
+static int ll1_compiled_indices_ok(const ll1_compiled_header *h,
+                                   const char *base) {
+  const int *cells = (const int *)(base + h->cells_at);
+  const int *prod_offsets = (const int *)(base + h->prod_offsets_at);
+  const int *prod_syms = (const int *)(base + h->prod_syms_at);
+  const ll1_compiled_rhs *rhs = (const ll1_compiled_rhs *)(base + h->rhs_at);
+  const symbol_id *rhs_syms = (const symbol_id *)(base + h->rhs_syms_at);
+  const int *suffix_offsets = (const int *)(base + h->suffix_offsets_at);
+
+  for (int i = 0; i < GRAMMAR_BYTES_LEN; i++) {
+    if (h->terminal_cols[i] != LL1_NO_INDEX &&
+        (h->terminal_cols[i] <= LL1_END_COL || h->terminal_cols[i] >= h->cols))
+      return 0;
+  }
+
+  if (prod_offsets[0] != 0 || prod_offsets[h->prods_len] != h->syms_len ||
+      suffix_offsets[0] != 0 ||
+      suffix_offsets[h->prods_len] != h->suffixes_len)
+    return 0;
+
+  for (int i = 0; i < h->prods_len; i++) {
+    int from = prod_offsets[i];
+    int len = prod_offsets[i + 1] - from;
+
+    if (len < 0 || from < 0 || from > h->syms_len - len || rhs[i].id != i ||
+        rhs[i].len != len || rhs[i].syms_offset < 0 ||
+        rhs[i].syms_offset > h->syms_len - len ||
+        !symbol_is_var(rhs[i].for_var) ||
+        symbol_index(rhs[i].for_var) >= h->vars_len ||
+        suffix_offsets[i + 1] - suffix_offsets[i] != len + 1)
+      return 0;
+
+    // prod_syms is the right hand side reversed, in stack encoding
+    for (int j = 0; j < len; j++) {
+      symbol_id sym = rhs_syms[rhs[i].syms_offset + len - 1 - j];
+
+      if (!ll1_compiled_symbol_ok(h, sym) ||
+          prod_syms[from + j] != (symbol_is_var(sym)
+                                      ? h->cols + symbol_index(sym)
+                                      : symbol_index(sym)))
+        return 0;
+    }
+  }
+
+  // a cell predicts a right hand side of the variable of its row
+  for (int i = 0; i < h->vars_len; i++) {
+    for (int j = 0; j < h->cols; j++) {
+      int p = cells[(long long)i * h->cols + j];
+
+      if (p < LL1_NO_PRODUCTION || p >= h->prods_len ||
+          (p != LL1_NO_PRODUCTION && rhs[p].for_var != var_symbol(i)))
+        return 0;
+    }
+  }
+
+  const int *name_offsets[2] = {(const int *)(base + h->var_names_at),
+                                (const int *)(base + h->terminal_names_at)};
+  const int *name_lens[2] = {(const int *)(base + h->var_name_lens_at),
+                             (const int *)(base + h->terminal_name_lens_at)};
+  int lens[2] = {h->vars_len, h->terminals_len};
+
+  for (int k = 0; k < 2; k++) {
+    for (int i = 0; i < lens[k]; i++) {
+      if (name_offsets[k][i] < 0 || name_lens[k][i] < 0 ||
+          name_lens[k][i] >= h->names_len - name_offsets[k][i] ||
+          base[h->names_at + name_offsets[k][i] + name_lens[k][i]] != '\0')
+        return 0;
+    }
+  }
+
+  return ll1_compiled_buckets_ok((const int *)(base + h->var_buckets_at),
+                                 h->var_buckets_len, h->vars_len) &&
+         ll1_compiled_buckets_ok(
+             (const int *)(base + h->terminal_buckets_at),
+             h->terminal_buckets_len, h->terminals_len) &&
+         symbol_is_var(h->start_var) &&
+         symbol_index(h->start_var) < h->vars_len;
+}
+
+static int ll1_compiled_names_view(symbol_names *n, const char *base,
+                                   const ll1_compiled_header *h, int len,
+                                   unsigned long long names_at,
+                                   unsigned long long lens_at,
+                                   unsigned long long buckets_at,
+                                   int buckets_len) {
+  const int *offsets = (const int *)(base + names_at);
+
+  n->len = len;
+  n->max = len;
+  n->name_lens = (int *)(base + lens_at);
+  n->buckets_len = buckets_len;
+  n->buckets = (int *)(base + buckets_at);
+  n->names = (const char **)malloc(sizeof(char *) * (len + 1));
+
+  if (n->names == NULL)
+    return -1;
+
+  for (int i = 0; i < len; i++)
+    n->names[i] = base + h->names_at + offsets[i];
+
+  return 0;
+}
+
+// only the pointer arrays (prods, rhs and the name pointers) are built on
+// load, every other array of the views points into the mapping
+ll1_compiled *ll1_load_compiled(const char *path,
+                                unsigned long long fingerprint) {
+  if (path == NULL)
+    return NULL;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ll1_compiled_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const char *base = (const char *)map;
+  const ll1_compiled_header *h = (const ll1_compiled_header *)map;
+
+  if (!ll1_compiled_header_ok(h, size) ||
+      (fingerprint != LL1_COMPILED_ANY_FINGERPRINT &&
+       h->fingerprint != fingerprint) ||
+      !ll1_compiled_indices_ok(h, base)) {
+    munmap(map, size);
+    return NULL;
+  }
+
+  ll1_compiled *c = (ll1_compiled *)malloc(sizeof(ll1_compiled));
+  if (c == NULL) {
+    munmap(map, size);
+    return NULL;
+  }
+
+  c->map = map;
+  c->size = size;
+  c->header = h;
+  c->start_var = h->start_var;
+  c->symbols.vars.names = NULL;
+  c->symbols.terminals.names = NULL;
+  c->symbols.names_arena = NULL;
+  c->rhs = (production_rhs *)malloc(sizeof(production_rhs) *
+                                    (h->prods_len + 1));
+  c->prods = (production_rhs **)malloc(sizeof(production_rhs *) *
+                                       (h->prods_len + 1));
+
+  if (c->rhs == NULL || c->prods == NULL ||
+      ll1_compiled_names_view(&c->symbols.vars, base, h, h->vars_len,
+                              h->var_names_at, h->var_name_lens_at,
+                              h->var_buckets_at, h->var_buckets_len) != 0 ||
+      ll1_compiled_names_view(&c->symbols.terminals, base, h,
+                              h->terminals_len, h->terminal_names_at,
+                              h->terminal_name_lens_at,
+                              h->terminal_buckets_at,
+                              h->terminal_buckets_len) != 0) {
+    free_ll1_compiled(c);
+    return NULL;
+  }
+
+  // the per variable lists are not kept, next is always NULL
+  const ll1_compiled_rhs *rhs = (const ll1_compiled_rhs *)(base + h->rhs_at);
+  symbol_id *rhs_syms = (symbol_id *)(base + h->rhs_syms_at);
+
+  for (int i = 0; i < h->prods_len; i++) {
+    c->rhs[i].id = rhs[i].id;
+    c->rhs[i].len = rhs[i].len;
+    c->rhs[i].syms = &rhs_syms[rhs[i].syms_offset];
+    c->rhs[i].for_var = rhs[i].for_var;
+    c->rhs[i].next = NULL;
+    c->prods[i] = &c->rhs[i];
+  }
+
+  ff_table *ff = &c->ff;
+  ff->symbols = &c->symbols;
+  ff->vars_len = h->vars_len;
+  ff->terminals_len = h->terminals_len;
+  ff->words = h->words;
+  ff->nullable = (char *)(base + h->nullable_at);
+  ff->first_sets = (bitset_word *)(base + h->first_sets_at);
+  ff->follow_sets = (bitset_word *)(base + h->follow_sets_at);
+  ff->prods_len = h->prods_len;
+  ff->prods = c->prods;
+  ff->suffix_offsets = (int *)(base + h->suffix_offsets_at);
+  ff->suffix_nullable = (char *)(base + h->suffix_nullable_at);
+  ff->suffix_firsts = (bitset_word *)(base + h->suffix_firsts_at);
+
+  ll1_table *t = &c->table;
+  t->symbols = &c->symbols;
+  t->vars_len = h->vars_len;
+  t->terminals_len = h->terminals_len;
+  t->table = NULL;
+  t->cols = h->cols;
+  t->cells = (int *)(base + h->cells_at);
+  t->prods_len = h->prods_len;
+  t->prods = c->prods;
+  t->prod_offsets = (int *)(base + h->prod_offsets_at);
+  t->prod_syms = (int *)(base + h->prod_syms_at);
+  memcpy(t->terminal_cols, h->terminal_cols, sizeof(t->terminal_cols));
+
+  return c;
+}
+
+// <dir>/<fingerprint>.ll1g is loaded when it is there, otherwise the tables
+// are built, written to a temporary file and renamed into place so readers
+// never map a half written file
+ll1_compiled *ll1_compiled_cache_load(const char *dir, grammar *g) {
+  if (dir == NULL || g == NULL)
+    return NULL;
+
+  unsigned long long fingerprint = grammar_fingerprint(g);
+  char path[LL1_COMPILED_PATH_LEN];
+  char temp_path[LL1_COMPILED_PATH_LEN];
+
+  int l = snprintf(path, sizeof(path), "%s/%016llx.ll1g", dir, fingerprint);
+  if (l < 0 || l >= (int)sizeof(path))
+    return NULL;
+
+  ll1_compiled *c = ll1_load_compiled(path, fingerprint);
+  if (c != NULL)
+    return c;
+
+  l = snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path,
+               (long)getpid());
+  if (l < 0 || l >= (int)sizeof(temp_path))
+    return NULL;
+
+  ff_table *fft = new_ff_table(g);
+  if (fft == NULL)
+    return NULL;
+
+  if (calculate_firsts(g, fft) != SUCCESS_ON_FIRST_CALC ||
+      calculate_follows(g, fft) != SUCCESS_ON_FOLLOW_CALC) {
+    free_ff_table(fft);
+    return NULL;
+  }
+
+  ll1_table *t = new_ll1_table(g, fft);
+  if (t == NULL) {
+    free_ff_table(fft);
+    return NULL;
+  }
+
+  int res = ll1_save_compiled(temp_path, g, fft, t);
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+
+  if (res != LL1_COMPILED_SUCCESS)
+    return NULL;
+
+  if (rename(temp_path, path) != 0) {
+    remove(temp_path);
+    return NULL;
+  }
+
+  return ll1_load_compiled(path, fingerprint);
+}
+
+void free_ll1_compiled(ll1_compiled *c) {
+  munmap(c->map, c->size);
+  free(c->rhs);
+  free(c->prods);
+  free(c->symbols.vars.names);
+  free(c->symbols.terminals.names);
+  free(c);
+}
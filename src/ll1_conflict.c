@@ -0,0 +1,231 @@
+#include "../include/ll1.h"
+
+// scratch sets of the variable being checked, words long each
+typedef struct ll1_conflict_sets {
+  int words;
+  bitset_word *pred;
+  bitset_word *seen;
+  bitset_word *twice;
+  bitset_word *follow_only;
+} ll1_conflict_sets;
+
+static int ll1_conflicts_reserve(ll1_conflicts *c, int len, int ids_len) {
+  if (c->len + len > c->max) {
+    int max = c->max;
+
+    while (c->len + len > max)
+      max *= 2;
+
+    ll1_conflict *temp =
+        (ll1_conflict *)realloc(c->data, sizeof(ll1_conflict) * max);
+    if (temp == NULL)
+      return -1;
+
+    c->data = temp;
+    c->max = max;
+  }
+
+  if (c->ids_len + ids_len > c->ids_max) {
+    int max = c->ids_max;
+
+    while (c->ids_len + ids_len > max)
+      max *= 2;
+
+    int *temp = (int *)realloc(c->ids, sizeof(int) * max);
+    if (temp == NULL)
+      return -1;
+
+    c->ids = temp;
+    c->ids_max = max;
+  }
+
+  return 0;
+}
+
+// the cells rhs claims: its FIRST set, and FOLLOW of its variable when it
+// can derive epsilon
+static int ll1_conflict_predict(ff_table *fft, ll1_conflict_sets *s,
+                                production_rhs *rhs, bitset_word *follow) {
+  bitset_word *first = ff_rhs_first_set(fft, rhs, 0);
+  int nullable = ff_rhs_nullable(fft, rhs, 0);
+
+  for (int w = 0; w < s->words; w++)
+    s->pred[w] = first[w] | (nullable ? follow[w] : 0);
+
+  return nullable;
+}
+
+// two passes over the right hand sides of p that only visit the claimed
+// cells: one counts the claims on the cells claimed twice, the other
+// appends the ids once every conflict has its slice of ids
+static int ll1_conflicts_add_var(ll1_conflicts *c, ff_table *fft,
+                                 ll1_conflict_sets *s, int *cells,
+                                 production *p) {
+  bitset_word *follow = ff_follow_set(fft, p->var);
+  int ids_len = 0;
+
+  bitset_clear(s->seen, s->words);
+  bitset_clear(s->twice, s->words);
+  bitset_clear(s->follow_only, s->words);
+
+  for (production_rhs *curr = p->first_rhs; curr != NULL; curr = curr->next) {
+    bitset_word *first = ff_rhs_first_set(fft, curr, 0);
+    int nullable = ll1_conflict_predict(fft, s, curr, follow);
+
+    for (int w = 0; w < s->words; w++) {
+      s->twice[w] |= s->seen[w] & s->pred[w];
+      s->seen[w] |= s->pred[w];
+
+      if (nullable)
+        s->follow_only[w] |= follow[w] & ~first[w];
+    }
+  }
+
+  int len = bitset_count(s->twice, s->words);
+  if (len == 0)
+    return 0;
+
+  for (int w = 0; w < s->words; w++) {
+    for (bitset_word bits = s->twice[w]; bits != 0; bits &= bits - 1)
+      cells[w * BITSET_WORD_BITS + __builtin_ctzll(bits)] = 0;
+  }
+
+  for (production_rhs *curr = p->first_rhs; curr != NULL; curr = curr->next) {
+    ll1_conflict_predict(fft, s, curr, follow);
+
+    for (int w = 0; w < s->words; w++) {
+      for (bitset_word bits = s->pred[w] & s->twice[w]; bits != 0;
+           bits &= bits - 1) {
+        cells[w * BITSET_WORD_BITS + __builtin_ctzll(bits)]++;
+        ids_len++;
+      }
+    }
+  }
+
+  if (ll1_conflicts_reserve(c, len, ids_len) != 0)
+    return -1;
+
+  // from here on cells holds the index of the conflict of each cell
+  for (int w = 0; w < s->words; w++) {
+    for (bitset_word bits = s->twice[w]; bits != 0; bits &= bits - 1) {
+      int j = w * BITSET_WORD_BITS + __builtin_ctzll(bits);
+      ll1_conflict *conflict = &c->data[c->len];
+
+      conflict->var = p->var;
+      conflict->terminal = terminal_symbol(j);
+      conflict->kind = bitset_test(s->follow_only, j)
+                           ? LL1_CONFLICT_FIRST_FOLLOW
+                           : LL1_CONFLICT_FIRST_FIRST;
+      conflict->ids_offset = c->ids_len;
+      conflict->ids_len = 0;
+
+      c->ids_len += cells[j];
+      cells[j] = c->len++;
+    }
+  }
+
+  for (production_rhs *curr = p->first_rhs; curr != NULL; curr = curr->next) {
+    ll1_conflict_predict(fft, s, curr, follow);
+
+    for (int w = 0; w < s->words; w++) {
+      for (bitset_word bits = s->pred[w] & s->twice[w]; bits != 0;
+           bits &= bits - 1) {
+        ll1_conflict *conflict =
+            &c->data[cells[w * BITSET_WORD_BITS + __builtin_ctzll(bits)]];
+
+        c->ids[conflict->ids_offset + conflict->ids_len++] = curr->id;
+      }
+    }
+  }
+
+  // right hand sides are listed newest first
+  for (int i = c->len - len; i < c->len; i++) {
+    int *ids = &c->ids[c->data[i].ids_offset];
+
+    for (int a = 0, b = c->data[i].ids_len - 1; a < b; a++, b--) {
+      int temp = ids[a];
+      ids[a] = ids[b];
+      ids[b] = temp;
+    }
+  }
+
+  return 0;
+}
+
+// every cell of the table claimed more than once, found in time linear in
+// the claims rather than by building the table. an empty list means the
+// grammar is LL(1). the ids of a conflict are in grammar order, conflicts
+// are ordered by var, then terminal.
+ll1_conflicts *new_ll1_conflicts(grammar *g, ff_table *fft) {
+  if (g == NULL || fft == NULL)
+    return NULL;
+
+  ll1_conflicts *c = (ll1_conflicts *)malloc(sizeof(ll1_conflicts));
+  if (c == NULL)
+    return NULL;
+
+  c->symbols = fft->symbols;
+  c->prods = fft->prods;
+  c->len = 0;
+  c->max = LL1_CONFLICTS_INITIAL_LEN;
+  c->ids_len = 0;
+  c->ids_max = LL1_CONFLICTS_INITIAL_LEN * 2;
+  c->data = (ll1_conflict *)malloc(sizeof(ll1_conflict) * c->max);
+  c->ids = (int *)malloc(sizeof(int) * c->ids_max);
+
+  ll1_conflict_sets s;
+  s.words = fft->words;
+  s.pred = new_bitset(s.words * 4);
+  s.seen = s.pred + s.words;
+  s.twice = s.seen + s.words;
+  s.follow_only = s.twice + s.words;
+
+  int *cells = (int *)malloc(sizeof(int) * (fft->terminals_len + 1));
+  int ok = c->data != NULL && c->ids != NULL && s.pred != NULL &&
+           cells != NULL;
+
+  for (int i = 0; ok && i < fft->vars_len; i++) {
+    if (ll1_conflicts_add_var(c, fft, &s, cells,
+                              &g->productions_table->productions[i]) != 0)
+      ok = 0;
+  }
+
+  free(s.pred);
+  free(cells);
+
+  if (!ok) {
+    free_ll1_conflicts(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+void print_ll1_conflicts(ll1_conflicts *c) {
+  char buff[256];
+
+  printf("LL(1) Conflicts: %d\n", c->len);
+
+  for (int i = 0; i < c->len; i++) {
+    ll1_conflict *conflict = &c->data[i];
+    const char *var = symbol_name(c->symbols, conflict->var);
+
+    printf("   %s on %s: %s\n", var,
+           symbol_name(c->symbols, conflict->terminal),
+           conflict->kind == LL1_CONFLICT_FIRST_FOLLOW ? "FIRST/FOLLOW"
+                                                       : "FIRST/FIRST");
+
+    for (int k = 0; k < conflict->ids_len; k++) {
+      production_rhs *rhs = c->prods[c->ids[conflict->ids_offset + k]];
+
+      format_production_rhs(c->symbols, rhs, buff, sizeof(buff));
+      printf("      %s -> %s\n", var, buff);
+    }
+  }
+}
+
+void free_ll1_conflicts(ll1_conflicts *c) {
+  free(c->data);
+  free(c->ids);
+  free(c);
+}
@@ -0,0 +1,89 @@
+#include "../include/ll1_internal.h"
+
+typedef struct ll1_events {
+  ll1_table *table;
+  ll1_parse_callbacks *cb;
+} ll1_events;
+
+// the mark of a variable is its row
+static int ll1_events_enter(void *data, int row, int p, int offset,
+                            int *mark) {
+  ll1_events *e = (ll1_events *)data;
+  (void)offset;
+
+  *mark = row;
+  if (e->cb->enter_var != NULL &&
+      e->cb->enter_var(e->cb->data, var_symbol(row), e->table->prods[p]) != 0)
+    return STRING_PARSE_STOPPED;
+
+  return 0;
+}
+
+static int ll1_events_terminal(void *data, int col, int offset) {
+  ll1_parse_callbacks *cb = ((ll1_events *)data)->cb;
+
+  if (cb->terminal != NULL &&
+      cb->terminal(cb->data, terminal_symbol(col), offset) != 0)
+    return STRING_PARSE_STOPPED;
+
+  return 0;
+}
+
+static int ll1_events_epsilon(void *data, int mark, int offset) {
+  ll1_parse_callbacks *cb = ((ll1_events *)data)->cb;
+  (void)offset;
+
+  if (cb->epsilon != NULL && cb->epsilon(cb->data, var_symbol(mark)) != 0)
+    return STRING_PARSE_STOPPED;
+
+  return 0;
+}
+
+static int ll1_events_exit(void *data, int mark) {
+  ll1_parse_callbacks *cb = ((ll1_events *)data)->cb;
+
+  if (cb->exit_var != NULL && cb->exit_var(cb->data, var_symbol(mark)) != 0)
+    return STRING_PARSE_STOPPED;
+
+  return 0;
+}
+
+static const ll1_walk_hooks ll1_events_hooks = {
+    ll1_events_enter, ll1_events_terminal, ll1_events_epsilon,
+    ll1_events_exit};
+
+// the stack only ever holds what is still to come, so memory is bounded by
+// the depth of the derivation rather than the size of the tree
+static int ll1_parse_events_input(ll1_table *table, symbol_id start_var,
+                                  const char *str, const int *tokens,
+                                  int str_len, ll1_parse_callbacks *cb) {
+  ll1_events e = {table, cb};
+
+  return ll1_walk_input(table, start_var, str, tokens, str_len,
+                        &ll1_events_hooks, &e);
+}
+
+// walks the derivation of str without building a tree. the callbacks run
+// as the parse goes, so a rejected input has already delivered the events
+// of the prefix that fit. events come in the order a preorder walk of the
+// tree would see them, every enter_var has its exit_var and a variable that
+// derives epsilon gets epsilon in between.
+int ll1_parse_events(ll1_table *table, symbol_id start_var, const char *str,
+                     int str_len, ll1_parse_callbacks *cb) {
+  if (table == NULL || cb == NULL || (str == NULL && str_len != 0) ||
+      str_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return ll1_parse_events_input(table, start_var, str, NULL, str_len, cb);
+}
+
+int ll1_parse_events_tokens(ll1_table *table, symbol_id start_var,
+                            const int *tokens, int tokens_len,
+                            ll1_parse_callbacks *cb) {
+  if (table == NULL || cb == NULL || (tokens == NULL && tokens_len != 0) ||
+      tokens_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return ll1_parse_events_input(table, start_var, NULL, tokens, tokens_len,
+                                cb);
+}
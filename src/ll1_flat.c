@@ -0,0 +1,348 @@
+#include "../include/ll1_internal.h"
+
+// node 0 is the root and the first child of a node is the node right after
+// it, so n has children when ends[n] > n + 1 and the next sibling of a child
+// c is ends[c] while that is still inside the parent. offsets[n] is where the
+// node starts, it ends where the node at ends[n] starts (input_len past the
+// last node).
+ll1_flat_tree *new_ll1_flat_tree(int max) {
+  ll1_flat_tree *t = (ll1_flat_tree *)malloc(sizeof(ll1_flat_tree));
+  if (t == NULL)
+    return NULL;
+
+  t->len = 0;
+  t->max = max > 0 ? max : LL1_FLAT_TREE_INITIAL_LEN;
+  t->input_len = 0;
+  t->syms = (symbol_id *)malloc(sizeof(symbol_id) * t->max);
+  t->ends = (int *)malloc(sizeof(int) * t->max);
+  t->offsets = (int *)malloc(sizeof(int) * t->max);
+
+  if (t->syms == NULL || t->ends == NULL || t->offsets == NULL) {
+    free_ll1_flat_tree(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+static int ll1_flat_tree_reserve(ll1_flat_tree *t, int len) {
+  if (len <= t->max)
+    return 0;
+
+  int max = t->max;
+
+  while (max < len)
+    max *= 2;
+
+  symbol_id *syms = (symbol_id *)realloc(t->syms, sizeof(symbol_id) * max);
+  if (syms == NULL)
+    return -1;
+  t->syms = syms;
+
+  int *ends = (int *)realloc(t->ends, sizeof(int) * max);
+  if (ends == NULL)
+    return -1;
+  t->ends = ends;
+
+  int *offsets = (int *)realloc(t->offsets, sizeof(int) * max);
+  if (offsets == NULL)
+    return -1;
+  t->offsets = offsets;
+
+  t->max = max;
+  return 0;
+}
+
+// appends a leaf and returns its index, the ends of a variable are moved
+// past its subtree once that is done
+static int ll1_flat_tree_add(ll1_flat_tree *t, symbol_id sym, int offset) {
+  if (t->len == t->max && ll1_flat_tree_reserve(t, t->len + 1) != 0)
+    return LL1_NO_INDEX;
+
+  int n = t->len++;
+
+  t->syms[n] = sym;
+  t->ends[n] = n + 1;
+  t->offsets[n] = offset;
+
+  return n;
+}
+
+// the mark of a variable is its node, nodes are written as they are
+// popped, which is preorder
+static int ll1_flat_enter(void *data, int row, int p, int offset,
+                          int *mark) {
+  (void)p;
+
+  *mark = ll1_flat_tree_add((ll1_flat_tree *)data, var_symbol(row), offset);
+  return *mark == LL1_NO_INDEX ? STRING_PARSE_ERROR : 0;
+}
+
+static int ll1_flat_terminal(void *data, int col, int offset) {
+  if (ll1_flat_tree_add((ll1_flat_tree *)data, terminal_symbol(col),
+                        offset) == LL1_NO_INDEX)
+    return STRING_PARSE_ERROR;
+
+  return 0;
+}
+
+static int ll1_flat_epsilon(void *data, int mark, int offset) {
+  (void)mark;
+
+  if (ll1_flat_tree_add((ll1_flat_tree *)data, SYMBOL_EPSILON, offset) ==
+      LL1_NO_INDEX)
+    return STRING_PARSE_ERROR;
+
+  return 0;
+}
+
+// closes the subtree of node mark
+static int ll1_flat_exit(void *data, int mark) {
+  ll1_flat_tree *tree = (ll1_flat_tree *)data;
+
+  tree->ends[mark] = tree->len;
+  return 0;
+}
+
+static const ll1_walk_hooks ll1_flat_hooks = {
+    ll1_flat_enter, ll1_flat_terminal, ll1_flat_epsilon, ll1_flat_exit};
+
+static int fill_flat_tree(ll1_table *table, ll1_flat_tree *tree,
+                          symbol_id start_var, const char *str,
+                          const int *tokens, int str_len) {
+  tree->len = 0;
+  tree->input_len = str_len;
+
+  return ll1_walk_input(table, start_var, str, tokens, str_len,
+                        &ll1_flat_hooks, tree);
+}
+
+int fill_flat_tree_with_string(ll1_table *table, ll1_flat_tree *tree,
+                               symbol_id start_var, const char *str,
+                               int str_len) {
+  if (str_len == 0 || str == NULL || table == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  return fill_flat_tree(table, tree, start_var, str, NULL, str_len);
+}
+
+int fill_flat_tree_with_tokens(ll1_table *table, ll1_flat_tree *tree,
+                               symbol_id start_var, const int *tokens,
+                               int tokens_len) {
+  if (tokens_len == 0 || tokens == NULL || table == NULL || tree == NULL)
+    return STRING_PARSE_ERROR;
+
+  return fill_flat_tree(table, tree, start_var, NULL, tokens, tokens_len);
+}
+
+int ll1_flat_tree_first_child(ll1_flat_tree *t, int node) {
+  return t->ends[node] > node + 1 ? node + 1 : LL1_NO_INDEX;
+}
+
+// siblings are found through their parent, whose subtree they end with
+int ll1_flat_tree_next_sibling(ll1_flat_tree *t, int parent, int node) {
+  return t->ends[node] < t->ends[parent] ? t->ends[node] : LL1_NO_INDEX;
+}
+
+int ll1_flat_tree_children_len(ll1_flat_tree *t, int node) {
+  int len = 0;
+
+  for (int c = ll1_flat_tree_first_child(t, node); c != LL1_NO_INDEX;
+       c = ll1_flat_tree_next_sibling(t, node, c))
+    len++;
+
+  return len;
+}
+
+// there is no parent array, the parent is the closest node before this one
+// whose subtree still covers it
+int ll1_flat_tree_parent(ll1_flat_tree *t, int node) {
+  for (int p = node - 1; p >= 0; p--) {
+    if (t->ends[p] > node)
+      return p;
+  }
+
+  return LL1_NO_INDEX;
+}
+
+// the input node covers is offsets[node] up to this
+int ll1_flat_tree_span_end(ll1_flat_tree *t, int node) {
+  int end = t->ends[node];
+
+  return end < t->len ? t->offsets[end] : t->input_len;
+}
+
+// a node of the pointer tree with the flat index that goes with it
+typedef struct ll1_flat_entry {
+  ll1_parse_node *node;
+  int index;
+} ll1_flat_entry;
+
+static ll1_flat_entry *ll1_flat_entries_reserve(ll1_flat_entry *e, int *max,
+                                                int len) {
+  if (len <= *max)
+    return e;
+
+  int m = *max;
+
+  while (m < len)
+    m *= 2;
+
+  ll1_flat_entry *temp =
+      (ll1_flat_entry *)realloc(e, sizeof(ll1_flat_entry) * m);
+  if (temp == NULL)
+    return NULL;
+
+  *max = m;
+  return temp;
+}
+
+// the pointer tree is built in the same preorder, open holds the nodes
+// whose subtrees are not done yet, each with the index its subtree ends at
+ll1_parse_tree *new_ll1_parse_tree_from_flat(ll1_flat_tree *f) {
+  if (f == NULL || f->len == 0)
+    return NULL;
+
+  ll1_parse_tree *tree = new_ll1_parse_tree(f->syms[0]);
+  if (tree == NULL)
+    return NULL;
+
+  int max = LL1_FLAT_STACK_LEN;
+  int top = 0;
+  ll1_flat_entry *open =
+      (ll1_flat_entry *)malloc(sizeof(ll1_flat_entry) * max);
+  int ok = open != NULL &&
+           ll1_parse_node_reserve_children(tree, tree->root,
+                                           ll1_flat_tree_children_len(f, 0)) ==
+               PARSE_TREE_ADD_NODE_SUCCESS;
+
+  if (ok) {
+    open[0].node = tree->root;
+    open[0].index = f->ends[0];
+  }
+
+  for (int i = 1; ok && i < f->len; i++) {
+    while (open[top].index <= i)
+      top--;
+
+    ll1_parse_node *parent = open[top].node;
+
+    if (ll1_parse_tree_add_child(tree, parent, f->syms[i],
+                                 ll1_flat_tree_children_len(f, i)) !=
+        PARSE_TREE_ADD_NODE_SUCCESS) {
+      ok = 0;
+      continue;
+    }
+
+    if (f->ends[i] == i + 1)
+      continue;
+
+    ll1_flat_entry *temp = ll1_flat_entries_reserve(open, &max, top + 2);
+    if (temp == NULL) {
+      ok = 0;
+      continue;
+    }
+
+    open = temp;
+    top++;
+    open[top].node = parent->children[parent->children_len - 1];
+    open[top].index = f->ends[i];
+  }
+
+  free(open);
+
+  if (!ok) {
+    free_ll1_parse_tree(tree);
+    return NULL;
+  }
+
+  return tree;
+}
+
+// a pointer tree does not know its input, offsets count the terminal leaves
+// before each node. the stack holds the nodes still to visit with the index
+// of their parent, ends are filled in backwards once every node has one.
+int ll1_flat_tree_from_tree(ll1_flat_tree *f, ll1_parse_tree *tree) {
+  if (f == NULL || tree == NULL || tree->root == NULL)
+    return STRING_PARSE_ERROR;
+
+  if (ll1_flat_tree_reserve(f, tree->nodes) != 0)
+    return STRING_PARSE_ERROR;
+
+  int max = LL1_FLAT_STACK_LEN;
+  int top = 0;
+  int offset = 0;
+  ll1_flat_entry *stack =
+      (ll1_flat_entry *)malloc(sizeof(ll1_flat_entry) * max);
+  int *parents = (int *)malloc(sizeof(int) * tree->nodes);
+  int ok = stack != NULL && parents != NULL;
+
+  f->len = 0;
+
+  if (ok) {
+    stack[0].node = tree->root;
+    stack[0].index = LL1_NO_INDEX;
+  }
+
+  while (ok && top >= 0) {
+    ll1_parse_node *node = stack[top].node;
+    int parent = stack[top--].index;
+
+    // nodes counts every node, more of them means a broken tree
+    if (f->len == tree->nodes) {
+      ok = 0;
+      continue;
+    }
+
+    int n = ll1_flat_tree_add(f, node->sym, offset);
+    parents[n] = parent;
+
+    if (node->children_len == 0 && symbol_is_terminal(node->sym))
+      offset++;
+
+    ll1_flat_entry *temp =
+        ll1_flat_entries_reserve(stack, &max, top + 1 + node->children_len);
+    if (temp == NULL) {
+      ok = 0;
+      continue;
+    }
+
+    stack = temp;
+
+    for (int k = node->children_len - 1; k >= 0; k--) {
+      top++;
+      stack[top].node = node->children[k];
+      stack[top].index = n;
+    }
+  }
+
+  ok = ok && f->len == tree->nodes;
+
+  for (int i = f->len - 1; ok && i > 0; i--) {
+    if (f->ends[i] > f->ends[parents[i]])
+      f->ends[parents[i]] = f->ends[i];
+  }
+
+  f->input_len = offset;
+
+  free(stack);
+  free(parents);
+
+  return ok ? STRING_PARSE_SUCCESS : STRING_PARSE_ERROR;
+}
+
+void print_ll1_flat_tree(ll1_flat_tree *t, symbol_table *s) {
+  printf("Flat Tree: %d nodes\n", t->len);
+
+  for (int i = 0; i < t->len; i++) {
+    printf("   %d: %s at %d, ends %d\n", i, symbol_name(s, t->syms[i]),
+           t->offsets[i], t->ends[i]);
+  }
+}
+
+void free_ll1_flat_tree(ll1_flat_tree *t) {
+  free(t->syms);
+  free(t->ends);
+  free(t->offsets);
+  free(t);
+}
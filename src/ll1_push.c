@@ -0,0 +1,170 @@
+#include "../include/ll1.h"
+
+// only the symbol stack and the nodes waiting on it are kept between calls,
+// the input is never buffered
+ll1_push_parser *new_ll1_push_parser(ll1_table *table, symbol_id start_var,
+                                     ll1_parse_tree *tree) {
+  if (table == NULL)
+    return NULL;
+
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= table->vars_len)
+    return NULL;
+
+  ll1_push_parser *p = (ll1_push_parser *)malloc(sizeof(ll1_push_parser));
+  if (p == NULL)
+    return NULL;
+
+  p->table = table;
+  p->tree = tree;
+  p->status = LL1_PUSH_RUNNING;
+  p->offset = 0;
+  p->top = 0;
+  p->max = LL1_PUSH_STACK_LEN;
+  p->nodes = NULL;
+
+  p->syms = (int *)malloc(sizeof(int) * p->max);
+  if (p->syms == NULL) {
+    free(p);
+    return NULL;
+  }
+
+  p->syms[0] = table->cols + symbol_index(start_var);
+
+  if (tree != NULL) {
+    p->nodes = (ll1_parse_node **)malloc(sizeof(ll1_parse_node *) * p->max);
+
+    if (p->nodes == NULL ||
+        ll1_parse_tree_reset(tree, start_var) != PARSE_TREE_ADD_NODE_SUCCESS) {
+      free_ll1_push_parser(p);
+      return NULL;
+    }
+
+    p->nodes[0] = tree->root;
+  }
+
+  return p;
+}
+
+static int ll1_push_parser_increase(ll1_push_parser *p, int need) {
+  int max = p->max;
+
+  while (max < need)
+    max *= 2;
+
+  int *syms = (int *)realloc(p->syms, sizeof(int) * max);
+  if (syms == NULL)
+    return -1;
+
+  p->syms = syms;
+
+  if (p->nodes != NULL) {
+    ll1_parse_node **nodes =
+        (ll1_parse_node **)realloc(p->nodes, sizeof(ll1_parse_node *) * max);
+    if (nodes == NULL)
+      return -1;
+
+    p->nodes = nodes;
+  }
+
+  p->max = max;
+  return 0;
+}
+
+// expands variables on top of the stack until a terminal is on top, using col
+// as the lookahead. returns 0 or -1 when there is no prediction.
+static int ll1_push_parser_expand(ll1_push_parser *p, int col) {
+  ll1_table *t = p->table;
+
+  while (p->top >= 0 && p->syms[p->top] >= t->cols) {
+    int row = p->syms[p->top] - t->cols;
+    int prod = t->cells[row * t->cols + col];
+
+    if (prod == LL1_NO_PRODUCTION)
+      return -1;
+
+    int from = t->prod_offsets[prod];
+    int len = t->prod_offsets[prod + 1] - from;
+
+    if (p->top + len >= p->max &&
+        ll1_push_parser_increase(p, p->top + len + 1) != 0)
+      return -1;
+
+    if (p->nodes != NULL) {
+      ll1_parse_node *node = p->nodes[p->top];
+      production_rhs *rhs = t->prods[prod];
+
+      if (len == 0) {
+        if (ll1_parse_tree_add_child(p->tree, node, SYMBOL_EPSILON, 0) !=
+            PARSE_TREE_ADD_NODE_SUCCESS)
+          return -1;
+      } else {
+        if (ll1_parse_node_reserve_children(p->tree, node, len) !=
+            PARSE_TREE_ADD_NODE_SUCCESS)
+          return -1;
+
+        for (int i = 0; i < len; i++) {
+          if (ll1_parse_tree_add_child(p->tree, node, rhs->syms[i], 0) !=
+              PARSE_TREE_ADD_NODE_SUCCESS)
+            return -1;
+        }
+
+        // prod_syms is reversed, so the last child lands on the bottom
+        for (int i = 0; i < len; i++)
+          p->nodes[p->top + i] = node->children[len - 1 - i];
+      }
+    }
+
+    memcpy(&p->syms[p->top], &t->prod_syms[from], sizeof(int) * len);
+    p->top += len - 1;
+  }
+
+  return 0;
+}
+
+int ll1_feed(ll1_push_parser *p, const char *chunk, int len) {
+  if (p == NULL || (chunk == NULL && len != 0) || len < 0)
+    return LL1_PUSH_FAILED;
+
+  if (p->status != LL1_PUSH_RUNNING)
+    return p->status;
+
+  ll1_table *t = p->table;
+
+  for (int i = 0; i < len; i++) {
+    int col = t->terminal_cols[(unsigned char)chunk[i]];
+
+    if (col == LL1_NO_INDEX ||
+        ll1_push_parser_expand(p, col) != 0 || p->top < 0 ||
+        p->syms[p->top] != col) {
+      p->status = LL1_PUSH_FAILED;
+      return p->status;
+    }
+
+    p->top--;
+    p->offset++;
+  }
+
+  return p->status;
+}
+
+int ll1_finish(ll1_push_parser *p) {
+  if (p == NULL)
+    return LL1_PUSH_FAILED;
+
+  if (p->status != LL1_PUSH_RUNNING)
+    return p->status;
+
+  if (ll1_push_parser_expand(p, LL1_END_COL) != 0 || p->top >= 0) {
+    p->status = LL1_PUSH_FAILED;
+    return p->status;
+  }
+
+  p->status = LL1_PUSH_ACCEPTED;
+  return p->status;
+}
+
+void free_ll1_push_parser(ll1_push_parser *p) {
+  free(p->syms);
+  free(p->nodes);
+  free(p);
+}
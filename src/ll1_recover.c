@@ -0,0 +1,320 @@
+#include "../include/ll1_internal.h"
+
+// offset is the byte or token that did not fit, found its column or
+// LL1_NO_INDEX and sym what was on top of the stack. the terminals that would
+// have fit are at expected[i * words] for error i, skipped counts the input
+// thrown away to get back in sync.
+ll1_parse_errors *new_ll1_parse_errors(ll1_table *table) {
+  if (table == NULL)
+    return NULL;
+
+  ll1_parse_errors *e = (ll1_parse_errors *)malloc(sizeof(ll1_parse_errors));
+  if (e == NULL)
+    return NULL;
+
+  e->len = 0;
+  e->max = LL1_PARSE_ERRORS_INITIAL_LEN;
+  e->words = bitset_words(table->cols);
+  e->data = (ll1_parse_error *)malloc(sizeof(ll1_parse_error) * e->max);
+  e->expected = new_bitset(e->words * e->max);
+
+  if (e->data == NULL || e->expected == NULL) {
+    free_ll1_parse_errors(e);
+    return NULL;
+  }
+
+  return e;
+}
+
+// the column of input i, LL1_END_COL past the end
+static int ll1_recover_col(ll1_table *t, const char *str, const int *tokens,
+                           int len, int i) {
+  if (i >= len)
+    return LL1_END_COL;
+
+  return str != NULL ? t->terminal_cols[(unsigned char)str[i]]
+                     : ll1_table_token_col(t, tokens[i]);
+}
+
+// puts an error leaf under a variable, or among the siblings of a terminal
+// right before it
+static int ll1_recover_mark(ll1_parse_tree *tree, ll1_parse_node *node) {
+  ll1_parse_node *parent = symbol_is_var(node->sym) ? node : node->parent;
+
+  if (ll1_parse_tree_add_child(tree, parent, SYMBOL_ERROR, 0) !=
+      PARSE_TREE_ADD_NODE_SUCCESS)
+    return -1;
+
+  if (parent == node)
+    return 0;
+
+  int k = parent->children_len - 1;
+  ll1_parse_node *leaf = parent->children[k];
+
+  for (; parent->children[k - 1] != node; k--)
+    parent->children[k] = parent->children[k - 1];
+
+  parent->children[k] = node;
+  parent->children[k - 1] = leaf;
+
+  return 0;
+}
+
+// records an error at input i with node on top of the stack, the caller
+// marks it in the tree. returns the index of the error.
+static int ll1_recover_error(ll1_table *t, ll1_parse_errors *e,
+                             ll1_parse_node *node, int i, int col) {
+  if (e->len == e->max) {
+    int max = e->max * 2;
+
+    ll1_parse_error *data =
+        (ll1_parse_error *)realloc(e->data, sizeof(ll1_parse_error) * max);
+    if (data == NULL)
+      return -1;
+
+    e->data = data;
+
+    bitset_word *expected = (bitset_word *)realloc(
+        e->expected, sizeof(bitset_word) * e->words * max);
+    if (expected == NULL)
+      return -1;
+
+    e->expected = expected;
+    e->max = max;
+  }
+
+  ll1_parse_error *err = &e->data[e->len];
+  bitset_word *expected = &e->expected[e->len * e->words];
+
+  err->offset = i;
+  err->found = col;
+  err->sym = node->sym;
+  err->skipped = 0;
+
+  bitset_clear(expected, e->words);
+
+  if (symbol_is_terminal(node->sym)) {
+    bitset_set(expected, symbol_index(node->sym));
+  } else {
+    int *row = &t->cells[symbol_index(node->sym) * t->cols];
+
+    for (int j = 0; j < t->cols; j++) {
+      if (row[j] != LL1_NO_PRODUCTION)
+        bitset_set(expected, j);
+    }
+  }
+
+  return e->len++;
+}
+
+// panic mode: a variable with no prediction for the input skips it up to
+// something the variable can start with, and then is expanded after all, or
+// up to something in its FOLLOW set or the end, and then is given up. a
+// terminal that does not match is taken as missing. input no terminal
+// matches is skipped right away. every step consumes input or pops the
+// stack, so the parse always ends.
+static int recover_parse_tree_stack(ll1_table *table, ff_table *fft,
+                                    ll1_parse_tree *tree,
+                                    ll1_parse_node_stack *node_s,
+                                    const char *str, const int *tokens,
+                                    int len, ll1_parse_errors *errors) {
+  int i = 0;
+  ll1_parse_node *node;
+
+  while (!ll1_parse_node_stack_is_empty(node_s)) {
+    if (ll1_parse_node_stack_pop(node_s, &node) != 0)
+      return STRING_PARSE_ERROR;
+
+    int col = ll1_recover_col(table, str, tokens, len, i);
+
+    if (col == LL1_NO_INDEX) {
+      int e = ll1_recover_error(table, errors, node, i, col);
+      if (e < 0 || ll1_recover_mark(tree, node) != 0)
+        return STRING_PARSE_ERROR;
+
+      while (col == LL1_NO_INDEX) {
+        errors->data[e].skipped++;
+        col = ll1_recover_col(table, str, tokens, len, ++i);
+      }
+    }
+
+    symbol_id sym = node->sym;
+
+    if (symbol_is_terminal(sym)) {
+      // a missing terminal becomes the error leaf
+      if (i < len && symbol_index(sym) == col)
+        i++;
+      else if (ll1_recover_error(table, errors, node, i, col) < 0)
+        return STRING_PARSE_ERROR;
+      else
+        node->sym = SYMBOL_ERROR;
+      continue;
+    }
+
+    int *row = &table->cells[symbol_index(sym) * table->cols];
+    int p = row[col];
+
+    if (p == LL1_NO_PRODUCTION) {
+      int e = ll1_recover_error(table, errors, node, i, col);
+      if (e < 0 || ll1_recover_mark(tree, node) != 0)
+        return STRING_PARSE_ERROR;
+
+      bitset_word *follow = ff_follow_set(fft, sym);
+
+      while (i < len) {
+        col = ll1_recover_col(table, str, tokens, len, i);
+
+        if (col != LL1_NO_INDEX &&
+            (row[col] != LL1_NO_PRODUCTION || bitset_test(follow, col)))
+          break;
+
+        errors->data[e].skipped++;
+        i++;
+      }
+
+      if (i == len)
+        col = LL1_END_COL;
+
+      p = row[col];
+      if (p == LL1_NO_PRODUCTION)
+        continue;
+    }
+
+    production_rhs *rhs = table->prods[p];
+    int base = node->children_len;
+
+    if (rhs->len == 0) {
+      if (ll1_parse_tree_add_child(tree, node, SYMBOL_EPSILON, 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
+        return STRING_PARSE_ERROR;
+      continue;
+    }
+
+    if (ll1_parse_node_reserve_children(tree, node, rhs->len) !=
+        PARSE_TREE_ADD_NODE_SUCCESS)
+      return STRING_PARSE_ERROR;
+
+    for (int k = 0; k < rhs->len; k++) {
+      if (ll1_parse_tree_add_child(tree, node, rhs->syms[k], 0) !=
+          PARSE_TREE_ADD_NODE_SUCCESS)
+        return STRING_PARSE_ERROR;
+    }
+
+    for (int k = rhs->len - 1; k >= 0; k--) {
+      if (ll1_parse_node_stack_push(node_s, node->children[base + k]) != 0)
+        return STRING_PARSE_ERROR;
+    }
+  }
+
+  // input left over once the start variable is done
+  if (i < len) {
+    int e = ll1_recover_error(table, errors, tree->root, i,
+                              ll1_recover_col(table, str, tokens, len, i));
+    if (e < 0 || ll1_recover_mark(tree, tree->root) != 0)
+      return STRING_PARSE_ERROR;
+
+    // it was counted as expecting the row of the start variable
+    bitset_word *expected = &errors->expected[e * errors->words];
+
+    bitset_clear(expected, errors->words);
+    bitset_set(expected, LL1_END_COL);
+    errors->data[e].sym = terminal_symbol(LL1_END_COL);
+    errors->data[e].skipped = len - i;
+  }
+
+  return errors->len == 0 ? STRING_PARSE_SUCCESS : STRING_PARSE_RECOVERED;
+}
+
+static int recover_parse_tree(ll1_table *table, ff_table *fft,
+                              ll1_parse_tree *tree, symbol_id start_var,
+                              const char *str, const int *tokens, int len,
+                              ll1_parse_errors *errors) {
+  if (!symbol_is_var(start_var) || symbol_index(start_var) >= table->vars_len)
+    return STRING_PARSE_ERROR;
+
+  errors->len = 0;
+
+  if (ll1_parse_tree_reset(tree, start_var) != PARSE_TREE_ADD_NODE_SUCCESS)
+    return STRING_PARSE_ERROR;
+
+  ll1_parse_node_stack *node_s =
+      new_ll1_parse_node_stack(table->terminals_len * 2);
+  if (node_s == NULL)
+    return STRING_PARSE_ERROR;
+
+  int res = STRING_PARSE_ERROR;
+
+  if (ll1_parse_node_stack_push(node_s, tree->root) == 0)
+    res = recover_parse_tree_stack(table, fft, tree, node_s, str, tokens, len,
+                                   errors);
+
+  free_ll1_parse_node_stack(node_s);
+
+  return res;
+}
+
+// like fill_parse_tree_with_string, but a mismatch is recorded in errors and
+// the parse goes on, so one pass finds every error. returns
+// STRING_PARSE_RECOVERED when there were some, the tree then holds error
+// leaves where they were found.
+int recover_parse_tree_with_string(ll1_table *table, ff_table *fft,
+                                   ll1_parse_tree *tree, symbol_id start_var,
+                                   const char *str, int str_len,
+                                   ll1_parse_errors *errors) {
+  if (table == NULL || fft == NULL || tree == NULL || errors == NULL ||
+      (str == NULL && str_len != 0) || str_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return recover_parse_tree(table, fft, tree, start_var, str, NULL, str_len,
+                            errors);
+}
+
+int recover_parse_tree_with_tokens(ll1_table *table, ff_table *fft,
+                                   ll1_parse_tree *tree, symbol_id start_var,
+                                   const int *tokens, int tokens_len,
+                                   ll1_parse_errors *errors) {
+  if (table == NULL || fft == NULL || tree == NULL || errors == NULL ||
+      (tokens == NULL && tokens_len != 0) || tokens_len < 0)
+    return STRING_PARSE_ERROR;
+
+  return recover_parse_tree(table, fft, tree, start_var, NULL, tokens,
+                            tokens_len, errors);
+}
+
+void print_ll1_parse_errors(ll1_parse_errors *e, symbol_table *s) {
+  printf("Parse Errors: %d\n", e->len);
+
+  for (int i = 0; i < e->len; i++) {
+    ll1_parse_error *err = &e->data[i];
+    bitset_word *expected = &e->expected[i * e->words];
+    const char *sep = "";
+
+    if (err->found == LL1_NO_INDEX)
+      printf("   at %d: unknown input", err->offset);
+    else
+      printf("   at %d: found %s", err->offset,
+             symbol_name(s, terminal_symbol(err->found)));
+
+    printf(", expected ");
+
+    for (int w = 0; w < e->words; w++) {
+      for (bitset_word bits = expected[w]; bits != 0; bits &= bits - 1) {
+        int j = w * BITSET_WORD_BITS + __builtin_ctzll(bits);
+
+        printf("%s%s", sep, symbol_name(s, terminal_symbol(j)));
+        sep = " ";
+      }
+    }
+
+    if (err->skipped > 0)
+      printf(", skipped %d", err->skipped);
+
+    printf("\n");
+  }
+}
+
+void free_ll1_parse_errors(ll1_parse_errors *e) {
+  free(e->data);
+  free(e->expected);
+  free(e);
+}
@@ -1,70 +1,541 @@
 #include "../include/grammar.h"
+#include "../include/grammar_file.h"
+#include "../include/grammar_gen.h"
+#include "../include/grammar_transform.h"
+#include "../include/lexer.h"
 #include "../include/ll1.h"
-#include "../include/util.h"
+#include "../include/ll1_codegen.h"
 
-int main() {
-  char str[1024];
-  int c;
+#define MAIN_READ_CHUNK 65536
 
-  c = get_input("Enter string: ", str, sizeof(str));
+#define MAIN_PRINT_TREE 1
+#define MAIN_PRINT_TABLE 2
+#define MAIN_PRINT_SETS 4
+#define MAIN_PRINT_VERDICT 8
+#define MAIN_PRINT_STATS 16
+#define MAIN_PRINT_ERRORS 32
 
-  if (c == NO_INPUT) {
-    printf("No input provided for string\n");
-    return -1;
+#define MAIN_ACCEPTED 0
+#define MAIN_REJECTED 1
+#define MAIN_FAILED 2
+
+// used when no --grammar is given
+static const char *default_grammar =
+    "<S> ::= <A> <B> ;\n"
+    "<A> ::= <C> <D> ;\n"
+    "<B> ::= \"+\" <A> <B> | eps ;\n"
+    "<C> ::= <I> | \"(\" <S> \")\" ;\n"
+    "<D> ::= \"*\" <C> <D> | eps ;\n"
+    "<I> ::= \"a\" | \"b\" | \"c\" | \"d\" ;\n";
+
+static void print_usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [--grammar FILE] [--tree] [--table] [--sets] "
+          "[--verdict] [--stats] [--errors] [--transform]\n"
+          "          [INPUT]\n"
+          "       %s [--grammar FILE] --generate BYTES [--near-miss] "
+          "[--seed N]\n"
+          "       %s [--grammar FILE] [--transform] --emit-parser PREFIX\n"
+          "\n"
+          "parses INPUT (or stdin) with the grammar in FILE, or with a small\n"
+          "arithmetic grammar when there is none. grammars with patterns or\n"
+          "multi byte literals are lexed first, otherwise every byte is a\n"
+          "terminal and one trailing newline is ignored.\n"
+          "\n"
+          "  --tree       print the parse tree (the default)\n"
+          "  --table      print the LL(1) table\n"
+          "  --sets       print the FIRST and FOLLOW sets\n"
+          "  --verdict    only print whether the input is accepted\n"
+          "  --stats      print the parser counters, needs a build with\n"
+          "               -DLL1_STATS (make build-stats)\n"
+          "  --errors     list every error of a rejected input, recovering\n"
+          "               at the FOLLOW set of the failing variable\n"
+          "  --transform  remove left recursion and common prefixes first,\n"
+          "               trees are still printed for the grammar in FILE\n"
+          "  --generate   write a random sentence of about BYTES to stdout\n"
+          "  --near-miss  with --generate, break the sentence at one token\n"
+          "  --seed       seed of the generator\n"
+          "  --emit-parser\n"
+          "               write a recursive descent parser in C for the\n"
+          "               grammar to stdout, its functions start with PREFIX\n"
+          "\n"
+          "exits with 0 when the input is accepted, 1 when it is rejected\n"
+          "and 2 on any other error.\n",
+          name, name, name);
+}
+
+static char *read_all(FILE *f, int *len) {
+  int max = MAIN_READ_CHUNK;
+  char *buff = (char *)malloc(max);
+
+  *len = 0;
+
+  while (buff != NULL) {
+    if (*len == max) {
+      if (max > 0x3fffffff) {
+        free(buff);
+        return NULL;
+      }
+
+      char *temp = (char *)realloc(buff, max * 2);
+      if (temp == NULL) {
+        free(buff);
+        return NULL;
+      }
+
+      buff = temp;
+      max *= 2;
+    }
+
+    size_t n = fread(buff + *len, 1, max - *len, f);
+    *len += n;
+
+    if (n == 0) {
+      if (ferror(f)) {
+        free(buff);
+        return NULL;
+      }
+      break;
+    }
   }
 
-  if (c == TOO_LONG) {
-    printf("String is too long\n");
-    return -1;
+  return buff;
+}
+
+// single byte literals name their terminal directly, anything else needs
+// the lexer
+static int grammar_needs_lexer(grammar *g) {
+  for (int i = 0; i < g->tokens_len; i++) {
+    token_def *t = &g->tokens[i];
+
+    if (t->kind != TOKEN_LITERAL || t->len != 1 ||
+        t->terminal == SYMBOL_NONE)
+      return 1;
   }
 
-  grammar *g = new_grammar("SABCDI", "+*abcd", 'S');
-  add_production(g, 'S', "AB");
-  add_production(g, 'A', "CD");
-  add_production(g, 'B', "+AB");
-  add_production(g, 'B', "epsilon");
-  add_production(g, 'C', "I");
-  add_production(g, 'C', "(S)");
-  add_production(g, 'D', "*CD");
-  add_production(g, 'D', "epsilon");
-  add_production(g, 'I', "a");
-  add_production(g, 'I', "b");
-  add_production(g, 'I', "c");
-  add_production(g, 'I', "d");
+  return 0;
+}
+
+// parses a rejected input again, going on after each error. offsets of
+// tokens are turned into byte offsets.
+static void print_input_errors(grammar *g, ll1_table *t, ff_table *fft,
+                               lexer_tokens *tokens, const char *str, int len,
+                               int print) {
+  ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+  ll1_parse_errors *errors = new_ll1_parse_errors(t);
+  int res = STRING_PARSE_ERROR;
 
-  print_grammar(g);
+  if (tree != NULL && errors != NULL && tokens != NULL)
+    res = recover_parse_tree_with_tokens(t, fft, tree, g->start_var,
+                                         tokens->cols, tokens->len, errors);
+  else if (tree != NULL && errors != NULL)
+    res = recover_parse_tree_with_string(t, fft, tree, g->start_var, str, len,
+                                         errors);
 
-  ff_table *fft = new_ff_table(g);
-  calculate_firsts(g, fft);
-  int e = calculate_follows(g, fft);
-  if (e == GRAMMAR_IS_NOT_LL1) {
-    printf("Grammar is not ll(1)\n");
+  if (res == STRING_PARSE_ERROR) {
+    fprintf(stderr, "cannot recover from the errors\n");
+  } else {
+    for (int i = 0; tokens != NULL && i < errors->len; i++) {
+      int offset = errors->data[i].offset;
+      errors->data[i].offset = offset < tokens->len ? tokens->offsets[offset]
+                                                    : len;
+    }
 
-    free_ff_table(fft);
-    free_grammar(g);
+    print_ll1_parse_errors(errors, g->symbols);
 
-    return 1;
+    if (print & MAIN_PRINT_TREE)
+      print_ll1_parse_tree(tree, g->symbols);
   }
-  print_ff_table(fft);
 
-  ll1_table *ll1_t = new_ll1_table(g, fft);
-  print_ll1_table(ll1_t);
+  if (tree != NULL)
+    free_ll1_parse_tree(tree);
+  if (errors != NULL)
+    free_ll1_parse_errors(errors);
+}
+
+// trees of a transformed grammar are printed for the source grammar
+static void print_input_tree(grammar *g, grammar_transform *gt,
+                             ll1_parse_tree *tree) {
+  if (gt == NULL) {
+    print_ll1_parse_tree(tree, g->symbols);
+    return;
+  }
 
-  int str_len = strlen((char *)str);
-  ll1_parse_tree *tree;
-  int f =
-      create_parse_tree_with_string(ll1_t, &tree, g->start_var, str, str_len);
+  ll1_parse_tree *restored = grammar_transform_restore_tree(gt, tree);
 
-  if (f == STRING_PARSE_SUCCESS) {
-    print_ll1_parse_tree(tree);
+  if (restored != NULL) {
+    print_ll1_parse_tree(restored, gt->source->symbols);
+    free_ll1_parse_tree(restored);
   } else {
-    printf("String cannot be parsed\n");
+    printf("accepted, but the tree could not be restored\n");
+  }
+}
+
+// feeds in to the push parser a chunk at a time, so the input is never held
+// in memory and a tree is only kept when it is printed. the last two bytes
+// read are held back until the end, when one trailing newline is dropped.
+static int stream_input(grammar *g, grammar_transform *gt, ll1_table *t,
+                        FILE *in, int print) {
+  ll1_parse_tree *tree = NULL;
+
+  if (print & MAIN_PRINT_TREE) {
+    tree = new_ll1_parse_tree(g->start_var);
+    if (tree == NULL) {
+      fprintf(stderr, "out of memory\n");
+      return MAIN_FAILED;
+    }
+  }
+
+  ll1_push_parser *p = new_ll1_push_parser(t, g->start_var, tree);
+  char *chunk = (char *)malloc(MAIN_READ_CHUNK + 2);
+  int held = 0;
+  int status = LL1_PUSH_RUNNING;
+
+  if (p == NULL || chunk == NULL) {
+    fprintf(stderr, "out of memory\n");
+    status = LL1_PUSH_FAILED;
+  }
+
+  while (status == LL1_PUSH_RUNNING) {
+    size_t n = fread(chunk + held, 1, MAIN_READ_CHUNK, in);
+    int len = held + n;
+
+    if (n == 0)
+      break;
+
+    held = len < 2 ? len : 2;
+    status = ll1_feed(p, chunk, len - held);
+    memmove(chunk, chunk + len - held, held);
+  }
+
+  int res = MAIN_ACCEPTED;
+
+  if (p == NULL || chunk == NULL || ferror(in)) {
+    if (p != NULL && chunk != NULL)
+      fprintf(stderr, "cannot read the input\n");
+    res = MAIN_FAILED;
+  } else {
+    if (status == LL1_PUSH_RUNNING) {
+      if (held > 0 && chunk[held - 1] == '\n')
+        held--;
+      if (held > 0 && chunk[held - 1] == '\r')
+        held--;
+
+      status = ll1_feed(p, chunk, held);
+    }
+
+    if (status == LL1_PUSH_RUNNING)
+      status = ll1_finish(p);
+
+    if (status != LL1_PUSH_ACCEPTED) {
+      printf("rejected at offset %ld\n", p->offset);
+      res = MAIN_REJECTED;
+    } else {
+      if (print & MAIN_PRINT_TREE)
+        print_input_tree(g, gt, tree);
+      if (print & MAIN_PRINT_VERDICT)
+        printf("accepted\n");
+    }
+  }
+
+  if (p != NULL)
+    free_ll1_push_parser(p);
+  if (tree != NULL)
+    free_ll1_parse_tree(tree);
+  free(chunk);
+
+  return res;
+}
+
+// returns MAIN_ACCEPTED or MAIN_REJECTED, reporting where the input failed
+static int parse_input(grammar *g, grammar_transform *gt, ll1_table *t,
+                       ff_table *fft, lexer *l, const char *str, int len,
+                       int print) {
+  lexer_tokens *tokens = NULL;
+  int offset = STRING_RECOGNIZE_SUCCESS;
+
+  if (l != NULL) {
+    tokens = new_lexer_tokens(LEXER_TOKENS_INITIAL_LEN);
+    if (tokens == NULL) {
+      fprintf(stderr, "out of memory\n");
+      return MAIN_FAILED;
+    }
+
+    int res = lex_string(l, str, len, tokens);
+    if (res != LEXER_SUCCESS) {
+      if (res >= 0)
+        printf("rejected: no token at offset %d\n", res);
+      else
+        printf("rejected: cannot lex the input\n");
+
+      free_lexer_tokens(tokens);
+      return MAIN_REJECTED;
+    }
+
+    offset = ll1_recognize_tokens(t, g->start_var, tokens->cols, tokens->len);
+    if (offset >= 0)
+      offset = offset < tokens->len ? tokens->offsets[offset] : len;
+  } else {
+    offset = ll1_recognize(t, g->start_var, str, len);
+  }
+
+  if (offset != STRING_RECOGNIZE_SUCCESS) {
+    if (offset >= 0)
+      printf("rejected at offset %d\n", offset);
+    else
+      printf("rejected\n");
+
+    if (offset >= 0 && (print & MAIN_PRINT_ERRORS))
+      print_input_errors(g, t, fft, tokens, str, len, print);
+
+    if (tokens != NULL)
+      free_lexer_tokens(tokens);
+    return MAIN_REJECTED;
+  }
+
+  if (print & (MAIN_PRINT_TREE | MAIN_PRINT_STATS)) {
+    ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+    ll1_parse_stats stats;
+    int res = STRING_PARSE_ERROR;
+
+    memset(&stats, 0, sizeof(stats));
+
+    if (tree != NULL && tokens != NULL)
+      res = fill_parse_tree_with_tokens(t, tree, g->start_var, tokens->cols,
+                                        tokens->len, &stats);
+    else if (tree != NULL)
+      res = fill_parse_tree_with_string(t, tree, g->start_var, str, len,
+                                        &stats);
+
+    if (res == STRING_PARSE_SUCCESS && (print & MAIN_PRINT_TREE))
+      print_input_tree(g, gt, tree);
+    else if (res != STRING_PARSE_SUCCESS)
+      printf("accepted, but the tree could not be built\n");
+
+    if (print & MAIN_PRINT_STATS) {
+      if (LL1_STATS_ENABLED)
+        print_ll1_parse_stats(&stats);
+      else
+        fprintf(stderr, "built without LL1_STATS, nothing was counted\n");
+    }
+
+    if (tree != NULL)
+      free_ll1_parse_tree(tree);
+  }
+
+  if (print & MAIN_PRINT_VERDICT)
+    printf("accepted\n");
+
+  if (tokens != NULL)
+    free_lexer_tokens(tokens);
+  return MAIN_ACCEPTED;
+}
+
+// a transformed grammar goes with its transform, the source after it
+static void free_main_grammar(grammar *g, grammar_transform *gt) {
+  if (gt != NULL) {
+    g = gt->source;
+    free_grammar_transform(gt);
   }
 
-  free_ll1_parse_tree(tree);
-  free_ll1_table(ll1_t);
-  free_ff_table(fft);
   free_grammar(g);
+}
 
-  return 0;
+// writes one sentence to stdout, the grammar is released here
+static int generate_sentence(grammar *g, long bytes, int near_miss,
+                             unsigned long long seed) {
+  grammar_gen *gen = new_grammar_gen(g, seed);
+  long res = GRAMMAR_GEN_ERROR;
+
+  if (gen != NULL)
+    res = near_miss ? grammar_gen_near_miss(gen, bytes, stdout)
+                    : grammar_gen_sentence(gen, bytes, stdout);
+
+  if (res == GRAMMAR_GEN_NO_SENTENCE)
+    fprintf(stderr, "the start variable derives no finite sentence\n");
+  else if (res == GRAMMAR_GEN_NO_NEAR_MISS)
+    fprintf(stderr, "every terminal can follow, there is no near miss\n");
+  else if (res < 0)
+    fprintf(stderr, "cannot generate a sentence\n");
+  else
+    putchar('\n');
+
+  free_grammar_gen(gen);
+  free_grammar(g);
+
+  return res >= 0 ? MAIN_ACCEPTED : MAIN_FAILED;
+}
+
+int main(int argc, char **argv) {
+  const char *grammar_path = NULL;
+  const char *input_path = NULL;
+  int print = 0;
+  long generate = -1;
+  int near_miss = 0;
+  int transform = 0;
+  unsigned long long seed = 0;
+  const char *emit_prefix = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--grammar") == 0 && i + 1 < argc) {
+      grammar_path = argv[++i];
+    } else if (strcmp(argv[i], "--tree") == 0) {
+      print |= MAIN_PRINT_TREE;
+    } else if (strcmp(argv[i], "--table") == 0) {
+      print |= MAIN_PRINT_TABLE;
+    } else if (strcmp(argv[i], "--sets") == 0) {
+      print |= MAIN_PRINT_SETS;
+    } else if (strcmp(argv[i], "--verdict") == 0) {
+      print |= MAIN_PRINT_VERDICT;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      print |= MAIN_PRINT_STATS;
+    } else if (strcmp(argv[i], "--errors") == 0) {
+      print |= MAIN_PRINT_ERRORS;
+    } else if (strcmp(argv[i], "--transform") == 0) {
+      transform = 1;
+    } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generate = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--near-miss") == 0) {
+      near_miss = 1;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--emit-parser") == 0 && i + 1 < argc) {
+      emit_prefix = argv[++i];
+    } else if (argv[i][0] != '-' && input_path == NULL) {
+      input_path = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return MAIN_FAILED;
+    }
+  }
+
+  if ((print & ~MAIN_PRINT_ERRORS) == 0)
+    print |= MAIN_PRINT_TREE;
+
+  grammar_file_error err;
+  grammar *g = grammar_path != NULL
+                   ? new_grammar_from_file(grammar_path, &err)
+                   : new_grammar_from_text(default_grammar,
+                                           strlen(default_grammar), &err);
+
+  if (g == NULL) {
+    if (err.line > 0)
+      fprintf(stderr, "%s:%d:%d: %s\n",
+              grammar_path != NULL ? grammar_path : "default grammar",
+              err.line, err.col, err.msg);
+    else
+      fprintf(stderr, "%s\n", err.msg);
+    return MAIN_FAILED;
+  }
+
+  if (generate >= 0)
+    return generate_sentence(g, generate, near_miss, seed);
+
+  grammar_transform *gt = NULL;
+
+  if (transform) {
+    int tres = GRAMMAR_TRANSFORM_ERROR;
+
+    gt = new_grammar_transform(g, &tres);
+    if (gt == NULL) {
+      if (tres == GRAMMAR_TRANSFORM_HIDDEN_RECURSION)
+        fprintf(stderr, "left recursion through variables deriving epsilon "
+                        "cannot be removed\n");
+      else
+        fprintf(stderr, "cannot transform the grammar\n");
+      free_grammar(g);
+      return MAIN_FAILED;
+    }
+
+    g = gt->g;
+  }
+
+  ff_table *fft = new_ff_table(g);
+  if (fft == NULL || calculate_firsts(g, fft) != SUCCESS_ON_FIRST_CALC ||
+      calculate_follows(g, fft) != SUCCESS_ON_FOLLOW_CALC) {
+    fprintf(stderr, "cannot compute FIRST and FOLLOW sets\n");
+    if (fft != NULL)
+      free_ff_table(fft);
+    free_main_grammar(g, gt);
+    return MAIN_FAILED;
+  }
+
+  if (print & MAIN_PRINT_SETS)
+    print_ff_table(fft);
+
+  ll1_table *t = new_ll1_table(g, fft);
+  if (t == NULL) {
+    ll1_conflicts *c = new_ll1_conflicts(g, fft);
+
+    fprintf(stderr, "Grammar is not ll(1)\n");
+    if (c != NULL && c->len > 0)
+      print_ll1_conflicts(c);
+    if (c != NULL)
+      free_ll1_conflicts(c);
+
+    free_ff_table(fft);
+    free_main_grammar(g, gt);
+    return MAIN_FAILED;
+  }
+
+  if (print & MAIN_PRINT_TABLE)
+    print_ll1_table(t);
+
+  int res = MAIN_ACCEPTED;
+
+  if (emit_prefix != NULL) {
+    if (ll1_generate_parser(stdout, t, g->start_var, emit_prefix) !=
+        LL1_CODEGEN_SUCCESS) {
+      fprintf(stderr, "cannot write a parser with prefix %s\n", emit_prefix);
+      res = MAIN_FAILED;
+    }
+  } else if (print & (MAIN_PRINT_TREE | MAIN_PRINT_VERDICT | MAIN_PRINT_STATS)) {
+    int needs_lexer = grammar_needs_lexer(g);
+    lexer *l = needs_lexer ? new_lexer(g) : NULL;
+    FILE *in = input_path != NULL ? fopen(input_path, "rb") : stdin;
+    int len = 0;
+    char *str = NULL;
+
+    // the lexer needs the whole input, so do the error listing and the
+    // counters of the tree builders, everything else is streamed
+    int buffered =
+        needs_lexer || (print & (MAIN_PRINT_ERRORS | MAIN_PRINT_STATS));
+
+    if (in != NULL && !buffered) {
+      res = stream_input(g, gt, t, in, print);
+    } else if (in != NULL) {
+      str = read_all(in, &len);
+    }
+
+    if (in != NULL && in != stdin)
+      fclose(in);
+
+    if (in != NULL && !buffered) {
+      // streamed above
+    } else if (str == NULL) {
+      fprintf(stderr, "cannot read %s\n",
+              input_path != NULL ? input_path : "stdin");
+      res = MAIN_FAILED;
+    } else if (needs_lexer && l == NULL) {
+      fprintf(stderr, "cannot build the lexer for the token definitions\n");
+      res = MAIN_FAILED;
+    } else {
+      if (!needs_lexer && len > 0 && str[len - 1] == '\n')
+        len--;
+      if (!needs_lexer && len > 0 && str[len - 1] == '\r')
+        len--;
+
+      res = parse_input(g, gt, t, fft, l, str, len, print);
+    }
+
+    if (l != NULL)
+      free_lexer(l);
+    free(str);
+  }
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_main_grammar(g, gt);
+
+  return res;
 }
@@ -0,0 +1,94 @@
+#include "../include/output.h"
+
+output_buffer *new_output_buffer(FILE *f, int max) {
+  if (f == NULL)
+    return NULL;
+
+  output_buffer *o = (output_buffer *)malloc(sizeof(output_buffer));
+  if (o == NULL)
+    return NULL;
+
+  o->f = f;
+  o->len = 0;
+  o->max = max > 0 ? max : OUTPUT_BUFFER_LEN;
+  o->failed = 0;
+  o->data = (char *)malloc(o->max);
+
+  if (o->data == NULL) {
+    free(o);
+    return NULL;
+  }
+
+  return o;
+}
+
+// going through f keeps the text in order with anything else printed there.
+// a failed write sticks, later writes are dropped and the next flush reports
+// it.
+static void output_drain(output_buffer *o) {
+  if (!o->failed && o->len > 0 &&
+      fwrite(o->data, 1, o->len, o->f) != (size_t)o->len)
+    o->failed = 1;
+
+  o->len = 0;
+}
+
+int output_flush(output_buffer *o) {
+  output_drain(o);
+
+  if (!o->failed && fflush(o->f) != 0)
+    o->failed = 1;
+
+  return o->failed ? OUTPUT_ERROR : OUTPUT_SUCCESS;
+}
+
+void output_write(output_buffer *o, const char *s, int len) {
+  while (len > 0) {
+    if (o->len == o->max)
+      output_drain(o);
+
+    int n = o->max - o->len < len ? o->max - o->len : len;
+
+    memcpy(o->data + o->len, s, n);
+    o->len += n;
+    s += n;
+    len -= n;
+  }
+}
+
+void output_str(output_buffer *o, const char *s) {
+  output_write(o, s, strlen(s));
+}
+
+void output_char(output_buffer *o, char c) {
+  if (o->len == o->max)
+    output_drain(o);
+
+  o->data[o->len++] = c;
+}
+
+void output_fill(output_buffer *o, char c, int n) {
+  while (n > 0) {
+    if (o->len == o->max)
+      output_drain(o);
+
+    int k = o->max - o->len < n ? o->max - o->len : n;
+
+    memset(o->data + o->len, c, k);
+    o->len += k;
+    n -= k;
+  }
+}
+
+void output_int(output_buffer *o, long v) {
+  char buff[24];
+  int len = snprintf(buff, sizeof(buff), "%ld", v);
+
+  output_write(o, buff, len);
+}
+
+// the buffer is not flushed here, that is up to the caller
+void free_output_buffer(output_buffer *o) {
+  free(o->data);
+  free(o);
+}
@@ -0,0 +1,190 @@
+#include "../include/symbol.h"
+
+static unsigned int symbol_hash(const char *name, int len) {
+  unsigned int h = 2166136261u;
+
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char)name[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static int init_symbol_names(symbol_names *n) {
+  n->len = 0;
+  n->max = SYMBOL_NAMES_INITIAL_LEN;
+  n->buckets_len = SYMBOL_NAMES_INITIAL_LEN * 2;
+  n->names = (const char **)malloc(sizeof(char *) * n->max);
+  n->name_lens = (int *)malloc(sizeof(int) * n->max);
+  n->buckets = (int *)calloc(n->buckets_len, sizeof(int));
+
+  if (n->names == NULL || n->name_lens == NULL || n->buckets == NULL)
+    return -1;
+
+  return 0;
+}
+
+static void free_symbol_names(symbol_names *n) {
+  free(n->names);
+  free(n->name_lens);
+  free(n->buckets);
+}
+
+// buckets hold index + 1 of the name, 0 marks an empty bucket
+static int find_symbol_name(symbol_names *n, const char *name, int len) {
+  unsigned int mask = n->buckets_len - 1;
+  unsigned int b = symbol_hash(name, len) & mask;
+
+  while (n->buckets[b] != 0) {
+    int i = n->buckets[b] - 1;
+
+    if (n->name_lens[i] == len && memcmp(n->names[i], name, len) == 0)
+      return i;
+
+    b = (b + 1) & mask;
+  }
+
+  return -1;
+}
+
+static int symbol_names_increase(symbol_names *n) {
+  int max = n->max * 2;
+
+  const char **names = (const char **)realloc(n->names, sizeof(char *) * max);
+  if (names == NULL)
+    return -1;
+  n->names = names;
+
+  int *name_lens = (int *)realloc(n->name_lens, sizeof(int) * max);
+  if (name_lens == NULL)
+    return -1;
+  n->name_lens = name_lens;
+
+  int buckets_len = max * 2;
+  int *buckets = (int *)calloc(buckets_len, sizeof(int));
+  if (buckets == NULL)
+    return -1;
+
+  for (int i = 0; i < n->len; i++) {
+    unsigned int b =
+        symbol_hash(n->names[i], n->name_lens[i]) & (buckets_len - 1);
+
+    while (buckets[b] != 0)
+      b = (b + 1) & (buckets_len - 1);
+
+    buckets[b] = i + 1;
+  }
+
+  free(n->buckets);
+  n->buckets = buckets;
+  n->buckets_len = buckets_len;
+  n->max = max;
+
+  return 0;
+}
+
+static int intern_symbol_name(symbol_table *t, symbol_names *n,
+                              const char *name, int len) {
+  int i = find_symbol_name(n, name, len);
+  if (i >= 0)
+    return i;
+
+  if (n->len == n->max && symbol_names_increase(n) != 0)
+    return -1;
+
+  char *copy = (char *)arena_alloc(t->names_arena, len + 1);
+  if (copy == NULL)
+    return -1;
+
+  memcpy(copy, name, len);
+  copy[len] = '\0';
+
+  i = n->len++;
+  n->names[i] = copy;
+  n->name_lens[i] = len;
+
+  unsigned int mask = n->buckets_len - 1;
+  unsigned int b = symbol_hash(name, len) & mask;
+
+  while (n->buckets[b] != 0)
+    b = (b + 1) & mask;
+
+  n->buckets[b] = i + 1;
+
+  return i;
+}
+
+symbol_table *new_symbol_table() {
+  symbol_table *t = (symbol_table *)malloc(sizeof(symbol_table));
+  if (t == NULL)
+    return NULL;
+
+  memset(&t->vars, 0, sizeof(symbol_names));
+  memset(&t->terminals, 0, sizeof(symbol_names));
+
+  t->names_arena = new_arena(ARENA_DEFAULT_BLOCK_SIZE);
+  if (t->names_arena == NULL) {
+    free(t);
+    return NULL;
+  }
+
+  if (init_symbol_names(&t->vars) != 0 ||
+      init_symbol_names(&t->terminals) != 0 ||
+      intern_terminal(t, SYMBOL_TERMINATE_NAME,
+                      strlen(SYMBOL_TERMINATE_NAME)) != SYMBOL_TERMINATE) {
+    free_symbol_table(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+symbol_id intern_var(symbol_table *t, const char *name, int len) {
+  int i = intern_symbol_name(t, &t->vars, name, len);
+  return i < 0 ? SYMBOL_NONE : var_symbol(i);
+}
+
+symbol_id intern_terminal(symbol_table *t, const char *name, int len) {
+  int i = intern_symbol_name(t, &t->terminals, name, len);
+  return i < 0 ? SYMBOL_NONE : terminal_symbol(i);
+}
+
+symbol_id find_var(symbol_table *t, const char *name, int len) {
+  int i = find_symbol_name(&t->vars, name, len);
+  return i < 0 ? SYMBOL_NONE : var_symbol(i);
+}
+
+symbol_id find_terminal(symbol_table *t, const char *name, int len) {
+  int i = find_symbol_name(&t->terminals, name, len);
+  return i < 0 ? SYMBOL_NONE : terminal_symbol(i);
+}
+
+const char *symbol_name(symbol_table *t, symbol_id s) {
+  if (s == SYMBOL_EPSILON)
+    return SYMBOL_EPSILON_NAME;
+  if (s == SYMBOL_ERROR)
+    return SYMBOL_ERROR_NAME;
+  if (s == SYMBOL_NONE)
+    return "?";
+  if (symbol_is_var(s))
+    return t->vars.names[symbol_index(s)];
+
+  return t->terminals.names[symbol_index(s)];
+}
+
+int symbol_name_len(symbol_table *t, symbol_id s) {
+  if (s == SYMBOL_EPSILON || s == SYMBOL_ERROR || s == SYMBOL_NONE)
+    return strlen(symbol_name(t, s));
+  if (symbol_is_var(s))
+    return t->vars.name_lens[symbol_index(s)];
+
+  return t->terminals.name_lens[symbol_index(s)];
+}
+
+void free_symbol_table(symbol_table *t) {
+  free_symbol_names(&t->vars);
+  free_symbol_names(&t->terminals);
+  free_arena(t->names_arena);
+  free(t);
+}
@@ -0,0 +1,80 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// batches smaller than the number of lanes leave lanes idle for the whole
+// run, every verdict has to match ll1_recognize
+
+static const char *inputs[] = {"a",   "(a+b)*c", "a+",   "",    "((a))",
+                               "a*b", "b+c+d",   "(a+b", "d*d", "x"};
+
+static int check_batch(ll1_table *t, symbol_id start_var, int count) {
+  const char *strs[16];
+  int lens[16];
+  unsigned char accepted[2];
+  int expected = 0;
+  int failed = 0;
+
+  for (int i = 0; i < count; i++) {
+    strs[i] = inputs[i];
+    lens[i] = strlen(inputs[i]);
+  }
+
+  int res = ll1_recognize_batch(t, start_var, strs, lens, count, accepted);
+
+  for (int i = 0; i < count; i++) {
+    int want = ll1_recognize(t, start_var, strs[i], lens[i]) ==
+               STRING_RECOGNIZE_SUCCESS;
+    int got = (accepted[i / 8] >> (i % 8)) & 1;
+
+    expected += want;
+
+    if (want != got) {
+      printf("batch of %d: \"%s\" is %d, expected %d\n", count, strs[i], got,
+             want);
+      failed = 1;
+    }
+  }
+
+  if (res != expected) {
+    printf("batch of %d: %d accepted, expected %d\n", count, res, expected);
+    failed = 1;
+  }
+
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'A', "CD");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'C', "I");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+
+  int failed = 0;
+  int count = sizeof(inputs) / sizeof(inputs[0]);
+
+  for (int n = 1; n <= count; n++)
+    failed |= check_batch(t, g->start_var, n);
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("batch_recognize: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,109 @@
+#include "../include/grammar_file.h"
+#include "../include/ll1_compiled.h"
+#include <unistd.h>
+
+// every byte of a compiled file is damaged in turn. the loader either
+// rejects the file or hands out tables that can be parsed with and printed
+// without leaving their arrays.
+
+static const char *text = "<S> ::= <A> <B> ;\n"
+                          "<A> ::= <C> <D> ;\n"
+                          "<B> ::= \"+\" <A> <B> | eps ;\n"
+                          "<C> ::= <I> | \"(\" <S> \")\" ;\n"
+                          "<D> ::= \"*\" <C> <D> | eps ;\n"
+                          "<I> ::= \"a\" | \"b\" | \"c\" | \"d\" ;\n";
+
+static const unsigned char flips[] = {0x01, 0x80, 0xff};
+
+static void use_compiled(ll1_compiled *c, output_buffer *o) {
+  const char *input = "(a+b)*c";
+
+  ll1_recognize(&c->table, c->start_var, input, strlen(input));
+  find_var(&c->symbols, "S", 1);
+  find_terminal(&c->symbols, "?", 1);
+  write_ll1_table(o, &c->table);
+  write_ff_table(o, &c->ff);
+  output_flush(o);
+}
+
+int main() {
+  grammar_file_error err;
+  grammar *g = new_grammar_from_text(text, strlen(text), &err);
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+
+  char path[] = "/tmp/ll1_compiled_XXXXXX";
+  int fd = mkstemp(path);
+  int failed = fd < 0 || ll1_save_compiled(path, g, fft, t) != 0;
+
+  FILE *f = failed ? NULL : fopen(path, "rb");
+  char *data = NULL;
+  long size = 0;
+
+  if (f != NULL) {
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (char *)malloc(size);
+    failed = data == NULL || (long)fread(data, 1, size, f) != size;
+    fclose(f);
+  }
+
+  FILE *null_f = fopen("/dev/null", "w");
+  output_buffer *o = new_output_buffer(null_f, 0);
+  long loaded = 0;
+
+  for (long i = 0; !failed && i < size; i++) {
+    for (int k = 0; k < (int)sizeof(flips); k++) {
+      data[i] ^= flips[k];
+
+      f = fopen(path, "wb");
+      fwrite(data, 1, size, f);
+      fclose(f);
+
+      ll1_compiled *c = ll1_load_compiled(path, LL1_COMPILED_ANY_FINGERPRINT);
+      if (c != NULL) {
+        use_compiled(c, o);
+        free_ll1_compiled(c);
+        loaded++;
+      }
+
+      data[i] ^= flips[k];
+    }
+  }
+
+  // and the undamaged file still loads
+  if (!failed) {
+    f = fopen(path, "wb");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    ll1_compiled *c = ll1_load_compiled(path, LL1_COMPILED_ANY_FINGERPRINT);
+    if (c == NULL) {
+      printf("compiled_corrupt: the undamaged file does not load\n");
+      failed = 1;
+    } else {
+      free_ll1_compiled(c);
+    }
+  }
+
+  if (fd >= 0) {
+    close(fd);
+    remove(path);
+  }
+
+  free_output_buffer(o);
+  fclose(null_f);
+  free(data);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("compiled_corrupt: ok, %ld of %ld damaged files loaded\n", loaded,
+           size * (long)sizeof(flips));
+
+  return failed;
+}
@@ -0,0 +1,108 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// a nullable right hand side that claims a terminal through FIRST as well is
+// FIRST/FIRST, only a claim through FOLLOW alone is FIRST/FOLLOW
+
+// conflict i as "var terminal kind ids...", ids by the order of
+// add_production
+static void describe(ll1_conflicts *c, int i, char *buff, int len) {
+  ll1_conflict *conflict = &c->data[i];
+  int n = snprintf(buff, len, "%s %s %s",
+                   symbol_name(c->symbols, conflict->var),
+                   symbol_name(c->symbols, conflict->terminal),
+                   conflict->kind == LL1_CONFLICT_FIRST_FOLLOW ? "FOLLOW"
+                                                               : "FIRST");
+
+  for (int k = 0; k < conflict->ids_len && n < len; k++)
+    n += snprintf(buff + n, len - n, " %d",
+                  c->ids[conflict->ids_offset + k]);
+}
+
+static int check_conflicts(grammar *g, const char *name, const char **want,
+                           int want_len) {
+  ff_table *fft = new_ff_table(g);
+  int failed = calculate_firsts(g, fft) != SUCCESS_ON_FIRST_CALC ||
+               calculate_follows(g, fft) != SUCCESS_ON_FOLLOW_CALC;
+  ll1_conflicts *c = failed ? NULL : new_ll1_conflicts(g, fft);
+
+  if (c == NULL) {
+    printf("%s: no conflict list\n", name);
+    free_ff_table(fft);
+    return 1;
+  }
+
+  if (c->len != want_len) {
+    printf("%s: %d conflicts, expected %d\n", name, c->len, want_len);
+    failed = 1;
+  }
+
+  for (int i = 0; i < c->len && i < want_len; i++) {
+    char buff[128];
+
+    describe(c, i, buff, sizeof(buff));
+    if (strcmp(buff, want[i]) != 0) {
+      printf("%s: conflict %d is \"%s\", expected \"%s\"\n", name, i, buff,
+             want[i]);
+      failed = 1;
+    }
+  }
+
+  // the table is built exactly when the list is empty
+  ll1_table *t = new_ll1_table(g, fft);
+  if ((t == NULL) != (c->len > 0)) {
+    printf("%s: the table is %sbuilt\n", name, t == NULL ? "not " : "");
+    failed = 1;
+  }
+
+  if (t != NULL)
+    free_ll1_table(t);
+  free_ll1_conflicts(c);
+  free_ff_table(fft);
+  return failed;
+}
+
+int main() {
+  int failed = 0;
+
+  // FIRST(A) = {a, b} and FIRST(B) = {b}, both nullable, FOLLOW(A) =
+  // FOLLOW(B) = {b}
+  grammar *g = new_grammar("SAB", "abc", 'S');
+  add_production(g, 'S', "Ab");
+  add_production(g, 'S', "aS");
+  add_production(g, 'S', "a");
+  add_production(g, 'S', "b");
+  add_production(g, 'A', "a");
+  add_production(g, 'A', "b");
+  add_production(g, 'A', "B");
+  add_production(g, 'B', "b");
+  add_production(g, 'B', "epsilon");
+
+  const char *want[] = {"S a FIRST 0 1 2", "S b FIRST 0 3", "A b FIRST 5 6",
+                        "B b FOLLOW 7 8"};
+  failed |= check_conflicts(g, "conflicts", want, 4);
+  free_grammar(g);
+
+  // the expression grammar of main.c is LL(1)
+  g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  failed |= check_conflicts(g, "expr", NULL, 0);
+  free_grammar(g);
+
+  if (!failed)
+    printf("conflicts: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,125 @@
+#include "../include/grammar_file.h"
+#include "../include/ll1.h"
+
+// main.out --emit-parser writes a parser that is compiled on its own here
+// and has to agree with ll1_recognize. make test passes the library sources
+// in TEST_SRCS.
+
+#ifndef TEST_SRCS
+#error "build with make test, which defines TEST_SRCS"
+#endif
+
+static const char *text = "<S> ::= <A> <B> ;\n"
+                          "<A> ::= <C> <D> ;\n"
+                          "<B> ::= \"+\" <A> <B> | eps ;\n"
+                          "<C> ::= <I> | \"(\" <S> \")\" ;\n"
+                          "<D> ::= \"*\" <C> <D> | eps ;\n"
+                          "<I> ::= \"a\" | \"b\" | \"c\" | \"d\" ;\n";
+
+static const char *inputs[] = {"a",    "(a+b)*c", "a+",    "",  "((a))",
+                               "a*b+c", "a)",     "(a+b", "x", "a+b*(c+d)"};
+
+#define EMIT_DEPTH 20000
+
+static int write_file(const char *path, const char *data) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return -1;
+
+  fputs(data, f);
+  return fclose(f);
+}
+
+static int run(const char *fmt, const char *dir) {
+  char cmd[4096];
+  snprintf(cmd, sizeof(cmd), fmt, dir, dir, dir);
+  return system(cmd);
+}
+
+int main() {
+  char dir[] = "/tmp/ll1_emit_XXXXXX";
+  char path[256];
+  int count = sizeof(inputs) / sizeof(inputs[0]);
+
+  if (mkdtemp(dir) == NULL) {
+    printf("emit_parser: no temporary directory\n");
+    return 1;
+  }
+
+  // the driver prints what the emitted recognizer says about every input,
+  // then about a nesting past its depth limit
+  char driver[4096];
+  int l = snprintf(driver, sizeof(driver),
+                   "#include \"calc.c\"\n"
+                   "#include <stdio.h>\n"
+                   "static const char *inputs[] = {");
+  for (int i = 0; i < count; i++)
+    l += snprintf(driver + l, sizeof(driver) - l, "\"%s\", ", inputs[i]);
+  snprintf(driver + l, sizeof(driver) - l,
+           "};\n"
+           "static char deep[%d];\n"
+           "int main() {\n"
+           "  for (int i = 0; i < %d; i++)\n"
+           "    printf(\"%%d\\n\", calc_recognize(inputs[i], "
+           "strlen(inputs[i])));\n"
+           "  for (int i = 0; i < %d; i++)\n"
+           "    deep[i] = i < %d ? '(' : i == %d ? 'a' : ')';\n"
+           "  printf(\"%%d\\n\", calc_recognize(deep, %d));\n"
+           "  return 0;\n"
+           "}\n",
+           2 * EMIT_DEPTH + 1, count, 2 * EMIT_DEPTH + 1, EMIT_DEPTH,
+           EMIT_DEPTH, 2 * EMIT_DEPTH + 1);
+
+  snprintf(path, sizeof(path), "%s/calc.bnf", dir);
+  int failed = write_file(path, text) != 0;
+  snprintf(path, sizeof(path), "%s/driver.c", dir);
+  failed |= write_file(path, driver) != 0;
+
+  failed = failed ||
+           run("g++ -o %s/main.out src/main.c " TEST_SRCS, dir) != 0 ||
+           run("%s/main.out --grammar %s/calc.bnf --emit-parser calc > "
+               "%s/calc.c",
+               dir) != 0 ||
+           run("g++ -Iinclude -o %s/driver.out %s/driver.c " TEST_SRCS, dir) !=
+               0 ||
+           run("%s/driver.out > %s/verdicts.txt", dir) != 0;
+
+  if (failed)
+    printf("emit_parser: cannot emit, build or run the parser\n");
+
+  grammar_file_error err;
+  grammar *g = new_grammar_from_text(text, strlen(text), &err);
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+
+  snprintf(path, sizeof(path), "%s/verdicts.txt", dir);
+  FILE *f = failed ? NULL : fopen(path, "r");
+
+  for (int i = 0; f != NULL && i <= count; i++) {
+    int got;
+    int want = i < count ? ll1_recognize(t, g->start_var, inputs[i],
+                                         strlen(inputs[i]))
+                         : STRING_RECOGNIZE_ERROR;
+
+    if (fscanf(f, "%d", &got) != 1 || got != want) {
+      printf("emit_parser: \"%s\" gives %d, expected %d\n",
+             i < count ? inputs[i] : "deep nesting", got, want);
+      failed = 1;
+    }
+  }
+
+  if (f != NULL)
+    fclose(f);
+
+  run("rm -rf %s", dir);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("emit_parser: ok\n");
+
+  return failed;
+}
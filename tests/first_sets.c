@@ -0,0 +1,113 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// FIRST has to see past nullable leading variables, and the fixpoint has to
+// end on left recursion
+
+// set holds exactly the terminals named in want, $ for the end marker
+static int same_set(grammar *g, bitset_word *set, const char *want,
+                    const char *what) {
+  for (int i = 0; i < g->terminals_len; i++) {
+    const char *name = symbol_name(g->symbols, terminal_symbol(i));
+
+    if (bitset_test(set, i) != (strchr(want, name[0]) != NULL)) {
+      printf("%s: %s %s, expected {%s}\n", what, name,
+             bitset_test(set, i) ? "is in it" : "is missing", want);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int check_first(grammar *g, ff_table *fft, char var, const char *want,
+                       int nullable) {
+  char what[] = "FIRST(?)";
+  symbol_id v = find_var(g->symbols, &var, 1);
+
+  what[6] = var;
+
+  if (fft->nullable[symbol_index(v)] != nullable) {
+    printf("%c is %snullable\n", var, nullable ? "not " : "");
+    return 1;
+  }
+
+  return !same_set(g, ff_first_set(fft, v), want, what);
+}
+
+static int check_suffix(grammar *g, ff_table *fft, char var, int from,
+                        const char *want, int nullable) {
+  symbol_id v = find_var(g->symbols, &var, 1);
+  production_rhs *rhs = g->productions_table->productions[symbol_index(v)]
+                            .first_rhs;
+
+  if (ff_rhs_nullable(fft, rhs, from) != nullable) {
+    printf("suffix %d of %c is %snullable\n", from, var,
+           nullable ? "not " : "");
+    return 1;
+  }
+
+  return !same_set(g, ff_rhs_first_set(fft, rhs, from), want, "suffix FIRST");
+}
+
+static int check_nullable_prefix() {
+  grammar *g = new_grammar("SABX", "abc", 'S');
+  add_production(g, 'S', "ABc");
+  add_production(g, 'A', "a");
+  add_production(g, 'A', "epsilon");
+  add_production(g, 'B', "b");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'X', "AB");
+
+  ff_table *fft = new_ff_table(g);
+  int failed = calculate_firsts(g, fft) != SUCCESS_ON_FIRST_CALC;
+
+  failed |= check_first(g, fft, 'S', "abc", 0);
+  failed |= check_first(g, fft, 'A', "a", 1);
+  failed |= check_first(g, fft, 'B', "b", 1);
+  failed |= check_first(g, fft, 'X', "ab", 1);
+  failed |= check_suffix(g, fft, 'S', 0, "abc", 0);
+  failed |= check_suffix(g, fft, 'S', 1, "bc", 0);
+  failed |= check_suffix(g, fft, 'S', 2, "c", 0);
+  failed |= check_suffix(g, fft, 'S', 3, "", 1);
+  failed |= check_suffix(g, fft, 'X', 1, "b", 1);
+
+  free_ff_table(fft);
+  free_grammar(g);
+  return failed;
+}
+
+static int check_left_recursion() {
+  grammar *g = new_grammar("ETFN", "+*()xe", 'E');
+  add_production(g, 'E', "E+T");
+  add_production(g, 'E', "T");
+  add_production(g, 'T', "T*F");
+  add_production(g, 'T', "F");
+  add_production(g, 'F', "(E)");
+  add_production(g, 'F', "NF");
+  add_production(g, 'F', "x");
+  add_production(g, 'N', "epsilon");
+  add_production(g, 'N', "e");
+
+  ff_table *fft = new_ff_table(g);
+  int failed = calculate_firsts(g, fft) != SUCCESS_ON_FIRST_CALC;
+
+  failed |= check_first(g, fft, 'E', "(xe", 0);
+  failed |= check_first(g, fft, 'T', "(xe", 0);
+  failed |= check_first(g, fft, 'F', "(xe", 0);
+  failed |= check_first(g, fft, 'N', "e", 1);
+
+  free_ff_table(fft);
+  free_grammar(g);
+  return failed;
+}
+
+int main() {
+  int failed = check_nullable_prefix();
+  failed |= check_left_recursion();
+
+  if (!failed)
+    printf("first_sets: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,193 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// the flat tree of an input is the pointer tree of it in preorder, and
+// converting either way gives the other back
+
+#define FLAT_DEPTH 100000
+
+typedef struct walk_entry {
+  ll1_parse_node *n;
+  int parent;
+} walk_entry;
+
+// the pointer tree in preorder: symbols, parents, children counts and the
+// terminals before each node, walked without recursing
+static int preorder(ll1_parse_tree *tree, symbol_id *syms, int *parents,
+                    int *children, int *before) {
+  int max = 64, top = 0, len = 0, leaves = 0;
+  walk_entry *stack = (walk_entry *)malloc(sizeof(walk_entry) * max);
+
+  stack[top].n = tree->root;
+  stack[top++].parent = LL1_NO_INDEX;
+
+  while (top > 0) {
+    walk_entry e = stack[--top];
+
+    syms[len] = e.n->sym;
+    parents[len] = e.parent;
+    children[len] = e.n->children_len;
+    before[len] = leaves;
+
+    if (e.n->children_len == 0 && symbol_is_terminal(e.n->sym))
+      leaves++;
+
+    while (top + e.n->children_len > max) {
+      max *= 2;
+      stack = (walk_entry *)realloc(stack, sizeof(walk_entry) * max);
+    }
+
+    for (int k = e.n->children_len - 1; k >= 0; k--) {
+      stack[top].n = e.n->children[k];
+      stack[top++].parent = len;
+    }
+
+    len++;
+  }
+
+  before[len] = leaves;
+  free(stack);
+  return len;
+}
+
+static int check_flat(ll1_flat_tree *f, ll1_parse_tree *tree,
+                      const char *what, int navigate) {
+  symbol_id *syms = (symbol_id *)malloc(sizeof(symbol_id) * tree->nodes);
+  int *parents = (int *)malloc(sizeof(int) * tree->nodes);
+  int *children = (int *)malloc(sizeof(int) * tree->nodes);
+  int *before = (int *)malloc(sizeof(int) * (tree->nodes + 1));
+  int len = preorder(tree, syms, parents, children, before);
+  int failed = 0;
+
+  if (len != f->len || f->input_len != before[len]) {
+    printf("%s: %d nodes over %d, expected %d over %d\n", what, f->len,
+           f->input_len, len, before[len]);
+    failed = 1;
+  }
+
+  for (int i = 0; !failed && i < len; i++) {
+    int end = f->ends[i];
+
+    failed = f->syms[i] != syms[i] || f->offsets[i] != before[i] ||
+             end <= i || end > len ||
+             ll1_flat_tree_span_end(f, i) != before[end] ||
+             (navigate && (ll1_flat_tree_parent(f, i) != parents[i] ||
+                           ll1_flat_tree_children_len(f, i) != children[i]));
+
+    for (int c = ll1_flat_tree_first_child(f, i); navigate && !failed &&
+                                                  c != LL1_NO_INDEX;
+         c = ll1_flat_tree_next_sibling(f, i, c))
+      failed = parents[c] != i;
+
+    if (failed)
+      printf("%s: node %d differs\n", what, i);
+  }
+
+  free(syms);
+  free(parents);
+  free(children);
+  free(before);
+  return failed;
+}
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++) {
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+  }
+
+  return 1;
+}
+
+// the flat tree of str against the pointer tree, then both conversions
+static int check_input(ll1_table *t, symbol_id start_var, const char *str,
+                       int navigate) {
+  int len = strlen(str);
+  ll1_flat_tree *f = new_ll1_flat_tree(0);
+  ll1_flat_tree *back = new_ll1_flat_tree(0);
+  ll1_parse_tree *tree = new_ll1_parse_tree(start_var);
+  ll1_parse_tree *from_flat = NULL;
+  int res = fill_flat_tree_with_string(t, f, start_var, str, len);
+  int want = fill_parse_tree_with_string(t, tree, start_var, str, len, NULL);
+  int failed = 0;
+
+  if (res != want) {
+    printf("\"%.40s\": flat tree returned %d, expected %d\n", str, res, want);
+    failed = 1;
+  } else if (res == STRING_PARSE_SUCCESS) {
+    failed |= check_flat(f, tree, "fill_flat_tree", navigate);
+
+    if (ll1_flat_tree_from_tree(back, tree) != STRING_PARSE_SUCCESS)
+      failed = 1;
+    else
+      failed |= check_flat(back, tree, "ll1_flat_tree_from_tree", navigate);
+
+    from_flat = new_ll1_parse_tree_from_flat(f);
+    if (from_flat == NULL || from_flat->nodes != tree->nodes ||
+        (navigate && !same_tree(from_flat->root, tree->root))) {
+      printf("\"%.40s\": new_ll1_parse_tree_from_flat differs\n", str);
+      failed = 1;
+    } else if (!navigate &&
+               (ll1_flat_tree_from_tree(back, from_flat) !=
+                    STRING_PARSE_SUCCESS ||
+                check_flat(back, tree, "deep round trip", 0))) {
+      failed = 1;
+    }
+  }
+
+  if (from_flat != NULL)
+    free_ll1_parse_tree(from_flat);
+  free_ll1_parse_tree(tree);
+  free_ll1_flat_tree(back);
+  free_ll1_flat_tree(f);
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  int failed = 0;
+
+  const char *inputs[] = {"a",         "a+b",     "(a+b)*c",
+                          "((a))*b+c", "a*b*c*d", "(a+(b*(c+d)))",
+                          "a+",        "(a",      "a)b",
+                          "x"};
+  for (int i = 0; i < (int)(sizeof(inputs) / sizeof(inputs[0])); i++)
+    failed |= check_input(t, g->start_var, inputs[i], 1);
+
+  char *deep = (char *)malloc(FLAT_DEPTH * 2 + 2);
+  memset(deep, '(', FLAT_DEPTH);
+  deep[FLAT_DEPTH] = 'a';
+  memset(deep + FLAT_DEPTH + 1, ')', FLAT_DEPTH);
+  deep[FLAT_DEPTH * 2 + 1] = '\0';
+  failed |= check_input(t, g->start_var, deep, 0);
+  free(deep);
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("flat_tree: ok\n");
+
+  return failed;
+}
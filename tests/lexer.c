@@ -0,0 +1,150 @@
+#include "../include/grammar_file.h"
+#include "../include/lexer.h"
+
+// longest match with the first definition winning ties, and runs skipped
+// in blocks giving the same tokens as stepping the DFA byte by byte, wherever
+// the run starts and ends relative to a block
+
+static const char *text = "%token WHILE \"while\"\n"
+                          "%token ID /[a-z_][a-z0-9_]*/\n"
+                          "%token NUM /[0-9]+/\n"
+                          "%skip /[ \\t\\n]+/\n"
+                          "<s> ::= <item> <s> | eps ;\n"
+                          "<item> ::= WHILE | ID | NUM | \">=\" | \">\" ;\n";
+
+typedef struct lexer_case {
+  const char *str;
+  int res;
+  const char *tokens;
+} lexer_case;
+
+// tokens as name@offset+len, space separated
+static const lexer_case cases[] = {
+    {"while", LEXER_SUCCESS, "WHILE@0+5"},
+    {"whilex", LEXER_SUCCESS, "ID@0+6"},
+    {"whil", LEXER_SUCCESS, "ID@0+4"},
+    {"while while_", LEXER_SUCCESS, "WHILE@0+5 ID@6+6"},
+    {">=>", LEXER_SUCCESS, ">=@0+2 >@2+1"},
+    {"a1 22\n\t>", LEXER_SUCCESS, "ID@0+2 NUM@3+2 >@7+1"},
+    {"  ", LEXER_SUCCESS, ""},
+    {"", LEXER_SUCCESS, ""},
+    {"ab $", 3, "ID@0+2"},
+    {"=", 0, ""},
+};
+
+static void format_tokens(grammar *g, lexer_tokens *t, char *buff, int max) {
+  int l = 0;
+
+  buff[0] = '\0';
+  for (int i = 0; i < t->len && l < max; i++)
+    l += snprintf(buff + l, max - l, "%s%s@%d+%d", i > 0 ? " " : "",
+                  symbol_name(g->symbols, terminal_symbol(t->cols[i])),
+                  t->offsets[i], t->lens[i]);
+}
+
+// lex_string without the run skipping
+static int lex_bytewise(lexer *l, const char *str, int str_len,
+                        lexer_tokens *out) {
+  int i = 0;
+
+  out->len = 0;
+
+  while (i < str_len) {
+    int state = 0;
+    int end = -1;
+    int accept = LEXER_NO_ACCEPT;
+
+    for (int j = i; j < str_len; j++) {
+      state = l->trans[state * l->classes_len +
+                       l->byte_classes[(unsigned char)str[j]]];
+      if (state == LEXER_DEAD_STATE)
+        break;
+
+      if (l->accepts[state] != LEXER_NO_ACCEPT) {
+        end = j + 1;
+        accept = l->accepts[state];
+      }
+    }
+
+    if (end <= i)
+      return i;
+
+    if (accept != LEXER_SKIP)
+      lexer_tokens_push(out, accept, i, end - i);
+    i = end;
+  }
+
+  return LEXER_SUCCESS;
+}
+
+int main() {
+  grammar_file_error err;
+  grammar *g = new_grammar_from_text(text, strlen(text), &err);
+  lexer *l = g != NULL ? new_lexer(g) : NULL;
+
+  if (l == NULL) {
+    printf("lexer: cannot build the lexer: %s\n", err.msg);
+    return 1;
+  }
+
+  lexer_tokens *got = new_lexer_tokens(0);
+  lexer_tokens *want = new_lexer_tokens(0);
+  char got_str[256];
+  char want_str[256];
+  int failed = 0;
+
+  for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+    const lexer_case *c = &cases[i];
+    int res = lex_string(l, c->str, strlen(c->str), got);
+
+    format_tokens(g, got, got_str, sizeof(got_str));
+
+    if (res != c->res || strcmp(got_str, c->tokens) != 0) {
+      printf("\"%s\": %d \"%s\", expected %d \"%s\"\n", c->str, res, got_str,
+             c->res, c->tokens);
+      failed = 1;
+    }
+  }
+
+  // an identifier and a blank run of every length up to 40, shifted through
+  // a 16 byte block, then a byte the run stops at
+  char str[128];
+
+  for (int pad = 0; pad < 18; pad++) {
+    for (int id = 0; id <= 40; id++) {
+      for (int blank = 0; blank <= 40; blank++) {
+        int len = 0;
+
+        memset(str, ' ', pad);
+        len += pad;
+        for (int k = 0; k < id; k++)
+          str[len++] = k == 0 ? 'q' : "a_9"[k % 3];
+        for (int k = 0; k < blank; k++)
+          str[len++] = " \t\n"[k % 3];
+        str[len++] = blank % 2 ? '7' : '$';
+
+        int res = lex_string(l, str, len, got);
+        int res_want = lex_bytewise(l, str, len, want);
+
+        format_tokens(g, got, got_str, sizeof(got_str));
+        format_tokens(g, want, want_str, sizeof(want_str));
+
+        if (res != res_want || strcmp(got_str, want_str) != 0) {
+          printf("pad %d, id %d, blank %d: %d \"%s\", expected %d \"%s\"\n",
+                 pad, id, blank, res, got_str, res_want, want_str);
+          failed = 1;
+        }
+      }
+    }
+  }
+
+  free_lexer_tokens(got);
+  free_lexer_tokens(want);
+  free_lexer(l);
+  free_grammar(g);
+
+  if (!failed)
+    printf("lexer: ok\n");
+
+  return failed;
+}
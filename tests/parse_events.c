@@ -0,0 +1,187 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// the events of a parse are a preorder walk of its tree, and a callback
+// returning non zero stops the parse right after it
+
+// events are logged as "(S" for enter_var, "a@0" for a terminal at an
+// offset, "e" for epsilon and ")" for exit_var, one per line
+typedef struct event_log {
+  symbol_table *symbols;
+  char *buff;
+  int len;
+  int max;
+  int events;
+  int stop_at;
+  int bad_rhs;
+} event_log;
+
+static int log_event(event_log *l, const char *fmt, const char *name,
+                     int offset) {
+  if (l->len + 64 > l->max) {
+    l->max *= 2;
+    l->buff = (char *)realloc(l->buff, l->max);
+  }
+
+  l->len += snprintf(l->buff + l->len, l->max - l->len, fmt, name, offset);
+  return ++l->events == l->stop_at;
+}
+
+static int on_enter(void *data, symbol_id var, production_rhs *rhs) {
+  event_log *l = (event_log *)data;
+
+  if (rhs == NULL || rhs->for_var != var)
+    l->bad_rhs = 1;
+
+  return log_event(l, "(%s\n", symbol_name(l->symbols, var), 0);
+}
+
+static int on_terminal(void *data, symbol_id terminal, int offset) {
+  event_log *l = (event_log *)data;
+  return log_event(l, "%s@%d\n", symbol_name(l->symbols, terminal), offset);
+}
+
+static int on_epsilon(void *data, symbol_id var) {
+  event_log *l = (event_log *)data;
+  (void)var;
+  return log_event(l, "e\n", "", 0);
+}
+
+static int on_exit(void *data, symbol_id var) {
+  event_log *l = (event_log *)data;
+  (void)var;
+  return log_event(l, ")\n", "", 0);
+}
+
+// the log the tree of a parse gives
+static void log_tree(event_log *l, ll1_parse_node *n, int *offset) {
+  if (n->sym == SYMBOL_EPSILON) {
+    log_event(l, "e\n", "", 0);
+  } else if (symbol_is_terminal(n->sym)) {
+    log_event(l, "%s@%d\n", symbol_name(l->symbols, n->sym), (*offset)++);
+  } else {
+    log_event(l, "(%s\n", symbol_name(l->symbols, n->sym), 0);
+    for (int i = 0; i < n->children_len; i++)
+      log_tree(l, n->children[i], offset);
+    log_event(l, ")\n", "", 0);
+  }
+}
+
+static void init_log(event_log *l, symbol_table *s, int stop_at) {
+  l->symbols = s;
+  l->max = 256;
+  l->buff = (char *)malloc(l->max);
+  l->buff[0] = '\0';
+  l->len = 0;
+  l->events = 0;
+  l->stop_at = stop_at;
+  l->bad_rhs = 0;
+}
+
+static int run(ll1_table *t, symbol_id start_var, const char *str,
+               event_log *l, int tokens) {
+  ll1_parse_callbacks cb = {l, on_enter, on_terminal, on_epsilon, on_exit};
+  int len = strlen(str);
+
+  if (!tokens)
+    return ll1_parse_events(t, start_var, str, len, &cb);
+
+  int *cols = (int *)malloc(sizeof(int) * (len + 1));
+  for (int i = 0; i < len; i++)
+    cols[i] = t->terminal_cols[(unsigned char)str[i]];
+
+  int res = ll1_parse_events_tokens(t, start_var, cols, len, &cb);
+  free(cols);
+  return res;
+}
+
+static int check_events(ll1_table *t, grammar *g, const char *str,
+                        int tokens) {
+  ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+  int want_res = fill_parse_tree_with_string(t, tree, g->start_var, str,
+                                             strlen(str), NULL);
+  event_log want, got;
+  int failed = 0, offset = 0;
+
+  init_log(&want, g->symbols, 0);
+  init_log(&got, g->symbols, 0);
+  if (want_res == STRING_PARSE_SUCCESS)
+    log_tree(&want, tree->root, &offset);
+
+  int res = run(t, g->start_var, str, &got, tokens);
+
+  if (res != want_res || got.bad_rhs ||
+      (res == STRING_PARSE_SUCCESS && strcmp(got.buff, want.buff) != 0)) {
+    printf("\"%s\": returned %d, expected %d, events:\n%s", str, res,
+           want_res, got.buff);
+    failed = 1;
+  }
+
+  // stopping at every event delivers exactly the events up to it
+  for (int stop = 1; !failed && stop <= got.events; stop++) {
+    event_log part;
+
+    init_log(&part, g->symbols, stop);
+    res = run(t, g->start_var, str, &part, tokens);
+
+    if (res != STRING_PARSE_STOPPED || part.events != stop ||
+        strncmp(part.buff, got.buff, part.len) != 0) {
+      printf("\"%s\": stopping at event %d returned %d after %d events\n",
+             str, stop, res, part.events);
+      failed = 1;
+    }
+
+    free(part.buff);
+  }
+
+  // no callbacks at all
+  ll1_parse_callbacks none = {NULL, NULL, NULL, NULL, NULL};
+  if (ll1_parse_events(t, g->start_var, str, strlen(str), &none) !=
+      want_res) {
+    printf("\"%s\": a parse without callbacks differs\n", str);
+    failed = 1;
+  }
+
+  free(want.buff);
+  free(got.buff);
+  free_ll1_parse_tree(tree);
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  int failed = 0;
+
+  const char *inputs[] = {"a", "a+b", "(a+b)*c", "((a))*b+(c*d)", "a+",
+                          "a)", "x"};
+  for (int i = 0; i < (int)(sizeof(inputs) / sizeof(inputs[0])); i++) {
+    failed |= check_events(t, g, inputs[i], 0);
+    failed |= check_events(t, g, inputs[i], 1);
+  }
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("parse_events: ok\n");
+
+  return failed;
+}
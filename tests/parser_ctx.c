@@ -0,0 +1,139 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// one context and one tree reused across parses of any size and outcome
+// give what a fresh parse gives, and the stack stops growing once it has
+// seen the deepest input
+
+#define CTX_DEPTH 50000
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++) {
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+  }
+
+  return 1;
+}
+
+static char *nested(int depth) {
+  char *str = (char *)malloc(depth * 2 + 2);
+
+  memset(str, '(', depth);
+  str[depth] = 'a';
+  memset(str + depth + 1, ')', depth);
+  str[depth * 2 + 1] = '\0';
+
+  return str;
+}
+
+static int check_parse(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                       symbol_id start_var, const char *str, int tokens) {
+  ll1_table *t = ctx->table;
+  int len = strlen(str);
+  ll1_parse_tree *want = new_ll1_parse_tree(start_var);
+  int want_res = fill_parse_tree_with_string(t, want, start_var, str, len,
+                                             NULL);
+  int verdict = ll1_recognize(t, start_var, str, len);
+  int res;
+
+  if (tokens) {
+    int *cols = (int *)malloc(sizeof(int) * len);
+    for (int i = 0; i < len; i++)
+      cols[i] = t->terminal_cols[(unsigned char)str[i]];
+
+    res = ll1_parser_ctx_parse_tokens(ctx, tree, start_var, cols, len, NULL);
+    free(cols);
+  } else {
+    res = ll1_parser_ctx_parse_string(ctx, tree, start_var, str, len, NULL);
+  }
+
+  int failed = res != want_res ||
+               (res == STRING_PARSE_SUCCESS) !=
+                   (verdict == STRING_RECOGNIZE_SUCCESS) ||
+               (res == STRING_PARSE_SUCCESS &&
+                (tree->nodes != want->nodes ||
+                 (len < 1000 && !same_tree(tree->root, want->root))));
+
+  if (failed)
+    printf("\"%.40s\"%s: returned %d with %d nodes, expected %d with %d\n",
+           str, tokens ? " as tokens" : "", res, tree->nodes, want_res,
+           want->nodes);
+
+  free_ll1_parse_tree(want);
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  ll1_parser_ctx *ctx = new_ll1_parser_ctx(t);
+  ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+  symbol_id s = g->start_var;
+  int failed = 0;
+
+  char *deep = nested(CTX_DEPTH);
+  char *shallow = nested(10);
+  // a rejected parse stops with a deep stack left behind
+  char *broken = nested(CTX_DEPTH / 2);
+  broken[CTX_DEPTH / 2] = '+';
+
+  const char *inputs[] = {"a",     "(a+b)*c", deep,     "a+b",
+                          broken,  "a*",      shallow,  "x",
+                          "(a)+d", deep,      "((b))*c"};
+  int stack_max = 0;
+  ll1_parser_entry *stack = NULL;
+
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < (int)(sizeof(inputs) / sizeof(inputs[0])); i++)
+      failed |= check_parse(ctx, tree, s, inputs[i], round);
+
+    // the second round needs no more room than the first
+    if (round == 0) {
+      stack_max = ctx->max;
+      stack = ctx->stack;
+    } else if (ctx->max != stack_max || ctx->stack != stack) {
+      printf("the stack grew from %d to %d on inputs seen before\n",
+             stack_max, ctx->max);
+      failed = 1;
+    }
+  }
+
+  if (stack_max < CTX_DEPTH) {
+    printf("a %d deep input left a stack of %d\n", CTX_DEPTH, stack_max);
+    failed = 1;
+  }
+
+  free(deep);
+  free(shallow);
+  free(broken);
+  free_ll1_parse_tree(tree);
+  free_ll1_parser_ctx(ctx);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("parser_ctx: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,110 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// the push parser is fed every input whole, split in two at every byte and
+// one byte at a time. verdict, failing offset and tree must not depend on
+// where the chunks end.
+
+static const char *inputs[] = {"a",     "(a+b)*c", "a+",   "",  "((a))",
+                               "a*b+c", "a)",      "(a+b", "x", "a+b*(c+d)"};
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++)
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+
+  return 1;
+}
+
+// feeds str in chunks of step bytes, the first one cut at split
+static int check_chunks(ll1_table *t, symbol_id start_var, const char *str,
+                        int split, int step) {
+  int len = strlen(str);
+  int offset = ll1_recognize(t, start_var, str, len);
+  ll1_parse_tree *tree = new_ll1_parse_tree(start_var);
+  ll1_parse_tree *want = new_ll1_parse_tree(start_var);
+  ll1_push_parser *p = new_ll1_push_parser(t, start_var, tree);
+  int res = LL1_PUSH_RUNNING;
+
+  // an empty first chunk is fed as well
+  res = ll1_feed(p, str, split < len ? split : len);
+
+  for (int i = split; i < len && res == LL1_PUSH_RUNNING; i += step)
+    res = ll1_feed(p, str + i, i + step > len ? len - i : step);
+
+  if (res == LL1_PUSH_RUNNING)
+    res = ll1_finish(p);
+
+  int failed = 0;
+
+  if ((res == LL1_PUSH_ACCEPTED) != (offset == STRING_RECOGNIZE_SUCCESS)) {
+    printf("\"%s\" split at %d: push says %d, recognize %d\n", str, split, res,
+           offset);
+    failed = 1;
+  } else if (res == LL1_PUSH_FAILED && p->offset != offset) {
+    printf("\"%s\" split at %d: failed at %ld, recognize at %d\n", str, split,
+           p->offset, offset);
+    failed = 1;
+  } else if (res == LL1_PUSH_ACCEPTED && len > 0 &&
+             (fill_parse_tree_with_string(t, want, start_var, str, len,
+                                          NULL) != STRING_PARSE_SUCCESS ||
+              !same_tree(tree->root, want->root))) {
+    printf("\"%s\" split at %d: tree differs\n", str, split);
+    failed = 1;
+  }
+
+  // a finished parser keeps its verdict
+  if (!failed && (ll1_feed(p, "a", 1) != res || ll1_finish(p) != res)) {
+    printf("\"%s\" split at %d: verdict changed after the end\n", str, split);
+    failed = 1;
+  }
+
+  free_ll1_push_parser(p);
+  free_ll1_parse_tree(tree);
+  free_ll1_parse_tree(want);
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'A', "CD");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'C', "I");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+
+  int failed = 0;
+  int count = sizeof(inputs) / sizeof(inputs[0]);
+
+  for (int i = 0; i < count; i++) {
+    int len = strlen(inputs[i]);
+
+    for (int split = 0; split <= len; split++)
+      failed |= check_chunks(t, g->start_var, inputs[i], split, len + 1);
+    failed |= check_chunks(t, g->start_var, inputs[i], 1, 1);
+  }
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("push_parser: ok\n");
+
+  return failed;
+}
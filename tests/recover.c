@@ -0,0 +1,122 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// each error is listed once and marked once in the tree: a missing terminal
+// is replaced by the error leaf, skipped input puts one in front of the
+// terminal on top, and a variable or the root holds it as a child
+
+// the tree as "S(a S(c) error b)"
+static int format_node(symbol_table *s, ll1_parse_node *n, char *buff,
+                       int len) {
+  int w = snprintf(buff, len, "%s", symbol_name(s, n->sym));
+
+  for (int i = 0; i < n->children_len && w < len; i++) {
+    w += snprintf(buff + w, len - w, i == 0 ? "(" : " ");
+    w += format_node(s, n->children[i], buff + w, len - w);
+  }
+
+  if (n->children_len > 0 && w < len)
+    w += snprintf(buff + w, len - w, ")");
+
+  return w;
+}
+
+// the errors as "offset found expected skipped", found is # for unknown
+// input and expected lists terminal names
+static void format_errors(symbol_table *s, ll1_parse_errors *e, char *buff,
+                          int len) {
+  int w = 0;
+
+  buff[0] = '\0';
+  for (int i = 0; i < e->len && w < len; i++) {
+    ll1_parse_error *err = &e->data[i];
+    bitset_word *expected = &e->expected[i * e->words];
+
+    w += snprintf(buff + w, len - w, "%s%d %s ", i > 0 ? ", " : "",
+                  err->offset,
+                  err->found == LL1_NO_INDEX
+                      ? "#"
+                      : symbol_name(s, terminal_symbol(err->found)));
+
+    for (int j = 0; j < e->words * BITSET_WORD_BITS && w < len; j++) {
+      if (bitset_test(expected, j))
+        w += snprintf(buff + w, len - w, "%s",
+                      symbol_name(s, terminal_symbol(j)));
+    }
+
+    if (w < len)
+      w += snprintf(buff + w, len - w, " %d", err->skipped);
+  }
+}
+
+static int check_recover(grammar *g, ll1_table *t, ff_table *fft,
+                         const char *str, const char *want_errors,
+                         const char *want_tree) {
+  ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+  ll1_parse_errors *e = new_ll1_parse_errors(t);
+  int res = recover_parse_tree_with_string(t, fft, tree, g->start_var, str,
+                                           strlen(str), e);
+  char errors[256], shape[256];
+  int failed = 0;
+
+  if (res != (want_errors[0] == '\0' ? STRING_PARSE_SUCCESS
+                                     : STRING_PARSE_RECOVERED)) {
+    printf("\"%s\": returned %d\n", str, res);
+    failed = 1;
+  }
+
+  format_errors(g->symbols, e, errors, sizeof(errors));
+  if (strcmp(errors, want_errors) != 0) {
+    printf("\"%s\": errors \"%s\", expected \"%s\"\n", str, errors,
+           want_errors);
+    failed = 1;
+  }
+
+  format_node(g->symbols, tree->root, shape, sizeof(shape));
+  if (strcmp(shape, want_tree) != 0) {
+    printf("\"%s\": tree %s, expected %s\n", str, shape, want_tree);
+    failed = 1;
+  }
+
+  free_ll1_parse_errors(e);
+  free_ll1_parse_tree(tree);
+  return failed;
+}
+
+int main() {
+  grammar *g = new_grammar("S", "abc", 'S');
+  add_production(g, 'S', "aSb");
+  add_production(g, 'S', "c");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  int failed = 0;
+
+  failed |= check_recover(g, t, fft, "acb", "", "S(a S(c) b)");
+  // missing terminal
+  failed |= check_recover(g, t, fft, "ac", "2 $ b 0", "S(a S(c) error)");
+  failed |= check_recover(g, t, fft, "aac", "3 $ b 0, 3 $ b 0",
+                          "S(a S(a S(c) error) error)");
+  // unknown byte with a terminal on top, which still matches after it
+  failed |= check_recover(g, t, fft, "ac#b", "2 # b 1",
+                          "S(a S(c) error b)");
+  // unknown byte with a variable on top
+  failed |= check_recover(g, t, fft, "a##cb", "1 # ac 2",
+                          "S(a S(error c) b)");
+  // no prediction, given up at FOLLOW
+  failed |= check_recover(g, t, fft, "ab", "1 b ac 0", "S(a S(error) b)");
+  // trailing input
+  failed |= check_recover(g, t, fft, "cbb", "1 b $ 2", "S(c error)");
+  failed |= check_recover(g, t, fft, "c#", "1 # $ 1", "S(c error)");
+
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("recover: ok\n");
+
+  return failed;
+}
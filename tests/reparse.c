@@ -0,0 +1,157 @@
+#include "../include/grammar.h"
+#include "../include/ll1.h"
+
+// random edits of an expression reparsed in place give the tree a full
+// parse gives, spans included, and the arena stays within a bound of the
+// arena a full parse needs however many edits there are
+
+#define REPARSE_EDITS 5000
+#define REPARSE_TERMS 100
+#define REPARSE_MAX_LEN 8192
+#define REPARSE_ARENA_FACTOR 8
+
+static const char *pieces[] = {"a", "b", "+c", "*d", "(a+b)", "(c)*d",
+                               "+(a*b)", ")", "(", "+", ""};
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len ||
+      a->len != b->len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++) {
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+  }
+
+  return 1;
+}
+
+// replaces the deleted bytes of str at the edit with text, returns the new
+// length
+static int apply_edit(char *str, int len, ll1_edit *e, const char *text) {
+  memmove(str + e->offset + e->inserted, str + e->offset + e->deleted,
+          len - e->offset - e->deleted);
+  memcpy(str + e->offset, text, e->inserted);
+
+  return len + e->inserted - e->deleted;
+}
+
+// reparses str after the edit and compares with a full parse of it
+static int check_edit(ll1_parser_ctx *ctx, ll1_parse_tree *tree,
+                      ll1_parse_tree *full, symbol_id s, const char *str,
+                      int len, ll1_edit *e, int *res) {
+  *res = ll1_reparse_with_string(ctx, tree, s, str, len, e, NULL);
+  int want = ll1_reparse_with_string(ctx, full, s, str, len, NULL, NULL);
+
+  if (*res == want &&
+      (*res != STRING_PARSE_SUCCESS ||
+       (tree->nodes == full->nodes && same_tree(tree->root, full->root))))
+    return 0;
+
+  printf("edit at %d, -%d +%d of \"%.*s\": returned %d, expected %d\n",
+         e->offset, e->deleted, e->inserted, len < 60 ? len : 60, str, *res,
+         want);
+  return 1;
+}
+
+int main() {
+  grammar *g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  ll1_parser_ctx *ctx = new_ll1_parser_ctx(t);
+  ll1_parse_tree *tree = new_ll1_parse_tree(g->start_var);
+  ll1_parse_tree *full = new_ll1_parse_tree(g->start_var);
+  symbol_id s = g->start_var;
+  char *str = (char *)malloc(REPARSE_MAX_LEN + 16);
+  size_t full_max;
+  int len = 0, failed = 0, reparsed = 0;
+
+  srand(7);
+
+  for (int i = 0; i < REPARSE_TERMS; i++)
+    len += sprintf(str + len, "%s(%c*%c)", i > 0 ? "+" : "", 'a' + i % 4,
+                   'a' + (i + 1) % 4);
+
+  if (ll1_reparse_with_string(ctx, tree, s, str, len, NULL, NULL) !=
+          STRING_PARSE_SUCCESS ||
+      ll1_reparse_with_string(ctx, full, s, str, len, NULL, NULL) !=
+          STRING_PARSE_SUCCESS) {
+    printf("the first input is rejected\n");
+    failed = 1;
+  }
+
+  // arenas keep their largest size across resets
+  full_max = full->node_arena->capacity;
+
+  // a rejected edit is taken back, so the input stays mostly valid
+  for (int i = 0; i < REPARSE_EDITS && !failed; i++) {
+    const char *piece = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+    char removed[3];
+    ll1_edit edit;
+    int res;
+
+    edit.offset = rand() % (len + 1);
+    edit.deleted = rand() % (sizeof(removed) + 1);
+    if (edit.offset + edit.deleted > len)
+      edit.deleted = len - edit.offset;
+    edit.inserted = strlen(piece);
+    if (len - edit.deleted + edit.inserted > REPARSE_MAX_LEN)
+      edit.inserted = 0;
+
+    memcpy(removed, str + edit.offset, edit.deleted);
+    len = apply_edit(str, len, &edit, piece);
+    failed = check_edit(ctx, tree, full, s, str, len, &edit, &res);
+    reparsed += res == STRING_PARSE_SUCCESS;
+
+    if (!failed && res != STRING_PARSE_SUCCESS) {
+      int removed_len = edit.deleted;
+
+      edit.deleted = edit.inserted;
+      edit.inserted = removed_len;
+      len = apply_edit(str, len, &edit, removed);
+      failed = check_edit(ctx, tree, full, s, str, len, &edit, &res);
+    }
+
+    if (full->node_arena->capacity > full_max)
+      full_max = full->node_arena->capacity;
+
+    if (tree->node_arena->capacity > full_max * REPARSE_ARENA_FACTOR) {
+      printf("edit %d: the arena holds %zu bytes, a full parse needs %zu\n",
+             i, tree->node_arena->capacity, full_max);
+      failed = 1;
+    }
+  }
+
+  if (!failed && reparsed < REPARSE_EDITS / 10) {
+    printf("only %d of %d edits were accepted\n", reparsed, REPARSE_EDITS);
+    failed = 1;
+  }
+
+  free(str);
+  free_ll1_parse_tree(full);
+  free_ll1_parse_tree(tree);
+  free_ll1_parser_ctx(ctx);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+
+  if (!failed)
+    printf("reparse: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,159 @@
+#include "../include/ll1_static.hpp"
+
+// tables compiled by the C++ compiler have to parse like the runtime ones.
+// the header is also built as C++14, where the table needs its out of class
+// definition to link, and a grammar that is not LL(1) must not compile.
+
+#ifndef TEST_SRCS
+#error "build with make test, which defines TEST_SRCS"
+#endif
+
+static constexpr ll1_static::production calc_prods[] = {
+    {'S', "AB"},      {'A', "CD"},  {'B', "+AB"}, {'B', "epsilon"},
+    {'C', "I"},       {'C', "(S)"}, {'D', "*CD"}, {'D', "epsilon"},
+    {'I', "a"},       {'I', "b"},   {'I', "c"},   {'I', "d"}};
+static constexpr ll1_static::grammar_def calc = {
+    "SABCDI", "+*()abcd", 'S', calc_prods,
+    sizeof(calc_prods) / sizeof(calc_prods[0])};
+
+static const char *inputs[] = {"a",     "(a+b)*c", "a+",   "",  "((a))",
+                               "a*b+c", "a)",      "(a+b", "x", "a+b*(c+d)"};
+
+static const char *cpp14_program =
+    "#include \"ll1_static.hpp\"\n"
+    "static constexpr ll1_static::production prods[] = {\n"
+    "    {'S', \"aS\"}, {'S', \"epsilon\"}};\n"
+    "static constexpr ll1_static::grammar_def g = {\"S\", \"a\", 'S', prods, "
+    "2};\n"
+    "int main() {\n"
+    "  ll1_parse_tree *t = new_ll1_parse_tree(ll1_static::start_var<g>());\n"
+    "  int res = ll1_static::recognize<g>(\"aaa\", 3) ==\n"
+    "                STRING_RECOGNIZE_SUCCESS &&\n"
+    "            ll1_static::fill_parse_tree<g>(t, \"aa\", 2) ==\n"
+    "                STRING_PARSE_SUCCESS;\n"
+    "  free_ll1_parse_tree(t);\n"
+    "  return !res;\n"
+    "}\n";
+
+// S -> a | a b share their FIRST set
+static const char *conflict_program =
+    "#include \"ll1_static.hpp\"\n"
+    "static constexpr ll1_static::production prods[] = {\n"
+    "    {'S', \"a\"}, {'S', \"ab\"}};\n"
+    "static constexpr ll1_static::grammar_def g = {\"S\", \"ab\", 'S', prods, "
+    "2};\n"
+    "int main() { return ll1_static::recognize<g>(\"a\", 1); }\n";
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++)
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+
+  return 1;
+}
+
+static int write_file(const char *dir, const char *name, const char *data) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL)
+    return -1;
+
+  fputs(data, f);
+  return fclose(f);
+}
+
+static int run(const char *fmt, const char *dir) {
+  char cmd[4096];
+  snprintf(cmd, sizeof(cmd), fmt, dir, dir, dir);
+  return system(cmd);
+}
+
+static int check_runtime_match() {
+  grammar *g = new_grammar(calc.vars, calc.terminals, calc.start_var);
+
+  for (int i = 0; i < calc.prods_len; i++)
+    add_production(g, calc.prods[i].var, calc.prods[i].rhs);
+
+  ff_table *fft = new_ff_table(g);
+  calculate_firsts(g, fft);
+  calculate_follows(g, fft);
+  ll1_table *t = new_ll1_table(g, fft);
+  ll1_parse_tree *got = new_ll1_parse_tree(g->start_var);
+  ll1_parse_tree *want = new_ll1_parse_tree(g->start_var);
+  int failed = ll1_static::start_var<calc>() != g->start_var;
+
+  for (int i = 0; i < (int)(sizeof(inputs) / sizeof(inputs[0])); i++) {
+    const char *str = inputs[i];
+    int len = strlen(str);
+    int res = ll1_static::recognize<calc>(str, len);
+    int res_want = ll1_recognize(t, g->start_var, str, len);
+
+    if (res != res_want) {
+      printf("static_tables: \"%s\" gives %d, expected %d\n", str, res,
+             res_want);
+      failed = 1;
+    }
+
+    int parsed = ll1_static::fill_parse_tree<calc>(got, str, len);
+    int parsed_want =
+        fill_parse_tree_with_string(t, want, g->start_var, str, len, NULL);
+
+    if (parsed != parsed_want ||
+        (parsed == STRING_PARSE_SUCCESS && !same_tree(got->root, want->root))) {
+      printf("static_tables: the tree of \"%s\" differs\n", str);
+      failed = 1;
+    }
+  }
+
+  free_ll1_parse_tree(got);
+  free_ll1_parse_tree(want);
+  free_ll1_table(t);
+  free_ff_table(fft);
+  free_grammar(g);
+  return failed;
+}
+
+static int check_builds() {
+  char dir[] = "/tmp/ll1_static_XXXXXX";
+
+  if (mkdtemp(dir) == NULL ||
+      write_file(dir, "cpp14.cpp", cpp14_program) != 0 ||
+      write_file(dir, "conflict.cpp", conflict_program) != 0) {
+    printf("static_tables: no temporary directory\n");
+    return 1;
+  }
+
+  int failed = 0;
+
+  if (run("g++ -std=c++14 -Iinclude -o %s/cpp14.out %s/cpp14.cpp " TEST_SRCS
+          " && %s/cpp14.out",
+          dir) != 0) {
+    printf("static_tables: the C++14 build does not link or run\n");
+    failed = 1;
+  }
+
+  if (run("g++ -fsyntax-only -Iinclude %s/conflict.cpp > %s/conflict.txt "
+          "2>&1 && false || grep -q grammar_is_not_ll1 %s/conflict.txt",
+          dir) != 0) {
+    printf("static_tables: a grammar that is not LL(1) compiles\n");
+    failed = 1;
+  }
+
+  run("rm -rf %s", dir);
+  return failed;
+}
+
+int main() {
+  int failed = check_runtime_match();
+  failed |= check_builds();
+
+  if (!failed)
+    printf("static_tables: ok\n");
+
+  return failed;
+}
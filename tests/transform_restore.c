@@ -0,0 +1,224 @@
+#include "../include/grammar.h"
+#include "../include/grammar_transform.h"
+#include "../include/ll1.h"
+
+// a left recursive source grammar has no LL(1) parse to compare with, but
+// the grammars below are unambiguous, so a restored tree that derives the
+// input with productions of the source is the parse of the source grammar.
+// a grammar that is LL(1) already is compared with its own parse.
+
+#define RESTORE_DEPTH 200000
+
+typedef struct walk_entry {
+  ll1_parse_node *n;
+  int k;
+} walk_entry;
+
+static int is_source_rhs(grammar *g, ll1_parse_node *n) {
+  production *p = &g->productions_table->productions[symbol_index(n->sym)];
+  int len = n->children_len;
+
+  if (len == 1 && n->children[0]->sym == SYMBOL_EPSILON)
+    len = 0;
+
+  for (production_rhs *rhs = p->first_rhs; rhs != NULL; rhs = rhs->next) {
+    int k = 0;
+
+    while (k < len && k < rhs->len && rhs->syms[k] == n->children[k]->sym)
+      k++;
+
+    if (k == len && rhs->len == len)
+      return 1;
+  }
+
+  return 0;
+}
+
+// every variable node is a right hand side of g and the leaves spell str,
+// walked without recursing so deep trees can be checked
+static int derives(grammar *g, ll1_parse_tree *tree, const char *str,
+                   int len) {
+  int max = 64, top = 0, i = 0, ok = tree->root->sym == g->start_var;
+  walk_entry *stack = (walk_entry *)malloc(sizeof(walk_entry) * max);
+
+  stack[top].n = tree->root;
+  stack[top++].k = 0;
+
+  while (ok && top > 0) {
+    walk_entry *e = &stack[top - 1];
+    ll1_parse_node *n = e->n;
+
+    if (e->k == 0 && symbol_is_var(n->sym) && !is_source_rhs(g, n))
+      ok = 0;
+    else if (symbol_is_terminal(n->sym))
+      ok = i < len &&
+           (symbol_id)g->byte_terminals[(unsigned char)str[i++]] == n->sym;
+
+    if (!ok || e->k == n->children_len) {
+      top--;
+      continue;
+    }
+
+    ll1_parse_node *c = n->children[e->k++];
+
+    if (c->sym == SYMBOL_EPSILON)
+      continue;
+
+    if (top == max) {
+      max *= 2;
+      stack = (walk_entry *)realloc(stack, sizeof(walk_entry) * max);
+    }
+
+    stack[top].n = c;
+    stack[top++].k = 0;
+  }
+
+  free(stack);
+  return ok && i == len;
+}
+
+static int same_tree(ll1_parse_node *a, ll1_parse_node *b) {
+  if (a->sym != b->sym || a->children_len != b->children_len)
+    return 0;
+
+  for (int i = 0; i < a->children_len; i++) {
+    if (!same_tree(a->children[i], b->children[i]))
+      return 0;
+  }
+
+  return 1;
+}
+
+// parses str with the transform of source and restores the tree, compared
+// with the parse of source when that has a table
+static int check_restore(grammar *source, const char *name, const char *str) {
+  int res = GRAMMAR_TRANSFORM_ERROR;
+  int len = strlen(str);
+  grammar_transform *t = new_grammar_transform(source, &res);
+
+  if (t == NULL) {
+    printf("%s: cannot transform, %d\n", name, res);
+    return 1;
+  }
+
+  ff_table *fft = new_ff_table(t->g);
+  calculate_firsts(t->g, fft);
+  calculate_follows(t->g, fft);
+  ll1_table *table = new_ll1_table(t->g, fft);
+  ll1_parse_tree *tree = new_ll1_parse_tree(t->g->start_var);
+  ll1_parse_tree *restored = NULL;
+  int failed = 1;
+
+  if (table == NULL) {
+    printf("%s: the transformed grammar is not LL(1)\n", name);
+  } else if (fill_parse_tree_with_string(table, tree, t->g->start_var, str,
+                                         len, NULL) != STRING_PARSE_SUCCESS) {
+    printf("%s: \"%.40s\" is rejected\n", name, str);
+  } else if ((restored = grammar_transform_restore_tree(t, tree)) == NULL) {
+    printf("%s: \"%.40s\" is not restored\n", name, str);
+  } else if (!derives(source, restored, str, len)) {
+    printf("%s: \"%.40s\" is restored to a wrong tree\n", name, str);
+  } else {
+    failed = 0;
+  }
+
+  ff_table *source_fft = new_ff_table(source);
+  calculate_firsts(source, source_fft);
+  calculate_follows(source, source_fft);
+  ll1_table *source_table = new_ll1_table(source, source_fft);
+
+  if (!failed && source_table != NULL) {
+    ll1_parse_tree *want = new_ll1_parse_tree(source->start_var);
+
+    fill_parse_tree_with_string(source_table, want, source->start_var, str,
+                                len, NULL);
+    if (!same_tree(want->root, restored->root)) {
+      printf("%s: \"%s\" is not the parse of the source\n", name, str);
+      failed = 1;
+    }
+
+    free_ll1_parse_tree(want);
+  }
+
+  if (source_table != NULL)
+    free_ll1_table(source_table);
+  free_ff_table(source_fft);
+  if (restored != NULL)
+    free_ll1_parse_tree(restored);
+  free_ll1_parse_tree(tree);
+  if (table != NULL)
+    free_ll1_table(table);
+  free_ff_table(fft);
+  free_grammar_transform(t);
+
+  return failed;
+}
+
+static char *nested(int depth) {
+  char *str = (char *)malloc(depth * 2 + 2);
+
+  memset(str, '(', depth);
+  str[depth] = 'a';
+  memset(str + depth + 1, ')', depth);
+  str[depth * 2 + 1] = '\0';
+
+  return str;
+}
+
+int main() {
+  int failed = 0;
+
+  // direct left recursion, lists of lists
+  grammar *g = new_grammar("ETF", "+*()a", 'E');
+  add_production(g, 'E', "E+T");
+  add_production(g, 'E', "T");
+  add_production(g, 'T', "T*F");
+  add_production(g, 'T', "F");
+  add_production(g, 'F', "(E)");
+  add_production(g, 'F', "a");
+
+  const char *direct[] = {"a", "a+a", "a*a", "a+a*a+a", "a*(a+a)*a",
+                          "((a))+a*a*a+(a*a)"};
+  for (int i = 0; i < (int)(sizeof(direct) / sizeof(direct[0])); i++)
+    failed |= check_restore(g, "direct", direct[i]);
+
+  char *deep = nested(RESTORE_DEPTH);
+  failed |= check_restore(g, "direct", deep);
+  free(deep);
+  free_grammar(g);
+
+  // S -> A -> S + a, left recursion through another variable
+  g = new_grammar("SA", "+()a", 'S');
+  add_production(g, 'S', "A");
+  add_production(g, 'A', "S+a");
+  add_production(g, 'A', "(S)");
+  add_production(g, 'A', "a");
+
+  const char *indirect[] = {"a", "a+a", "(a)", "(a)+a+a", "((a+a))+a"};
+  for (int i = 0; i < (int)(sizeof(indirect) / sizeof(indirect[0])); i++)
+    failed |= check_restore(g, "indirect", indirect[i]);
+  free_grammar(g);
+
+  // the expression grammar of main.c is LL(1) as it is
+  g = new_grammar("SABCDI", "+*()abcd", 'S');
+  add_production(g, 'S', "AB");
+  add_production(g, 'B', "+AB");
+  add_production(g, 'B', "epsilon");
+  add_production(g, 'A', "CD");
+  add_production(g, 'D', "*CD");
+  add_production(g, 'D', "epsilon");
+  add_production(g, 'C', "(S)");
+  add_production(g, 'C', "I");
+  add_production(g, 'I', "a");
+  add_production(g, 'I', "b");
+  add_production(g, 'I', "c");
+  add_production(g, 'I', "d");
+
+  failed |= check_restore(g, "expr", "(a+b)*c+d*(a)");
+  free_grammar(g);
+
+  if (!failed)
+    printf("transform_restore: ok\n");
+
+  return failed;
+}